@@ -489,6 +489,7 @@ BOOL CBTClient::OnHandshake2()
 	if ( CDownloadSource* pSource = GetSource() )	// Transfer exists, so must be initiated from this side
 	{
 		pSource->m_oGUID = transformGuid( m_oGUID );
+		m_pDownload->ReindexSource( pSource );
 
 		// ToDo: This seems to trip when it shouldn't. Should be investigated...
 		//if ( memcmp( &m_pGUID, &pSource->m_pGUID, 16 ) != 0 )
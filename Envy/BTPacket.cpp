@@ -149,10 +149,10 @@ void CDHT::Connect()
 		for ( CHostCacheIterator i = HostCache.BitTorrent.Begin(); i != HostCache.BitTorrent.End() && nCount < 100; ++i )
 		{
 			CHostCacheHostPtr pCache = (*i);
-			if ( pCache->m_oBtGUID )
+			if ( pCache->Extra().m_oBtGUID )
 			{
 				SOCKADDR_IN sa = { AF_INET, htons( pCache->m_nPort ), pCache->m_pAddress };
-				dht_insert_node( &pCache->m_oBtGUID[ 0 ], (sockaddr*)&sa, sizeof( SOCKADDR_IN ) );
+				dht_insert_node( &pCache->Extra().m_oBtGUID[ 0 ], (sockaddr*)&sa, sizeof( SOCKADDR_IN ) );
 				nCount++;
 			}
 		}
@@ -192,8 +192,9 @@ void CDHT::Disconnect()
 			if ( CHostCacheHostPtr pCache = HostCache.BitTorrent.Add( &pHosts[ i ].sin_addr, pHosts[ i].sin_port ) )
 			{
 			//	pCache->m_bDHT = TRUE;	// Unused
-				CopyMemory( &pCache->m_oBtGUID[ 0 ], &pIDs[ i * Hashes::BtGuid::byteCount ], Hashes::BtGuid::byteCount );
-				pCache->m_oBtGUID.validate();
+				CHostCacheExtra& oExtra = pCache->EditExtra();
+				CopyMemory( &oExtra.m_oBtGUID[ 0 ], &pIDs[ i * Hashes::BtGuid::byteCount ], Hashes::BtGuid::byteCount );
+				oExtra.m_oBtGUID.validate();
 			}
 		}
 	}
@@ -318,8 +319,9 @@ void CDHT::OnEvent(void* /*closure*/, int evt, const unsigned char* info_hash, c
 			// Node just added
 			if ( CHostCacheHostPtr pCache = HostCache.BitTorrent.Add( &pHost->sin_addr, htons( pHost->sin_port ) ) )
 			{
-				CopyMemory( &pCache->m_oBtGUID[ 0 ], info_hash, Hashes::BtGuid::byteCount );
-				pCache->m_oBtGUID.validate();
+				CHostCacheExtra& oExtra = pCache->EditExtra();
+				CopyMemory( &oExtra.m_oBtGUID[ 0 ], info_hash, Hashes::BtGuid::byteCount );
+				oExtra.m_oBtGUID.validate();
 
 				HostCache.BitTorrent.m_nCookie++;
 			}
@@ -688,7 +690,7 @@ BOOL CBTPacket::OnPacket(const SOCKADDR_IN* pHost)
 
 			if ( CHostCacheHostPtr pCache = HostCache.BitTorrent.OnSuccess( &pHost->sin_addr, htons( pHost->sin_port ) ) )
 			{
-				pCache->m_sName = strName;
+				pCache->EditExtra().m_sName = strName;
 				HostCache.BitTorrent.m_nCookie++;
 			}
 		}
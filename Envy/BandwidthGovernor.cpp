@@ -0,0 +1,240 @@
+//
+// BandwidthGovernor.cpp
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+#include "StdAfx.h"
+#include "Settings.h"
+#include "Envy.h"
+#include "BandwidthGovernor.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#define new DEBUG_NEW
+#endif	// Debug
+
+CBandwidthGovernor BandwidthGovernor;
+
+
+//////////////////////////////////////////////////////////////////////
+// CBandwidthGovernor construction
+
+CBandwidthGovernor::CBandwidthGovernor()
+	: m_tRefill		( 0 )
+	, m_tMeasure	( 0 )
+{
+	ZeroMemory( m_pLine, sizeof( m_pLine ) );
+	ZeroMemory( m_pClass, sizeof( m_pClass ) );
+	ZeroMemory( m_pProtocol, sizeof( m_pProtocol ) );
+}
+
+CBandwidthGovernor::~CBandwidthGovernor()
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBandwidthGovernor rates
+
+void CBandwidthGovernor::UpdateRates()
+{
+	// Monitor bar sliders: over 100% is MAX (no limit), otherwise scales line speed
+	const DWORD nScale[ bdLast ] = { Settings.Live.BandwidthScaleIn, Settings.Live.BandwidthScaleOut };
+	const DWORD nLine[ bdLast ] = { Settings.Connection.InSpeed * Kilobits / Bytes, Settings.Connection.OutSpeed * Kilobits / Bytes };
+	const DWORD nTransfer[ bdLast ] = { Settings.Bandwidth.Downloads, Settings.Bandwidth.Uploads };
+
+	// Line share per protocol, 100% (or unlisted) is no protocol limit
+	DWORD nShare[ PROTOCOL_LAST ] = {};
+	nShare[ PROTOCOL_G1 ]	= Settings.Bandwidth.ShareG1;
+	nShare[ PROTOCOL_G2 ]	= Settings.Bandwidth.ShareG2;
+	nShare[ PROTOCOL_ED2K ]	= Settings.Bandwidth.ShareED2K;
+	nShare[ PROTOCOL_HTTP ]	= Settings.Bandwidth.ShareHTTP;
+	nShare[ PROTOCOL_DC ]	= Settings.Bandwidth.ShareDC;
+	nShare[ PROTOCOL_BT ]	= Settings.Bandwidth.ShareBT;
+
+	for ( int nDirection = bdIn; nDirection < bdLast; nDirection++ )
+	{
+		const DWORD nRate = ( nScale[ nDirection ] > 100 ) ? 0 :
+			max( 1ul, (DWORD)( (QWORD)nLine[ nDirection ] * nScale[ nDirection ] / 100 ) );
+
+		m_pLine[ nDirection ].nRate = nRate;
+		m_pClass[ nDirection ][ bcControl ].nRate = nRate;
+		m_pClass[ nDirection ][ bcTransfer ].nRate = ( nRate && nTransfer[ nDirection ] ) ?
+			min( nRate, nTransfer[ nDirection ] ) : nRate;
+
+		for ( int nProtocol = PROTOCOL_NULL; nProtocol < PROTOCOL_LAST; nProtocol++ )
+		{
+			m_pProtocol[ nDirection ][ nProtocol ].nRate = ( nRate && nShare[ nProtocol ] && nShare[ nProtocol ] < 100 ) ?
+				max( 1ul, (DWORD)( (QWORD)nRate * nShare[ nProtocol ] / 100 ) ) : 0;
+		}
+	}
+}
+
+void CBandwidthGovernor::Fill(sBucket& oBucket, DWORD tElapsed, DWORD nBurst)
+{
+	if ( ! oBucket.nRate )
+		return;
+
+	const __int64 nDepth = (__int64)oBucket.nRate * nBurst;
+	oBucket.nTokens = min( oBucket.nTokens + (__int64)oBucket.nRate * tElapsed, nDepth );
+}
+
+void CBandwidthGovernor::Roll(sBucket& oBucket, bool bIdle)
+{
+	oBucket.nMeasured = bIdle ? 0 : oBucket.nCount;
+	oBucket.nCount = 0;
+}
+
+void CBandwidthGovernor::Take(sBucket& oBucket, __int64 nTokens)
+{
+	if ( oBucket.nRate )
+		oBucket.nTokens -= nTokens;
+}
+
+void CBandwidthGovernor::Refill(DWORD tNow)
+{
+	ASSUME_LOCK( m_pSection );
+
+	if ( tNow - m_tMeasure >= 1000 )
+	{
+		// Roll throughput counters once a second, rates may have changed too
+		const bool bIdle = ( tNow - m_tMeasure >= 2000 );
+		m_tMeasure = tNow;
+
+		for ( int nDirection = bdIn; nDirection < bdLast; nDirection++ )
+		{
+			Roll( m_pLine[ nDirection ], bIdle );
+			for ( int nClass = bcControl; nClass < bcLast; nClass++ )
+				Roll( m_pClass[ nDirection ][ nClass ], bIdle );
+			for ( int nProtocol = PROTOCOL_NULL; nProtocol < PROTOCOL_LAST; nProtocol++ )
+				Roll( m_pProtocol[ nDirection ][ nProtocol ], bIdle );
+		}
+
+		UpdateRates();
+	}
+
+	const DWORD tElapsed = min( tNow - m_tRefill, 1000ul );
+	if ( ! tElapsed )
+		return;
+
+	m_tRefill = tNow;
+
+	const DWORD nBurst = max( Settings.Bandwidth.Burst, 10ul );
+	for ( int nDirection = bdIn; nDirection < bdLast; nDirection++ )
+	{
+		Fill( m_pLine[ nDirection ], tElapsed, nBurst );
+		for ( int nClass = bcControl; nClass < bcLast; nClass++ )
+			Fill( m_pClass[ nDirection ][ nClass ], tElapsed, nBurst );
+		for ( int nProtocol = PROTOCOL_NULL; nProtocol < PROTOCOL_LAST; nProtocol++ )
+			Fill( m_pProtocol[ nDirection ][ nProtocol ], tElapsed, nBurst );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBandwidthGovernor token requests
+
+DWORD CBandwidthGovernor::Request(BandwidthDirection nDirection, BandwidthClass nClass, PROTOCOLID nProtocol, DWORD nWanted, DWORD tNow)
+{
+	ASSERT( nDirection < bdLast && nClass < bcLast );
+
+	CQuickLock oLock( m_pSection );
+
+	Refill( tNow );
+
+	sBucket& oLine = m_pLine[ nDirection ];
+	sBucket& oClass = m_pClass[ nDirection ][ nClass ];
+
+	if ( ! oLine.nRate )
+		return nWanted;		// Unlimited
+
+	__int64 nAvailable = min( oLine.nTokens, oClass.nTokens );
+
+	sBucket* pProtocol = ( nProtocol > PROTOCOL_ANY && nProtocol < PROTOCOL_LAST ) ?
+		&m_pProtocol[ nDirection ][ nProtocol ] : NULL;
+	if ( pProtocol && pProtocol->nRate )
+		nAvailable = min( nAvailable, pProtocol->nTokens );
+
+	// Lower priority traffic leaves reserve in line bucket
+	if ( nClass != bcControl )
+		nAvailable = min( nAvailable, oLine.nTokens -
+			(__int64)oLine.nRate * Settings.Bandwidth.Burst * Settings.Bandwidth.Reserve / 100 );
+
+	if ( nAvailable < 1000 )
+		return 0;
+
+	const DWORD nGranted = (DWORD)min( (__int64)nWanted, nAvailable / 1000 );
+
+	// Taken up front, so concurrent connections don't overdraw
+	oLine.nTokens -= (__int64)nGranted * 1000;
+	oClass.nTokens -= (__int64)nGranted * 1000;
+	if ( pProtocol )
+		Take( *pProtocol, (__int64)nGranted * 1000 );
+
+	return nGranted;
+}
+
+void CBandwidthGovernor::Commit(BandwidthDirection nDirection, BandwidthClass nClass, PROTOCOLID nProtocol, DWORD nGranted, DWORD nUsed)
+{
+	ASSERT( nDirection < bdLast && nClass < bcLast );
+
+	CQuickLock oLock( m_pSection );
+
+	sBucket& oLine = m_pLine[ nDirection ];
+	sBucket& oClass = m_pClass[ nDirection ][ nClass ];
+	sBucket* pProtocol = ( nProtocol > PROTOCOL_ANY && nProtocol < PROTOCOL_LAST ) ?
+		&m_pProtocol[ nDirection ][ nProtocol ] : NULL;
+
+	// Unused bytes go back, whole datagrams sent past the grant are overdrawn
+	if ( oLine.nRate && nGranted != nUsed )
+	{
+		const __int64 nTokens = ( (__int64)nUsed - nGranted ) * 1000;
+		Take( oLine, nTokens );
+		Take( oClass, nTokens );
+		if ( pProtocol )
+			Take( *pProtocol, nTokens );
+	}
+
+	oLine.nCount += nUsed;
+	oClass.nCount += nUsed;
+	if ( pProtocol )
+		pProtocol->nCount += nUsed;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBandwidthGovernor throughput
+
+DWORD CBandwidthGovernor::GetMeasured(BandwidthDirection nDirection, BandwidthClass nClass) const
+{
+	CQuickLock oLock( m_pSection );
+
+	return m_pClass[ nDirection ][ nClass ].nMeasured;
+}
+
+DWORD CBandwidthGovernor::GetMeasured(BandwidthDirection nDirection, PROTOCOLID nProtocol) const
+{
+	if ( nProtocol <= PROTOCOL_ANY || nProtocol >= PROTOCOL_LAST )
+		return 0;
+
+	CQuickLock oLock( m_pSection );
+
+	return m_pProtocol[ nDirection ][ nProtocol ].nMeasured;
+}
+
+DWORD CBandwidthGovernor::GetMeasured(BandwidthDirection nDirection) const
+{
+	CQuickLock oLock( m_pSection );
+
+	return m_pLine[ nDirection ].nMeasured;
+}
@@ -0,0 +1,77 @@
+//
+// BandwidthGovernor.h
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+// Token buckets shared by all connections, line (Connection.InSpeed/OutSpeed),
+// protocol (Bandwidth.Share* percent of line) and traffic class (control/transfer).
+// Control traffic has priority: transfers can't drain the line bucket below
+// Bandwidth.Reserve percent.  Queue and per-transfer limits (UdpOut meter,
+// TCPBandwidthMeter set by CDownloads/CUploadQueue) still apply below this.
+
+#pragma once
+
+enum BandwidthDirection
+{
+	bdIn,
+	bdOut,
+	bdLast
+};
+
+enum BandwidthClass
+{
+	bcControl,		// Neighbours, handshakes, chat (priority)
+	bcTransfer,		// Uploads and downloads
+	bcLast
+};
+
+
+class CBandwidthGovernor
+{
+public:
+	CBandwidthGovernor();
+	~CBandwidthGovernor();
+
+public:
+	DWORD		Request(BandwidthDirection nDirection, BandwidthClass nClass, PROTOCOLID nProtocol, DWORD nWanted, DWORD tNow);	// Take up to nWanted bytes
+	void		Commit(BandwidthDirection nDirection, BandwidthClass nClass, PROTOCOLID nProtocol, DWORD nGranted, DWORD nUsed);	// Return unused bytes (or charge overdraw), count used
+	DWORD		GetMeasured(BandwidthDirection nDirection, BandwidthClass nClass) const;		// Bytes/s last second
+	DWORD		GetMeasured(BandwidthDirection nDirection, PROTOCOLID nProtocol) const;		// Bytes/s last second
+	DWORD		GetMeasured(BandwidthDirection nDirection) const;							// Bytes/s last second, all traffic
+
+protected:
+	struct sBucket
+	{
+		DWORD	nRate;			// Bytes/s, 0 = unlimited
+		__int64	nTokens;		// Byte-milliseconds available (1000 per byte)
+		DWORD	nCount;			// Bytes this second
+		DWORD	nMeasured;		// Bytes last second
+	};
+
+	mutable CCriticalSection	m_pSection;
+	sBucket		m_pLine[ bdLast ];
+	sBucket		m_pClass[ bdLast ][ bcLast ];
+	sBucket		m_pProtocol[ bdLast ][ PROTOCOL_LAST ];
+	DWORD		m_tRefill;		// Last token refill
+	DWORD		m_tMeasure;		// Last measure period start
+
+	void		Refill(DWORD tNow);
+	void		UpdateRates();
+	static void	Fill(sBucket& oBucket, DWORD tElapsed, DWORD nBurst);
+	static void	Roll(sBucket& oBucket, bool bIdle);
+	static void	Take(sBucket& oBucket, __int64 nTokens);
+};
+
+extern CBandwidthGovernor BandwidthGovernor;
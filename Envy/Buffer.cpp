@@ -167,6 +167,22 @@ void CBuffer::Attach(CBuffer* pBuffer)
 	pBuffer->m_nLength = 0;
 }
 
+// Exchanges the contents of two buffers, both keep an allocation for reuse
+void CBuffer::Swap(CBuffer& oBuffer) throw()
+{
+	BYTE* pBuffer = m_pBuffer;
+	m_pBuffer = oBuffer.m_pBuffer;
+	oBuffer.m_pBuffer = pBuffer;
+
+	DWORD nBuffer = m_nBuffer;
+	m_nBuffer = oBuffer.m_nBuffer;
+	oBuffer.m_nBuffer = nBuffer;
+
+	DWORD nLength = m_nLength;
+	m_nLength = oBuffer.m_nLength;
+	oBuffer.m_nLength = nLength;
+}
+
 // Takes a pointer to some memory, and the number of bytes we can read there
 // Adds them to this buffer, except in reverse order
 void CBuffer::AddReversed(const void *pData, const size_t nLength)
@@ -56,6 +56,7 @@ public:
 	DWORD	AddBuffer(CBuffer* pBuffer, const size_t nLength);					// Copy all or part of the data in another CBuffer object into this one
 	void	AddReversed(const void* pData, const size_t nLength);				// Add data to this buffer, but with the bytes in reverse order
 	void	Attach(CBuffer* pBuffer);											// Get ownership of another CBuffer object data
+	void	Swap(CBuffer& oBuffer) throw();										// Exchange data and allocations with another CBuffer object
 
 	// Convert Unicode text to ASCII and add it to the buffer
 	void	Print(const LPCWSTR pszText, const size_t nLength, const UINT nCodePage = CP_ACP);
@@ -447,12 +447,20 @@ CXMLElement* CCollectionFile::CloneMetadata(CXMLElement* pMetadata)
 			pNode->SetName( strNodeName.Mid( 2 ) );
 	}
 
+	// Renaming may delete a namesake attribute, so collect names before renaming
+	CStringArray pRenames;
 	for ( POSITION pos = pCore->GetAttributeIterator(); pos; )
 	{
 		CXMLNode* pNode = pCore->GetNextAttribute( pos );
 		CString strNodeName = pNode->GetName();
 		if ( _tcsnicmp( strNodeName, L"s:", 2 ) == 0 )
-			pNode->SetName( strNodeName.Mid( 2 ) );
+			pRenames.Add( strNodeName );
+	}
+
+	for ( INT_PTR nRename = 0; nRename < pRenames.GetCount(); ++nRename )
+	{
+		if ( CXMLAttribute* pNode = pCore->GetAttribute( pRenames[ nRename ] ) )
+			pNode->SetName( pRenames[ nRename ].Mid( 2 ) );
 	}
 
 	return pMetadata;
@@ -49,6 +49,7 @@ CConnection::CConnection(PROTOCOLID nProtocol)
 	, m_pInput			( NULL )
 	, m_pOutput 		( NULL )
 	, m_nProtocol		( nProtocol )
+	, m_nBandwidthClass	( bcControl )
 	, m_bClientExtended ( FALSE )
 	, m_bAutoDelete		( FALSE )
 	, m_nDelayCloseReason ( 0 )
@@ -530,6 +531,9 @@ BOOL CConnection::OnRead()
 	if ( nLimit > (DWORD)INT_MAX )
 		nLimit = (DWORD)INT_MAX;
 
+	// Take share of the global line, protocol and class buckets
+	const DWORD nGranted = nLimit = BandwidthGovernor.Request( bdIn, m_nBandwidthClass, m_nProtocol, nLimit, tNow );
+
 	// Start the total at 0
 	DWORD nTotal = 0ul;
 
@@ -560,6 +564,8 @@ BOOL CConnection::OnRead()
 		nLimit				-= nRead;	// Adjust the limit
 	}
 
+	BandwidthGovernor.Commit( bdIn, m_nBandwidthClass, m_nProtocol, nGranted, nTotal );
+
 	if ( nTotal )
 	{
 		// Bytes were read, add # bytes to bandwidth meter
@@ -605,6 +611,9 @@ BOOL CConnection::OnWrite()
 	if ( nLimit > (DWORD)INT_MAX )
 		nLimit = (DWORD)INT_MAX;
 
+	// Take share of the global line, protocol and class buckets
+	const DWORD nGranted = nLimit = BandwidthGovernor.Request( bdOut, m_nBandwidthClass, m_nProtocol, nLimit, tNow );
+
 	// Point to the data to write
 	const BYTE* pData = m_pOutput->GetData();
 
@@ -626,6 +635,8 @@ BOOL CConnection::OnWrite()
 		nLimit	-= nSend;	// Adjust the limit
 	}
 
+	BandwidthGovernor.Commit( bdOut, m_nBandwidthClass, m_nProtocol, nGranted, nTotal );
+
 	if ( nTotal )
 	{
 		// Remove sent bytes from the buffer
@@ -681,65 +692,123 @@ void CConnection::MeasureOut()
 // Remove the headers from the input buffer, handing each to OnHeaderLine
 BOOL CConnection::ReadHeaders()
 {
-	// Move the first line from the m_pInput buffer to strLine and do the contents of the while loop
-	CString strLine;
-	while ( Read( strLine ) )	// ReadLine will return false when there are no more lines
+	CString strHeader, strValue;
+	for ( ;; )
 	{
-		// If the line is more than 256 KB, change it to the long line error code
-		if ( strLine.GetLength() > HTTP_HEADER_MAX_LINE )
-			strLine = L"#LINE_TOO_LONG#";
-
-		// Find the first colon in the line
-		int nPos = strLine.Find( L":" );
-
-		// The line is empty, it's just a \n character
-		if ( strLine.IsEmpty() )
+		switch ( ReadHeaderLine( strHeader, strValue ) )
 		{
-			// Empty the last header member variable (do)
+		case hlNone:
+			// Send the contents of the output buffer to the remote computer
+			OnWrite();
+			return TRUE;
+
+		case hlEnd:
+			// The line is empty, it's just a \n character
 			m_sLastHeader.Empty();
 
 			// Call the OnHeadersComplete method for the most advanced class that inherits from CConnection
 			return OnHeadersComplete();
-		}
-		else if ( _istspace( strLine.GetAt( 0 ) ) )		// Get the first character in the string, and see if its a space
-		{
-			// The line starts with a space
 
-			// The last header has length
-			if ( ! m_sLastHeader.IsEmpty() )
+		case hlContinue:
+			// The line starts with a space, give OnHeaderLine the last header and this line
+			if ( ! m_sLastHeader.IsEmpty() && ! strValue.IsEmpty() )
 			{
-				// Trim whitespace from both ends of the line, and ensure it still has length
-				strLine.Trim();
-				if ( strLine.IsEmpty() ) continue;
+				if ( ! OnHeaderLine( m_sLastHeader, strValue ) )
+					return FALSE;
+			}
+			break;
 
-				// Give OnHeaderLine the last header and this line
-				if ( ! OnHeaderLine( m_sLastHeader, strLine ) )
+		case hlField:
+			// The line is like "header:value"
+			m_sLastHeader = strHeader;
+			if ( ! strValue.IsEmpty() )
+			{
+				if ( ! OnHeaderLine( strHeader, strValue ) )
 					return FALSE;
 			}
+			break;
+
+		default:
+			// Malformed or too long line, skip it
+			break;
 		}
-		else if ( nPos > 1 && nPos < 64 )	// ":a" is 0 and "a:a" is 1, but "aa:a" is greater than 1
-		{
-			// The colon is at a distance greater than 1 and less than 64
+	}
+}
 
-			// The line is like "header:value", copy out both parts
-			CString strHeader	= strLine.Left( nPos );
-			CString strValue	= strLine.Mid( nPos + 1 );
-			m_sLastHeader = strHeader;
+// Tokenizes the first line of the input buffer in place, only header name and value are decoded
+CConnection::HeaderLine CConnection::ReadHeaderLine(CString& strHeader, CString& strValue)
+{
+	CQuickLock oInputLock( *m_pInputSection );
+
+	const char* pLine = (const char*)m_pInput->m_pBuffer;
+	const char* pEnd = m_pInput->m_nLength ? (const char*)memchr( pLine, '\n', m_pInput->m_nLength ) : NULL;
+	if ( ! pEnd )
+		return hlNone;
+
+	const DWORD nLine = (DWORD)( pEnd - pLine ) + 1;
+	while ( pEnd > pLine && pEnd[ -1 ] == '\r' )
+		pEnd--;
 
-			strValue.Trim();
-			if ( strValue.IsEmpty() ) continue;
+	HeaderLine nResult = hlSkip;
 
-			// Give OnHeaderLine this last header, and its value
-			if ( ! OnHeaderLine( strHeader, strValue ) )
-				return FALSE;
+	if ( pEnd == pLine )
+	{
+		nResult = hlEnd;
+	}
+	else if ( pEnd - pLine <= HTTP_HEADER_MAX_LINE )
+	{
+		const char* pValue = NULL;
+
+		if ( *pLine == ' ' || *pLine == '\t' )
+		{
+			pValue = pLine;
+			nResult = hlContinue;
+		}
+		else if ( const char* pColon = (const char*)memchr( pLine, ':', pEnd - pLine ) )
+		{
+			// ":a" is 0 and "a:a" is 1, but "aa:a" is greater than 1
+			const int nPos = (int)( pColon - pLine );
+			if ( nPos > 1 && nPos < 64 )
+			{
+				strHeader = UTF8Decode( pLine, nPos );
+				pValue = pColon + 1;
+				nResult = hlField;
+			}
+		}
+
+		if ( pValue )
+		{
+			while ( pValue < pEnd && IsSpace( *pValue ) )
+				pValue++;
+			while ( pEnd > pValue && IsSpace( pEnd[ -1 ] ) )
+				pEnd--;
+
+			if ( pEnd > pValue )
+				strValue = UTF8Decode( pValue, (int)( pEnd - pValue ) );
+			else
+				strValue.Empty();
 		}
 	}
 
-	// Send the contents of the output buffer to the remote computer
-	OnWrite();
-	return TRUE;
+	m_pInput->Remove( nLine );
+
+	return nResult;
 }
 
+// Header names are hashed once at startup, lookups only read the table
+static const CTextSwitch::Item pHeaderItems[] =
+{
+	{ L"user-agent",	'u' },
+	{ L"remote-ip",		'i' },
+	{ L"x-my-address",	'o' },
+	{ L"listen-ip",		'o' },
+	{ L"x-node",		'o' },
+	{ L"node",			'o' },
+	{ L"accept",		'a' },
+};
+
+static const CTextSwitch HeaderNames( pHeaderItems, _countof( pHeaderItems ) );
+
 // Takes a header and its value
 // Reads and processes popular Gnutella headers
 // Returns true to have ReadHeaders keep going
@@ -747,24 +816,23 @@ BOOL CConnection::OnHeaderLine(CString& strHeader, CString& strValue)
 {
 	theApp.Message( MSG_DEBUG | MSG_FACILITY_INCOMING, L"%s >> %s: %s", (LPCTSTR)m_sAddress, (LPCTSTR)strHeader, (LPCTSTR)strValue );
 
+	const char nHeader = HeaderNames.Lookup( strHeader );
+
 	// It's the user agent header
-	if ( strHeader.CompareNoCase( L"User-Agent" ) == 0 )
+	if ( nHeader == 'u' )
 	{
 		// Copy the value into the user agent member string
 		m_sUserAgent = strValue;	// This tells what software the remote computer is running
 		m_bClientExtended = VendorCache.IsExtended( m_sUserAgent );
 	}
 	// It's the remote IP header
-	else if ( strHeader.CompareNoCase( L"Remote-IP" ) == 0 )
+	else if ( nHeader == 'i' )
 	{
 		// Add this address to our record of them
 		Network.AcquireLocalAddress( strValue );
 	}
 	// It's the x my address, listen IP, or node header, like "X-My-Address: 10.254.0.16:6349"
-	else if (  strHeader.CompareNoCase( L"X-My-Address" ) == 0
-			|| strHeader.CompareNoCase( L"Listen-IP" ) == 0
-			|| strHeader.CompareNoCase( L"X-Node" ) == 0
-			|| strHeader.CompareNoCase( L"Node" ) == 0 )
+	else if ( nHeader == 'o' )
 	{
 		// Find another colon in the value
 		int nColon = strValue.Find( L':' );
@@ -781,7 +849,7 @@ BOOL CConnection::OnHeaderLine(CString& strHeader, CString& strValue)
 			}
 		}
 	}
-	else if ( strHeader.CompareNoCase( L"Accept" ) == 0 )
+	else if ( nHeader == 'a' )
 	{
 		if ( m_nProtocol != PROTOCOL_G2 )
 		{
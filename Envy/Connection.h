@@ -24,6 +24,7 @@
 
 #include "Buffer.h"
 #include "Packet.h"
+#include "BandwidthGovernor.h"
 
 
 // A socket connection to a remote computer on the Internet running peer-to-peer software
@@ -46,6 +47,7 @@ public:
 	CString		m_sUserAgent;		// The name of the program the remote computer is running
 	CString		m_sLastHeader;		// The handshake header that ReadHeaders most recently read
 	PROTOCOLID	m_nProtocol;		// Detected protocol
+	BandwidthClass m_nBandwidthClass;	// Traffic class for BandwidthGovernor (transfers are bcTransfer)
 
 // Buffers access
 protected:
@@ -62,6 +64,11 @@ private:
 	int			m_nQueuedRun;		// The queued run state of 0, 1, or 2 (do)
 	UINT		m_nDelayCloseReason;  // Reason for DelayClose()
 
+	// Kind of line found by ReadHeaderLine()
+	enum HeaderLine { hlNone, hlEnd, hlField, hlContinue, hlSkip };
+
+	HeaderLine ReadHeaderLine(CString& strHeader, CString& strValue);	// Tokenize the next header line straight from the input buffer
+
 	CConnection(const CConnection&);
 	CConnection& operator=(const CConnection&);
 
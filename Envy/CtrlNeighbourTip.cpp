@@ -167,8 +167,11 @@ void CNeighbourTipCtrl::OnCalcSize(CDC* pDC)
 	if ( nCompIn > 0 || nCompOut > 0 )
 		m_sz.cy += TIP_TEXTHEIGHT;
 
+	if ( pNeighbour->m_nProtocol == PROTOCOL_G1 || pNeighbour->m_nProtocol == PROTOCOL_G2 )
+		m_sz.cy += TIP_TEXTHEIGHT;
+
 	m_sz.cy += 40;	// Graph?
-	m_sz.cx = max( m_sz.cx, 128 + 160 );
+	m_sz.cx = max( m_sz.cx, nCompOut > 0 ? 128 + 200 : 128 + 160 );	// Outgoing ratio with level and deflate time
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -357,7 +360,22 @@ void CNeighbourTipCtrl::OnPaint(CDC* pDC)
 		DrawText( pDC, &pt, str );
 		( nCompIn  > 0 ) ? str.Format( L"%.2f%%", nCompIn  * 100.0 ) : str.Empty();
 		DrawText( pDC, &pt, str, 128 );
-		( nCompOut > 0 ) ? str.Format( L"%.2f%%", nCompOut * 100.0 ) : str.Empty();
+		int nLevel;
+		DWORD nTime;
+		pNeighbour->GetCompressionCost( nLevel, nTime );
+		( nCompOut > 0 ) ? str.Format( L"%.2f%% (%i, %u ms)", nCompOut * 100.0, nLevel, nTime ) : str.Empty();
+		DrawText( pDC, &pt, str, 128 + 80 );
+		pt.y += TIP_TEXTHEIGHT;
+	}
+
+	if ( pNeighbour->m_nProtocol == PROTOCOL_G1 || pNeighbour->m_nProtocol == PROTOCOL_G2 )
+	{
+		// Outbound packets dropped, expired or evicted (control/hits/pushes/queries)
+		LoadString( str, IDS_NEIGHBOUR_LOST );
+		DrawText( pDC, &pt, str );
+		str.Format( L"%u (%u/%u/%u/%u)", pNeighbour->m_nLostCount,
+			pNeighbour->m_nLostByClass[ 0 ], pNeighbour->m_nLostByClass[ 1 ],
+			pNeighbour->m_nLostByClass[ 2 ], pNeighbour->m_nLostByClass[ 3 ] );
 		DrawText( pDC, &pt, str, 128 + 80 );
 		pt.y += TIP_TEXTHEIGHT;
 	}
@@ -699,7 +699,7 @@ BOOL CDCNeighbour::OnLock(LPSTR szParams)
 
 		if ( CHostCacheHostPtr pServer = HostCache.DC.Find( &m_pHost.sin_addr ) )
 		{
-			m_sNick = pServer->m_sUser;
+			m_sNick = pServer->Extra().m_sUser;
 		}
 
 		m_sNick = DCClients.CreateNick( m_sNick );
@@ -748,7 +748,7 @@ BOOL CDCNeighbour::OnHello(LPSTR szNick)
 
 	if ( CHostCacheHostPtr pServer = HostCache.DC.Find( &m_pHost.sin_addr ) )
 	{
-		pServer->m_sUser = m_sNick;
+		pServer->EditExtra().m_sUser = m_sNick;
 		HostCache.DC.m_nCookie++;
 	}
 
@@ -788,8 +788,9 @@ BOOL CDCNeighbour::OnHubName(CDCPacket *pPacket)
 
 	if ( CHostCacheHostPtr pServer = HostCache.DC.Find( &m_pHost.sin_addr ) )
 	{
-		pServer->m_sName = m_sServerName;
-		pServer->m_sDescription = strDescription;
+		CHostCacheExtra& oExtra = pServer->EditExtra();
+		oExtra.m_sName = m_sServerName;
+		oExtra.m_sDescription = strDescription;
 		HostCache.DC.m_nCookie++;
 	}
 
@@ -1046,7 +1047,7 @@ BOOL CDCNeighbour::OnValidateDenide()
 
 	if ( CHostCacheHostPtr pServer = HostCache.DC.Find( &m_pHost.sin_addr ) )
 	{
-		pServer->m_sUser = m_sNick;
+		pServer->EditExtra().m_sUser = m_sNick;
 	}
 
 	if ( CDCPacket* pPacket = CDCPacket::New() )
@@ -20,6 +20,7 @@
 #include "Settings.h"
 #include "Envy.h"
 #include "Datagrams.h"
+#include "BandwidthGovernor.h"
 #include "Datagram.h"
 #include "DatagramPart.h"
 
@@ -367,11 +368,16 @@ BOOL CDatagrams::Send(const SOCKADDR_IN* pHost, CPacket* pPacket, BOOL bRelease,
 		//	;	// Other?
 		}
 
+		const PROTOCOLID nProtocol = pPacket->m_nProtocol;
+
 		pPacket->SmartDump( pHost, TRUE, TRUE );
 		if ( bRelease ) pPacket->Release();
 
 		CNetwork::SendTo( m_hSocket[ 0 ], (LPSTR)pBuffer.m_pBuffer, pBuffer.m_nLength, pHost );
 
+		// Not queued, sent at once and charged to the governor afterwards
+		BandwidthGovernor.Commit( bdOut, bcControl, nProtocol, 0, pBuffer.m_nLength );
+
 		return TRUE;
 	}
 
@@ -556,6 +562,10 @@ BOOL CDatagrams::TryWrite()
 		nLimit = ( nUsed >= nLimit ) ? 0 : ( nLimit - nUsed );
 	}
 
+	// Take share of the global line, protocol and control buckets
+	const DWORD nGranted = nLimit = ( nLimit && m_pOutputFirst ) ?
+		BandwidthGovernor.Request( bdOut, bcControl, PROTOCOL_G2, nLimit, tNow ) : 0;
+
 	DWORD nLastHost = 0;
 
 	while ( nLimit > 0 )
@@ -603,6 +613,10 @@ BOOL CDatagrams::TryWrite()
 			break;
 	}
 
+	// Last datagram may exceed the grant, it is overdrawn
+	if ( nGranted )
+		BandwidthGovernor.Commit( bdOut, bcControl, PROTOCOL_G2, nGranted, nTotal );
+
 	if ( nTotal )
 	{
 		if ( tNow < m_mOutput.tLastSlot + METER_MINIMUM )
@@ -707,6 +721,9 @@ BOOL CDatagrams::TryRead(int nIndex /*0*/)
 	m_mInput.nTotal += nLength;
 	Statistics.Current.Bandwidth.Incoming += nLength;
 
+	// Already received, charged so TCP reads leave room for it
+	BandwidthGovernor.Commit( bdIn, bcControl, PROTOCOL_ANY, 0, nLength );
+
 	if ( Network.IsFirewalledAddress( &pFrom.sin_addr, Settings.Connection.IgnoreOwnUDP, FALSE ) ||
 		 Security.IsDenied( &pFrom.sin_addr ) )
 	{
@@ -67,6 +67,9 @@ CDownload::CDownload()
 	, m_bStableName	( false )
 	, m_bShared		( Settings.Uploads.SharePartials )
 	, m_tSaved		( 0 )
+	, m_nSnapshotSize	( 0 )
+	, m_nSnapshotSeq	( 0 )
+	, m_nJournalSize	( 0 )
 	, m_tBegan		( 0 )
 	, m_pTask		( this )
 {
@@ -238,6 +241,7 @@ void CDownload::Remove()
 	{
 		DeleteFileEx( m_sPath + L".png", FALSE, FALSE, TRUE );
 		DeleteFileEx( m_sPath + L".sav", FALSE, FALSE, TRUE );
+		DeleteFileEx( m_sPath + L".jnl", FALSE, FALSE, TRUE );
 		DeleteFileEx( m_sPath, FALSE, FALSE, TRUE );
 		m_sPath.Empty();
 	}
@@ -605,8 +609,8 @@ void CDownload::OnRun()
 		}
 	}
 
-	// Don't save Downloads with many sources too often, since it's slow
-	if ( tNow >= m_tSaved + ( GetCount() > 20 ? 5 * Settings.Downloads.SaveInterval : Settings.Downloads.SaveInterval ) )
+	// Don't fully save Downloads with many sources too often, since it's slow (journal appends are cheap)
+	if ( tNow >= m_tSaved + ( GetCount() > 20 && m_bSnapshot ? 5 * Settings.Downloads.SaveInterval : Settings.Downloads.SaveInterval ) )
 	{
 		if ( IsModified() )
 		{
@@ -685,6 +689,7 @@ void CDownload::OnMoved()
 
 	DeleteFileEx( strPath + L".png", FALSE, FALSE, TRUE );
 	DeleteFileEx( strPath + L".sav", FALSE, FALSE, TRUE );
+	DeleteFileEx( strPath + L".jnl", FALSE, FALSE, TRUE );
 	DeleteFileEx( strPath, FALSE, FALSE, TRUE );
 
 	pTransfersLock.Lock();
@@ -819,15 +824,30 @@ BOOL CDownload::Load(LPCTSTR pszName)
 	ASSERT( m_sPath.IsEmpty() );
 	m_sPath = SafePath( pszName );
 
+	// A complete .pd.sav newer than the .pd was saved, but not renamed yet
+	DWORD nSequence = 0, nSequenceSav = 0;
+	const BOOL bSequence = LoadSequence( m_sPath, nSequence );
+	const BOOL bPreferSav = LoadSequence( m_sPath + L".sav", nSequenceSav ) &&
+		( ! bSequence || (LONG)( nSequenceSav - nSequence ) > 0 );
+
 	BOOL bSuccess = FALSE;
-	CFile pFile;
-	if ( pFile.Open( m_sPath, CFile::modeRead ) )	// .pd file
+	BOOL bFromSav = FALSE;
+	for ( int nTry = 0; nTry < 2 && ! bSuccess; nTry++ )
 	{
+		bFromSav = ( ( nTry == 0 ) == bPreferSav );
+		const CString strPath = bFromSav ? m_sPath + L".sav" : m_sPath;
+
+		CFile pFile;
+		if ( ! pFile.Open( strPath, CFile::modeRead ) )	// .pd file
+			continue;
+
 		TRY
 		{
 			CArchive ar( &pFile, CArchive::load, 32768 );	// 32 KB buffer
 			Serialize( ar, 0 );
 			bSuccess = TRUE;
+			m_nSnapshotSize = (DWORD)pFile.GetLength();
+			m_nSnapshotSeq = bFromSav ? nSequenceSav : nSequence;
 		}
 		CATCH( CFileException, pException )
 		{
@@ -836,39 +856,190 @@ BOOL CDownload::Load(LPCTSTR pszName)
 		}
 		AND_CATCH_ALL( pException )
 		{
-			theApp.Message( MSG_ERROR, IDS_DOWNLOAD_FILE_OPEN_ERROR, m_sPath );
+			theApp.Message( MSG_ERROR, IDS_DOWNLOAD_FILE_OPEN_ERROR, strPath );
 		}
 		END_CATCH_ALL
 
 		pFile.Close();
 	}
 
-	if ( ! bSuccess && pFile.Open( m_sPath + L".sav", CFile::modeRead ) )
+	if ( bSuccess && bFromSav )
+	{
+		// Any journal belongs to the older .pd
+		DeleteFileEx( m_sPath + L".jnl", FALSE, FALSE, FALSE );
+		Save();
+	}
+
+	m_nSaveCookie = m_nCookie;
+	m_bSnapshot = false;
+
+	// Replayed journal is compacted by the next save
+	if ( bSuccess && ! bFromSav && LoadJournal() )
+		SetModified();
+
+	return bSuccess;
+}
+
+// Snapshot sequence from the .pd trailer "PS:", sequence and CRC32 of the two.
+// Reads only the head and trailer; a torn save lacks the trailer at its end.
+// FALSE if missing, damaged or saved before sequences (ignored by older versions).
+BOOL CDownload::LoadSequence(const CString& strPath, DWORD& nSequence)
+{
+	CFile pFile;
+	if ( ! pFile.Open( strPath, CFile::modeRead ) )
+		return FALSE;
+
+	const DWORD nTrailer = 3 + 2 * sizeof( DWORD );
+	BYTE pHead[ 3 ], pTrailer[ nTrailer ];
+
+	try
+	{
+		if ( pFile.GetLength() < 3 + nTrailer ||
+			 pFile.Read( pHead, 3 ) != 3 )
+			return FALSE;
+
+		pFile.Seek( -(LONGLONG)nTrailer, CFile::end );
+		if ( pFile.Read( pTrailer, nTrailer ) != nTrailer )
+			return FALSE;
+	}
+	catch ( CException* pException )
+	{
+		pException->Delete();
+		return FALSE;
+	}
+
+	if ( memcmp( pHead, "PD:", 3 ) != 0 || memcmp( pTrailer, "PS:", 3 ) != 0 ||
+		 crc32( 0, pTrailer, 3 + sizeof( DWORD ) ) != *(DWORD*)( pTrailer + 3 + sizeof( DWORD ) ) )
+		return FALSE;
+
+	nSequence = *(DWORD*)( pTrailer + 3 );
+	return TRUE;
+}
+
+BOOL CDownload::LoadJournal()
+{
+	CFile pFile;
+	if ( ! pFile.Open( m_sPath + L".jnl", CFile::modeRead ) )
+		return FALSE;	// No changes since .pd
+
+	// Header "PJ:", DOWNLOAD_SER_VERSION and sequence of the .pd it extends,
+	// then records of DWORD length, DWORD CRC32 and an archive of the changes.
+	// Replay stops at the first incomplete or damaged record.
+
+	CHAR szID[3] = { 0, 0, 0 };
+	int nVersion = 0;
+	DWORD nSequence = 0;
+	if ( pFile.Read( szID, 3 ) != 3 || strncmp( szID, "PJ:", 3 ) != 0 ||
+		 pFile.Read( &nVersion, sizeof( nVersion ) ) != sizeof( nVersion ) ||
+		 nVersion < 1 || nVersion > DOWNLOAD_SER_VERSION ||
+		 pFile.Read( &nSequence, sizeof( nSequence ) ) != sizeof( nSequence ) )
+		return TRUE;
+
+	// Left over from an older .pd, its changes are in this one already
+	if ( nSequence != m_nSnapshotSeq )
+	{
+		pFile.Close();
+		DeleteFileEx( m_sPath + L".jnl", FALSE, FALSE, FALSE );
+		return FALSE;
+	}
+
+	CSingleLock pTransfersLock( &Transfers.m_pSection, TRUE );
+
+	DWORD nRecords = 0;
+	for ( ;; )
 	{
+		DWORD nLength = 0, nCRC = 0;
+		if ( pFile.Read( &nLength, sizeof( nLength ) ) != sizeof( nLength ) ||
+			 pFile.Read( &nCRC, sizeof( nCRC ) ) != sizeof( nCRC ) ||
+			 nLength == 0 || nLength > pFile.GetLength() - pFile.GetPosition() )
+			break;
+
+		CAutoVectorPtr< BYTE > pData( new BYTE[ nLength ] );
+		if ( ! pData || pFile.Read( pData, nLength ) != nLength ||
+			 crc32( 0, pData, nLength ) != nCRC )
+			break;
+
+		BOOL bReplayed = FALSE;
 		TRY
 		{
-			CArchive ar( &pFile, CArchive::load, 32768 );	// 32 KB buffer
-			Serialize( ar, 0 );
-			bSuccess = TRUE;
-		}
-		CATCH( CFileException, pException )
-		{
-			if ( pException->m_cause == CFileException::fileNotFound )
-				return FALSE;	// Subfile missing
+			CMemFile pMemFile( pData, nLength );
+			CArchive ar( &pMemFile, CArchive::load );
+			SerializeSourceChanges( ar, nVersion );
+			SerializeProgress( ar, nVersion );
+			bReplayed = TRUE;
 		}
-		AND_CATCH_ALL( pException )
+		CATCH_ALL( pException )
 		{
-			theApp.Message( MSG_ERROR, IDS_DOWNLOAD_FILE_OPEN_ERROR, m_sPath + L".sav" );
+			theApp.Message( MSG_ERROR, IDS_DOWNLOAD_FILE_OPEN_ERROR, m_sPath + L".jnl" );
 		}
 		END_CATCH_ALL
 
-		pFile.Close();
+		if ( ! bReplayed )
+			break;
 
-		if ( bSuccess )
-			Save();
+		nRecords++;
 	}
 
-	m_nSaveCookie = m_nCookie;
+	theApp.Message( MSG_DEBUG, L"Replayed %lu journal records for %s", nRecords, (LPCTSTR)GetDisplayName() );
+
+	return TRUE;
+}
+
+BOOL CDownload::SaveJournal()
+{
+	ASSUME_LOCK( Transfers.m_pSection );
+
+	CMemFile pMemFile;
+	try
+	{
+		CArchive ar( &pMemFile, CArchive::store );
+		SerializeSourceChanges( ar, DOWNLOAD_SER_VERSION );
+		SerializeProgress( ar, DOWNLOAD_SER_VERSION );
+		ar.Close();
+	}
+	catch ( CException* pException )
+	{
+		pException->Delete();
+		return FALSE;
+	}
+
+	const DWORD nLength = (DWORD)pMemFile.GetLength();
+	BYTE* pData = pMemFile.Detach();
+	const DWORD nCRC = crc32( 0, pData, nLength );
+
+	// First record after a full save starts a new journal, over any stale one
+	BOOL bSuccess = FALSE;
+	CFile pFile;
+	if ( pFile.Open( m_sPath + L".jnl",
+		CFile::modeWrite|CFile::modeCreate|CFile::osWriteThrough|( m_nJournalSize ? CFile::modeNoTruncate : 0 ) ) )
+	{
+		try
+		{
+			if ( pFile.GetLength() == 0 )
+			{
+				const int nVersion = DOWNLOAD_SER_VERSION;
+				pFile.Write( "PJ:", 3 );
+				pFile.Write( &nVersion, sizeof( nVersion ) );
+				pFile.Write( &m_nSnapshotSeq, sizeof( m_nSnapshotSeq ) );
+			}
+
+			pFile.SeekToEnd();
+			pFile.Write( &nLength, sizeof( nLength ) );
+			pFile.Write( &nCRC, sizeof( nCRC ) );
+			pFile.Write( pData, nLength );
+
+			m_nJournalSize = (DWORD)pFile.GetLength();
+			pFile.Close();
+			bSuccess = TRUE;
+		}
+		catch ( CException* pException )
+		{
+			pFile.Abort();
+			pException->Delete();
+		}
+	}
+
+	free( pData );
 
 	return bSuccess;
 }
@@ -881,7 +1052,10 @@ BOOL CDownload::Save(BOOL bFlush)
 		DeleteFileEx( LPCTSTR( m_sPath ), FALSE, FALSE, FALSE );
 
 	if ( m_sPath.IsEmpty() || m_sPath.Right( 3 ) != L".pd" )		// From incomplete folder or .sd imports
+	{
 		m_sPath = SafePath( Settings.Downloads.IncompletePath + L"\\" + GetFilename() + L".pd" );
+		m_nSnapshotSize = 0;
+	}
 
 	// Escape Windows path length limit with \\?\ if needed?  (SafePath() above)
 	//const CString strPath = ( m_sPath.GetLength() > ( MAX_PATH - 4 ) ) ? ( L"\\\\?\\"  + m_sPath ) : m_sPath;
@@ -895,67 +1069,99 @@ BOOL CDownload::Save(BOOL bFlush)
 	if ( m_bSeeding && ! Settings.BitTorrent.AutoSeed )
 		return TRUE;
 
+	// Routine saves append to the .pd journal, until it outgrows the .pd
+	// or something it doesn't record has changed
+	if ( ! bFlush && ! m_bSnapshot && m_nSnapshotSize &&
+		 m_nJournalSize < max( m_nSnapshotSize, 64ul * 1024ul ) &&
+		 SaveJournal() )
+		return TRUE;
+
 	const CString strPathSav = m_sPath + L".sav";
+	const CString strPathJournal = m_sPath + L".jnl";
 	const LPCTSTR pszPath = m_sPath;
 	const LPCTSTR pszPathSav = strPathSav;
 
-	DeleteFileEx( pszPathSav, FALSE, FALSE, FALSE );
-
-	CFile pFile;
-	if ( ! pFile.Open( pszPathSav,		// Create temp .pd.sav
-		CFile::modeReadWrite|CFile::modeCreate|CFile::osWriteThrough ) )
-		return FALSE;
-
-	CHAR szID[3] = { 0, 0, 0 };
-	try
+	// Serialize to memory with trailer "PS:", sequence and CRC32 (see LoadSequence)
+	const DWORD nSequence = m_nSnapshotSeq + 1;
+	CMemFile pMemFile;
 	{
-		CArchive ar( &pFile, CArchive::store, 32768 );	// 32 KB buffer
+		CArchive ar( &pMemFile, CArchive::store, 32768 );	// 32 KB buffer
 		try
 		{
 			Serialize( ar, 0 );
+			ar.Write( "PS:", 3 );
+			ar << nSequence;
 			ar.Close();
 		}
 		catch ( CException* pException )
 		{
 			ar.Abort();
-			pFile.Abort();
 			theApp.Message( MSG_ERROR, L"Serialize Error: %s", GetFilename() );
 			pException->Delete();
 			return FALSE;
 		}
+	}
 
-		if ( Settings.Downloads.FlushPD || bFlush ) 	// Always true (Why advanced setting?)
-			pFile.Flush();
+	const DWORD nLength = (DWORD)pMemFile.GetLength();
+	BYTE* pData = pMemFile.Detach();
+	const DWORD nCRC = nLength > 3 + sizeof( nSequence ) ?
+		crc32( 0, pData + nLength - 3 - sizeof( nSequence ), 3 + sizeof( nSequence ) ) : 0;
 
-		pFile.SeekToBegin();
-		pFile.Read( szID, 3 );
-		pFile.Close();
-	}
-	catch ( CException* pException )
+	DeleteFileEx( pszPathSav, FALSE, FALSE, FALSE );
+
+	// .pd file should start with characters PD:  (Legacy SDL in Shareaza .sd)
+	BOOL bSaved = FALSE;
+	if ( nLength > 3 + 3 + sizeof( nSequence ) && memcmp( pData, "PD:", 3 ) == 0 )
 	{
-		pFile.Abort();
-		pException->Delete();
-		return FALSE;
-	}
+		CFile pFile;
+		if ( pFile.Open( pszPathSav,		// Create temp .pd.sav
+			CFile::modeWrite|CFile::modeCreate|CFile::osWriteThrough ) )
+		{
+			try
+			{
+				pFile.Write( pData, nLength );
+				pFile.Write( &nCRC, sizeof( nCRC ) );
 
-	pTransfersLock.Unlock();
+				if ( Settings.Downloads.FlushPD || bFlush ) 	// Always true (Why advanced setting?)
+					pFile.Flush();
 
-	// .pd file should now start with characters PD:  (Legacy SDL in Shareaza .sd)
-	if ( szID[0] == 'P' && szID[1] == 'D' && szID[2] == ':' )
+				pFile.Close();
+				bSaved = TRUE;
+			}
+			catch ( CException* pException )
+			{
+				pFile.Abort();
+				pException->Delete();
+			}
+		}
+	}
+	else // Bad file header?
 	{
-		// Rename temp .pd.sav file to .pd
-		if ( ::MoveFileEx( pszPathSav, pszPath,
-				MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
-			return TRUE;	// Done
 		ASSERT( FALSE );
 	}
-	else // Bad file header?
+
+	free( pData );
+
+	// Rename temp .pd.sav file to .pd, then drop the journal of the old .pd.
+	// If stopped in between, the journal sequence no longer matches the .pd,
+	// and Load() ignores it.
+	if ( ! bSaved ||
+		 ! ::MoveFileEx( pszPathSav, pszPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
 	{
 		DeleteFileEx( pszPathSav, FALSE, FALSE, FALSE );
-		ASSERT( FALSE );
+		m_bSnapshot = true;		// Old .pd and journal stay valid, retry full save
+		ASSERT( ! bSaved );
+		return FALSE;
 	}
 
-	return FALSE;
+	DeleteFileEx( strPathJournal, FALSE, FALSE, FALSE );
+
+	m_bSnapshot = false;
+	m_nSnapshotSeq = nSequence;
+	m_nSnapshotSize = nLength + sizeof( nCRC );
+	m_nJournalSize = 0;
+
+	return TRUE;	// Done
 }
 
 BOOL CDownload::OnVerify(const CLibraryFile* pFile, TRISTATE bVerified)
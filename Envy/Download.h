@@ -63,6 +63,9 @@ private:
 	bool		m_bStableName;			// Download has a stable name  (Set in CDownloadTransferHTTP::OnHeaderLine "Content-Disposition")
 	DWORD		m_tBegan;				// Time when this download began trying to download (Started searching, etc). 0 means not tried this session.
 	DWORD		m_tSaved;
+	DWORD		m_nSnapshotSize;		// Size of the .pd file (0 - no valid .pd yet)
+	DWORD		m_nSnapshotSeq;			// Sequence of the .pd file, its journal must match
+	DWORD		m_nJournalSize;			// Size of the .pd journal appended since
 
 	CDownloadTask	m_pTask;
 
@@ -104,6 +107,9 @@ private:
 	void		AbortTask();
 	DWORD		GetStartTimer() const;
 	void		OnDownloaded();
+	BOOL		SaveJournal();			// Append changes since last save to the .pd journal
+	BOOL		LoadJournal();			// Replay the .pd journal over the loaded .pd
+	static BOOL	LoadSequence(const CString& strPath, DWORD& nSequence);	// Sequence from a complete .pd file
 //	void		SerializeOld(CArchive& ar, int nVersion);	// Legacy DOWNLOAD_SER_VERSION < 11 (2002), for reference only
 
 public:
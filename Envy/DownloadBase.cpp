@@ -40,6 +40,7 @@ CDownloadBase::CDownloadBase()
 	, m_bMD5Trusted		( false )
 	, m_nCookie			( 1 )
 	, m_nSaveCookie		( 0 )
+	, m_bSnapshot		( true )
 {
 }
 
@@ -55,9 +56,12 @@ bool CDownloadBase::IsModified() const
 	return ( m_nCookie != m_nSaveCookie );
 }
 
-void CDownloadBase::SetModified()
+void CDownloadBase::SetModified(bool bSnapshot)
 {
 	++m_nCookie;
+
+	if ( bSnapshot )
+		m_bSnapshot = true;
 }
 
 //////////////////////////////////////////////////////////////////////
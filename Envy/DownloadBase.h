@@ -40,9 +40,10 @@ public:
 protected:
 	int				m_nCookie;
 	int				m_nSaveCookie;
+	bool			m_bSnapshot;		// A change the .pd journal can't record is pending
 
 public:
-	void			SetModified();
+	void			SetModified(bool bSnapshot = true);	// bSnapshot = false: the .pd journal will do until next full save
 	bool			IsModified() const;
 
 	virtual BOOL	SubmitData(QWORD nOffset, LPBYTE pData, QWORD nLength) = 0;
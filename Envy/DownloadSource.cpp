@@ -262,6 +262,8 @@ void CDownloadSource::Construct(const CDownload* pDownload)
 	m_bPreview				= FALSE;
 	m_bPreviewRequestSent	= FALSE;
 	m_bMetaIgnore			= FALSE;
+	m_bSaved				= FALSE;
+	m_bChanged				= FALSE;
 }
 
 CDownloadSource::~CDownloadSource()
@@ -363,6 +365,9 @@ void CDownloadSource::Serialize(CArchive& ar, int nVersion)	// DOWNLOAD_SER_VERS
 
 		ar << m_bClientExtended;
 		ar << m_bMetaIgnore;
+
+		m_bSaved = TRUE;
+		m_bChanged = FALSE;
 	}
 	else // Loading
 	{
@@ -405,6 +410,9 @@ void CDownloadSource::Serialize(CArchive& ar, int nVersion)	// DOWNLOAD_SER_VERS
 
 		//if ( nVersion >= 42 )	// 1000
 			ar >> m_bMetaIgnore;
+
+		m_bSaved = TRUE;
+		m_bChanged = FALSE;
 	}
 	//else	// nVersion < 21	Obsolete legacy Shareaza, for reference?
 	//{
@@ -529,7 +537,7 @@ BOOL CDownloadSource::CanInitiate(BOOL bNetwork, BOOL bEstablished)
 			m_bKeep = TRUE;
 			m_tAttempt = CalcFailureDelay();
 
-			m_pDownload->SetModified();
+			SetChanged();
 		}
 		else
 		{
@@ -607,14 +615,14 @@ void CDownloadSource::OnFailure(BOOL bNondestructive, DWORD nRetryAfter)
 	if ( bNondestructive || ( ++m_nFailures < Settings.Downloads.MaxAllowedFailures ) )
 	{
 		m_tAttempt = max( m_tAttempt, CalcFailureDelay( nRetryAfter ) );
-		m_pDownload->SetModified();
+		SetChanged();
 	}
 	else if ( Settings.Downloads.NeverDrop )
 	{
 		// Keep source
 		m_bKeep = TRUE;
 		m_tAttempt = CalcFailureDelay();
-		m_pDownload->SetModified();
+		SetChanged();
 	}
 	else
 	{
@@ -670,18 +678,24 @@ void CDownloadSource::OnResumeClosed()
 	}
 
 	m_tAttempt = 0;
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 //////////////////////////////////////////////////////////////////////
 // CDownloadSource status
 
+void CDownloadSource::SetChanged()
+{
+	m_bChanged = TRUE;
+	m_pDownload->SetModified( false );
+}
+
 void CDownloadSource::SetValid()
 {
 	m_bReadContent = TRUE;
 	m_nFailures = 0;
 	m_bKeep = FALSE;
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 void CDownloadSource::SetLastSeen()
@@ -690,13 +704,13 @@ void CDownloadSource::SetLastSeen()
 	GetSystemTime( &pTime );
 	SystemTimeToFileTime( &pTime, &m_tLastSeen );
 	m_bKeep = FALSE;
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 void CDownloadSource::SetGnutella(int nGnutella)
 {
 	m_nGnutella |= nGnutella;
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -712,11 +726,16 @@ BOOL CDownloadSource::CheckHash(const Hashes::Sha1Hash& oSHA1)
 	{
 		if ( m_pDownload->IsMultiFileTorrent() ) return TRUE;
 
-		m_pDownload->m_oSHA1 = oSHA1;
+		// Download hashes are not journaled, learning one needs a full save
+		if ( ! validAndEqual( m_pDownload->m_oSHA1, oSHA1 ) )
+		{
+			m_pDownload->m_oSHA1 = oSHA1;
+			m_pDownload->SetModified();
+		}
 	}
 
 	m_bSHA1 = TRUE;
-	m_pDownload->SetModified();
+	SetChanged();
 
 	return TRUE;
 }
@@ -731,11 +750,15 @@ BOOL CDownloadSource::CheckHash(const Hashes::TigerHash& oTiger)
 	{
 		if ( m_pDownload->IsMultiFileTorrent() ) return TRUE;
 
-		m_pDownload->m_oTiger = oTiger;
+		if ( ! validAndEqual( m_pDownload->m_oTiger, oTiger ) )
+		{
+			m_pDownload->m_oTiger = oTiger;
+			m_pDownload->SetModified();
+		}
 	}
 
 	m_bTiger = TRUE;
-	m_pDownload->SetModified();
+	SetChanged();
 
 	return TRUE;
 }
@@ -750,11 +773,15 @@ BOOL CDownloadSource::CheckHash(const Hashes::Ed2kHash& oED2K)
 	{
 		if ( m_pDownload->IsMultiFileTorrent() ) return TRUE;
 
-		m_pDownload->m_oED2K = oED2K;
+		if ( ! validAndEqual( m_pDownload->m_oED2K, oED2K ) )
+		{
+			m_pDownload->m_oED2K = oED2K;
+			m_pDownload->SetModified();
+		}
 	}
 
 	m_bED2K = TRUE;
-	m_pDownload->SetModified();
+	SetChanged();
 
 	return TRUE;
 }
@@ -769,11 +796,15 @@ BOOL CDownloadSource::CheckHash(const Hashes::BtHash& oBTH)
 	{
 		if ( m_pDownload->IsTorrent() ) return TRUE;
 
-		m_pDownload->m_oBTH = oBTH;
+		if ( ! validAndEqual( m_pDownload->m_oBTH, oBTH ) )
+		{
+			m_pDownload->m_oBTH = oBTH;
+			m_pDownload->SetModified();
+		}
 	}
 
 	m_bBTH = TRUE;
-	m_pDownload->SetModified();
+	SetChanged();
 
 	return TRUE;
 }
@@ -788,11 +819,15 @@ BOOL CDownloadSource::CheckHash(const Hashes::Md5Hash& oMD5)
 	{
 		if ( m_pDownload->IsMultiFileTorrent() ) return TRUE;
 
-		m_pDownload->m_oMD5 = oMD5;
+		if ( ! validAndEqual( m_pDownload->m_oMD5, oMD5 ) )
+		{
+			m_pDownload->m_oMD5 = oMD5;
+			m_pDownload->SetModified();
+		}
 	}
 
 	m_bMD5 = TRUE;
-	m_pDownload->SetModified();
+	SetChanged();
 
 	return TRUE;
 }
@@ -890,7 +925,7 @@ void CDownloadSource::AddFragment(QWORD nOffset, QWORD nLength, BOOL /*bMerge*/)
 {
 	m_bReadContent = TRUE;
 	m_oPastFragments.insert( Fragments::Fragment( nOffset, nOffset + nLength ) );
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -924,7 +959,7 @@ void CDownloadSource::SetAvailableRanges(LPCTSTR pszRanges)
 		}
 	}
 
-	m_pDownload->SetModified();
+	SetChanged();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -88,6 +88,8 @@ public:
 	BOOL				m_bPreview;				// Does the user allow previews?
 	BOOL				m_bPreviewRequestSent;
 	BOOL				m_bMetaIgnore;			// Ignore metadata from this source (for example already got)
+	BOOL				m_bSaved;				// Stored in the .pd file or its journal
+	BOOL				m_bChanged;				// State changed since stored, journal stores it again
 
 public:
 	BOOL		ResolveURL();
@@ -100,6 +102,7 @@ public:
 	void		OnResume();
 	void		OnResumeClosed();
 
+	void		SetChanged();		// Stored state is outdated, for the .pd journal
 	void		SetValid();
 	void		SetLastSeen();
 	void		SetGnutella(int nGnutella);
@@ -226,6 +226,7 @@ BOOL CDownloadTransferED2K::OnConnected()
 	UpdateCountry();
 
 	m_pSource->m_oGUID	= m_pClient->m_oGUID;
+	m_pDownload->ReindexSource( m_pSource );
 	m_pSource->m_sNick	= m_pClient->m_sNick;
 	m_pSource->m_sServer = m_sUserAgent = m_pClient->m_sUserAgent;
 	m_pSource->SetLastSeen();
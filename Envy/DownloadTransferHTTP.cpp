@@ -675,6 +675,51 @@ BOOL CDownloadTransferHTTP::ReadResponseLine()
 //////////////////////////////////////////////////////////////////////
 // CDownloadTransferHTTP read header lines
 
+// Expected headers, hashed once at startup so lookups only read the table
+static const CTextSwitch::Item pHeaderItems[] =
+{
+	{ L"server",						'S' },
+	{ L"connection",					'C' },
+	{ L"location",						'L' },
+	{ L"retry-after",					'R' },
+	{ L"content-length",				'l' },
+	{ L"content-range",					'r' },
+	{ L"content-type",					't' },
+	{ L"content-language",				'y' },
+	{ L"content-encoding",				'e' },
+	{ L"transfer-encoding",				'E' },
+	{ L"content-urn",					'u' },
+	{ L"x-content-urn",					'u' },
+	{ L"x-gnutella-content-urn",		'u' },
+	{ L"x-metadata-path",				'm' },
+	{ L"x-tigertree-path",				'g' },
+	{ L"x-thex-uri",					'h' },
+	{ L"alt-location",					'a' },
+	{ L"x-alt",							'a' },
+	{ L"x-gnutella-alternate-location",	'a' },
+	{ L"x-available-ranges",			'v' },
+	{ L"x-queue",						'q' },
+	{ L"x-perhost",						'p' },
+	{ L"x-gnutella-maxslotsperhost",	'p' },
+	{ L"x-delete-source",				'd' },
+	{ L"x-nick",						'n' },
+	{ L"x-name",						'n' },
+	{ L"x-username",					'n' },
+	{ L"x-features",					'f' },
+	{ L"content-disposition",			'o' },
+	{ L"content-md5",					'5' },
+
+	{ L"x-node",						'x' },
+	{ L"x-nalt",						'x' },
+	{ L"x-palt",						'x' },
+	{ L"fp-1a",							'x' },
+	{ L"fp-auth-challenge",				'x' },
+	{ L"accept-ranges",					'x' },
+	{ L"x-create-time",					'x' },
+};
+
+static const CTextSwitch HeaderNames( pHeaderItems, _countof( pHeaderItems ) );
+
 BOOL CDownloadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 {
 	ASSUME_LOCK( Transfers.m_pSection );
@@ -682,56 +727,10 @@ BOOL CDownloadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 	if ( ! CDownloadTransfer::OnHeaderLine( strHeader, strValue ) )
 		return FALSE;
 
-	CString strCase( strHeader );
-	if ( strCase.GetLength() < 4 )
+	if ( strHeader.GetLength() < 4 )
 		return TRUE;	// Skip bad/unknown small header
 
-	strCase.MakeLower();
-
-	// Expected Headers
-	SwitchMap( Text )
-	{
-		Text[ L"server" ]					= 'S';
-		Text[ L"connection" ]				= 'C';
-		Text[ L"location" ]					= 'L';
-		Text[ L"retry-after" ]				= 'R';
-		Text[ L"content-length" ]			= 'l';
-		Text[ L"content-range" ]			= 'r';
-		Text[ L"content-type" ]				= 't';
-		Text[ L"content-language" ]			= 'y';
-		Text[ L"content-encoding" ]			= 'e';
-		Text[ L"transfer-encoding" ]		= 'E';
-		Text[ L"content-urn" ]				= 'u';
-		Text[ L"x-content-urn" ]			= 'u';
-		Text[ L"x-gnutella-content-urn" ]	= 'u';
-		Text[ L"x-metadata-path" ]			= 'm';
-		Text[ L"x-tigertree-path" ]			= 'g';
-		Text[ L"x-thex-uri" ]				= 'h';
-		Text[ L"alt-location" ]				= 'a';
-		Text[ L"x-alt" ]					= 'a';
-		Text[ L"x-gnutella-alternate-location" ] = 'a';
-		Text[ L"x-available-ranges" ]		= 'v';
-		Text[ L"x-queue" ]					= 'q';
-		Text[ L"x-perhost" ]				= 'p';
-		Text[ L"x-gnutella-maxslotsperhost" ] = 'p';
-		Text[ L"x-delete-source" ]			= 'd';
-		Text[ L"x-nick" ]					= 'n';
-		Text[ L"x-name" ]					= 'n';
-		Text[ L"x-username" ]				= 'n';
-		Text[ L"x-features" ]				= 'f';
-		Text[ L"content-disposition" ]		= 'o';
-		Text[ L"content-md5" ]				= '5';
-
-		Text[ L"x-node" ]					= 'x';
-		Text[ L"x-nalt" ]					= 'x';
-		Text[ L"x-palt" ]					= 'x';
-		Text[ L"fp-1a" ]					= 'x';
-		Text[ L"fp-auth-challenge" ] 		= 'x';
-		Text[ L"accept-ranges" ] 			= 'x';
-		Text[ L"x-create-time" ] 			= 'x';
-	}
-
-	switch ( Text[ strCase ] )
+	switch ( HeaderNames.Lookup( strHeader ) )
 	{
 	case 'S':		// "Server"
 		m_sUserAgent = strValue;
@@ -1071,7 +1070,7 @@ BOOL CDownloadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 		break;
 
 	default:		// Unknown Headers?
-		theApp.Message( MSG_DEBUG, L"Unknown header: %s", (LPCTSTR)strCase );
+		theApp.Message( MSG_DEBUG, L"Unknown header: %s", (LPCTSTR)strHeader );
 		break;
 	}
 
@@ -848,7 +848,7 @@ QWORD CDownloadWithFile::EraseRange(QWORD nOffset, QWORD nLength)
 
 	const QWORD nCount = m_pFile->InvalidateRange( nOffset, nLength );
 	if ( nCount > 0 )
-		SetModified();
+		SetModified( false );
 	return nCount;
 }
 
@@ -857,7 +857,7 @@ QWORD CDownloadWithFile::EraseRange(QWORD nOffset, QWORD nLength)
 
 BOOL CDownloadWithFile::SubmitData(QWORD nOffset, LPBYTE pData, QWORD nLength)
 {
-	SetModified();
+	SetModified( false );
 	m_tReceived = GetTickCount();
 
 	// Note BitTorrent-specific virtual function
@@ -1033,3 +1033,29 @@ void CDownloadWithFile::SerializeFile(CArchive& ar, int nVersion)
 	if ( m_pFile.get() )
 		m_pFile->Serialize( ar, nVersion );
 }
+
+void CDownloadWithFile::SerializeFragments(CArchive& ar, int nVersion)
+{
+	if ( ar.IsStoring() )
+	{
+		ar.WriteCount( m_pFile.get() != NULL );
+
+		if ( m_pFile.get() )
+			m_pFile->SerializeFragments( ar, nVersion );
+	}
+	else // Loading
+	{
+		if ( ! ar.ReadCount() )
+			return;
+
+		if ( m_pFile.get() )
+		{
+			m_pFile->SerializeFragments( ar, nVersion );
+		}
+		else
+		{
+			Fragments::List oSkip( 0 );
+			SerializeIn1( ar, oSkip, nVersion );
+		}
+	}
+}
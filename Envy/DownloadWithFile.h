@@ -89,6 +89,7 @@ protected:
 	BOOL			ReadFile(QWORD nOffset, LPVOID pData, QWORD nLength, QWORD* pnRead = NULL);
 	BOOL			WriteFile(QWORD nOffset, LPCVOID pData, QWORD nLength, QWORD* pnWritten = NULL);
 	void			SerializeFile(CArchive& ar, int nVersion);
+	void			SerializeFragments(CArchive& ar, int nVersion);	// .pd journal
 	virtual BOOL	OnVerify(const CLibraryFile* pFile, TRISTATE bVerified);	// File was hashed and verified in the Library
 
 	virtual void	Serialize(CArchive& ar, int nVersion);
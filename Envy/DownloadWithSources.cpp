@@ -48,12 +48,15 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+#define ALTLOC_REFRESH	5000	// ms, failures and last seen times change without touching the source list
+
 
 //////////////////////////////////////////////////////////////////////
 // CDownloadWithSources construction
 
 CDownloadWithSources::CDownloadWithSources()
-	: m_nG1SourceCount	( 0 )
+	: m_nSourceCookie	( 0 )
+	, m_nG1SourceCount	( 0 )
 	, m_nG2SourceCount	( 0 )
 	, m_nEdSourceCount	( 0 )
 	, m_nHTTPSourceCount( 0 )
@@ -62,6 +65,10 @@ CDownloadWithSources::CDownloadWithSources()
 	, m_nDCSourceCount	( 0 )
 	, m_pXML			( NULL )
 {
+	// CMap never grows its table, size for a full source list
+	const UINT nTableSize = GetBestHashTableSize( Settings.Downloads.SourcesWanted );
+	m_pSourceIndex.InitHashTable( nTableSize );
+	m_pFailedIndex.InitHashTable( nTableSize );
 }
 
 CDownloadWithSources::~CDownloadWithSources()
@@ -74,6 +81,7 @@ CDownloadWithSources::~CDownloadWithSources()
 		delete m_pFailedSources.GetNext( pos );
 
 	m_pFailedSources.RemoveAll();
+	m_pFailedIndex.RemoveAll();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -212,7 +220,7 @@ BOOL CDownloadWithSources::CheckSource(CDownloadSource* pCheck) const
 {
 	CQuickLock pLock( Transfers.m_pSection );
 
-	return ( m_pSources.Find( pCheck ) != NULL );
+	return ( m_pSourceIndex.PLookup( pCheck ) != NULL );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -229,6 +237,11 @@ void CDownloadWithSources::ClearSources()
 		pSource->Remove();
 	}
 	m_pSources.RemoveAll();
+	m_pSourceIndex.RemoveAll();
+	m_pSourcesByAddress.clear();
+	m_pSourcesByGUID.clear();
+	m_pSourcesByURL.clear();
+	m_nSourceCookie++;
 
 	m_nG1SourceCount	= 0;
 	m_nG2SourceCount	= 0;
@@ -584,10 +597,28 @@ BOOL CDownloadWithSources::AddSourceInternal(CDownloadSource* pSource)
 			Settings.Gnutella2.Enabled &&
 			VendorCache.IsExtended( pSource->m_sServer );
 
+		// Only sources sharing the address or the GUID can be equal (see CDownloadSource::Equals)
+		CList< CDownloadSource* > pMatches;
+		std::pair< CEndpointMap::const_iterator, CEndpointMap::const_iterator > oRange =
+			m_pSourcesByAddress.equal_range( pSource->m_pAddress.S_un.S_addr );
+		for ( ; oRange.first != oRange.second; ++oRange.first )
+		{
+			pMatches.AddTail( oRange.first->second );
+		}
+		if ( pSource->m_oGUID.isValid() )
+		{
+			oRange = m_pSourcesByGUID.equal_range( FoldGUID( pSource ) );
+			for ( ; oRange.first != oRange.second; ++oRange.first )
+			{
+				if ( pMatches.Find( oRange.first->second ) == NULL )
+					pMatches.AddTail( oRange.first->second );
+			}
+		}
+
 		// Remove unneeded sources
-		for ( POSITION posSource = GetIterator(); posSource; )
+		for ( POSITION posSource = pMatches.GetHeadPosition(); posSource; )
 		{
-			CDownloadSource* pExisting = GetNext( posSource );
+			CDownloadSource* pExisting = pMatches.GetNext( posSource );
 
 			ASSERT( pSource != pExisting );
 			if ( pExisting->Equals( pSource ) ) 	// IPs and ports are equal
@@ -626,7 +657,7 @@ BOOL CDownloadWithSources::AddSourceInternal(CDownloadSource* pSource)
 		{
 			delete pSource;
 
-			SetModified();
+			SetModified( false );
 
 			return FALSE;
 		}
@@ -708,7 +739,7 @@ BOOL CDownloadWithSources::AddSourceInternal(CDownloadSource* pSource)
 
 	InternalAdd( pSource );
 
-	SetModified();
+	SetModified( false );
 
 	return TRUE;
 }
@@ -720,58 +751,109 @@ CString CDownloadWithSources::GetSourceURLs(CList< CString >* pState, int nMaxim
 {
 	CQuickLock pLock( Transfers.m_pSection );
 
+	// Header entries are prebuilt per protocol, a full list is built for this call only
+	CAltLocCache oAll;
+	CAltLocCache& oCache = ( nProtocol == PROTOCOL_G1 ) ? m_pAltLocG1 :
+		( nProtocol == PROTOCOL_HTTP ) ? m_pAltLocHTTP : oAll;
+
+	const DWORD tNow = GetTickCount();
+	if ( &oCache == &oAll || oCache.nCookie != m_nSourceCookie || tNow - oCache.tBuilt > ALTLOC_REFRESH )
+	{
+		BuildAltLocCache( oCache, nProtocol );
+		oCache.nCookie = m_nSourceCookie;
+		oCache.tBuilt = tNow;
+	}
+
+	const size_t nCount = oCache.pEntries.size();
+	if ( nCount == 0 )
+		return CString();
+
+	// What this transfer was already sent, hashed once instead of searched per source
+	CMap< CString, const CString&, BOOL, BOOL > pSent;
+	if ( pState != NULL && ! pState->IsEmpty() )
+	{
+		pSent.InitHashTable( GetBestHashTableSize( (DWORD)pState->GetCount() ) );
+		for ( POSITION pos = pState->GetHeadPosition(); pos; )
+		{
+			pSent.SetAt( pState->GetNext( pos ), TRUE );
+		}
+	}
+
+	// Start where the last header stopped, so other peers get other sources
 	CString strSources;
+	size_t nIndex = oCache.nNext % nCount;
+	for ( size_t nScan = 0; nScan < nCount; ++nScan, nIndex = ( nIndex + 1 ) % nCount )
+	{
+		const CAltLocEntry& oEntry = oCache.pEntries[ nIndex ];
+
+		BOOL bSent;
+		if ( oEntry.pSource == pExcept || ( pState != NULL && pSent.Lookup( oEntry.sURL, bSent ) ) )
+			continue;
+
+		if ( pState != NULL ) pState->AddTail( oEntry.sURL );
+
+		if ( ! strSources.IsEmpty() )
+			strSources += ( nProtocol == PROTOCOL_G1 ) ? L"," : L", ";
+		strSources += oEntry.sEntry;
+
+		oCache.nNext = nIndex + 1;
+
+		if ( nMaximum == 1 )
+			break;
+		else if ( nMaximum > 1 )
+			nMaximum --;
+	}
+
+	return strSources;
+}
+
+void CDownloadWithSources::BuildAltLocCache(CAltLocCache& oCache, PROTOCOLID nProtocol) const
+{
+	ASSUME_LOCK( Transfers.m_pSection );
+
+	oCache.pEntries.clear();
+	oCache.pEntries.reserve( m_pSources.GetCount() );
 
 	for ( POSITION posSource = GetIterator(); posSource; )
 	{
 		CDownloadSource* pSource = GetNext( posSource );
 
-		if ( pSource != pExcept && pSource->m_bPushOnly == FALSE &&
+		if ( pSource->m_bPushOnly == FALSE &&
 			 ( ( pSource->m_nFailures == 0 && pSource->m_bReadContent ) || nProtocol == PROTOCOL_NULL ) &&
-			 ( pSource->m_bSHA1 || pSource->m_bTiger || pSource->m_bED2K || pSource->m_bBTH || pSource->m_bMD5 ) &&
-			 ( pState == NULL || pState->Find( pSource->m_sURL ) == NULL ) )
+			 ( pSource->m_bSHA1 || pSource->m_bTiger || pSource->m_bED2K || pSource->m_bBTH || pSource->m_bMD5 ) )
 		{
 			// Only return appropriate sources
 			if ( ( nProtocol == PROTOCOL_HTTP ) && ( pSource->m_nProtocol != PROTOCOL_HTTP ) ) continue;
 			if ( ( nProtocol == PROTOCOL_G1 ) && ( pSource->m_nGnutella != 1 ) ) continue;
 			//if ( bHTTP && pSource->m_nProtocol != PROTOCOL_HTTP ) continue;
 
-			if ( pState != NULL ) pState->AddTail( pSource->m_sURL );
+			CAltLocEntry oEntry;
+			oEntry.pSource = pSource;
+			oEntry.sURL = pSource->m_sURL;
 
 			if ( nProtocol == PROTOCOL_G1 )
 			{
-				if ( ! strSources.IsEmpty() )
-					strSources += ',';
-				strSources += CString( inet_ntoa( pSource->m_pAddress ) );
-				CString strURL;
-				strURL.Format( L"%hu", pSource->m_nPort );
-				strSources += ':' + strURL;
+				oEntry.sEntry.Format( L"%s:%hu",
+					(LPCTSTR)CString( inet_ntoa( pSource->m_pAddress ) ), pSource->m_nPort );
 			}
 			else if ( pSource->m_sURL.Find( L"Zhttp://" ) >= 0 ||
 				pSource->m_sURL.Find( L"Z%2C http://" ) >= 0 )
 			{
 				// Ignore buggy URLs
 				TRACE( "CDownloadWithSources::GetSourceURLs() Bad URL: %s\n", (LPCSTR)CT2A( pSource->m_sURL ) );
+				continue;
 			}
 			else
 			{
-				CString strURL = pSource->m_sURL;
-				strURL.Replace( L",", L"%2C" );
-
-				if ( ! strSources.IsEmpty() ) strSources += L", ";
-				strSources += strURL;
-				strSources += ' ';
-				strSources += TimeToString( &pSource->m_tLastSeen );
+				oEntry.sEntry = pSource->m_sURL;
+				oEntry.sEntry.Replace( L",", L"%2C" );
+				oEntry.sEntry += ' ';
+				oEntry.sEntry += TimeToString( &pSource->m_tLastSeen );
 			}
 
-			if ( nMaximum == 1 )
-				break;
-			else if ( nMaximum > 1 )
-				nMaximum --;
+			oCache.pEntries.push_back( oEntry );
 		}
 	}
-
-	return strSources;
 }
 
 // Returns a string containing the most recent failed sources
@@ -879,32 +961,20 @@ CFailedSource* CDownloadWithSources::LookupFailedSource(LPCTSTR pszUrl, bool bRe
 
 	CFailedSource* pResult = NULL;
 
-	for ( POSITION pos = m_pFailedSources.GetHeadPosition(); pos; )
+	if ( m_pFailedIndex.Lookup( CString( pszUrl ), pResult ) )
 	{
-		pResult = m_pFailedSources.GetNext( pos );
-		if ( pResult && pResult->m_sURL.Compare( pszUrl ) == 0 )
-		{
 #ifndef NDEBUG
-			theApp.Message( MSG_DEBUG, L"Votes for file %s: negative - %i, positive - %i; offline status: %i",
-				pszUrl, pResult->m_nNegativeVotes,
-				pResult->m_nPositiveVotes,
-				pResult->m_bOffline );
+		theApp.Message( MSG_DEBUG, L"Votes for file %s: negative - %i, positive - %i; offline status: %i",
+			pszUrl, pResult->m_nNegativeVotes,
+			pResult->m_nPositiveVotes,
+			pResult->m_bOffline );
 #endif
-			if ( pResult->m_bLocal )
-				break;
-
-			if ( bReliable )	// Not used anywhere at the moment, we check that explicitly
-			{
-				INT_PTR nTotalVotes = pResult->m_nNegativeVotes + pResult->m_nPositiveVotes;
-				if ( nTotalVotes > 20 && pResult->m_nNegativeVotes / nTotalVotes > 2 / 3 )
-					break;
-			}
-			break;	// Temp solution to ensure same source not added more than once
-					// We should check IPs which add these sources, since voting takes place, etc.
-		}
-		else
-			pResult = NULL;
+		// bReliable is not used anywhere at the moment, we check votes explicitly.
+		// Any match is returned to ensure same source not added more than once.
+		// We should check IPs which add these sources, since voting takes place, etc.
+		UNUSED_ALWAYS( bReliable );
 	}
+
 	return pResult;
 }
 
@@ -932,6 +1002,7 @@ void CDownloadWithSources::AddFailedSource(LPCTSTR pszUrl, bool bLocal, bool bOf
 		if ( CFailedSource* pBadSource = new CFailedSource( pszUrl, bLocal, bOffline ) )
 		{
 			m_pFailedSources.AddTail( pBadSource );
+			m_pFailedIndex.SetAt( pBadSource->m_sURL, pBadSource );
 			theApp.Message( MSG_DEBUG, L"Bad sources count for \"%s\": %i. URL: %s", (LPCTSTR)m_sName, m_pFailedSources.GetCount(), pszUrl );
 		}
 	}
@@ -962,6 +1033,7 @@ void CDownloadWithSources::ExpireFailedSources()
 			// Expire bad sources added more than 2 hours ago
 			if ( tNow > pBadSource->m_nTimeAdded + ( 2 * 3600 * 1000 ) )
 			{
+				m_pFailedIndex.RemoveKey( pBadSource->m_sURL );
 				delete pBadSource;
 				m_pFailedSources.RemoveAt( posThis );
 			}
@@ -985,6 +1057,8 @@ void CDownloadWithSources::ClearFailedSources()
 			m_pFailedSources.RemoveAt( posThis );
 		}
 	}
+
+	m_pFailedIndex.RemoveAll();
 }
 
 
@@ -995,8 +1069,8 @@ void CDownloadWithSources::InternalAdd(CDownloadSource* pSource)
 {
 	ASSUME_LOCK( Transfers.m_pSection );
 
-	ASSERT( m_pSources.Find( pSource ) == NULL );
-	m_pSources.AddTail( pSource );
+	ASSERT( m_pSourceIndex.PLookup( pSource ) == NULL );
+	IndexSource( pSource, m_pSources.AddTail( pSource ) );
 
 	switch ( pSource->m_nProtocol )
 	{
@@ -1030,9 +1104,14 @@ void CDownloadWithSources::InternalRemove(CDownloadSource* pSource)
 {
 	ASSUME_LOCK( Transfers.m_pSection );
 
-	POSITION posSource = m_pSources.Find( pSource );
-	ASSERT( posSource != NULL );
-	m_pSources.RemoveAt( posSource );
+	CSourceMap::CPair* pEntry = m_pSourceIndex.PLookup( pSource );
+	ASSERT( pEntry != NULL );
+	if ( pEntry == NULL )
+		return;
+
+	const CSourceEntry oEntry = pEntry->value;
+	m_pSources.RemoveAt( oEntry.pos );
+	UnindexSource( pSource, oEntry );
 
 	switch ( pSource->m_nProtocol )
 	{
@@ -1062,6 +1141,91 @@ void CDownloadWithSources::InternalRemove(CDownloadSource* pSource)
 	}
 }
 
+void CDownloadWithSources::IndexSource(CDownloadSource* pSource, POSITION pos)
+{
+	CSourceEntry oEntry;
+	oEntry.pos		= pos;
+	oEntry.nAddress	= pSource->m_pAddress.S_un.S_addr;
+	oEntry.bGUID	= pSource->m_oGUID.isValid();
+	oEntry.nGUID	= oEntry.bGUID ? FoldGUID( pSource ) : 0;
+	m_pSourceIndex.SetAt( pSource, oEntry );
+
+	m_pSourcesByAddress.insert( CEndpointMap::value_type( oEntry.nAddress, pSource ) );
+	if ( oEntry.bGUID )
+		m_pSourcesByGUID.insert( CEndpointMap::value_type( oEntry.nGUID, pSource ) );
+	m_pSourcesByURL.insert( CSourceURLMap::value_type( pSource->m_sURL, pSource ) );
+
+	m_nSourceCookie++;
+}
+
+void CDownloadWithSources::UnindexSource(const CDownloadSource* pSource, const CSourceEntry& oEntry)
+{
+	std::pair< CEndpointMap::iterator, CEndpointMap::iterator > oRange =
+		m_pSourcesByAddress.equal_range( oEntry.nAddress );
+	for ( ; oRange.first != oRange.second; ++oRange.first )
+	{
+		if ( oRange.first->second == pSource )
+		{
+			m_pSourcesByAddress.erase( oRange.first );
+			break;
+		}
+	}
+
+	if ( oEntry.bGUID )
+	{
+		oRange = m_pSourcesByGUID.equal_range( oEntry.nGUID );
+		for ( ; oRange.first != oRange.second; ++oRange.first )
+		{
+			if ( oRange.first->second == pSource )
+			{
+				m_pSourcesByGUID.erase( oRange.first );
+				break;
+			}
+		}
+	}
+
+	std::pair< CSourceURLMap::iterator, CSourceURLMap::iterator > oURLs =
+		m_pSourcesByURL.equal_range( pSource->m_sURL );
+	for ( ; oURLs.first != oURLs.second; ++oURLs.first )
+	{
+		if ( oURLs.first->second == pSource )
+		{
+			m_pSourcesByURL.erase( oURLs.first );
+			break;
+		}
+	}
+
+	m_pSourceIndex.RemoveKey( pSource );
+
+	m_nSourceCookie++;
+}
+
+CDownloadSource* CDownloadWithSources::FindSourceByURL(const CString& strURL) const
+{
+	CSourceURLMap::const_iterator i = m_pSourcesByURL.find( strURL );
+	return ( i != m_pSourcesByURL.end() ) ? i->second : NULL;
+}
+
+// Call after changing the address or GUID of a listed source
+void CDownloadWithSources::ReindexSource(CDownloadSource* pSource)
+{
+	CQuickLock pLock( Transfers.m_pSection );
+
+	CSourceMap::CPair* pEntry = m_pSourceIndex.PLookup( pSource );
+	if ( ! pEntry )
+		return;		// Not listed (yet)
+
+	const CSourceEntry oEntry = pEntry->value;
+	UnindexSource( pSource, oEntry );
+	IndexSource( pSource, oEntry.pos );
+}
+
+DWORD CDownloadWithSources::FoldGUID(const CDownloadSource* pSource)
+{
+	const DWORD* pGUID = reinterpret_cast< const DWORD* >( &*pSource->m_oGUID.begin() );
+	return pGUID[ 0 ] ^ pGUID[ 1 ] ^ pGUID[ 2 ] ^ pGUID[ 3 ];
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // CDownloadWithSources remove a source
@@ -1075,7 +1239,11 @@ void CDownloadWithSources::RemoveSource(CDownloadSource* pSource, BOOL bBan)
 	if ( bBan && ! pSource->m_sURL.IsEmpty() )
 		AddFailedSource( pSource );
 
-	SetModified();
+	// The .pd still lists it
+	if ( pSource->m_bSaved )
+		m_pSavedRemoved.AddTail( pSource->m_sURL );
+
+	SetModified( false );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1088,15 +1256,17 @@ void CDownloadWithSources::SortSource(CDownloadSource* pSource, BOOL bTop)
 	if ( m_pSources.GetCount() == 1 )
 		return;		// No sorting
 
-	POSITION posSource = m_pSources.Find( pSource );
-	ASSERT( posSource );
+	CSourceMap::CPair* pEntry = m_pSourceIndex.PLookup( pSource );
+	ASSERT( pEntry );
+	if ( ! pEntry )
+		return;
 
-	m_pSources.RemoveAt( posSource );
+	m_pSources.RemoveAt( pEntry->value.pos );
 
 	if ( bTop )
-		m_pSources.AddHead( pSource );
+		pEntry->value.pos = m_pSources.AddHead( pSource );
 	else
-		m_pSources.AddTail( pSource );
+		pEntry->value.pos = m_pSources.AddTail( pSource );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1109,9 +1279,12 @@ void CDownloadWithSources::SortSource(CDownloadSource* pSource)
 	if ( m_pSources.GetCount() == 1 )
 		return;		// No sorting
 
-	POSITION posSource = m_pSources.Find( pSource );
-	ASSERT( posSource );
+	CSourceMap::CPair* pEntry = m_pSourceIndex.PLookup( pSource );
+	ASSERT( pEntry );
+	if ( ! pEntry )
+		return;
 
+	POSITION posSource = pEntry->value.pos;
 	m_pSources.RemoveAt( posSource );
 
 	// Run through the sources to the correct position
@@ -1125,7 +1298,7 @@ void CDownloadWithSources::SortSource(CDownloadSource* pSource)
 	}
 
 	// Insert source in front of current compare source
-	m_pSources.InsertBefore( posSource, pSource );
+	pEntry->value.pos = m_pSources.InsertBefore( posSource, pSource );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1198,6 +1371,8 @@ void CDownloadWithSources::Serialize(CArchive& ar, int nVersion)	// DOWNLOAD_SER
 			pSource->Serialize( ar, nVersion );
 		}
 
+		m_pSavedRemoved.RemoveAll();
+
 		ar.WriteCount( m_pXML != NULL ? 1 : 0 );
 		if ( m_pXML ) m_pXML->Serialize( ar );
 	}
@@ -1205,26 +1380,9 @@ void CDownloadWithSources::Serialize(CArchive& ar, int nVersion)	// DOWNLOAD_SER
 	{
 		for ( DWORD_PTR nSources = ar.ReadCount(); nSources; nSources-- )
 		{
-			// Create new source
-			//CDownloadSource* pSource = new CDownloadSource( (CDownload*)this );	// Obsolete
-			CAutoPtr< CDownloadSource > pSource( new CDownloadSource( static_cast< CDownload* >( this ) ) );
-			if ( ! pSource )
-				AfxThrowMemoryException();
-
-			// Load details from disk
-			pSource->Serialize( ar, nVersion );
-
-			// Extract ed2k client ID from url (m_pAddress) because it wasn't saved
-			if ( ! pSource->m_nPort && _tcsnicmp( pSource->m_sURL, L"ed2kftp://", 10 ) == 0 )
-			{
-				CString strURL = pSource->m_sURL.Mid( 10 );
-				if ( ! strURL.IsEmpty() )
-					_stscanf( strURL, L"%lu", &pSource->m_pAddress.S_un.S_addr );
-			}
-
 			// Add to the list no more than ~500 sources
 			//if ( nSources < (DWORD_PTR)Settings.Downloads.SourcesWanted )
-				InternalAdd( pSource.Detach() );
+				LoadSource( ar, nVersion );
 		}
 
 		if ( ar.ReadCount() )
@@ -1238,6 +1396,92 @@ void CDownloadWithSources::Serialize(CArchive& ar, int nVersion)	// DOWNLOAD_SER
 	}
 }
 
+void CDownloadWithSources::LoadSource(CArchive& ar, int nVersion, BOOL bReplace)
+{
+	// Create new source
+	//CDownloadSource* pSource = new CDownloadSource( (CDownload*)this );	// Obsolete
+	CAutoPtr< CDownloadSource > pSource( new CDownloadSource( static_cast< CDownload* >( this ) ) );
+	if ( ! pSource )
+		AfxThrowMemoryException();
+
+	// Load details from disk
+	pSource->Serialize( ar, nVersion );
+
+	// Extract ed2k client ID from url (m_pAddress) because it wasn't saved
+	if ( ! pSource->m_nPort && _tcsnicmp( pSource->m_sURL, L"ed2kftp://", 10 ) == 0 )
+	{
+		CString strURL = pSource->m_sURL.Mid( 10 );
+		if ( ! strURL.IsEmpty() )
+			_stscanf( strURL, L"%lu", &pSource->m_pAddress.S_un.S_addr );
+	}
+
+	// Journal stores changed sources again, newer state replaces older
+	if ( bReplace )
+	{
+		if ( CDownloadSource* pExisting = FindSourceByURL( pSource->m_sURL ) )
+		{
+			InternalRemove( pExisting );
+			delete pExisting;
+		}
+	}
+
+	InternalAdd( pSource.Detach() );
+}
+
+void CDownloadWithSources::SerializeSourceChanges(CArchive& ar, int nVersion)
+{
+	ASSUME_LOCK( Transfers.m_pSection );
+
+	if ( ar.IsStoring() )
+	{
+		ar.WriteCount( m_pSavedRemoved.GetCount() );
+		for ( POSITION pos = m_pSavedRemoved.GetHeadPosition(); pos; )
+		{
+			ar << m_pSavedRemoved.GetNext( pos );
+		}
+		m_pSavedRemoved.RemoveAll();
+
+		// New and changed sources among those a full save would store
+		CList< CDownloadSource* > pAdded;
+		DWORD_PTR nSources = (DWORD_PTR)GetCount();
+		if ( nSources > Settings.Downloads.SourcesWanted )
+			nSources = (DWORD_PTR)Settings.Downloads.SourcesWanted;
+
+		for ( POSITION posSource = GetIterator(); posSource && nSources; nSources-- )
+		{
+			CDownloadSource* pSource = GetNext( posSource );
+
+			if ( ! pSource->m_bSaved || pSource->m_bChanged )
+				pAdded.AddTail( pSource );
+		}
+
+		ar.WriteCount( pAdded.GetCount() );
+		for ( POSITION pos = pAdded.GetHeadPosition(); pos; )
+		{
+			pAdded.GetNext( pos )->Serialize( ar, nVersion );
+		}
+	}
+	else // Loading
+	{
+		for ( DWORD_PTR nRemoved = ar.ReadCount(); nRemoved; nRemoved-- )
+		{
+			CString strURL;
+			ar >> strURL;
+
+			if ( CDownloadSource* pSource = FindSourceByURL( strURL ) )
+			{
+				InternalRemove( pSource );
+				delete pSource;
+			}
+		}
+
+		for ( DWORD_PTR nAdded = ar.ReadCount(); nAdded; nAdded-- )
+		{
+			LoadSource( ar, nVersion, TRUE );
+		}
+	}
+}
+
 void CDownloadWithSources::MergeMetadata(const CXMLElement* pXML)
 {
 	CQuickLock pLock( Transfers.m_pSection );
@@ -56,8 +56,46 @@ protected:
 	virtual ~CDownloadWithSources();
 
 private:
+	// Where a source sits in m_pSources, and the endpoint keys it was indexed under
+	struct CSourceEntry
+	{
+		POSITION	pos;
+		DWORD		nAddress;
+		DWORD		nGUID;
+		bool		bGUID;
+	};
+	typedef CMap< const CDownloadSource*, const CDownloadSource*, CSourceEntry, const CSourceEntry& > CSourceMap;
+	typedef std::multimap< DWORD, CDownloadSource* > CEndpointMap;
+	typedef std::multimap< CString, CDownloadSource* > CSourceURLMap;
+	typedef CMap< CString, const CString&, CFailedSource*, CFailedSource* > CFailedMap;
+
+	// Prebuilt alt-location header entries, handed out from a rotating start
+	struct CAltLocEntry
+	{
+		const CDownloadSource*	pSource;	// Compared only, never dereferenced
+		CString		sURL;					// As the transfer remembers it was sent
+		CString		sEntry;					// As written to the header
+	};
+	struct CAltLocCache
+	{
+		CAltLocCache() : nCookie( 0 ), tBuilt( 0 ), nNext( 0 ) {}
+		std::vector< CAltLocEntry >	pEntries;
+		DWORD		nCookie;				// m_nSourceCookie when built
+		DWORD		tBuilt;
+		size_t		nNext;
+	};
+
 	CList< CDownloadSource* >	m_pSources;		// Download sources
+	CSourceMap		m_pSourceIndex;		// Source to list position
+	CEndpointMap	m_pSourcesByAddress;	// Sources by IP address
+	CEndpointMap	m_pSourcesByGUID;	// Sources by folded GUID, when they have one
+	CSourceURLMap	m_pSourcesByURL;	// Sources by URL (fixed once listed)
+	DWORD			m_nSourceCookie;	// Changes whenever m_pSources does
+	mutable CAltLocCache	m_pAltLocG1;	// X-Alt
+	mutable CAltLocCache	m_pAltLocHTTP;	// Alt-Location
 	CList< CFailedSource* >	m_pFailedSources;	// Failed source with a timestamp when added
+	CFailedMap		m_pFailedIndex;		// Failed sources by URL
+	CList< CString >	m_pSavedRemoved;	// URLs of removed sources the .pd still lists
 	int				m_nG1SourceCount;
 	int				m_nG2SourceCount;
 	int				m_nEdSourceCount;
@@ -92,6 +130,7 @@ public:
 	int				AddSourceURLs(LPCTSTR pszURLs, BOOL bFailed = FALSE);
 	void			RemoveSource(CDownloadSource* pSource, BOOL bBan);
 					// Remove source from list, add it to failed sources if bBan == TRUE, and destroy source itself
+	void			ReindexSource(CDownloadSource* pSource);	// Source address or GUID changed
 
 	virtual BOOL	OnQueryHits(const CQueryHit* pHits);
 	virtual void	Serialize(CArchive& ar, int nVersion);	// DOWNLOAD_SER_VERSION
@@ -113,4 +152,13 @@ protected:
 	void			InternalAdd(CDownloadSource* pSource);			// Add new source to list, update counters
 	void			InternalRemove(CDownloadSource* pSource);		// Remove existing source from list, update counters
 	void			VoteSource(LPCTSTR pszUrl, bool bPositively);
+	void			SerializeSourceChanges(CArchive& ar, int nVersion);	// Sources added/changed/removed since last save (.pd journal)
+
+private:
+	void			LoadSource(CArchive& ar, int nVersion, BOOL bReplace = FALSE);
+	void			IndexSource(CDownloadSource* pSource, POSITION pos);
+	void			UnindexSource(const CDownloadSource* pSource, const CSourceEntry& oEntry);
+	CDownloadSource*	FindSourceByURL(const CString& strURL) const;
+	void			BuildAltLocCache(CAltLocCache& oCache, PROTOCOLID nProtocol) const;
+	static DWORD	FoldGUID(const CDownloadSource* pSource);
 };
@@ -895,20 +895,29 @@ void CDownloadWithTiger::FinishValidation()
 	m_nVerifyBlock	= 0xFFFFFFFF;
 	m_nVerifyCookie++;
 
-	SetModified();
+	SetModified( false );
 }
 
 void CDownloadWithTiger::SubtractHelper(Fragments::List& ppCorrupted, BYTE* pBlock, QWORD nBlock, QWORD nSize)
 {
-	QWORD nOffset = 0;
+	if ( ppCorrupted.empty() )
+		return;
 
-	while ( nBlock-- && ! ppCorrupted.empty() )
-	{
-		if ( *pBlock++ == TRI_TRUE )
-			ppCorrupted.erase( Fragments::Fragment( nOffset, min( nOffset + nSize, m_nSize ) ) );
+	// Only visit the blocks under corrupted ranges, then remove the verified ones in one pass
+	Fragments::List oVerified( ppCorrupted.limit() );
 
-		nOffset += nSize;
+	Fragments::List::const_iterator pItr = ppCorrupted.begin();
+	const Fragments::List::const_iterator pEnd = ppCorrupted.end();
+	for ( ; pItr != pEnd; ++pItr )
+	{
+		for ( QWORD nIndex = pItr->begin() / nSize; nIndex < nBlock && nIndex * nSize < pItr->end(); ++nIndex )
+		{
+			if ( pBlock[ nIndex ] == TRI_TRUE )
+				oVerified.insert( oVerified.end(), Fragments::Fragment( nIndex * nSize, min( nIndex * nSize + nSize, m_nSize ) ) );
+		}
 	}
+
+	ppCorrupted.erase( oVerified );
 }
 
 Fragments::List CDownloadWithTiger::GetHashableFragmentList() const
@@ -954,9 +963,8 @@ Fragments::List CDownloadWithTiger::GetWantedFragmentList() const
 		const QWORD nSizeNow = GetVolumeComplete();
 		if ( nSizeNow != m_nWantedListCookie || nSizeNow == 0 )
 		{
-			const Fragments::List oList = inverse( GetHashableFragmentList() );
-			m_oWantedListCache = GetEmptyFragmentList();			// HighCPU
-			m_oWantedListCache.erase( oList.begin(), oList.end() );
+			m_oWantedListCache = GetEmptyFragmentList();
+			m_oWantedListCache.intersect( GetHashableFragmentList() );
 			m_nWantedListCookie = nSizeNow;
 			m_nWantedListTime = GetTickCount();
 		}
@@ -1006,8 +1014,7 @@ Fragments::List CDownloadWithTiger::GetPossibleFragments(const Fragments::List&
 	}
 	else
 	{
-		Fragments::List tmp = inverse( GetWantedFragmentList() );
-		oPossible.erase( tmp.begin(), tmp.end() );
+		oPossible.intersect( GetWantedFragmentList() );
 	}
 
 	if ( oPossible.empty() )
@@ -1196,6 +1203,48 @@ void CDownloadWithTiger::ClearVerification()
 //////////////////////////////////////////////////////////////////////
 // CDownloadWithTiger serialize
 
+// Block verification states, restored only if the block count still matches
+static void SerializeBlocks(CArchive& ar, BYTE* pBlock, DWORD nBlock, DWORD& nSuccess)
+{
+	if ( ar.IsStoring() )
+	{
+		ar << (DWORD)( pBlock ? nBlock : 0 );
+		ar << nSuccess;
+		if ( pBlock && nBlock )
+			ar.Write( pBlock, sizeof( BYTE ) * nBlock );
+	}
+	else // Loading
+	{
+		DWORD nCount, nCountSuccess;
+		ar >> nCount;
+		ar >> nCountSuccess;
+		if ( ! nCount )
+			return;
+
+		if ( pBlock && nCount == nBlock )
+		{
+			ReadArchive( ar, pBlock, sizeof( BYTE ) * nCount );
+			nSuccess = nCountSuccess;
+		}
+		else
+		{
+			CAutoVectorPtr< BYTE > pSkip( new BYTE[ nCount ] );
+			ReadArchive( ar, pSkip, sizeof( BYTE ) * nCount );
+		}
+	}
+}
+
+void CDownloadWithTiger::SerializeProgress(CArchive& ar, int nVersion)
+{
+	CQuickLock oLock( m_pTigerSection );
+
+	SerializeFragments( ar, nVersion );
+
+	SerializeBlocks( ar, m_pTigerBlock, m_nTigerBlock, m_nTigerSuccess );
+	SerializeBlocks( ar, m_pHashsetBlock, m_nHashsetBlock, m_nHashsetSuccess );
+	SerializeBlocks( ar, m_pTorrentBlock, m_nTorrentBlock, m_nTorrentSuccess );
+}
+
 void CDownloadWithTiger::Serialize(CArchive& ar, int nVersion)
 {
 	CQuickLock oLock( m_pTigerSection );
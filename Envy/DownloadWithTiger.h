@@ -84,6 +84,7 @@ protected:
 	bool		IsFullyVerified() const;
 
 	virtual void	Serialize(CArchive& ar, int nVersion);
+	void		SerializeProgress(CArchive& ar, int nVersion);	// Fragments and block verification (.pd journal)
 
 private:
 	DWORD		GetValidationCookie() const;
@@ -1292,6 +1292,7 @@ CDownload* CDownloads::Load(const CString& strPath)
 		// Remove orphaned .pd/.sd files at startup
 		m_pDelete.AddTail( SafePath( strPath ) );
 		m_pDelete.AddTail( SafePath( strPath + L".sav" ) );
+		m_pDelete.AddTail( SafePath( strPath + L".jnl" ) );
 		m_pDelete.AddTail( SafePath( strPath + L".png" ) );
 		theApp.Message( MSG_ERROR, IDS_DOWNLOAD_REMOVE, ( pDownload->m_sName.IsEmpty() ? strPath : pDownload->m_sName ) );
 	}
@@ -1302,6 +1303,7 @@ CDownload* CDownloads::Load(const CString& strPath)
 		{
 			m_pDelete.AddTail( SafePath( strPath ) );
 			m_pDelete.AddTail( SafePath( strPath + L".sav" ) );
+			m_pDelete.AddTail( SafePath( strPath + L".jnl" ) );
 			m_pDelete.AddTail( SafePath( strPath + L".png" ) );
 			theApp.Message( MSG_NOTICE, IDS_DOWNLOAD_REMOVE, pDownload->m_sName );
 			return NULL;
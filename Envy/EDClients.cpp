@@ -581,15 +581,16 @@ BOOL CEDClients::OnServerStatus(const SOCKADDR_IN* pHost, CEDPacket* pPacket)
 	pServer->m_bCheckedLocally	= TRUE;
 	pServer->m_nUserCount	= nUsers;
 	pServer->m_nUserLimit	= nMaxUsers;
-	pServer->m_nFileLimit	= nFileLimit;
-	pServer->m_nUDPFlags	= nUDPFlags;
+	CHostCacheExtra& oExtra = pServer->EditExtra();
+	oExtra.m_nFileLimit	= nFileLimit;
+	oExtra.m_nUDPFlags	= nUDPFlags;
 
 	if ( pServer->Seen() < pServer->m_tStats )
 		HostCache.eDonkey.Update( pServer, 0, pServer->m_tStats );
 	if ( nUDPFlags & ED2K_SERVER_UDP_UNICODE )
-		pServer->m_nTCPFlags |= ED2K_SERVER_TCP_UNICODE;
+		oExtra.m_nTCPFlags |= ED2K_SERVER_TCP_UNICODE;
 	if ( nUDPFlags & ED2K_SERVER_UDP_GETSOURCES2 )
-		pServer->m_nTCPFlags |= ED2K_SERVER_TCP_GETSOURCES2;
+		oExtra.m_nTCPFlags |= ED2K_SERVER_TCP_GETSOURCES2;
 
 	HostCache.eDonkey.Update( pServer );
 
@@ -614,7 +615,7 @@ BOOL CEDClients::OnServerSearchResult(const SOCKADDR_IN* pHost, CEDPacket* pPack
 	pAddress.sin_port = htons( pServer->m_nPort + 4 );
 
 	// Check server details in host cache
-	DWORD nServerFlags = ( pServer && pServer->m_nUDPFlags ) ? pServer->m_nUDPFlags : Settings.eDonkey.DefaultServerFlags;
+	DWORD nServerFlags = ( pServer && pServer->Extra().m_nUDPFlags ) ? pServer->Extra().m_nUDPFlags : Settings.eDonkey.DefaultServerFlags;
 
 	// Decode packet and create hits
 	if ( CQueryHit* pHits = CQueryHit::FromEDPacket( pPacket, &pAddress, nServerFlags ) )
@@ -472,21 +472,22 @@ BOOL CEDNeighbour::OnServerIdent(CEDPacket* pPacket)
 
 	if ( CHostCacheHostPtr pHost = HostCache.eDonkey.Add( &m_pHost.sin_addr, htons( m_pHost.sin_port ) ) )
 	{
-		pHost->m_sName			= m_sServerName;
-		pHost->m_sDescription	= strDescription;
+		CHostCacheExtra& oExtra = pHost->EditExtra();
+		oExtra.m_sName			= m_sServerName;
+		oExtra.m_sDescription	= strDescription;
 		pHost->m_nUserLimit		= m_nUserLimit;
-		pHost->m_nTCPFlags		= m_nTCPFlags;
+		oExtra.m_nTCPFlags		= m_nTCPFlags;
 
 		// We can assume some UDP flags based on TCP flags
 		if ( m_nTCPFlags & ED2K_SERVER_TCP_DEFLATE )
 		{
-			pHost->m_nUDPFlags |= ED2K_SERVER_UDP_GETSOURCES;
-			pHost->m_nUDPFlags |= ED2K_SERVER_UDP_GETFILES;
+			oExtra.m_nUDPFlags |= ED2K_SERVER_UDP_GETSOURCES;
+			oExtra.m_nUDPFlags |= ED2K_SERVER_UDP_GETFILES;
 		}
 		if ( m_nTCPFlags & ED2K_SERVER_TCP_UNICODE )
-			pHost->m_nUDPFlags |= ED2K_SERVER_UDP_UNICODE;
+			oExtra.m_nUDPFlags |= ED2K_SERVER_UDP_UNICODE;
 		if ( m_nTCPFlags & ED2K_SERVER_TCP_GETSOURCES2 )
-			pHost->m_nUDPFlags |= ED2K_SERVER_UDP_GETSOURCES2;
+			oExtra.m_nUDPFlags |= ED2K_SERVER_UDP_GETSOURCES2;
 	}
 
 	theApp.Message( MSG_NOTICE, IDS_ED2K_SERVER_IDENT, (LPCTSTR)m_sAddress, (LPCTSTR)m_sServerName );
@@ -675,8 +676,8 @@ BOOL CEDNeighbour::SendSharedFiles()
 		CQuickLock oLock( HostCache.eDonkey.m_pSection );
 
 		CHostCacheHost *pServer = HostCache.eDonkey.Find( &m_pHost.sin_addr );
-		if ( pServer && ( pServer->m_nFileLimit > 10 ) )
-			m_nFileLimit = min( m_nFileLimit, pServer->m_nFileLimit );
+		if ( pServer && ( pServer->Extra().m_nFileLimit > 10 ) )
+			m_nFileLimit = min( m_nFileLimit, pServer->Extra().m_nFileLimit );
 	}
 
 	CEDPacket* pPacket = CEDPacket::New( ED2K_C2S_OFFERFILES );
@@ -58,6 +58,7 @@
 #include "ShellIcons.h"
 #include "Skin.h"
 #include "SQLite.h"
+#include "Statistics.h"
 #include "ThumbCache.h"
 #include "Transfers.h"
 #include "UploadQueues.h"
@@ -671,10 +672,15 @@ int CEnvyApp::ExitInstance()
 		DCClients.Clear();
 		EDClients.Clear();
 
+		CThumbCache::Flush();
+		DatabasePool.Clear();
+
 		if ( m_bLive )
 		{
 			SplashStep( L"Saving Services" );
 			Settings.Save( TRUE );
+			if ( Settings.General.DebugLog )
+				Statistics.Export( Settings.General.DataPath + L"Statistics.csv" );
 			Security.Save();
 			HostCache.Save();
 			UploadQueues.Save();
@@ -3014,6 +3020,11 @@ void CEnvyApp::OnRename(LPCTSTR pszSource, LPCTSTR pszTarget)
 }
 
 CDatabase* CEnvyApp::GetDatabase(int nType /*0*/) const
+{
+	return new CDatabase( GetDatabasePath( nType ) );
+}
+
+CString CEnvyApp::GetDatabasePath(int nType /*0*/) const
 {
 	ASSERT( nType < DB_LAST );
 
@@ -3026,11 +3037,11 @@ CDatabase* CEnvyApp::GetDatabase(int nType /*0*/) const
 		bCheck = FALSE;
 	}
 
-	return new CDatabase( Settings.General.DataPath +
+	return Settings.General.DataPath +
 		( nType == DB_THUMBS ? L"Thumbnails.db" :
 		  nType == DB_SECURITY ? L"Security.db" :
 		  nType == DB_BLACKLIST ? L"Blacklist.db" :
-		/*nType == DB_DEFAULT ?*/ L"Envy.db" ) );
+		/*nType == DB_DEFAULT ?*/ L"Envy.db" );
 }
 
 BOOL CEnvyApp::GetPropertyStoreFromParsingName(LPCWSTR pszPath, IPropertyStore**ppv)
@@ -210,6 +210,7 @@ public:
 	CString			GetLocalAppDataFolder() const;
 
 	CDatabase*		GetDatabase(int nType = 0) const;				// Get SQLite (thumbs) database handler, must be freed by "delete" operator. (unique_ptr?)
+	CString			GetDatabasePath(int nType = 0) const;			// Get SQLite database file path (for pooled CPooledDatabase)
 
 	void			OnRename(LPCTSTR strSource, LPCTSTR pszTarget = (LPCTSTR)1);	// pszTarget: 0 = delete file, 1 = release file.
 
@@ -55,21 +55,20 @@ inline Ranges::Range< uint64 > SerializeIn(CArchive& ar, int /*version*/)
 }
 
 // Used in FragmentedFile.cpp
-inline void SerializeOut1(CArchive& ar, const Ranges::List< Ranges::Range< uint64 >, ListTraits >& out)
+inline void SerializeOut1(CArchive& ar, const List& out)
 {
 	uint64 nTotal = out.limit();
 	uint64 nRemaining = out.length_sum();
 	uint32 nFragments = static_cast< uint32 >( out.size() );
 	ar << nTotal << nRemaining << nFragments;
 
-	for ( Ranges::List< Ranges::Range< uint64 >, ListTraits >::const_iterator i = out.begin();
-		i != out.end(); ++i )
+	for ( List::const_iterator i = out.begin(); i != out.end(); ++i )
 	{
 		SerializeOut( ar, *i );
 	}
 }
 
-inline void SerializeIn1(CArchive& ar, Ranges::List< Ranges::Range< uint64 >, ListTraits >& in, int version)
+inline void SerializeIn1(CArchive& ar, List& in, int version)
 {
 	//if ( version > 28 )
 	//{
@@ -79,7 +78,7 @@ inline void SerializeIn1(CArchive& ar, Ranges::List< Ranges::Range< uint64 >, Li
 			uint32 nFragments;
 			ar >> nTotal >> nRemaining >> nFragments;
 			{
-				Ranges::List< Ranges::Range< uint64 >, ListTraits > oNewRange( nTotal );
+				List oNewRange( nTotal );
 				in.swap( oNewRange );
 			}
 			for ( ; nFragments--; )
@@ -106,7 +105,7 @@ inline void SerializeIn1(CArchive& ar, Ranges::List< Ranges::Range< uint64 >, Li
 	//		uint32 nFragments;
 	//		ar >> nTotal >> nRemaining >> nFragments;
 	//		{
-	//			Ranges::List< Ranges::Range< uint64 >, ListTraits > oNewRange( nTotal );
+	//			List oNewRange( nTotal );
 	//			in.swap( oNewRange );
 	//		}
 	//		for ( ; nFragments--; )
@@ -128,18 +127,17 @@ inline void SerializeIn1(CArchive& ar, Ranges::List< Ranges::Range< uint64 >, Li
 }
 
 // Used in DownloadSource.cpp
-inline void SerializeOut2(CArchive& ar, const Ranges::List< Ranges::Range< uint64 >, ListTraits >& out)
+inline void SerializeOut2(CArchive& ar, const List& out)
 {
 	ar.WriteCount( out.size() );
 
-	for ( Ranges::List< Ranges::Range< uint64 >, ListTraits >::const_iterator i	= out.begin();
-		i != out.end(); ++i )
+	for ( List::const_iterator i = out.begin(); i != out.end(); ++i )
 	{
 		SerializeOut( ar, *i );
 	}
 }
 
-inline void SerializeIn2(CArchive& ar, Ranges::List< Ranges::Range< uint64 >, ListTraits >& in, int version)
+inline void SerializeIn2(CArchive& ar, List& in, int version)
 {
 	try
 	{
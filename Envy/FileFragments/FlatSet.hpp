@@ -0,0 +1,160 @@
+//
+// FileFragments/FlatSet.hpp
+//
+// This file is part of Envy (getenvy.com)  2016-2018
+// Portions copyright Shareaza 2002-2007 and PeerProject 2008
+//
+// Envy is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation (fsf.org);
+// either version 3 of the License, or later version (at your option).
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// (http://www.gnu.org/licenses/gpl.html)
+//
+
+#ifndef FILEFRAGMENTS_FLATSET_HPP_INCLUDED
+#define FILEFRAGMENTS_FLATSET_HPP_INCLUDED
+
+namespace Ranges
+{
+
+// Sorted vector with the part of the std::set interface used by List.
+// Lookups are binary searches over contiguous memory, copies are a single
+// allocation, and merging or trimming a range rewrites it in place.
+// Inserting a new range in the middle moves the tail, which is cheap
+// next to the node allocation std::set needs for the same operation.
+template< class ValueT, class CompareT >
+class FlatSet
+{
+// Interface
+public:
+	// Typedefs
+	typedef std::vector< ValueT > vector_type;
+	typedef ValueT key_type;
+	typedef ValueT value_type;
+	typedef CompareT key_compare;
+	typedef CompareT value_compare;
+	typedef typename vector_type::pointer pointer;
+	typedef typename vector_type::const_pointer const_pointer;
+	typedef typename vector_type::reference reference;
+	typedef typename vector_type::const_reference const_reference;
+	typedef typename vector_type::iterator iterator;
+	typedef typename vector_type::const_iterator const_iterator;
+	typedef typename vector_type::reverse_iterator reverse_iterator;
+	typedef typename vector_type::const_reverse_iterator const_reverse_iterator;
+	typedef typename vector_type::size_type size_type;
+	typedef typename vector_type::difference_type difference_type;
+	// Constructor
+	FlatSet() : m_data(), m_compare() { }
+
+	// Iterators
+	iterator               begin()        { return m_data.begin(); }
+	const_iterator         begin()  const { return m_data.begin(); }
+	iterator               end()          { return m_data.end(); }
+	const_iterator         end()    const { return m_data.end(); }
+	reverse_iterator       rbegin()       { return m_data.rbegin(); }
+	const_reverse_iterator rbegin() const { return m_data.rbegin(); }
+	reverse_iterator       rend()         { return m_data.rend(); }
+	const_reverse_iterator rend()   const { return m_data.rend(); }
+
+	// Accessors
+	bool empty() const { return m_data.empty(); }
+	size_type size() const { return m_data.size(); }
+	size_type capacity() const { return m_data.capacity(); }
+	// Operations
+	void clear() { m_data.clear(); }
+	void reserve(size_type count) { m_data.reserve( count ); }
+	void swap(FlatSet& rhs)			// throw ()
+	{
+		m_data.swap( rhs.m_data );
+		std::swap( m_compare, rhs.m_compare );
+	}
+
+	std::pair< iterator, bool > insert(const value_type& value)
+	{
+		iterator where = lower_bound( value );
+		if ( where != end() && ! m_compare( value, *where ) )
+			return std::make_pair( where, false );
+		return std::make_pair( m_data.insert( where, value ), true );
+	}
+	// @insert	Inserts at the hint when the value belongs there, in constant
+	//			time at the end and with a tail move elsewhere.
+	iterator insert(iterator where, const value_type& value)
+	{
+		if ( ( where == begin() || m_compare( *( where - 1 ), value ) )
+			&& ( where == end() || m_compare( value, *where ) ) )
+			return m_data.insert( where, value );
+		return insert( value ).first;
+	}
+	iterator erase(iterator where) { return m_data.erase( where ); }
+	iterator erase(iterator first, iterator last) { return m_data.erase( first, last ); }
+	// @replace	Replaces the elements first..last with count sorted values that
+	//			belong at the same position. Elements are overwritten in place,
+	//			so the tail only moves when the number of elements changes.
+	void replace(iterator first, iterator last, const value_type* values, size_type count)
+	{
+		const size_type old_count = static_cast< size_type >( last - first );
+		const size_type same_count = min( old_count, count );
+		first = std::copy( values, values + same_count, first );
+		if ( old_count > count )
+			m_data.erase( first, last );
+		else if ( count > old_count )
+			m_data.insert( first, values + same_count, values + count );
+	}
+
+	iterator       lower_bound(const key_type& key)       { return std::lower_bound( begin(), end(), key, m_compare ); }
+	const_iterator lower_bound(const key_type& key) const { return std::lower_bound( begin(), end(), key, m_compare ); }
+	iterator       upper_bound(const key_type& key)       { return std::upper_bound( begin(), end(), key, m_compare ); }
+	const_iterator upper_bound(const key_type& key) const { return std::upper_bound( begin(), end(), key, m_compare ); }
+	std::pair< iterator, iterator > equal_range(const key_type& key)
+	{
+		return std::equal_range( begin(), end(), key, m_compare );
+	}
+	std::pair< const_iterator, const_iterator > equal_range(const key_type& key) const
+	{
+		return std::equal_range( begin(), end(), key, m_compare );
+	}
+	iterator find(const key_type& key)
+	{
+		iterator where = lower_bound( key );
+		return where != end() && ! m_compare( key, *where ) ? where : end();
+	}
+	const_iterator find(const key_type& key) const
+	{
+		const_iterator where = lower_bound( key );
+		return where != end() && ! m_compare( key, *where ) ? where : end();
+	}
+
+// Implementation
+private:
+	vector_type m_data;
+	key_compare m_compare;
+};
+
+// @replace_range	Replaces the elements first..last of a sorted container
+//					with count sorted values that belong at the same position.
+//					Node based containers erase and insert with last as hint.
+template< class ContainerT >
+void replace_range(ContainerT& set, typename ContainerT::iterator first,
+	typename ContainerT::iterator last, const typename ContainerT::value_type* values, size_t count)
+{
+	while ( first != last )
+		set.erase( first++ );
+	for ( ; count; --count )
+		set.insert( last, *values++ );
+}
+
+template< class ValueT, class CompareT >
+void replace_range(FlatSet< ValueT, CompareT >& set, typename FlatSet< ValueT, CompareT >::iterator first,
+	typename FlatSet< ValueT, CompareT >::iterator last, const ValueT* values, size_t count)
+{
+	set.replace( first, last, values, count );
+}
+
+} // namespace Ranges
+
+#endif // #ifndef FILEFRAGMENTS_FLATSET_HPP_INCLUDED
@@ -111,9 +111,15 @@ public:
 	//			which usually returns a size_type for this kind of funtion,
 	//			which indictaes the number of elements being erased.
 	range_size_type erase(const range_type& value);
+	// @insert	Merges another list into this one. Both lists are walked once
+	//			side by side and the result is built by appending, instead of
+	//			looking up each fragment of the other list.
+	// @complexity   ~O( n + n_insert )
+	range_size_type insert(const List& rhs);
 	// @erase	Deletes a sequence of fragments from the container.
 	//			That sequence need not be part of the list. If it is,
 	//			use a loop over the next function instead, if speed is important.
+	//			If the sequence is another list, use the overload below.
 	template< typename input_iterator >
 	range_size_type erase(input_iterator first, input_iterator last)
 	{
@@ -121,6 +127,15 @@ public:
 		for ( ; first != last; ) sum += erase( *first++ );
 		return sum;
 	}
+	// @erase	Deletes all fragments of another list in a single pass over both.
+	// @return	Returns the length of the range that has been deleted.
+	// @complexity   ~O( n + n_erase )
+	range_size_type erase(const List& rhs);
+	// @intersect	Keeps only the parts of the fragments that are also
+	//				present in another list, in a single pass over both.
+	// @return	Returns the length of the range that has been deleted.
+	// @complexity   ~O( n + n_rhs )
+	range_size_type intersect(const List& rhs);
 	// @erase	This deletes the fragment the argument points to.
 	//			Iterators that point to other fragments remain valid.
 	// @return	Returns iterator that points to the next fragment
@@ -224,7 +239,7 @@ private:
 
 // @inverse returns a list containing each range out of the base range 0..limit
 //          that is not part of the sourcelist
-// @complexity   ~O( n * log( n ) )
+// @complexity   ~O( n )
 template< class list_type >
 list_type inverse(const list_type& src);
 
@@ -295,13 +310,87 @@ typename RangeT::size_type List< RangeT, TraitsT, ContainerT >::erase(const Rang
 	if ( sequence.first == sequence.second ) return 0;
 	const range_type front( min( sequence.first->begin(), value.begin() ),
 		value.begin(), value.value() );
+	iterator last( sequence.second );
 	const range_type back( value.end(),
-		max( ( --sequence.second )->end(), value.end() ), value.value() );
-	range_size_type sum = 0;
-	for ( ++sequence.second; sequence.first != sequence.second; ) sum += erase( sequence.first++ );
-	sum -= insert( sequence.second, front );
-	sum -= insert( sequence.second, back );
-	return sum;
+		max( ( --last )->end(), value.end() ), value.value() );
+	return Traits::split_and_replace( m_set, sequence, front, back );
+}
+
+template< class RangeT, template< class, class > class TraitsT, class ContainerT >
+typename RangeT::size_type List< RangeT, TraitsT, ContainerT >::insert(
+	const List< RangeT, TraitsT, ContainerT >& rhs)
+{
+	if ( rhs.empty() ) return 0;
+	const range_size_type old_sum = Traits::length_sum();
+	List result( limit() );
+	const_iterator i = begin();
+	const_iterator j = rhs.begin();
+	range_size_type low = 0, high = 0;
+	while ( i != end() || j != rhs.end() )
+	{
+		const range_type& next = ( j == rhs.end() || ( i != end() && i->begin() < j->begin() ) )
+			? *i++ : *j++;
+		if ( low == high || next.begin() > high )
+		{
+			if ( low < high ) result.insert( result.end(), range_type( low, high ) );
+			low = next.begin();
+			high = next.end();
+		}
+		else if ( next.end() > high )
+		{
+			high = next.end();
+		}
+	}
+	if ( low < high ) result.insert( result.end(), range_type( low, high ) );
+	swap( result );
+	return Traits::length_sum() - old_sum;
+}
+
+template< class RangeT, template< class, class > class TraitsT, class ContainerT >
+typename RangeT::size_type List< RangeT, TraitsT, ContainerT >::erase(
+	const List< RangeT, TraitsT, ContainerT >& rhs)
+{
+	if ( empty() || rhs.empty() ) return 0;
+	const range_size_type old_sum = Traits::length_sum();
+	List result( limit() );
+	const_iterator cut = rhs.begin();
+	for ( const_iterator i = begin(); i != end(); ++i )
+	{
+		while ( cut != rhs.end() && cut->end() <= i->begin() ) ++cut;
+		range_size_type low = i->begin();
+		for ( const_iterator j = cut; j != rhs.end() && j->begin() < i->end(); ++j )
+		{
+			if ( j->begin() > low )
+				result.insert( result.end(), range_type( low, j->begin(), i->value() ) );
+			low = max( low, j->end() );
+		}
+		if ( low < i->end() )
+			result.insert( result.end(), range_type( low, i->end(), i->value() ) );
+	}
+	swap( result );
+	return old_sum - Traits::length_sum();
+}
+
+template< class RangeT, template< class, class > class TraitsT, class ContainerT >
+typename RangeT::size_type List< RangeT, TraitsT, ContainerT >::intersect(
+	const List< RangeT, TraitsT, ContainerT >& rhs)
+{
+	if ( empty() ) return 0;
+	const range_size_type old_sum = Traits::length_sum();
+	List result( limit() );
+	const_iterator i = begin();
+	const_iterator j = rhs.begin();
+	while ( i != end() && j != rhs.end() )
+	{
+		const range_size_type low = max( i->begin(), j->begin() );
+		const range_size_type high = min( i->end(), j->end() );
+		if ( low < high )
+			result.insert( result.end(), range_type( low, high, i->value() ) );
+		if ( i->end() < j->end() ) ++i;
+		else ++j;
+	}
+	swap( result );
+	return old_sum - Traits::length_sum();
 }
 
 template< class list_type >
@@ -315,10 +404,10 @@ list_type inverse(const list_type& src)
 	range_size_type last = 0;
 	for ( const_iterator i = src.begin(); i != src.end(); ++i )
 	{
-		result.insert( range_type( last, i->begin() ) );
+		result.insert( result.end(), range_type( last, i->begin() ) );
 		last = i->end();
 	}
-	result.insert( range_type( last, src.limit() ) );
+	result.insert( result.end(), range_type( last, src.limit() ) );
 	return result;
 }
 
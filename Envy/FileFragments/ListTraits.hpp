@@ -0,0 +1,116 @@
+//
+// FileFragments/ListTraits.hpp
+//
+// This file is part of Envy (getenvy.com)  2016-2018
+// Portions copyright Shareaza 2002-2007 and PeerProject 2008
+//
+// Envy is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation (fsf.org);
+// either version 3 of the License, or later version (at your option).
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// (http://www.gnu.org/licenses/gpl.html)
+//
+
+#ifndef FILEFRAGMENTS_LISTTRAITS_HPP_INCLUDED
+#define FILEFRAGMENTS_LISTTRAITS_HPP_INCLUDED
+
+namespace Fragments
+{
+
+// Length bookkeeping and merge policy for Fragments::List.
+// Kept apart from FileFragments.hpp so tools can use it without Envy.h
+
+template< class RangeT, class ContainerT >
+class ListTraits
+{
+public:
+	typedef RangeT range_type;
+	typedef ContainerT container_type;
+	typedef typename range_type::size_type range_size_type;
+	typedef typename range_type::payload_type payload_type;
+	typedef Ranges::RangeCompare< payload_type, range_size_type > compare_type;
+	typedef typename container_type::iterator iterator;
+	typedef std::pair< iterator, iterator > iterator_pair;
+
+public:
+	range_size_type limit() const { return m_limit; }
+	range_size_type length_sum() const { return m_length_sum; }
+	range_size_type missing() const { return limit() - length_sum(); }
+
+	void ensure(range_size_type limit)
+	{
+		if ( m_limit == SIZE_UNKNOWN || m_limit < limit )
+			m_limit = limit;
+	}
+
+// Following functions have to be declared
+protected:
+	typedef range_size_type ctor_arg_type;
+	explicit ListTraits(ctor_arg_type limit) : m_limit( limit ), m_length_sum( 0 ) { }
+	void clear() { m_length_sum = 0; }
+	void swap(ListTraits& other)
+	{
+		std::swap( m_limit, other.m_limit );
+		std::swap( m_length_sum, other.m_length_sum );
+	}
+	range_size_type erase(const iterator where)
+	{
+		m_length_sum -= where->size();
+		return where->size();
+	}
+	template< class container_type >
+	range_size_type merge_and_replace(container_type& set, iterator_pair sequence, const range_type& new_range)
+	{
+		ASSERT( sequence.first != sequence.second );
+		if ( sequence.first->begin() <= new_range.begin()
+			&& sequence.first->end() >= new_range.end() ) return 0;
+		range_size_type old_sum = m_length_sum;
+		range_size_type low = min( sequence.first->begin(), new_range.begin() );
+		range_size_type high = max( ( --sequence.second )->end(), new_range.end() );
+		++sequence.second;
+		for ( iterator i = sequence.first; i != sequence.second; ++i )
+		{
+			m_length_sum -= i->size();
+		}
+		const range_type merged( low, high );
+		Ranges::replace_range( set, sequence.first, sequence.second, &merged, 1 );
+		m_length_sum += high - low;
+		return m_length_sum - old_sum;
+	}
+	template< class container_type >
+	range_size_type split_and_replace(container_type& set, iterator_pair sequence, const range_type& front, const range_type& back)
+	{
+		ASSERT( sequence.first != sequence.second );
+		range_size_type old_sum = m_length_sum;
+		for ( iterator i = sequence.first; i != sequence.second; ++i )
+		{
+			m_length_sum -= i->size();
+		}
+		const range_type pieces[ 2 ] = { front, back };
+		const range_type* first = front.size() ? pieces : pieces + 1;
+		const range_type* last = back.size() ? pieces + 2 : pieces + 1;
+		Ranges::replace_range( set, sequence.first, sequence.second, first, last - first );
+		m_length_sum += front.size() + back.size();
+		return old_sum - m_length_sum;
+	}
+	template< class container_type >
+	range_size_type simple_merge(container_type& set, iterator where, const range_type& new_range)
+	{
+		set.insert( where, new_range );
+		m_length_sum += new_range.size();
+		return new_range.size();
+	}
+
+private:
+	range_size_type m_limit;
+	range_size_type m_length_sum;
+};
+
+} // namespace Fragments
+
+#endif // #ifndef FILEFRAGMENTS_LISTTRAITS_HPP_INCLUDED
@@ -0,0 +1,184 @@
+//
+// FileReader.cpp
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+#include "StdAfx.h"
+#include "FileReader.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#define new DEBUG_NEW
+#endif	// Debug
+
+//////////////////////////////////////////////////////////////////////
+// CFileReader construction
+
+CFileReader::CFileReader(HANDLE hFile, DWORD nWindow)
+	: m_hFile			( hFile )
+	, m_nSize			( 0 )
+	, m_nPosition		( 0 )
+	, m_pWindow			( NULL )
+	, m_nWindow			( nWindow )
+	, m_nWindowOffset	( 0 )
+	, m_nWindowLength	( 0 )
+	, m_nReads			( 0 )
+	, m_tDeadline		( 0 )
+{
+	LARGE_INTEGER nSize;
+	if ( GetFileSizeEx( m_hFile, &nSize ) )
+		m_nSize = nSize.QuadPart;
+
+	// Continue from the handle position, as the Win32 calls this replaces would
+	LARGE_INTEGER nZero = {};
+	LARGE_INTEGER nPosition;
+	if ( SetFilePointerEx( m_hFile, nZero, &nPosition, FILE_CURRENT ) )
+		m_nPosition = nPosition.QuadPart;
+
+	m_pWindow = new BYTE[ m_nWindow ];
+}
+
+CFileReader::~CFileReader()
+{
+	delete [] m_pWindow;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CFileReader read
+
+BOOL CFileReader::Read(LPVOID pData, DWORD nLength, LPDWORD pnRead)
+{
+	BYTE* pOutput = (BYTE*)pData;
+	DWORD nTotal = 0;
+	BOOL bResult = TRUE;
+
+	// Parsers stop at the first failed read, so a slow extractor gives up here
+	if ( m_tDeadline && (LONG)( GetTickCount() - m_tDeadline ) >= 0 )
+	{
+		if ( pnRead )
+			*pnRead = 0;
+		SetLastError( ERROR_TIMEOUT );
+		return FALSE;
+	}
+
+	while ( nLength && m_nPosition < m_nSize )
+	{
+		if ( m_nPosition < m_nWindowOffset || m_nPosition >= m_nWindowOffset + m_nWindowLength )
+		{
+			// Reads as large as the window bypass it
+			if ( nLength >= m_nWindow )
+			{
+				LARGE_INTEGER nOffset;
+				nOffset.QuadPart = (LONGLONG)m_nPosition;
+				DWORD nRead = 0;
+				m_nReads++;
+				bResult = SetFilePointerEx( m_hFile, nOffset, NULL, FILE_BEGIN ) &&
+					::ReadFile( m_hFile, pOutput, nLength, &nRead, NULL );
+				m_nPosition += nRead;
+				nTotal += nRead;
+				break;
+			}
+
+			bResult = Fill( m_nPosition );
+			if ( ! bResult || ! m_nWindowLength )
+				break;
+		}
+
+		const DWORD nOffset = (DWORD)( m_nPosition - m_nWindowOffset );
+		const DWORD nCopy = min( nLength, m_nWindowLength - nOffset );
+		CopyMemory( pOutput, m_pWindow + nOffset, nCopy );
+
+		pOutput += nCopy;
+		nLength -= nCopy;
+		nTotal += nCopy;
+		m_nPosition += nCopy;
+	}
+
+	if ( pnRead )
+		*pnRead = nTotal;
+
+	return bResult;
+}
+
+// Loads the window around nOffset, ending at the old window when stepping backwards (reverse line scans)
+BOOL CFileReader::Fill(QWORD nOffset)
+{
+	QWORD nStart = nOffset;
+	if ( m_nWindowLength && nOffset < m_nWindowOffset && nOffset + m_nWindow >= m_nWindowOffset )
+		nStart = ( m_nWindowOffset > m_nWindow ) ? m_nWindowOffset - m_nWindow : 0;
+
+	m_nWindowOffset = nStart;
+	m_nWindowLength = 0;
+	m_nReads++;
+
+	LARGE_INTEGER nPosition;
+	nPosition.QuadPart = (LONGLONG)nStart;
+	if ( ! SetFilePointerEx( m_hFile, nPosition, NULL, FILE_BEGIN ) )
+		return FALSE;
+
+	DWORD nRead = 0;
+	if ( ! ::ReadFile( m_hFile, m_pWindow, m_nWindow, &nRead, NULL ) )
+		return FALSE;
+
+	m_nWindowLength = nRead;
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CFileReader position
+
+// Same contract as SetFilePointer, without touching the file
+DWORD CFileReader::Seek(LONG nDistance, PLONG pnDistanceHigh, DWORD nMethod)
+{
+	LONGLONG nMove = nDistance;
+	if ( pnDistanceHigh )
+		nMove = (LONGLONG)( ( (QWORD)(DWORD)*pnDistanceHigh << 32 ) | (DWORD)nDistance );
+
+	LONGLONG nTarget = nMove;
+	if ( nMethod == FILE_CURRENT )
+		nTarget += (LONGLONG)m_nPosition;
+	else if ( nMethod == FILE_END )
+		nTarget += (LONGLONG)m_nSize;
+
+	if ( nTarget < 0 )
+	{
+		SetLastError( ERROR_NEGATIVE_SEEK );
+		return INVALID_SET_FILE_POINTER;
+	}
+
+	if ( ! pnDistanceHigh && nTarget >= INVALID_SET_FILE_POINTER )
+	{
+		SetLastError( ERROR_INVALID_PARAMETER );
+		return INVALID_SET_FILE_POINTER;
+	}
+
+	m_nPosition = (QWORD)nTarget;
+
+	if ( pnDistanceHigh )
+		*pnDistanceHigh = (LONG)( m_nPosition >> 32 );
+
+	SetLastError( NO_ERROR );
+	return (DWORD)( m_nPosition & 0xFFFFFFFF );
+}
+
+DWORD CFileReader::GetSize(LPDWORD pnSizeHigh) const
+{
+	if ( pnSizeHigh )
+		*pnSizeHigh = (DWORD)( m_nSize >> 32 );
+
+	return (DWORD)( m_nSize & 0xFFFFFFFF );
+}
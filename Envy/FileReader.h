@@ -0,0 +1,82 @@
+//
+// FileReader.h
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+// Read-only file access through a read-ahead window, for parsers issuing many small reads and seeks.
+// ReadFile/SetFilePointer/GetFileSize overloads below let Win32-style parsing code take it unchanged.
+// The underlying handle position is left wherever the last window fill put it.
+
+#pragma once
+
+class CFileReader
+{
+public:
+	CFileReader(HANDLE hFile, DWORD nWindow = 64 * 1024);
+	~CFileReader();
+
+protected:
+	HANDLE	m_hFile;
+	QWORD	m_nSize;			// Cached at open
+	QWORD	m_nPosition;		// Logical read position
+	BYTE*	m_pWindow;
+	DWORD	m_nWindow;			// Window capacity
+	QWORD	m_nWindowOffset;	// File offset of first window byte
+	DWORD	m_nWindowLength;	// Valid window bytes
+	DWORD	m_nReads;			// File system reads issued
+	DWORD	m_tDeadline;		// Reads fail with ERROR_TIMEOUT from this tick (0 - never)
+
+public:
+	BOOL	Read(LPVOID pData, DWORD nLength, LPDWORD pnRead);
+	DWORD	Seek(LONG nDistance, PLONG pnDistanceHigh, DWORD nMethod);
+	DWORD	GetSize(LPDWORD pnSizeHigh) const;
+
+	inline QWORD GetPosition() const
+	{
+		return m_nPosition;
+	}
+
+	inline DWORD GetReadCount() const
+	{
+		return m_nReads;
+	}
+
+	inline void SetDeadline(DWORD tDeadline)
+	{
+		m_tDeadline = tDeadline ? tDeadline : 1;
+	}
+
+protected:
+	BOOL	Fill(QWORD nOffset);
+
+private:
+	CFileReader(const CFileReader&);
+	CFileReader& operator=(const CFileReader&);
+};
+
+inline BOOL ReadFile(CFileReader& oFile, LPVOID pBuffer, DWORD nLength, LPDWORD pnRead, LPOVERLAPPED /*pOverlapped*/)
+{
+	return oFile.Read( pBuffer, nLength, pnRead );
+}
+
+inline DWORD SetFilePointer(CFileReader& oFile, LONG nDistance, PLONG pnDistanceHigh, DWORD nMethod)
+{
+	return oFile.Seek( nDistance, pnDistanceHigh, nMethod );
+}
+
+inline DWORD GetFileSize(const CFileReader& oFile, LPDWORD pnSizeHigh)
+{
+	return oFile.GetSize( pnSizeHigh );
+}
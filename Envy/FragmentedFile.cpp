@@ -863,6 +863,25 @@ void CFragmentedFile::Serialize(CArchive& ar, int nVersion)
 	}
 }
 
+void CFragmentedFile::SerializeFragments(CArchive& ar, int nVersion)
+{
+	CQuickLock oLock( m_pSection );
+
+	if ( ar.IsStoring() )
+	{
+		SerializeOut1( ar, m_oFList );
+	}
+	else // Loading
+	{
+		Fragments::List oFList( m_oFList.limit() );
+		SerializeIn1( ar, oFList, nVersion );
+
+		// Ignore if the file was resized since
+		if ( oFList.limit() == m_oFList.limit() )
+			m_oFList.swap( oFList );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////
 // CFragmentedFile write some data to a range
 
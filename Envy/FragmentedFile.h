@@ -175,6 +175,7 @@ public:
 	BOOL	SetSize(QWORD nSize);	// Set new file size
 	BOOL	MakeComplete();
 	void	Serialize(CArchive& ar, int nVersion);
+	void	SerializeFragments(CArchive& ar, int nVersion);	// Empty fragments only (.pd journal)
 	BOOL	EnsureWrite();
 	void	Delete();				// Delete file(s)
 	// Move file to destination. Returns 0 on success or file error number.
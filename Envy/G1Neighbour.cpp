@@ -76,8 +76,8 @@ CG1Neighbour::CG1Neighbour(CNeighbour* pBase)
 	// Set the hops flow byte to be all 1s (do)
 	m_nHopsFlow = 0xFF;
 
-	// Create a new packet buffer for sending packets, giving it the m_pZOutput buffer if we're compressing, or just m_pOutput if we're not
-	m_pOutbound = new CG1PacketBuffer( m_pZOutput ? m_pZOutput : (CBuffer*)pOutput );		// m_pZOutput is where to write data the program will compress
+	// Create a new packet buffer for packets we send when there is room, by priority class
+	m_pOutbound = new CPacketBuffer( PROTOCOL_G1 );
 
 	// Report that a Gnutella connection with the remote computer has been successfully established
 	theApp.Message( MSG_INFO, IDS_HANDSHAKE_ONLINE, (LPCTSTR)m_sAddress, 0, 6, m_sUserAgent.IsEmpty() ? L"Unknown" : (LPCTSTR)m_sUserAgent );
@@ -176,26 +176,25 @@ BOOL CG1Neighbour::OnWrite()
 	CNeighbour::OnWrite();
 
 	// Loop while the output buffer is empty, but the outbound packet buffer still has packets to send
-	while ( pOutput->m_nLength == 0 && m_pOutbound->m_nTotal > 0 )
+	while ( pOutput->m_nLength == 0 && m_pOutbound->GetCount() > 0 )
 	{
-		// Get a packet from the outbound packet buffer
-		CG1Packet* pPacket = m_pOutbound->GetPacketToSend( nExpire );	// Tell GetPacketToSend when OnWrite was called
+		// Get the highest priority packet that hasn't expired from the outbound packet buffer
+		CPacket* pPacket = m_pOutbound->GetPacketToSend( nExpire );	// Tell GetPacketToSend when OnWrite was called
 		if ( ! pPacket ) break;	// If the outbound packet buffer didn't give us anything, leave the while loop
 
 		// Write the packet into the output buffer, and release it
 		pPacket->ToBuffer( pOutput );
 		pPacket->Release();
 
-		// Tell the outbound packet buffer that it's holding one fewer packet
-		m_pOutbound->m_nTotal--;
-
 		// Call CNeighbour::OnWrite to compress the data, and then CConnection::OnWrite to send it into the socket
 		CNeighbour::OnWrite();
 	}
 
 	// Save statistics from the outbound packet buffer into this CG1Neighbour object
-	m_nOutbound  = m_pOutbound->m_nTotal;		// Number of packets added in empty array spots
-	m_nLostCount = m_pOutbound->m_nDropped;		// Number of packets overwritten
+	m_nOutbound  = m_pOutbound->GetCount();		// Number of packets waiting
+	m_nLostCount = m_pOutbound->GetDropped();	// Number of packets dropped, expired or evicted
+	for ( int nClass = CPacketBuffer::pcControl; nClass < CPacketBuffer::pcMax; nClass++ )
+		m_nLostByClass[ nClass ] = m_pOutbound->GetDropped( nClass );
 
 	// Always reports success
 	return TRUE;
@@ -242,8 +241,13 @@ BOOL CG1Neighbour::Send(CPacket* pPacket, BOOL bRelease, BOOL bBuffered)
 		m_nOutputCount++;							// To this remote computer
 		Statistics.Current.Gnutella1.Outgoing++;	// Total
 
-		// Add the packet to the outbound packet buffer, and send all the data to the remote computer soon
-		m_pOutbound->Add( pPacketG1, bBuffered );
+		// Add the packet to the outbound packet buffer, or write it out directly, and send all the data to the remote computer soon
+		if ( bBuffered && pPacketG1->m_nTypeIndex )
+			m_pOutbound->Add( pPacketG1 );
+		else if ( m_pZOutput )
+			pPacketG1->ToBuffer( m_pZOutput );
+		else
+			Write( pPacketG1 );
 		QueueRun(); // (do)
 
 		// Show this packet to all the windows on the tab bar
@@ -25,7 +25,7 @@
 #include "Neighbour.h"
 
 class CG1Packet;
-class CG1PacketBuffer;
+class CPacketBuffer;
 class CPongItem;
 class CGGEPItem;
 
@@ -55,7 +55,7 @@ protected:
 	BYTE  m_nHopsFlow;
 
 	// Holds the packets we are going to send to the remote computer
-	CG1PacketBuffer* m_pOutbound;
+	CPacketBuffer* m_pOutbound;
 
 public:
 	// Send a packet to the remote computer
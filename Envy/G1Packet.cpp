@@ -229,6 +229,16 @@ CString CG1Packet::GetGUID() const
 // Writes this Gnutella packet into it, composing a Gnutella packet header and then adding the payload from the packet's buffer
 void CG1Packet::ToBuffer(CBuffer* pBuffer, bool /*bTCP*/)
 {
+	// Routed to many neighbours, copy the bytes composed once by Encode
+	if ( m_pEncoded )
+	{
+		pBuffer->Add( m_pEncoded->m_pBuffer, m_pEncoded->m_nLength );
+		Statistics.Current.Gnutella1.Shared++;
+		return;
+	}
+
+	Statistics.Current.Gnutella1.Encoded++;
+
 	// Compose a Gnutella packet header with values from this CG1Packet object
 	GNUTELLAPACKET pHeader;						// Make a local GNUTELLAPACKET structure called pHeader
 	pHeader.m_oGUID		= m_oGUID.storage();	// Copy in the GUID
@@ -24,6 +24,7 @@
 #include "G2Packet.h"
 #include "G1Packet.h"
 #include "Buffer.h"
+#include "PacketBuffer.h"
 #include "Network.h"
 #include "Security.h"
 #include "Statistics.h"
@@ -88,6 +89,7 @@ CG2Neighbour::CG2Neighbour(CNeighbour* pBase)
 	, m_nCountHAWOut		( 0 )
 	, m_tLastQueryIn		( 0 )
 	, m_nCountQueryIn		( 0 )
+	, m_pOutbound			( new CPacketBuffer( PROTOCOL_G2 ) )
 {
 	theApp.Message( MSG_INFO, IDS_HANDSHAKE_ONLINE_G2, (LPCTSTR)m_sAddress, m_sUserAgent.IsEmpty() ? L"Unknown" : (LPCTSTR)m_sUserAgent );
 
@@ -98,12 +100,7 @@ CG2Neighbour::~CG2Neighbour()
 {
 	delete m_pHubGroup;
 	delete m_pGUIDCache;
-
-	for ( POSITION pos = m_pOutbound.GetHeadPosition(); pos; )
-	{
-		CG2Packet* pOutbound = m_pOutbound.GetNext( pos );
-		pOutbound->Release();
-	}
+	delete m_pOutbound;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -122,10 +119,13 @@ BOOL CG2Neighbour::OnWrite()
 
 	CBuffer* pOutput = m_pZOutput ? m_pZOutput : (CBuffer*)pOutputLocked;
 
-	while ( pOutput->m_nLength == 0 && m_nOutbound > 0 )
+	const DWORD tNow = GetTickCount();
+
+	while ( pOutput->m_nLength == 0 && m_pOutbound->GetCount() > 0 )
 	{
-		CG2Packet* pPacket = m_pOutbound.RemoveHead();
-		m_nOutbound--;
+		CPacket* pPacket = m_pOutbound->GetPacketToSend( tNow );
+		if ( ! pPacket )
+			break;
 
 		pPacket->ToBuffer( pOutput );
 		pPacket->Release();
@@ -135,6 +135,11 @@ BOOL CG2Neighbour::OnWrite()
 
 	CNeighbour::OnWrite();
 
+	m_nOutbound  = m_pOutbound->GetCount();
+	m_nLostCount = m_pOutbound->GetDropped();
+	for ( int nClass = CPacketBuffer::pcControl; nClass < CPacketBuffer::pcMax; nClass++ )
+		m_nLostByClass[ nClass ] = m_pOutbound->GetDropped( nClass );
+
 	return TRUE;
 }
 
@@ -211,17 +216,8 @@ BOOL CG2Neighbour::Send(CPacket* pPacket, BOOL bRelease, BOOL bBuffered)
 
 		if ( bBuffered )
 		{
-			if ( m_nOutbound >= Settings.Gnutella1.PacketBufferSize )
-			{
-				CG2Packet* pRemove = m_pOutbound.RemoveTail();
-				pRemove->Release();
-				m_nOutbound--;
-				Statistics.Current.Gnutella2.Lost++;
-			}
-
-			pPacket->AddRef();
-			m_pOutbound.AddHead( static_cast< CG2Packet* >( pPacket ) );
-			m_nOutbound++;
+			m_pOutbound->Add( pPacket );
+			m_nOutbound = m_pOutbound->GetCount();
 		}
 		else
 		{
@@ -986,7 +982,10 @@ BOOL CG2Neighbour::ParseKHLPacket(CG2Packet* pPacket, const SOCKADDR_IN* pHost)
 						{
 							if ( pCached->m_nKeyValue == 0 ||
 									pCached->m_nKeyHost != Network.m_pHost.sin_addr.S_un.S_addr )
+							{
 								pCached->SetKey( nKey, &(pOwner->m_pHost.sin_addr) );
+								HostCache.Gnutella2.QueueQuery( pCached );
+							}
 						}
 					}
 
@@ -1353,6 +1352,7 @@ BOOL CG2Neighbour::OnQueryKeyAns(CG2Packet* pPacket)
 		theApp.Message( MSG_DEBUG, L"Got a query key for %s:%i via neighbour %s: 0x%x",
 			(LPCTSTR)CString( inet_ntoa( *(IN_ADDR*)&nAddress ) ), nPort, (LPCTSTR)m_sAddress, nKey );
 		pCache->SetKey( nKey, &m_pHost.sin_addr );
+		HostCache.Gnutella2.QueueQuery( pCache );
 	}
 
 	return TRUE;
@@ -1462,7 +1462,7 @@ BOOL CG2Neighbour::OnProfileDelivery(CG2Packet* pPacket)
 
 		if ( CHostCacheHostPtr pHost = HostCache.Gnutella2.Find( &m_pHost.sin_addr ) )
 		{
-			pHost->m_sName = m_pProfile->GetNick();
+			pHost->EditExtra().m_sName = m_pProfile->GetNick();
 			HostCache.Gnutella2.m_nCookie ++;
 		}
 	}
@@ -22,6 +22,7 @@
 
 class CPacket;
 class CG2Packet;
+class CPacketBuffer;
 class CHubHorizonGroup;
 class CQuerySearch;
 class CRouteCache;
@@ -98,7 +99,7 @@ protected:
 	DWORD				m_nCountHAWOut;			// Number of HAW packets sent
 	DWORD				m_tLastQueryIn;			// Time when Q2 packet received
 	DWORD				m_nCountQueryIn;		// Number of Q2 packets received
-	CList< CG2Packet* >	m_pOutbound;			// Queue of outbound packets
+	CPacketBuffer*		m_pOutbound;			// Queue of outbound packets, by priority class
 	BOOL				m_bFirewalled;			// Is the client reporting they are firewalled from /LNI/FW
 
 protected:
@@ -409,6 +409,15 @@ int CG2Packet::GetStringLen(LPCTSTR pszString) const
 
 void CG2Packet::ToBuffer(CBuffer* pBuffer, bool /*bTCP*/)
 {
+	if ( m_pEncoded )
+	{
+		pBuffer->Add( m_pEncoded->m_pBuffer, m_pEncoded->m_nLength );
+		Statistics.Current.Gnutella2.Shared++;
+		return;
+	}
+
+	Statistics.Current.Gnutella2.Encoded++;
+
 	ASSERT( G2_TYPE_LEN( m_nType ) > 0 );
 
 	BYTE nLenLen  = 1;
@@ -1024,7 +1033,11 @@ BOOL CG2Packet::OnQueryKeyAnswer(const SOCKADDR_IN* pHost)
 
 		CHostCacheHostPtr pCache = HostCache.Gnutella2.Add(
 			&pHost->sin_addr, htons( pHost->sin_port ) );
-		if ( pCache != NULL ) pCache->SetKey( nKey );
+		if ( pCache != NULL )
+		{
+			pCache->SetKey( nKey );
+			HostCache.Gnutella2.QueueQuery( pCache );
+		}
 	}
 
 	if ( nAddress.s_addr != 0 && ! Network.IsSelfIP( nAddress ) )
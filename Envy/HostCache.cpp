@@ -35,8 +35,12 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+#define HOST_POOL_SIZE		256		// Hosts allocated at once by CHostCachePool
+
 CHostCache HostCache;
 
+const CHostCacheExtra CHostCacheHost::m_pNoExtra;
+
 
 //////////////////////////////////////////////////////////////////////
 // CHostCache construction
@@ -362,12 +366,14 @@ void CHostCacheList::Clear()
 	// ToDo: Crash at exit, Fix properly
 	for ( CHostCacheMapItr i = m_Hosts.begin(); i != m_Hosts.end(); ++i )
 	{
-		delete (*i).second;
+		m_pPool.Delete( (*i).second );
 	}
 #endif
 
 	m_Hosts.clear();
 	m_HostsTime.clear();
+	m_pQueryQueue.clear();
+	m_pQueryTimes.clear();
 
 	m_nCookie++;
 }
@@ -435,7 +441,7 @@ CHostCacheHostPtr CHostCacheList::Add(const IN_ADDR* pAddress, WORD nPort, DWORD
 	if ( ! pHost )
 	{
 		// Create new host
-		pHost = new CHostCacheHost( m_nProtocol );
+		pHost = m_pPool.New( m_nProtocol );
 		if ( pHost )
 		{
 			PruneHosts();
@@ -445,13 +451,16 @@ CHostCacheHostPtr CHostCacheList::Add(const IN_ADDR* pAddress, WORD nPort, DWORD
 			pHost->m_sAddress = pHost->m_sAddress.SpanExcluding( L":" );
 
 			pHost->Update( nPort, tSeen, pszVendor, nUptime, nCurrentLeaves, nLeafLimit );
+			SetCountry( pHost );
 
-			if ( ! pHost->m_pVendor && pHost->m_sName.IsEmpty() && pszVendor )
-				pHost->m_sName = pszVendor;
+			// Unknown vendor codes come from peers, each host keeps its own copy
+			if ( ! pHost->m_pVendor && pHost->Extra().m_sName.IsEmpty() && pszVendor && *pszVendor )
+				pHost->EditExtra().m_sName = pszVendor;
 
 			// Add host to map and index
 			m_Hosts.insert( CHostCacheMapPair( pHost->m_pAddress, pHost ) );
 			m_HostsTime.insert( pHost );
+			QueueQuery( pHost );
 
 			m_nCookie++;
 		}
@@ -476,7 +485,10 @@ void CHostCacheList::Update(CHostCacheHostPtr pHost, WORD nPort, DWORD tSeen, LP
 	ASSERT( m_Hosts.size() == m_HostsTime.size() );
 
 	// Update host
-	if ( pHost->Update( nPort, tSeen, pszVendor, nUptime, nCurrentLeaves, nLeafLimit ) )
+	const bool bChanged = pHost->Update( nPort, tSeen, pszVendor, nUptime, nCurrentLeaves, nLeafLimit );
+	SetCountry( pHost );
+
+	if ( bChanged )
 	{
 		// Remove host from old and now invalid position
 		m_HostsTime.erase( std::find( m_HostsTime.begin(), m_HostsTime.end(), pHost ) );
@@ -487,6 +499,9 @@ void CHostCacheList::Update(CHostCacheHostPtr pHost, WORD nPort, DWORD tSeen, LP
 		ASSERT( m_Hosts.size() == m_HostsTime.size() );
 	}
 
+	// Host may be current again
+	QueueQuery( pHost );
+
 	m_nCookie++;
 }
 
@@ -508,7 +523,7 @@ CHostCacheMapItr CHostCacheList::Remove(CHostCacheHostPtr pHost)
 	i = m_Hosts.erase( i );
 	ASSERT( m_Hosts.size() == m_HostsTime.size() );
 
-	delete pHost;
+	m_pPool.Delete( pHost );
 	m_nCookie++;
 
 	return i;
@@ -573,10 +588,11 @@ void CHostCacheList::OnResolve(LPCTSTR szAddress, const IN_ADDR* pAddress, WORD
 
 		pHost->m_pAddress = *pAddress;
 		pHost->m_nPort = nPort;
-		pHost->m_sCountry = theApp.GetCountryCode( pHost->m_pAddress );
+		SetCountry( pHost, true );
 
 		// Add to new place
 		m_Hosts.insert( CHostCacheMapPair( pHost->m_pAddress, pHost ) );
+		QueueQuery( pHost );
 
 		m_nCookie++;
 
@@ -655,6 +671,83 @@ CHostCacheHostPtr CHostCacheList::OnSuccess(const IN_ADDR* pAddress, WORD nPort,
 	return pHost;
 }
 
+//////////////////////////////////////////////////////////////////////
+// CHostCacheList query index (G2)
+
+// Entries are keyed by address and revalidated when visited, so removed or
+// recycled hosts simply drop out. Only moves that make a host due earlier
+// (new host, fresh query key, seen again) need to be queued explicitly.
+
+void CHostCacheList::QueueQuery(CHostCacheHostPtr pHost)
+{
+	if ( m_nProtocol != PROTOCOL_G2 )
+		return;
+
+	CQuickLock oLock( m_pSection );
+
+	const DWORD nAddress = pHost->m_pAddress.s_addr;
+	const DWORD tNext = pHost->QueryTime();
+
+	std::map< DWORD, DWORD >::iterator i = m_pQueryTimes.find( nAddress );
+	if ( i != m_pQueryTimes.end() )
+	{
+		if ( (*i).second == tNext )
+			return;
+
+		m_pQueryQueue.erase( CHostQueryPair( (*i).second, nAddress ) );
+		(*i).second = tNext;
+	}
+	else
+	{
+		m_pQueryTimes.insert( std::pair< DWORD, DWORD >( nAddress, tNext ) );
+	}
+
+	m_pQueryQueue.insert( CHostQueryPair( tNext, nAddress ) );
+}
+
+CHostCacheHostPtr CHostCacheList::GetNextQuery(CHostQueryIterator& i, const DWORD tNow, const CHostQueryFilter* pSkip)
+{
+	CQuickLock oLock( m_pSection );
+
+	while ( i != m_pQueryQueue.end() && (*i).first <= tNow )
+	{
+		CHostQueryIterator iCur = i++;
+
+		IN_ADDR pAddress;
+		pAddress.s_addr = (*iCur).second;
+
+		// Caller already has this one
+		if ( pSkip && pSkip->Check( pAddress.s_addr ) )
+			continue;
+
+		CHostCacheHostPtr pHost = Find( &pAddress );
+		if ( ! pHost || tNow > pHost->Seen() + Settings.Gnutella2.HostCurrent )
+		{
+			// Gone or no longer current, Update() will queue it again
+			m_pQueryTimes.erase( pAddress.s_addr );
+			m_pQueryQueue.erase( iCur );
+			continue;
+		}
+
+		// Ready hosts stay in place until QueueQuery() after sending
+		DWORD tNext = pHost->QueryTime();
+		if ( tNext <= tNow )
+		{
+			if ( pHost->CanQuery( tNow ) )
+				return pHost;
+
+			// Not ready for other reasons, have another look later
+			tNext = tNow + Settings.Gnutella2.QueryThrottle;
+		}
+
+		m_pQueryQueue.erase( iCur );
+		m_pQueryQueue.insert( CHostQueryPair( tNext, pAddress.s_addr ) );
+		m_pQueryTimes[ pAddress.s_addr ] = tNext;
+	}
+
+	return NULL;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CHostCacheList query acknowledgment prune (G2)
 
@@ -761,7 +854,7 @@ void CHostCacheList::PruneHosts()
 			i = m_HostsTime.erase( i );
 			m_Hosts.erase( std::find_if( m_Hosts.begin(), m_Hosts.end(),
 				std::bind2nd( is_host(), pHost ) ) );
-			delete pHost;
+			m_pPool.Delete( pHost );
 			m_nCookie++;
 		}
 	}
@@ -774,13 +867,22 @@ void CHostCacheList::PruneHosts()
 		i = m_HostsTime.erase( i );
 		m_Hosts.erase( std::find_if( m_Hosts.begin(), m_Hosts.end(),
 			std::bind2nd( is_host(), pHost ) ) );
-		delete pHost;
+		m_pPool.Delete( pHost );
 		m_nCookie++;
 	}
 
 	ASSERT( m_Hosts.size() == m_HostsTime.size() );
 }
 
+//////////////////////////////////////////////////////////////////////
+// CHostCacheList country lookup (one shared string per country code)
+
+void CHostCacheList::SetCountry(CHostCacheHostPtr pHost, bool bForce)
+{
+	if ( bForce || pHost->m_sCountry.IsEmpty() )
+		pHost->m_sCountry = m_pPool.InternCountry( theApp.GetCountryCode( pHost->m_pAddress ) );
+}
+
 //////////////////////////////////////////////////////////////////////
 // CHostCacheList serialize
 
@@ -802,21 +904,23 @@ void CHostCacheList::Serialize(CArchive& ar, int nVersion)
 		DWORD_PTR nCount = ar.ReadCount();
 		for ( DWORD_PTR nItem = 0; nItem < nCount; nItem++ )
 		{
-			CHostCacheHostPtr pHost = new CHostCacheHost( m_nProtocol );
+			CHostCacheHostPtr pHost = m_pPool.New( m_nProtocol );
 			if ( pHost )
 			{
 				pHost->Serialize( ar, nVersion );
+				pHost->m_sCountry = m_pPool.InternCountry( pHost->m_sCountry );
 				if ( ! Security.IsDenied( &pHost->m_pAddress ) &&
 					 ! Find( &pHost->m_pAddress ) &&
 					 ! Find( pHost->m_sAddress ) )
 				{
 					m_Hosts.insert( CHostCacheMapPair( pHost->m_pAddress, pHost ) );
 					m_HostsTime.insert( pHost );
+					QueueQuery( pHost );
 				}
 				else
 				{
 					// Remove bad or duplicated host
-					delete pHost;
+					m_pPool.Delete( pHost );
 				}
 			}
 		}
@@ -932,8 +1036,9 @@ int CHostCache::ImportHubList(CFile* pFile)
 				protocolNames[ PROTOCOL_DC ], 0, nUsers, nMaxusers, strAddress );
 			if ( pServer )
 			{
-				pServer->m_sName = pHub->GetAttributeValue( L"Name" );
-				pServer->m_sDescription = pHub->GetAttributeValue( L"Description" );
+				CHostCacheExtra& oExtra = pServer->EditExtra();
+				oExtra.m_sName = pHub->GetAttributeValue( L"Name" );
+				oExtra.m_sDescription = pHub->GetAttributeValue( L"Description" );
 				nHubs++;
 			}
 		}
@@ -975,15 +1080,15 @@ int CHostCache::ImportMET(CFile* pFile)
 			if ( pServer == NULL ) continue;
 
 			if ( pTag.Check( ED2K_ST_SERVERNAME, ED2K_TAG_STRING ) )
-				pServer->m_sName = pTag.m_sValue;
+				pServer->EditExtra().m_sName = pTag.m_sValue;
 			else if ( pTag.Check( ED2K_ST_DESCRIPTION, ED2K_TAG_STRING ) )
-				pServer->m_sDescription = pTag.m_sValue;
+				pServer->EditExtra().m_sDescription = pTag.m_sValue;
 			else if ( pTag.Check( ED2K_ST_MAXUSERS, ED2K_TAG_INT ) )
 				pServer->m_nUserLimit = (DWORD)pTag.m_nValue;
 			else if ( pTag.Check( ED2K_ST_MAXFILES, ED2K_TAG_INT ) )
-				pServer->m_nFileLimit = (DWORD)pTag.m_nValue;
+				pServer->EditExtra().m_nFileLimit = (DWORD)pTag.m_nValue;
 			else if ( pTag.Check( ED2K_ST_UDPFLAGS, ED2K_TAG_INT ) )
-				pServer->m_nUDPFlags = (DWORD)pTag.m_nValue;
+				pServer->EditExtra().m_nUDPFlags = (DWORD)pTag.m_nValue;
 		}
 
 		nServers++;
@@ -1249,37 +1354,161 @@ int CHostCache::LoadDefaultServers(PROTOCOLID nProtocol)
 }
 
 //////////////////////////////////////////////////////////////////////
-// CHostCacheHost construction
+// CHostCachePool construction
 
-CHostCacheHost::CHostCacheHost(PROTOCOLID nProtocol)
-	: m_nProtocol	( nProtocol )
-	, m_nPort		( 0 )
-	, m_nUDPPort	( 0 )
-	, m_pVendor 	( NULL )
-	, m_bPriority	( FALSE )
-	, m_nUserCount	( 0 )
-	, m_nUserLimit	( 0 )
-	, m_nFileLimit	( 0 )
+CHostCachePool::CHostCachePool()
+{
+}
+
+CHostCachePool::~CHostCachePool()
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CHostCachePool release all blocks (only when every host was returned)
+
+void CHostCachePool::Clear()
+{
+	if ( m_pFree.GetCount() != m_pBlocks.GetCount() * HOST_POOL_SIZE )
+		return;		// Some hosts still in use
+
+	for ( INT_PTR nBlock = 0; nBlock < m_pBlocks.GetCount(); nBlock++ )
+	{
+		delete [] m_pBlocks.GetAt( nBlock );
+	}
+
+	m_pBlocks.RemoveAll();
+	m_pFree.RemoveAll();
+	m_pStrings.RemoveAll();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CHostCachePool host allocation
+
+CHostCacheHostPtr CHostCachePool::New(PROTOCOLID nProtocol)
+{
+	if ( m_pFree.IsEmpty() )
+	{
+		CHostCacheHost* pBlock = new CHostCacheHost[ HOST_POOL_SIZE ];
+		if ( ! pBlock )
+			return NULL;
+
+		m_pBlocks.Add( pBlock );
+
+		// Hand out hosts from the start of the block first
+		for ( int nHost = HOST_POOL_SIZE - 1; nHost >= 0; nHost-- )
+		{
+			m_pFree.Add( &pBlock[ nHost ] );
+		}
+	}
+
+	const INT_PTR nLast = m_pFree.GetCount() - 1;
+	CHostCacheHostPtr pHost = m_pFree.GetAt( nLast );
+	m_pFree.RemoveAt( nLast );
+
+	pHost->Reset( nProtocol );
+
+	return pHost;
+}
+
+void CHostCachePool::Delete(CHostCacheHostPtr pHost)
+{
+	ASSERT( pHost );
+
+	// Release strings and optional attributes now, not on reuse
+	pHost->Reset( PROTOCOL_NULL );
+
+	m_pFree.Add( pHost );
+}
+
+//////////////////////////////////////////////////////////////////////
+// CHostCachePool country code interning
+
+CString CHostCachePool::InternCountry(const CString& str)
+{
+	// Two letters, digits or dashes as GeoIP returns them, anything else (from a damaged file) stays private
+	if ( str.GetLength() != 2 )
+		return str;
+	for ( int nChar = 0; nChar < 2; nChar++ )
+	{
+		const TCHAR c = str.GetAt( nChar );
+		if ( ! ( c >= L'A' && c <= L'Z' ) && ! ( c >= L'0' && c <= L'9' ) && c != L'-' )
+			return str;
+	}
+
+	CString strShared;
+	if ( ! m_pStrings.Lookup( str, strShared ) )
+	{
+		strShared = str;
+		m_pStrings.SetAt( strShared, strShared );
+	}
+
+	return strShared;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CHostCacheExtra construction
+
+CHostCacheExtra::CHostCacheExtra()
+	: m_nFileLimit	( 0 )
 	, m_nTCPFlags	( 0 )
 	, m_nUDPFlags	( 0 )
-	, m_tAdded		( GetTickCount() )
-	, m_tSeen		( 0 )
-	, m_tRetryAfter	( 0 )
-	, m_tConnect	( 0 )
-	, m_tQuery		( 0 )
-	, m_tAck		( 0 )
-	, m_tStats		( 0 )
-	, m_tFailure	( 0 )
-	, m_nFailures	( 0 )
-	, m_nDailyUptime( 0 )
-	, m_tKeyTime	( 0 )
-	, m_nKeyValue	( 0 )
-	, m_nKeyHost	( 0 )
-	, m_bCheckedLocally ( FALSE )
-//	, m_bDHT		( FALSE )	// Attributes: DHT (Unused)
 //	, m_nKADVersion	( 0 )		// ToDo: Attributes: Kademlia
 {
-	m_pAddress.s_addr = INADDR_ANY;
+}
+
+bool CHostCacheExtra::IsEmpty() const
+{
+	return m_sName.IsEmpty() && m_sDescription.IsEmpty() &&
+		m_sUser.IsEmpty() && m_sPass.IsEmpty() &&
+		! m_nFileLimit && ! m_nTCPFlags && ! m_nUDPFlags &&
+		! m_oBtGUID && ! m_oGUID && m_Token.IsEmpty();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CHostCacheHost construction
+
+CHostCacheHost::CHostCacheHost()
+	: m_pExtra		( NULL )
+{
+	Reset( PROTOCOL_NULL );
+}
+
+CHostCacheHost::~CHostCacheHost()
+{
+	delete m_pExtra;
+}
+
+void CHostCacheHost::Reset(PROTOCOLID nProtocol)
+{
+	delete m_pExtra;
+	m_pExtra = NULL;
+
+	m_pAddress.s_addr	= INADDR_ANY;
+	m_nPort				= 0;
+	m_nUDPPort			= 0;
+	m_nProtocol			= nProtocol;
+	m_bPriority			= FALSE;
+	m_bCheckedLocally	= FALSE;
+	m_tFailure			= 0;
+	m_nFailures			= 0;
+	m_tAck				= 0;
+	m_tStats			= 0;
+	m_tConnect			= 0;
+	m_tQuery			= 0;
+	m_tRetryAfter		= 0;
+	m_tAdded			= GetTickCount();
+	m_nDailyUptime		= 0;
+	m_tKeyTime			= 0;
+	m_nKeyValue			= 0;
+	m_nKeyHost			= 0;
+	m_nUserCount		= 0;
+	m_nUserLimit		= 0;
+	m_pVendor			= NULL;
+	m_tSeen				= 0;
+	m_sAddress.Empty();
+	m_sCountry.Empty();
 
 	// 20sec cooldown to avoid neighbor add-remove oscillation
 	const DWORD tNow = static_cast< DWORD >( time( NULL ) );
@@ -1297,6 +1526,14 @@ CHostCacheHost::CHostCacheHost(PROTOCOLID nProtocol)
 	}
 }
 
+CHostCacheExtra& CHostCacheHost::EditExtra()
+{
+	if ( ! m_pExtra )
+		m_pExtra = new CHostCacheExtra;
+
+	return *m_pExtra;
+}
+
 DWORD CHostCacheHost::Seen() const
 {
 	return m_tSeen;
@@ -1317,6 +1554,8 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 {
 	if ( ar.IsStoring() )
 	{
+		const CHostCacheExtra& oExtra = Extra();
+
 		ar.Write( &m_pAddress, sizeof( m_pAddress ) );
 		ar << m_nPort;
 
@@ -1337,17 +1576,17 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 			ar << cZero;
 		}
 
-		ar << m_sName;
-		if ( ! m_sName.IsEmpty() )
-			ar << m_sDescription;
+		ar << oExtra.m_sName;
+		if ( ! oExtra.m_sName.IsEmpty() )
+			ar << oExtra.m_sDescription;
 
 		ar << m_nUserCount;
 		ar << m_nUserLimit;
 		ar << m_bPriority;
 
-		ar << m_nFileLimit;
-		ar << m_nTCPFlags;
-		ar << m_nUDPFlags;
+		ar << oExtra.m_nFileLimit;
+		ar << oExtra.m_nTCPFlags;
+		ar << oExtra.m_nUDPFlags;
 		ar << m_tStats;
 
 		ar << m_nKeyValue;
@@ -1364,15 +1603,15 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 		ar << m_sCountry;
 
 	//	ar << m_bDHT;	// Unused
-		ar.Write( &m_oBtGUID[0], m_oBtGUID.byteCount );
+		ar.Write( &oExtra.m_oBtGUID[0], oExtra.m_oBtGUID.byteCount );
 
 		ar << m_nUDPPort;
-		ar.Write( &m_oGUID[0], m_oGUID.byteCount );
+		ar.Write( &oExtra.m_oGUID[0], oExtra.m_oGUID.byteCount );
 
 		ar << m_tConnect;
 
-		ar << m_sUser;
-		ar << m_sPass;
+		ar << oExtra.m_sUser;
+		ar << oExtra.m_sPass;
 
 		ar << m_sAddress;
 
@@ -1383,6 +1622,8 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 	{
 		const DWORD tNow = static_cast< DWORD >( time( NULL ) );
 
+		CHostCacheExtra& oExtra = EditExtra();
+
 		ReadArchive( ar, &m_pAddress, sizeof( m_pAddress ) );
 		ar >> m_nPort;
 
@@ -1404,17 +1645,17 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 			m_pVendor = VendorCache.Lookup( szVendor );
 		}
 
-		ar >> m_sName;
-		if ( ! m_sName.IsEmpty() )
-			ar >> m_sDescription;
+		ar >> oExtra.m_sName;
+		if ( ! oExtra.m_sName.IsEmpty() )
+			ar >> oExtra.m_sDescription;
 
 		ar >> m_nUserCount;
 		ar >> m_nUserLimit;
 		ar >> m_bPriority;
 
-		ar >> m_nFileLimit;
-		ar >> m_nTCPFlags;
-		ar >> m_nUDPFlags;
+		ar >> oExtra.m_nFileLimit;
+		ar >> oExtra.m_nTCPFlags;
+		ar >> oExtra.m_nUDPFlags;
 		ar >> m_tStats;
 
 		ar >> m_nKeyValue;
@@ -1433,20 +1674,27 @@ void CHostCacheHost::Serialize(CArchive& ar, int /*nVersion*/)	// HOSTCACHE_SER_
 		ar >> m_sCountry;
 
 		//ar >> m_bDHT;	// Unused
-		ReadArchive( ar, &m_oBtGUID[0], m_oBtGUID.byteCount );
-		m_oBtGUID.validate();
+		ReadArchive( ar, &oExtra.m_oBtGUID[0], oExtra.m_oBtGUID.byteCount );
+		oExtra.m_oBtGUID.validate();
 
 		ar >> m_nUDPPort;
-		ReadArchive( ar, &m_oGUID[0], m_oGUID.byteCount );
-		m_oGUID.validate();
+		ReadArchive( ar, &oExtra.m_oGUID[0], oExtra.m_oGUID.byteCount );
+		oExtra.m_oGUID.validate();
 
 		ar >> m_tConnect;
 
-		ar >> m_sUser;
-		ar >> m_sPass;
+		ar >> oExtra.m_sUser;
+		ar >> oExtra.m_sPass;
 
 		ar >> m_sAddress;
 
+		// Most G1/G2/DHT hosts carry no optional attributes
+		if ( oExtra.IsEmpty() )
+		{
+			delete m_pExtra;
+			m_pExtra = NULL;
+		}
+
 		//if ( m_nProtocol == PROTOCOL_KAD )
 		//	ar >> m_nKADVersion;	// ToDo: Kademlia
 	}
@@ -1492,9 +1740,6 @@ bool CHostCacheHost::Update(WORD nPort, DWORD tSeen, LPCTSTR pszVendor, DWORD nU
 			m_pVendor = VendorCache.Lookup( (LPCTSTR)strVendorCode );
 	}
 
-	if ( m_sCountry.IsEmpty() )
-		m_sCountry = theApp.GetCountryCode( m_pAddress );
-
 	return bChanged;
 }
 
@@ -1672,6 +1917,25 @@ bool CHostCacheHost::CanQuery(const DWORD tNow) const
 	}
 }
 
+//////////////////////////////////////////////////////////////////////
+// CHostCacheHost query schedule (G2)
+
+DWORD CHostCacheHost::QueryTime() const
+{
+	// Don't query too fast
+	DWORD tNext = m_tQuery ? m_tQuery + Settings.Gnutella2.QueryThrottle + 1 : 0;
+
+	// Retry After
+	if ( m_tRetryAfter > tNext )
+		tNext = m_tRetryAfter;
+
+	// Without a query key, wait before requesting another one
+	if ( m_nKeyValue == 0 && m_tKeyTime )
+		tNext = max( tNext, m_tKeyTime + max( Settings.Gnutella2.QueryThrottle * 5ul, 5ul * 60ul ) );
+
+	return tNext;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CHostCacheHost query key submission
 
@@ -27,40 +27,61 @@ class CHostCache;
 #include "VendorCache.h"
 
 
-class CHostCacheHost
+// Optional host attributes, allocated only for hosts that carry them (ED2K/DC servers, DHT/KAD nodes)
+class CHostCacheExtra
 {
 public:
-	CHostCacheHost(PROTOCOLID nProtocol);
+	CHostCacheExtra();
 
-	// Attributes: Host Information
-	PROTOCOLID	m_nProtocol;		// Host protocol (PROTOCOL_*)
-	CString		m_sAddress;			// Host full address (unresolved)
+	// Attributes: Server Information
+	CString		m_sName;			// Host name
+	CString		m_sDescription;		// Host description
+	CString		m_sUser;			// User name on this server (DC)
+	CString		m_sPass;			// User password on this server (DC)
+	DWORD		m_nFileLimit;		// ED2K-server file limit
+	DWORD		m_nTCPFlags;		// ED2K TCP flags (ED2K_SERVER_TCP_*)
+	DWORD		m_nUDPFlags;		// ED2K UDP flags (ED2K_SERVER_UDP_*)
+
+	// Attributes: DHT
+	Hashes::BtGuid	m_oBtGUID;		// Host GUID (160 bit)
+	CArray< BYTE >	m_Token;		// Host access token
+
+	// Attributes: Kademlia
+	Hashes::Guid	m_oGUID;		// Host GUID (128 bit)
+//	BYTE			m_nKADVersion;	// ToDo: Kademlia version
+
+	bool		IsEmpty() const;	// Nothing worth keeping
+
+private:
+	CHostCacheExtra(const CHostCacheExtra&);
+	CHostCacheExtra& operator=(const CHostCacheExtra&);
+};
+
+
+class CHostCacheHost
+{
+protected:
+	CHostCacheHost();
+	~CHostCacheHost();
+
+public:
+	// Attributes: Host Information  (Hot fields first, used by sort/prune)
 	IN_ADDR		m_pAddress; 		// Host IP address
 	WORD		m_nPort;			// Host TCP port number
 	WORD		m_nUDPPort; 		// Host UDP port number
-	CVendorPtr	m_pVendor;			// Vendor handler from VendorCache
+	PROTOCOLID	m_nProtocol;		// Host protocol (PROTOCOL_*)
 	BOOL		m_bPriority;		// Host cannot be removed on failure
-	DWORD		m_nUserCount;		// G2 leaf count / ED2K/DC user count
-	DWORD		m_nUserLimit;		// G2 leaf limit / ED2K/DC user limit
-	DWORD		m_nFileLimit;		// ED2K-server file limit
-	DWORD		m_nTCPFlags;		// ED2K TCP flags (ED2K_SERVER_TCP_*)
-	DWORD		m_nUDPFlags;		// ED2K UDP flags (ED2K_SERVER_UDP_*)
 	BOOL		m_bCheckedLocally;	// Host was successfully accessed via TCP or UDP
-	CString		m_sName;			// Host name
-	CString		m_sDescription;		// Host description
-	CString		m_sUser;			// User name on this server (DC)
-	CString		m_sPass;			// User password on this server (DC)
-	CString		m_sCountry; 		// Country code
 
 	// Attributes: Contact Times
-	DWORD		m_tAdded;			// Time when host was constructed (in ticks)
-	DWORD		m_tRetryAfter;		// G2 retry time according G2_PACKET_RETRY_AFTER packet (in seconds)
-	DWORD		m_tConnect; 		// TCP connect time (in seconds)
-	DWORD		m_tQuery;			// G2/ED2K/BitTorrentDHT query time (in seconds)
-	DWORD		m_tAck; 			// Time when we sent something requires acknowledgment (0 - not required)
-	DWORD		m_tStats;			// ED2K stats UDP request
 	DWORD		m_tFailure; 		// Last failure time
 	DWORD		m_nFailures;		// Failures counter
+	DWORD		m_tAck; 			// Time when we sent something requires acknowledgment (0 - not required)
+	DWORD		m_tStats;			// ED2K stats UDP request
+	DWORD		m_tConnect; 		// TCP connect time (in seconds)
+	DWORD		m_tQuery;			// G2/ED2K/BitTorrentDHT query time (in seconds)
+	DWORD		m_tRetryAfter;		// G2 retry time according G2_PACKET_RETRY_AFTER packet (in seconds)
+	DWORD		m_tAdded;			// Time when host was constructed (in ticks)
 	DWORD		m_nDailyUptime;		// Daily uptime (G1)
 
 	// Attributes: Query Keys
@@ -68,14 +89,19 @@ public:
 	DWORD		m_nKeyValue;		// G2 query key
 	DWORD		m_nKeyHost; 		// G2 query key host
 
-	// Attributes: DHT
-//	BOOL			m_bDHT; 		// Host is DHT capable (UNUSED)
-	Hashes::BtGuid	m_oBtGUID;		// Host GUID (160 bit)
-	CArray< BYTE >	m_Token;		// Host access token
+	DWORD		m_nUserCount;		// G2 leaf count / ED2K/DC user count
+	DWORD		m_nUserLimit;		// G2 leaf limit / ED2K/DC user limit
+	CVendorPtr	m_pVendor;			// Vendor handler from VendorCache
+	CString		m_sAddress;			// Host full address (unresolved)
+	CString		m_sCountry; 		// Country code (interned by owner list)
 
-	// Attributes: Kademlia
-	Hashes::Guid	m_oGUID;		// Host GUID (128 bit)
-//	BYTE			m_nKADVersion;	// ToDo: Kademlia version
+	// Attributes: Optional (Name, ED2K flags, DHT/KAD identity)
+	inline const CHostCacheExtra& Extra() const throw()
+	{
+		return m_pExtra ? *m_pExtra : m_pNoExtra;
+	}
+
+	CHostCacheExtra& EditExtra();	// Allocate optional attributes on first write
 
 	bool		ConnectTo(BOOL bAutomatic = FALSE);
 	CString		ToString(const bool bLong = true) const; // "10.0.0.1:6346 2002-04-30T08:30Z"
@@ -84,6 +110,7 @@ public:
 	bool		CanConnect(const DWORD tNow) const;		// Can we connect to this host now?
 	bool		CanQuote(const DWORD tNow) const;		// Is this a recently seen host?
 	bool		CanQuery(const DWORD tNow) const;		// Can we UDP query this host? (G2/ed2k)
+	DWORD		QueryTime() const;		// Earliest time this host may be UDP queried (G2)
 	void		SetKey(const DWORD nKey, const IN_ADDR* pHost = NULL);
 
 	DWORD		Seen() const;		// Get host last seen time
@@ -91,12 +118,17 @@ public:
 
 protected:
 	DWORD		m_tSeen;			// Host last seen time
+	CHostCacheExtra* m_pExtra;		// Optional attributes (NULL for most G1/G2/DHT hosts)
 
+	static const CHostCacheExtra m_pNoExtra;
+
+	void		Reset(PROTOCOLID nProtocol);
 	// Return: true - if tSeen changed, false - otherwise.
 	bool		Update(WORD nPort, DWORD tSeen = 0, LPCTSTR pszVendor = NULL, DWORD nUptime = 0, DWORD nCurrentLeaves = 0, DWORD nLeafLimit = 0);
 	void		Serialize(CArchive& ar, int nVersion);
 
 	friend class CHostCacheList;
+	friend class CHostCachePool;
 
 private:
 	CHostCacheHost(const CHostCacheHost&);
@@ -132,6 +164,74 @@ typedef std::pair < CHostCacheIndex::iterator, CHostCacheIndex::iterator > CHost
 typedef CHostCacheIndex::const_iterator CHostCacheIterator;
 typedef CHostCacheIndex::const_reverse_iterator CHostCacheRIterator;
 
+typedef std::pair< DWORD, DWORD > CHostQueryPair;		// Next query time (s), IP address
+typedef std::set< CHostQueryPair > CHostQueryQueue;		// Hosts by next query time (earliest first)
+typedef CHostQueryQueue::iterator CHostQueryIterator;
+
+// Bloom filter of IPv4 addresses: Check() may give false positives, never false negatives
+// Sized at 16 or more bits per address, at most 1.4% false positives with two hashes
+class CHostQueryFilter
+{
+public:
+	CHostQueryFilter()
+		: m_nShift		( 0 )
+		, m_nCount		( 0 )
+		, m_nCapacity	( 0 )
+	{
+		Clear();
+	}
+
+	// Empty the filter, resized for nExpected addresses
+	void Clear(DWORD nExpected = 0)
+	{
+		DWORD nBits = 17;		// 16 KB minimum
+		while ( nBits < 22 && ( 1ul << nBits ) < nExpected * 16 )
+			nBits++;
+
+		m_pBits.assign( (size_t)1 << ( nBits - 3 ), 0 );
+		m_nShift = 32 - nBits;
+		m_nCount = 0;
+		m_nCapacity = ( 1ul << nBits ) / 16;
+	}
+
+	// More addresses than sized for, false positives would rise
+	inline bool IsFull() const throw()
+	{
+		return m_nCount >= m_nCapacity;
+	}
+
+	inline void Add(DWORD nAddress) throw()
+	{
+		const DWORD nBit1 = Hash1( nAddress ), nBit2 = Hash2( nAddress );
+		m_pBits[ nBit1 >> 3 ] |= (BYTE)( 1 << ( nBit1 & 7 ) );
+		m_pBits[ nBit2 >> 3 ] |= (BYTE)( 1 << ( nBit2 & 7 ) );
+		m_nCount++;
+	}
+
+	inline bool Check(DWORD nAddress) const throw()
+	{
+		const DWORD nBit1 = Hash1( nAddress ), nBit2 = Hash2( nAddress );
+		return ( m_pBits[ nBit1 >> 3 ] & ( 1 << ( nBit1 & 7 ) ) ) &&
+			   ( m_pBits[ nBit2 >> 3 ] & ( 1 << ( nBit2 & 7 ) ) );
+	}
+
+protected:
+	std::vector< BYTE >	m_pBits;
+	DWORD	m_nShift;		// 32 - log2( bits )
+	DWORD	m_nCount;		// Addresses added since Clear()
+	DWORD	m_nCapacity;	// Addresses sized for
+
+	inline DWORD Hash1(DWORD nAddress) const throw()
+	{
+		return ( nAddress * 0x9E3779B1ul ) >> m_nShift;
+	}
+
+	inline DWORD Hash2(DWORD nAddress) const throw()
+	{
+		return ( ( nAddress ^ ( nAddress >> 15 ) ) * 0x85EBCA6Bul ) >> m_nShift;
+	}
+};
+
 struct good_host : public std::binary_function< CHostCacheMapPair, BOOL, bool>
 {
 	inline bool operator()(const CHostCacheMapPair& _Pair, const BOOL& _bLocally) const throw()
@@ -158,6 +258,30 @@ struct is_address : public std::binary_function< CHostCacheMapPair, LPCTSTR, boo
 };
 
 
+// Allocates host records in blocks of HOST_POOL_SIZE and interns the country codes shared by many hosts.
+// Guarded by the owning list section.
+class CHostCachePool
+{
+public:
+	CHostCachePool();
+	~CHostCachePool();
+
+	CHostCacheHostPtr	New(PROTOCOLID nProtocol);
+	void				Delete(CHostCacheHostPtr pHost);
+	CString				InternCountry(const CString& str);	// Return country code sharing buffer with equal ones
+	void				Clear();
+
+protected:
+	CArray< CHostCacheHost* >	m_pBlocks;	// Arrays of HOST_POOL_SIZE hosts
+	CArray< CHostCacheHostPtr >	m_pFree;	// Hosts ready for reuse
+	CMapStringToString			m_pStrings;	// Country codes, bounded by their charset
+
+private:
+	CHostCachePool(const CHostCachePool&);
+	CHostCachePool& operator=(const CHostCachePool&);
+};
+
+
 class CHostCacheList
 {
 public:
@@ -178,6 +302,8 @@ public:
 	void				OnFailure(LPCTSTR szAddress, bool bRemove = true);
 	void				OnFailure(const IN_ADDR* pAddress, WORD nPort, bool bRemove = true);
 	CHostCacheHostPtr	OnSuccess(const IN_ADDR* pAddress, WORD nPort, bool bUpdate = true);
+	void				QueueQuery(CHostCacheHostPtr pHost);	// (Re)schedule host in query index (G2)
+	CHostCacheHostPtr	GetNextQuery(CHostQueryIterator& i, const DWORD tNow, const CHostQueryFilter* pSkip = NULL);	// Next queryable host, advancing i
 	void				PruneOldHosts(DWORD tNow);
 	void				SanityCheck();
 	void				Clear();
@@ -203,6 +329,11 @@ public:
 		return m_HostsTime.rend();
 	}
 
+	inline CHostQueryIterator QueryBegin() throw()
+	{
+		return m_pQueryQueue.begin();
+	}
+
 	inline bool IsEmpty() const throw()
 	{
 		return m_HostsTime.empty();
@@ -250,8 +381,12 @@ public:
 protected:
 	CHostCacheMap		m_Hosts;		// Hosts map (sorted by IP)
 	CHostCacheIndex		m_HostsTime;	// Host index (sorted from newer to older)
+	CHostCachePool		m_pPool;		// Host storage
+	CHostQueryQueue		m_pQueryQueue;	// Query index (G2 only, revalidated on visit)
+	std::map< DWORD, DWORD > m_pQueryTimes;	// IP address -> time queued in m_pQueryQueue
 
 	void				PruneHosts();
+	void				SetCountry(CHostCacheHostPtr pHost, bool bForce = false);
 };
 
 
@@ -207,9 +207,9 @@ BOOL CKademlia::OnPacket_KADEMLIA_BOOTSTRAP_RES(const SOCKADDR_IN* /*pHost*/, CE
 		CHostCacheHostPtr pCache = HostCache.Kademlia.Add( &pAddress, nTCPPort );
 		if ( pCache )
 		{
-			pCache->m_oGUID = oGUID;
+			pCache->EditExtra().m_oGUID = oGUID;
 			pCache->m_nUDPPort = nUDPPort;
-			pCache->m_sDescription = oGUID.toString();
+			pCache->EditExtra().m_sDescription = oGUID.toString();
 		}
 	}
 
@@ -245,10 +245,10 @@ BOOL CKademlia::OnPacket_KADEMLIA2_BOOTSTRAP_RES(const SOCKADDR_IN* pHost, CEDPa
 	if ( ! pCache )
 		return FALSE;
 
-	pCache->m_oGUID = oGUID;
+	pCache->EditExtra().m_oGUID = oGUID;
 	pCache->m_nUDPPort = htons( pHost->sin_port );
 //	pCache->m_nKADVersion = nVersion;
-	pCache->m_sDescription = oGUID.toString();
+	pCache->EditExtra().m_sDescription = oGUID.toString();
 	pCache->m_tFailure = 0;
 	pCache->m_nFailures = 0;
 	pCache->m_bCheckedLocally = TRUE;
@@ -264,10 +264,10 @@ BOOL CKademlia::OnPacket_KADEMLIA2_BOOTSTRAP_RES(const SOCKADDR_IN* pHost, CEDPa
 		pCache = HostCache.Kademlia.Add( &pAddress, nTCPPort );
 		if ( pCache )
 		{
-			pCache->m_oGUID = oGUID;
+			pCache->EditExtra().m_oGUID = oGUID;
 			pCache->m_nUDPPort = nUDPPort;
 		//	pCache->m_nKADVersion = nVersion;
-			pCache->m_sDescription = oGUID.toString();
+			pCache->EditExtra().m_sDescription = oGUID.toString();
 		}
 	}
 
@@ -28,6 +28,7 @@
 #include "HashDatabase.h"
 #include "SharedFolder.h"
 #include "SharedFile.h"
+#include "ThumbCache.h"
 #include "AlbumFolder.h"
 #include "DlgExistingFile.h"
 #include "WndMain.h"
@@ -311,6 +312,7 @@ void CLibrary::Serialize(CArchive& ar)
 	LibraryFolders.Serialize( ar, nVersion );
 	LibraryHistory.Serialize( ar, nVersion );
 	LibraryMaps.Serialize2( ar, nVersion );
+	LibraryDictionary.SerializeWords( ar, nVersion );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -360,6 +362,39 @@ BOOL CLibrary::SafeReadTime(CFile& pFile, FILETIME* pFileTime) throw()
 	return FALSE;
 }
 
+BOOL CLibrary::LoadMapped(CFile& pFile)
+{
+	// Deserialize from read-only view of file (after FILETIME header),
+	// system read-ahead fills pages instead of many 256 KB ReadFile calls.
+	// In-page errors of damaged media are caught by SafeSerialize() as well.
+	const QWORD nLength = pFile.GetLength();
+	if ( nLength > sizeof( FILETIME ) && nLength < 0x7fffffff )
+	{
+		if ( HANDLE hMap = CreateFileMapping( pFile.m_hFile, NULL, PAGE_READONLY, 0, 0, NULL ) )
+		{
+			if ( LPBYTE pBuffer = (LPBYTE)MapViewOfFile( hMap, FILE_MAP_READ, 0, 0, 0 ) )
+			{
+				BOOL bResult;
+				{
+					CMemFile pMemFile( pBuffer + sizeof( FILETIME ), (UINT)( nLength - sizeof( FILETIME ) ) );
+					CArchive ar( &pMemFile, CArchive::load, 262144 );
+					bResult = SafeSerialize( ar );
+				}
+
+				VERIFY( UnmapViewOfFile( pBuffer ) );
+				VERIFY( CloseHandle( hMap ) );
+				pFile.Close();
+				return bResult;
+			}
+			VERIFY( CloseHandle( hMap ) );
+		}
+	}
+
+	// Fallback to buffered read
+	CArchive ar( &pFile, CArchive::load, 262144 );		// 256 KB buffer
+	return SafeSerialize( ar );
+}
+
 BOOL CLibrary::Load()
 {
 #ifdef _DEBUG
@@ -383,19 +418,16 @@ BOOL CLibrary::Load()
 		// .dat/.bak files are saved alternately for safe redundancy, so prefer latest one
 		CFile* pPreferred = ( ( CompareFileTime( &pFileDatTime, &pFileBakTime ) >= 0 ) ? &pFileDat : &pFileBak );
 
-		CArchive ar( pPreferred, CArchive::load, 262144 );		// 256 KB buffer
-		if ( ! SafeSerialize( ar ) )
+		if ( ! LoadMapped( *pPreferred ) )
 		{
 			pPreferred = pPreferred == &pFileDat ? &pFileBak : &pFileDat;
 
-			CArchive ar2( pPreferred, CArchive::load, 262144 );
-			SafeSerialize( ar2 );
+			LoadMapped( *pPreferred );
 		}
 	}
 	else if ( bFileDat || bFileBak )
 	{
-		CArchive ar( bFileDat ? &pFileDat : &pFileBak, CArchive::load, 262144 );
-		SafeSerialize( ar );
+		LoadMapped( bFileDat ? pFileDat : pFileBak );
 	}
 	else
 	{
@@ -514,6 +546,8 @@ void CLibrary::OnRun()
 		}
 
 		ThreadScan();
+
+		CThumbCache::OnRun();
 	}
 }
 
@@ -28,7 +28,7 @@ class CLibraryFolder;
 class CAlbumFolder;
 
 // Set at INTERNAL_VERSION on change:
-#define LIBRARY_SER_VERSION 1
+#define LIBRARY_SER_VERSION 4
 
 // nVersion History:
 // 27 - Changed CLibraryFile metadata saving order (ryo-oh-ki)
@@ -36,6 +36,7 @@ class CAlbumFolder;
 // 29 - Added CLibraryDictionary serialize (ryo-oh-ki)
 // 1000 - (29)
 // 1 - (Envy 1.0)
+// 4 - Added CLibraryDictionary word index
 
 class CLibrary :
 	public CComObject,
@@ -115,6 +116,7 @@ protected:
 	void			Serialize(CArchive& ar);
 	BOOL			SafeReadTime(CFile& pFile, FILETIME* pFileTime) throw();
 	BOOL			SafeSerialize(CArchive& ar) throw();
+	BOOL			LoadMapped(CFile& pFile);
 	BOOL			ThreadScan();
 
 // Automation
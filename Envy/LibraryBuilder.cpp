@@ -20,6 +20,7 @@
 #include "Settings.h"
 #include "Envy.h"
 #include "LibraryBuilder.h"
+#include "FileReader.h"
 #include "LibraryHistory.h"
 #include "Library.h"
 #include "SharedFile.h"
@@ -29,6 +30,7 @@
 #include "Downloads.h"
 #include "Transfers.h" // Locks
 #include "Security.h"
+#include "Statistics.h"
 #include "Schema.h"
 #include "SchemaCache.h"
 #include "XML.h"
@@ -83,6 +85,32 @@ void CFileHash::CopyTo(CLibraryFile* pFile) const
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// CLibraryExtractor construction
+
+CLibraryExtractor::CLibraryExtractor()
+	: m_tStarted	( 0 )
+	, m_bStalled	( false )
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryExtractor thread run (threaded)
+
+void CLibraryExtractor::OnRun()
+{
+	CString strPath;
+
+	while ( IsThreadEnabled() )
+	{
+		const DWORD nIndex = LibraryBuilder.GetNextFileToExtract( this, strPath );
+		if ( ! nIndex )
+			break;	// Queue drained, builder starts workers again on demand
+
+		LibraryBuilder.ExtractFile( this, nIndex, strPath );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilder construction
 
@@ -144,6 +172,11 @@ void CLibraryBuilder::Remove(DWORD nIndex)
 	CFileInfoList::iterator i = std::find( m_pFiles.begin(), m_pFiles.end(), nIndex );
 	if ( i != m_pFiles.end() )
 		m_pFiles.erase( i );
+
+	// Files already being extracted are opened with FILE_SHARE_DELETE, no need to wait
+	i = std::find( m_pExtract.begin(), m_pExtract.end(), nIndex );
+	if ( i != m_pExtract.end() )
+		m_pExtract.erase( i );
 }
 
 void CLibraryBuilder::Remove(const CLibraryFile* pFile)
@@ -223,6 +256,18 @@ float CLibraryBuilder::GetProgress() const
 	return m_nProgress;
 }
 
+size_t CLibraryBuilder::GetExtractRemaining() const
+{
+	CQuickLock oLock( m_pSection );
+	return m_pExtract.size();
+}
+
+CLibraryBuilder::CExtractStatsMap CLibraryBuilder::GetExtractStats() const
+{
+	CQuickLock oLock( m_pSection );
+	return m_pStats;
+}
+
 void CLibraryBuilder::RequestPriority(LPCTSTR pszPath)
 {
 	ASSERT( pszPath );
@@ -242,12 +287,23 @@ void CLibraryBuilder::RequestPriority(LPCTSTR pszPath)
 
 	if ( nIndex )
 	{
+		CFileInfo fi( nIndex );
+		fi.bPriority = true;
+
 		CQuickLock oLock( m_pSection );
 		CFileInfoList::iterator i = std::find( m_pFiles.begin(), m_pFiles.end(), nIndex );
 		if ( i != m_pFiles.end() )
 		{
 			m_pFiles.erase( i );
-			m_pFiles.push_front( nIndex );
+			m_pFiles.push_front( fi );
+		}
+
+		// Already hashed, waiting for metadata
+		i = std::find( m_pExtract.begin(), m_pExtract.end(), nIndex );
+		if ( i != m_pExtract.end() )
+		{
+			m_pExtract.erase( i );
+			m_pExtract.push_front( fi );
 		}
 	}
 }
@@ -292,8 +348,9 @@ DWORD CLibraryBuilder::GetNextFileToHash()
 
 		if ( m_pFiles.empty() )
 		{
-			// No files left
-			Exit();
+			// No files left, stay on as watchdog while metadata workers are busy
+			if ( m_pExtract.empty() && ! IsExtracting() )
+				Exit();
 		}
 		else
 		{
@@ -395,10 +452,22 @@ DWORD CLibraryBuilder::GetNextFileToHash()
 
 void CLibraryBuilder::StopThread()
 {
+	for ( int i = 0; i < _countof( m_pExtractors ); i++ )
+		m_pExtractors[ i ].Exit();
+
 	Exit();
 	Wakeup();
 }
 
+void CLibraryBuilder::CloseThread()
+{
+	// Builder first, it restarts workers
+	CThreadImpl::CloseThread();
+
+	for ( int i = 0; i < _countof( m_pExtractors ); i++ )
+		m_pExtractors[ i ].CloseThread();
+}
+
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilder priority control
 
@@ -412,6 +481,12 @@ void CLibraryBuilder::BoostPriority(bool bPriority)
 	m_bPriority = bPriority;
 
 	SetThreadPriority( m_bPriority ? THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_IDLE );
+
+	for ( int i = 0; i < _countof( m_pExtractors ); i++ )
+	{
+		if ( m_pExtractors[ i ].IsThreadAlive() )
+			m_pExtractors[ i ].SetThreadPriority( m_bPriority ? THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_IDLE );
+	}
 }
 
 bool CLibraryBuilder::GetBoostPriority() const
@@ -442,6 +517,8 @@ void CLibraryBuilder::OnRun()
 			continue;
 		}
 
+		CheckExtractors();
+
 		const DWORD nIndex = GetNextFileToHash();	// Sets m_sPath
 		if ( ! nIndex || m_sPath.GetLength() < 8 )
 			continue;
@@ -458,26 +535,10 @@ void CLibraryBuilder::OnRun()
 			if ( HashFile( m_sPath, hFile ) )
 			{
 				nAttempts = 0;
-				SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
-
-				ExtractProperties( nIndex, m_sPath );
-
-				try
-				{
-					ExtractMetadata( nIndex, m_sPath, hFile );
-				}
-				catch ( CException* pException )
-				{
-					pException->Delete();
-				}
-
-				ExtractPluginMetadata( nIndex, m_sPath );
 
-				CThumbCache::Delete( m_sPath );
-				CThumbCache::Cache( m_sPath );
-
-				// Done
-				Remove( nIndex );
+				// Done, metadata workers take it from here
+				QueueExtract( nIndex );
+				CheckExtractors();
 			}
 			else if ( ++nAttempts > 4 || IsSkipped() )
 			{
@@ -518,6 +579,175 @@ void CLibraryBuilder::OnRun()
 	}
 }
 
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilder metadata extraction queue
+
+void CLibraryBuilder::QueueExtract(DWORD nIndex)
+{
+	CQuickLock oLock( m_pSection );
+
+	CFileInfo fi( nIndex );
+
+	CFileInfoList::iterator i = std::find( m_pFiles.begin(), m_pFiles.end(), nIndex );
+	if ( i != m_pFiles.end() )
+	{
+		fi.bPriority = (*i).bPriority;
+		m_pFiles.erase( i );
+	}
+
+	if ( std::find( m_pExtract.begin(), m_pExtract.end(), nIndex ) != m_pExtract.end() )
+		return;
+
+	if ( fi.bPriority )
+		m_pExtract.push_front( fi );
+	else
+		m_pExtract.push_back( fi );
+}
+
+bool CLibraryBuilder::IsExtracting() const
+{
+	CQuickLock oLock( m_pSection );
+
+	for ( int i = 0; i < _countof( m_pExtractors ); i++ )
+	{
+		if ( ! m_pExtractors[ i ].m_sPath.IsEmpty() && ! m_pExtractors[ i ].m_bStalled )
+			return true;
+	}
+
+	return false;
+}
+
+void CLibraryBuilder::CheckExtractors()
+{
+	const DWORD tNow = GetTickCount();
+	const DWORD nTimeout = Settings.Library.ExtractTimeout * 1000;
+
+	CQuickLock oLock( m_pSection );
+
+	size_t nActive = 0;
+	for ( int i = 0; i < _countof( m_pExtractors ); i++ )
+	{
+		CLibraryExtractor& oExtractor = m_pExtractors[ i ];
+
+		// Internal extractors give up on their own, plugins can't be interrupted:
+		// leave the worker running and let a spare slot carry on with the queue
+		if ( ! oExtractor.m_sPath.IsEmpty() && ! oExtractor.m_bStalled && tNow - oExtractor.m_tStarted > nTimeout )
+		{
+			oExtractor.m_bStalled = true;
+			theApp.Message( MSG_DEBUG, L"Metadata extraction timed out: %s", (LPCTSTR)oExtractor.m_sPath );
+		}
+
+		if ( oExtractor.IsThreadAlive() && ! oExtractor.m_bStalled )
+			nActive++;
+	}
+
+	const size_t nWanted = min( (size_t)Settings.Library.ExtractThreads, nActive + m_pExtract.size() );
+	for ( int i = 0; i < _countof( m_pExtractors ) && nActive < nWanted; i++ )
+	{
+		if ( ! m_pExtractors[ i ].IsThreadAlive() &&
+			 m_pExtractors[ i ].BeginThread( "LibraryExtractor", m_bPriority ?
+				THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_IDLE ) )
+			nActive++;
+	}
+}
+
+DWORD CLibraryBuilder::GetNextFileToExtract(CLibraryExtractor* pExtractor, CString& strPath)
+{
+	for ( ;; )
+	{
+		DWORD nIndex;
+
+		{
+			CQuickLock oLock( m_pSection );
+
+			if ( m_pExtract.empty() )
+				return 0;
+
+			nIndex = m_pExtract.front().nIndex;
+			m_pExtract.pop_front();
+		}
+
+		CSingleLock oLibraryLock( &Library.m_pSection );
+		while ( ! oLibraryLock.Lock( 100 ) )
+		{
+			if ( ! pExtractor->IsThreadEnabled() )
+				return 0;
+		}
+
+		const CLibraryFile* pFile = LibraryMaps.LookupFile( nIndex );
+		if ( ! pFile )
+			continue;	// Removed meanwhile
+
+		strPath = pFile->GetPath();
+
+		oLibraryLock.Unlock();
+
+		CQuickLock oLock( m_pSection );
+		pExtractor->m_sPath = strPath;
+		pExtractor->m_tStarted = GetTickCount();
+		pExtractor->m_bStalled = false;
+
+		return nIndex;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilder metadata extraction (threaded)
+
+void CLibraryBuilder::ExtractFile(CLibraryExtractor* pExtractor, DWORD nIndex, const CString& strPath)
+{
+	theApp.Message( MSG_DEBUG, L"Extracting: %s", (LPCTSTR)strPath );
+
+	const DWORD nTimeout = Settings.Library.ExtractTimeout * 1000;
+	const DWORD tStart = GetTickCount();
+
+	ExtractProperties( nIndex, strPath );
+
+	HANDLE hFile = CreateFile( SafePath( strPath ), GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	VERIFY_FILE_ACCESS( hFile, strPath )
+	if ( hFile != INVALID_HANDLE_VALUE )
+	{
+		try
+		{
+			ExtractMetadata( nIndex, strPath, hFile, nTimeout );
+		}
+		catch ( CException* pException )
+		{
+			pException->Delete();
+		}
+
+		CloseHandle( hFile );
+	}
+
+	if ( pExtractor->IsThreadEnabled() )
+		ExtractPluginMetadata( nIndex, strPath );
+
+	if ( pExtractor->IsThreadEnabled() )
+	{
+		CThumbCache::Delete( strPath );
+		CThumbCache::Cache( strPath );
+	}
+
+	const DWORD nElapsed = GetTickCount() - tStart;
+	Statistics.Sample( statExtractTime, nElapsed );
+
+	CString strType = PathFindExtension( strPath );
+	strType.MakeLower();
+
+	CQuickLock oLock( m_pSection );
+
+	CExtractStats& oStats = m_pStats[ strType ];
+	oStats.nFiles++;
+	oStats.nElapsed += nElapsed;
+	if ( nElapsed > nTimeout )
+		oStats.nTimeouts++;
+
+	pExtractor->m_sPath.Empty();
+	pExtractor->m_bStalled = false;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilder file hashing (threaded)
 
@@ -558,6 +788,9 @@ bool CLibraryBuilder::HashFile(LPCTSTR szPath, HANDLE hFile)
 	if ( ! m_bPriority && ! theApp.m_bIsWinXP )
 		::SetThreadPriority( GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN );
 
+	const __int64 tStart = GetMicroCount();
+	DWORD tChecked = GetTickCount();
+
 	DWORD nBlock;
 	QWORD nLength = nFileSize;
 	while ( nLength )
@@ -571,6 +804,13 @@ bool CLibraryBuilder::HashFile(LPCTSTR szPath, HANDLE hFile)
 			m_nProgress = ( ( nFileSize - nLength ) * 100.00f ) / nFileSize;
 		}
 
+		// Large files take minutes, keep replacing stalled metadata workers meanwhile
+		if ( GetTickCount() - tChecked >= 1000 )
+		{
+			tChecked = GetTickCount();
+			CheckExtractors();
+		}
+
 		if ( ! IsThreadEnabled() || IsSkipped() )
 			break;
 
@@ -631,6 +871,9 @@ bool CLibraryBuilder::HashFile(LPCTSTR szPath, HANDLE hFile)
 	if ( nLength )
 		return false;
 
+	if ( const __int64 nElapsed = GetMicroCount() - tStart )
+		Statistics.Sample( statHashRate, (DWORD)( ( nFileSize * 1000000ull ) / ( (QWORD)nElapsed * 1024 ) ) );	// KB/s
+
 	pFileHash->Finish();
 
 	// Get associated download, if any
@@ -752,12 +995,14 @@ bool CLibraryBuilder::SubmitCorrupted(DWORD nIndex)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilder virtual file detection (threaded)
 
-bool CLibraryBuilder::DetectVirtualFile(LPCTSTR szPath, HANDLE hFile, QWORD& nOffset, QWORD& nLength)
+bool CLibraryBuilder::DetectVirtualFile(LPCTSTR szPath, HANDLE hSource, QWORD& nOffset, QWORD& nLength)
 {
 	bool bVirtual = false;
 
 	if ( _tcsistr( szPath, L".mp3" ) != NULL )
 	{
+		CFileReader hFile( hSource, 4096 );		// Tag padding is skipped byte by byte
+
 		bVirtual |= DetectVirtualID3v2( hFile, nOffset, nLength );
 		bVirtual |= DetectVirtualID3v1( hFile, nOffset, nLength );
 	//	bVirtual |= DetectVirtualLyrics( hFile, nOffset, nLength );
@@ -769,7 +1014,7 @@ bool CLibraryBuilder::DetectVirtualFile(LPCTSTR szPath, HANDLE hFile, QWORD& nOf
 	return bVirtual;
 }
 
-bool CLibraryBuilder::DetectVirtualID3v1(HANDLE hFile, QWORD& nOffset, QWORD& nLength)
+bool CLibraryBuilder::DetectVirtualID3v1(CFileReader& hFile, QWORD& nOffset, QWORD& nLength)
 {
 	if ( nLength <= 128 )
 		return false;
@@ -793,7 +1038,7 @@ bool CLibraryBuilder::DetectVirtualID3v1(HANDLE hFile, QWORD& nOffset, QWORD& nL
 	return true;
 }
 
-bool CLibraryBuilder::DetectVirtualID3v2(HANDLE hFile, QWORD& nOffset, QWORD& nLength)
+bool CLibraryBuilder::DetectVirtualID3v2(CFileReader& hFile, QWORD& nOffset, QWORD& nLength)
 {
 	ID3V2_HEADER pHeader = { 0 };
 	DWORD nRead;
@@ -44,6 +44,22 @@ protected:
 };
 
 
+// Metadata extraction worker, takes hashed files from the builder queue
+class CLibraryExtractor : public CThreadImpl
+{
+public:
+	CLibraryExtractor();
+
+public:
+	CString		m_sPath;					// Extracting filename, empty if idle (guarded by builder)
+	DWORD		m_tStarted;					// Extraction start (ticks)
+	bool		m_bStalled;					// Ran past the timeout, replaced in the pool
+
+protected:
+	virtual void OnRun();
+};
+
+
 class CLibraryBuilder :
 	public CLibraryBuilderInternals
 ,	public CLibraryBuilderPlugins
@@ -63,18 +79,31 @@ public:
 	void		RequestPriority(LPCTSTR pszPath);	// Place file to the begin of list
 	void		Skip(DWORD nIndex);					// Move file to the end of list
 	void		StopThread();
+	void		CloseThread();						// Builder and extraction workers
 	void		BoostPriority(bool bPriority);
 	bool		GetBoostPriority() const;
 
 	CString		GetCurrent() const;					// Hashing filename
 	size_t		GetRemaining() const;				// Hashing queue size
 	float		GetProgress() const;				// Hashing file progress (0..100%)
+	size_t		GetExtractRemaining() const;		// Metadata queue size
 
 	int			SubmitMetadata(DWORD nIndex, LPCTSTR pszSchemaURI, CXMLElement* pXML);
 	bool		SubmitCorrupted(DWORD nIndex);
 
 	bool		RefreshMetadata(const CString& sPath);
 
+	struct CExtractStats
+	{
+		CExtractStats() : nFiles( 0 ), nTimeouts( 0 ), nElapsed( 0 ) {}
+		DWORD		nFiles;						// Files extracted
+		DWORD		nTimeouts;					// Files past the extraction timeout
+		QWORD		nElapsed;					// Total extraction time (ms)
+	};
+	typedef std::map< CString, CExtractStats > CExtractStatsMap;	// By lower case extension
+
+	CExtractStatsMap GetExtractStats() const;		// Metadata throughput per file type
+
 
 private:
 	class CFileInfo
@@ -83,11 +112,13 @@ private:
 		CFileInfo(DWORD index = 0ul) :
 			nIndex			( index )
 		,	nNextAccessTime	( 0ull )
+		,	bPriority		( false )
 		{
 		}
 		CFileInfo(const CFileInfo& oFileInfo) :
 			nIndex			( oFileInfo.nIndex )
 		,	nNextAccessTime	( oFileInfo.nNextAccessTime )
+		,	bPriority		( oFileInfo.bPriority )
 		{
 		}
 		bool operator==(const CFileInfo& oFileInfo) const
@@ -96,6 +127,7 @@ private:
 		}
 		DWORD		nIndex;						// Library file index
 		QWORD		nNextAccessTime;			// Next access time
+		bool		bPriority;					// Requested by user, extract first too
 	};
 	typedef std::list< CFileInfo > CFileInfoList;
 
@@ -109,20 +141,30 @@ private:
 	QWORD			m_nReaded;					// (bytes)
 	__int64			m_nElapsed;					// (mks)
 	CEvent			m_oSkip;					// Request to skip hashing file
+	CFileInfoList	m_pExtract;					// Hashed files waiting for metadata
+	CLibraryExtractor m_pExtractors[ 8 ];		// Worker pool, spare slots replace stalled workers
+	CExtractStatsMap m_pStats;					// Metadata throughput per file type
 
 	// Get next file from list doing all possible tests
 	// Returns 0 if no file available, sets m_sPath to current file and sets thread cancel event if no files left.
 	DWORD		GetNextFileToHash();			// Sets m_sPath
 	void		OnRun();
+	void		QueueExtract(DWORD nIndex);		// Move hashed file to the metadata queue
+	void		CheckExtractors();				// Start workers, replace stalled ones (builder thread, also while hashing)
+	bool		IsExtracting() const;			// Any worker busy and not stalled
+	DWORD		GetNextFileToExtract(CLibraryExtractor* pExtractor, CString& strPath);
+	void		ExtractFile(CLibraryExtractor* pExtractor, DWORD nIndex, const CString& strPath);
 	bool		HashFile(LPCTSTR szPath, HANDLE hFile);
-	bool		DetectVirtualFile(LPCTSTR szPath, HANDLE hFile, QWORD& nOffset, QWORD& nLength);
-	bool		DetectVirtualID3v1(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
-	bool		DetectVirtualID3v2(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
+	bool		DetectVirtualFile(LPCTSTR szPath, HANDLE hSource, QWORD& nOffset, QWORD& nLength);
+	bool		DetectVirtualID3v1(CFileReader& hFile, QWORD& nOffset, QWORD& nLength);
+	bool		DetectVirtualID3v2(CFileReader& hFile, QWORD& nOffset, QWORD& nLength);
 //	bool		DetectVirtualLAME(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
 //	bool		DetectVirtualAPEHeader(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
 //	bool		DetectVirtualAPEFooter(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
 //	bool		DetectVirtualLyrics(HANDLE hFile, QWORD& nOffset, QWORD& nLength);
 
+	friend class CLibraryExtractor;
+
 	inline bool	IsSkipped() { return WaitForSingleObject( m_oSkip, 0 ) != WAIT_TIMEOUT; }
 
 	inline int	GetVbrHeaderOffset(int nId, int nMode)
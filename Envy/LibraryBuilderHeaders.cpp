@@ -0,0 +1,349 @@
+//
+// LibraryBuilderHeaders.cpp
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+
+#include "StdAfx.h"
+#include "LibraryBuilderHeaders.h"
+#include "FileReader.h"
+#include "Buffer.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#define new DEBUG_NEW
+#endif	// Debug
+
+CImageHeader::CImageHeader()
+	: m_nWidth		( 0 )
+	, m_nHeight		( 0 )
+	, m_nBits		( 0 )
+	, m_nComponents	( 0 )
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilderHeaders JPEG
+
+bool CLibraryBuilderHeaders::ReadJPEG(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted)
+{
+	DWORD nRead	= 0;
+	WORD wMagic	= 0;
+
+	bCorrupted = false;
+
+	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+		return false;
+	if ( ! ReadFile( hFile, &wMagic, 2, &nRead, NULL ) )
+		return false;
+	if ( nRead != 2 || wMagic != 0xD8FF )
+	{
+		bCorrupted = true;
+		return false;
+	}
+
+	BYTE nByte	= 0, nBits = 0, nComponents = 0;
+	WORD nWidth = 0, nHeight = 0;
+	CString strComment;
+
+	for ( DWORD nSeek = 512; nSeek > 0; nSeek-- )
+	{
+		if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 )
+			return false;
+		if ( nByte != 0xFF )
+			continue;
+
+		while ( nByte == 0xFF )
+		{
+			if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 )
+				return false;
+		}
+
+		if ( ! ReadFile( hFile, &wMagic, 2, &nRead, NULL ) )
+			return false;
+		wMagic = swapEndianess( wMagic );
+		if ( nRead != 2 || wMagic < 2 )
+			return false;
+
+		switch ( nByte )
+		{
+		case 0xC0: case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+		case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+			if ( ! ReadFile( hFile, &nBits, 1, &nRead, NULL ) || nRead != 1 )
+				return false;
+			if ( ! ReadFile( hFile, &nHeight, 2, &nRead, NULL ) || nRead != 2 )
+				return false;
+			nHeight = swapEndianess( nHeight );
+			if ( ! ReadFile( hFile, &nWidth, 2, &nRead, NULL ) || nRead != 2 )
+				return false;
+			nWidth = swapEndianess( nWidth );
+			if ( ! ReadFile( hFile, &nComponents, 1, &nRead, NULL ) || nRead != 1 )
+				return false;
+			if ( wMagic < 8 )
+				return false;
+			SetFilePointer( hFile, wMagic - 8, NULL, FILE_CURRENT );
+			break;
+		case 0xFE: case 0xEC:
+			if ( wMagic > 2 )
+			{
+				CBuffer pComment;
+				pComment.EnsureBuffer( wMagic - 2 );
+				pComment.m_nLength = (DWORD)wMagic - 2;
+				ReadFile( hFile, pComment.m_pBuffer, wMagic - 2, &nRead, NULL );
+				strComment = pComment.ReadString( nRead );
+			}
+			break;
+		case 0xD9: case 0xDA:
+			nSeek = 1;
+			break;
+		default:
+			SetFilePointer( hFile, wMagic - 2, NULL, FILE_CURRENT );
+			break;
+		}
+	}
+
+	if ( nWidth == 0 || nHeight == 0 )
+		return false;
+
+	strComment.Trim();
+
+	for ( int nChar = 0; nChar < strComment.GetLength(); nChar++ )
+	{
+		if ( strComment[ nChar ] < 32 )
+			strComment.SetAt( nChar, '?' );
+	}
+
+	oHeader.m_nWidth		= nWidth;
+	oHeader.m_nHeight		= nHeight;
+	oHeader.m_nBits			= nBits;
+	oHeader.m_nComponents	= nComponents;
+	oHeader.m_sComment		= strComment;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilderHeaders GIF
+
+bool CLibraryBuilderHeaders::ReadGIF(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted)
+{
+	CHAR szMagic[6];
+	DWORD nRead;
+
+	bCorrupted = false;
+
+	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+		return false;
+	if ( ! ReadFile( hFile, szMagic, 6, &nRead, NULL ) )
+		return false;
+
+	if ( nRead != 6 || ( strncmp( szMagic, "GIF87a", 6 ) && strncmp( szMagic, "GIF89a", 6 ) ) )
+	{
+		bCorrupted = true;
+		return false;
+	}
+
+	WORD nWidth, nHeight;
+
+	if ( ! ReadFile( hFile, &nWidth, 2, &nRead, NULL ) || nRead != 2 || nWidth == 0 )
+		return false;
+	if ( ! ReadFile( hFile, &nHeight, 2, &nRead, NULL ) || nRead != 2 || nHeight == 0 )
+		return false;
+
+	oHeader.m_nWidth	= nWidth;
+	oHeader.m_nHeight	= nHeight;
+	oHeader.m_nBits		= 8;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilderHeaders PNG
+
+bool CLibraryBuilderHeaders::ReadPNG(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted)
+{
+	BYTE  nMagic[8];
+	DWORD nRead;
+
+	bCorrupted = ( GetFileSize( hFile, NULL ) < 33 );
+	if ( bCorrupted )
+		return false;
+	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+		return false;
+	if ( ! ReadFile( hFile, nMagic, 8, &nRead, NULL ) )
+		return false;
+	if ( nRead != 8 )
+		return false;
+	if ( nMagic[0] != 137 || nMagic[1] != 80 || nMagic[2] != 78 )
+		return false;
+	if ( nMagic[3] != 71 || nMagic[4] != 13 || nMagic[5] != 10 )
+		return false;
+	if ( nMagic[6] != 26 || nMagic[7] != 10 )
+		return false;
+
+	DWORD nLength, nIHDR;
+
+	if ( ! ReadFile( hFile, &nLength, 4, &nRead, NULL ) )
+		return false;
+	nLength = swapEndianess( nLength );
+	if ( nRead != 4 || nLength < 10 )
+		return false;
+	if ( ! ReadFile( hFile, &nIHDR, 4, &nRead, NULL ) )
+		return false;
+	if ( nRead != 4 || nIHDR != 'RDHI' )
+		return false;
+
+	DWORD nWidth, nHeight;
+	BYTE  nBits, nColors;
+
+	if ( ! ReadFile( hFile, &nWidth, 4, &nRead, NULL ) )
+		return false;
+	nWidth = swapEndianess( nWidth );
+	if ( nRead != 4 || nWidth <= 0 || nWidth > 0xFFFF )
+		return false;
+	if ( ! ReadFile( hFile, &nHeight, 4, &nRead, NULL ) )
+		return false;
+	nHeight = swapEndianess( nHeight );
+	if ( nRead != 4 || nHeight <= 0 || nHeight > 0xFFFF )
+		return false;
+
+	if ( ! ReadFile( hFile, &nBits, 1, &nRead, NULL ) || nRead != 1 )
+		return false;
+	if ( ! ReadFile( hFile, &nColors, 1, &nRead, NULL ) || nRead != 1 )
+		return false;
+
+	oHeader.m_nWidth	= nWidth;
+	oHeader.m_nHeight	= nHeight;
+	oHeader.m_nBits		= nBits;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilderHeaders BMP
+
+bool CLibraryBuilderHeaders::ReadBMP(CFileReader& hFile, CImageHeader& oHeader)
+{
+	BITMAPFILEHEADER pBFH;
+	BITMAPINFOHEADER pBIH;
+	DWORD nRead;
+
+	if ( GetFileSize( hFile, NULL ) < sizeof( pBFH ) + sizeof( pBIH ) )
+		return false;
+
+	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
+	ReadFile( hFile, &pBFH, sizeof( pBFH ), &nRead, NULL );
+	if ( nRead != sizeof( pBFH ) || pBFH.bfType != 'MB' )
+		return false;
+
+	ReadFile( hFile, &pBIH, sizeof( pBIH ), &nRead, NULL );
+	if ( nRead != sizeof( pBIH ) || pBIH.biSize != sizeof( pBIH ) )
+		return false;
+
+	oHeader.m_nWidth	= (DWORD)pBIH.biWidth;
+	oHeader.m_nHeight	= (DWORD)pBIH.biHeight;
+	oHeader.m_nBits		= pBIH.biBitCount;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryBuilderHeaders ID3
+
+bool CLibraryBuilderHeaders::ReadID3v1(CFileReader& hFile, ID3V1& pInfo)
+{
+	if ( GetFileSize( hFile, NULL ) < 128 )
+		return false;
+
+	DWORD nRead;
+
+	if ( SetFilePointer( hFile, -128, NULL, FILE_END ) == INVALID_SET_FILE_POINTER )
+		return false;
+	if ( ! ReadFile( hFile, &pInfo, sizeof( pInfo ), &nRead, NULL ) )
+		return false;
+	if ( nRead != sizeof( pInfo ) )
+		return false;
+
+	return strncmp( pInfo.szTag, ID3V1_TAG, 3 ) == 0;
+}
+
+bool CLibraryBuilderHeaders::ReadID3v2(CFileReader& hFile, ID3V2_HEADER& pHeader, CBuffer& pFrames)
+{
+	DWORD nRead;
+
+	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+		return false;
+	if ( ! ReadFile( hFile, &pHeader, sizeof( pHeader ), &nRead, NULL ) )
+		return false;
+	if ( nRead != sizeof( pHeader ) )
+		return false;
+
+	if ( strncmp( pHeader.szTag, ID3V2_TAG, 3 ) != 0 )
+		return false;
+	if ( pHeader.nMajorVersion < 2 || pHeader.nMajorVersion > 4 )
+		return false;
+	if ( pHeader.nFlags & ~ID3V2_KNOWNMASK )
+		return false;
+	if ( pHeader.nFlags & ID3V2_UNSYNCHRONISED )
+		return false;
+
+	DWORD nBuffer = swapEndianess( pHeader.nSize );
+	ID3_DESYNC_SIZE( nBuffer );
+
+	if ( nBuffer > 1024 * 1024 * 2 )
+		return false;
+
+	pFrames.Clear();
+	if ( ! pFrames.EnsureBuffer( nBuffer ) )
+		return false;
+
+	if ( ! ReadFile( hFile, pFrames.m_pBuffer, nBuffer, &nRead, NULL ) )
+		return false;
+	if ( nRead != nBuffer )
+		return false;
+	pFrames.m_nLength = nBuffer;
+
+	if ( ( pHeader.nFlags & ID3V2_EXTENDEDHEADER ) && pHeader.nMajorVersion == 3 )
+	{
+		if ( nBuffer < sizeof( ID3V2_EXTENDED_HEADER_1 ) )
+			return false;
+
+		ID3V2_EXTENDED_HEADER_1* pExtended = (ID3V2_EXTENDED_HEADER_1*)pFrames.m_pBuffer;
+		const DWORD nSize = swapEndianess( pExtended->nSize );
+
+		if ( nBuffer - sizeof( ID3V2_EXTENDED_HEADER_1 ) < nSize )
+			return false;
+
+		pFrames.Remove( sizeof( ID3V2_EXTENDED_HEADER_1 ) + nSize );
+	}
+	else if ( ( pHeader.nFlags & ID3V2_EXTENDEDHEADER ) && pHeader.nMajorVersion == 4 )
+	{
+		if ( nBuffer < sizeof( ID3V2_EXTENDED_HEADER_2 ) )
+			return false;
+
+		ID3V2_EXTENDED_HEADER_2* pExtended = (ID3V2_EXTENDED_HEADER_2*)pFrames.m_pBuffer;
+		DWORD nSize = swapEndianess( pExtended->nSize );
+		ID3_DESYNC_SIZE( nSize );
+		nSize -= 6;
+
+		if ( nBuffer - sizeof( ID3V2_EXTENDED_HEADER_2 ) < nSize )
+			return false;
+
+		pFrames.Remove( sizeof( ID3V2_EXTENDED_HEADER_2 ) + nSize );
+	}
+
+	return true;
+}
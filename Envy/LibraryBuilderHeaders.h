@@ -0,0 +1,54 @@
+//
+// LibraryBuilderHeaders.h
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+
+// File header parsing for the built-in extractors, through CFileReader only.
+// No XML, schema or library state, so the Benchmark tool runs the same code.
+
+#pragma once
+
+#include "ID3.h"
+
+class CBuffer;
+class CFileReader;
+
+
+class CImageHeader
+{
+public:
+	CImageHeader();
+
+	DWORD		m_nWidth;
+	DWORD		m_nHeight;
+	DWORD		m_nBits;			// PNG bit depth, BMP bits per pixel
+	BYTE		m_nComponents;		// JPEG color components
+	CString		m_sComment;			// JPEG comment, control characters replaced
+};
+
+
+class CLibraryBuilderHeaders
+{
+public:
+	// bCorrupted is set when the signature does not match the file type
+	static bool	ReadJPEG(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted);
+	static bool	ReadGIF(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted);
+	static bool	ReadPNG(CFileReader& hFile, CImageHeader& oHeader, bool& bCorrupted);
+	static bool	ReadBMP(CFileReader& hFile, CImageHeader& oHeader);
+
+	static bool	ReadID3v1(CFileReader& hFile, ID3V1& pInfo);
+	static bool	ReadID3v2(CFileReader& hFile, ID3V2_HEADER& pHeader, CBuffer& pFrames);	// pFrames gets the frames after any extended header
+};
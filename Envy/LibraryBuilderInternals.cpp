@@ -28,12 +28,14 @@
 #include "LibraryMaps.h"
 #include "LibraryFolders.h"
 #include "SharedFile.h"
+#include "FileReader.h"
 
 #define _ID3_DEFINE_GENRES
 #include "Buffer.h"
 #include "Schema.h"
 #include "XML.h"
 #include "ID3.h"
+#include "LibraryBuilderHeaders.h"
 #include "BTInfo.h"
 #include "CollectionFile.h"
 
@@ -48,6 +50,17 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+// Switch tables are filled on first use by whichever metadata worker gets there first,
+// then only read through SwitchLookup() so concurrent extractors never insert
+static CCriticalSection SwitchSection;
+static std::map< const CString, char > FileTypes, ID3v2Tags, APEKeys;
+
+static inline char SwitchLookup(const std::map< const CString, char >& pMap, const CString& strKey)
+{
+	std::map< const CString, char >::const_iterator i = pMap.find( strKey );
+	return ( i != pMap.end() ) ? (*i).second : 0;
+}
+
 #define ReadDwordOrBreak(hFile, nID, nRead) \
 	if ( ! ReadFile( hFile, &nID, 4, &nRead, NULL ) || nRead != 4 ) break;
 
@@ -210,7 +223,7 @@ bool PropGetValue(IPropertyStore* pStore, const PROPERTYKEY& key, CString& val)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals extract metadata (threaded)
 
-bool CLibraryBuilderInternals::ExtractMetadata(DWORD nIndex, const CString& strPath, HANDLE hFile)
+bool CLibraryBuilderInternals::ExtractMetadata(DWORD nIndex, const CString& strPath, HANDLE hSource, DWORD nTimeout)
 {
 	CString strType = PathFindExtension( strPath );
 	strType.MakeLower();
@@ -218,7 +231,9 @@ bool CLibraryBuilderInternals::ExtractMetadata(DWORD nIndex, const CString& strP
 		return false;	// Skip missing/1-letter extension
 
 	// Native file extensions:
-	SwitchMap( FileType )
+	std::map< const CString, char >& FileType = FileTypes;
+	CSingleLock oSwitchLock( &SwitchSection, TRUE );
+	if ( FileType.empty() )
 	{
 		FileType[ L".mp3" ]  = '3';
 		FileType[ L".aac" ]  = '3';
@@ -271,8 +286,14 @@ bool CLibraryBuilderInternals::ExtractMetadata(DWORD nIndex, const CString& strP
 		// Others by plugins: zip/rar/mkv/etc.
 		// ToDo: Generic Fallback "Uknown Type"
 	}
+	oSwitchLock.Unlock();
 
-	switch ( FileType[ strType ] )
+	// Extractors issue many small reads and seeks, serve them from a read-ahead window
+	CFileReader hFile( hSource );
+	if ( nTimeout )
+		hFile.SetDeadline( GetTickCount() + nTimeout );
+
+	switch ( SwitchLookup( FileType, strType ) )
 	{
 	case '3':	// .mp3/.aac/.flac + .mpc/.mpp/.mp+ (musepack)
 		if ( ! Settings.Library.ScanMP3 )			return false;
@@ -552,21 +573,10 @@ bool CLibraryBuilderInternals::ExtractProperties(DWORD nIndex, const CString& st
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals ID3v1 (threaded)
 
-bool CLibraryBuilderInternals::ReadID3v1(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadID3v1(DWORD nIndex, CFileReader& hFile)
 {
-	if ( GetFileSize( hFile, NULL ) < 128 )
-		return false;
-
 	ID3V1 pInfo;
-	DWORD nRead;
-
-	if ( SetFilePointer( hFile, -128, NULL, FILE_END ) == INVALID_SET_FILE_POINTER )
-		return false;
-	if ( ! ReadFile( hFile, &pInfo, sizeof( pInfo ), &nRead, NULL ) )
-		return false;
-	if ( nRead != sizeof( pInfo ) )
-		return false;
-	if ( strncmp( pInfo.szTag, ID3V1_TAG, 3 ) != 0 )
+	if ( ! CLibraryBuilderHeaders::ReadID3v1( hFile, pInfo ) )
 		return false;
 
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"audio" ) );
@@ -630,82 +640,23 @@ int CLibraryBuilderInternals::LookupID3v1Genre(const CString& strGenre) const
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals ID3v2 (threaded)
 
-bool CLibraryBuilderInternals::ReadID3v2(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadID3v2(DWORD nIndex, CFileReader& hFile)
 {
 	ID3V2_HEADER pHeader;
-	DWORD nRead;
+	CBuffer pFrames;
 
-	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-		return false;
-	if ( ! ReadFile( hFile, &pHeader, sizeof( pHeader ), &nRead, NULL ) )
-		return false;
-	if ( nRead != sizeof( pHeader ) )
+	if ( ! CLibraryBuilderHeaders::ReadID3v2( hFile, pHeader, pFrames ) )
 		return false;
 
-	if ( strncmp( pHeader.szTag, ID3V2_TAG, 3 ) != 0 )
-		return false;
-	if ( pHeader.nMajorVersion < 2 || pHeader.nMajorVersion > 4 )
-		return false;
-	if ( pHeader.nFlags & ~ID3V2_KNOWNMASK )
-		return false;
-	if ( pHeader.nFlags & ID3V2_UNSYNCHRONISED )
-		return false;
-
-	DWORD nBuffer = swapEndianess( pHeader.nSize );
-	ID3_DESYNC_SIZE( nBuffer );
-
-	if ( nBuffer > 1024 * 1024 * 2 )
-		return false;
-
-	auto_array< BYTE > pRelease( new BYTE[ nBuffer ] );
-	BYTE* pBuffer = pRelease.get();
-
-	if ( ! ReadFile( hFile, pBuffer, nBuffer, &nRead, NULL ) )
-		return false;
-	if ( nRead != nBuffer )
-		return false;
-
-	if ( ( pHeader.nFlags & ID3V2_EXTENDEDHEADER ) && pHeader.nMajorVersion == 3 )
-	{
-		if ( nBuffer < sizeof( ID3V2_EXTENDED_HEADER_1 ) )
-			return false;
-
-		ID3V2_EXTENDED_HEADER_1* pExtended = (ID3V2_EXTENDED_HEADER_1*)pBuffer;
-		pBuffer += sizeof( ID3V2_EXTENDED_HEADER_1 );
-		nBuffer -= sizeof( ID3V2_EXTENDED_HEADER_1 );
-
-		pExtended->nSize = swapEndianess( pExtended->nSize );
-
-		if ( nBuffer < pExtended->nSize )
-			return false;
-
-		pBuffer += pExtended->nSize;
-		nBuffer -= pExtended->nSize;
-	}
-	else if ( ( pHeader.nFlags & ID3V2_EXTENDEDHEADER ) && pHeader.nMajorVersion == 4 )
-	{
-		if ( nBuffer < sizeof( ID3V2_EXTENDED_HEADER_2 ) )
-			return false;
-
-		ID3V2_EXTENDED_HEADER_2* pExtended = (ID3V2_EXTENDED_HEADER_2*)pBuffer;
-		pBuffer += sizeof( ID3V2_EXTENDED_HEADER_2 );
-		nBuffer -= sizeof( ID3V2_EXTENDED_HEADER_2 );
-
-		pExtended->nSize = swapEndianess( pExtended->nSize );
-		ID3_DESYNC_SIZE( pExtended->nSize );
-		pExtended->nSize -= 6;
-
-		if ( nBuffer < pExtended->nSize )
-			return false;
-
-		pBuffer += pExtended->nSize;
-		nBuffer -= pExtended->nSize;
-	}
+	BYTE* pBuffer = pFrames.m_pBuffer;
+	DWORD nBuffer = pFrames.m_nLength;
 
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"audio" ) );
 
 	// 4-Char ID3 FrameTag: 	(http://en.wikipedia.org/wiki/ID3)
-	SwitchMap( Tag )
+	std::map< const CString, char >& Tag = ID3v2Tags;
+	CSingleLock oSwitchLock( &SwitchSection, TRUE );
+	if ( Tag.empty() )
 	{
 		Tag[ L"TIT2" ]	= 'i';
 		Tag[ L"TT2" ]	= 'i';
@@ -759,6 +710,7 @@ bool CLibraryBuilderInternals::ReadID3v2(DWORD nIndex, HANDLE hFile)
 		Tag[ L"SIGN" ]	= 'z';
 		Tag[ L"SEEK" ]	= 'z';
 	}
+	oSwitchLock.Unlock();
 
 	while ( nBuffer )
 	{
@@ -812,7 +764,7 @@ bool CLibraryBuilderInternals::ReadID3v2(DWORD nIndex, HANDLE hFile)
 		if ( nBuffer < nFrameSize || ! szFrameTag[0] )
 			break;
 
-		switch ( Tag[ CString(szFrameTag) ] )
+		switch ( SwitchLookup( Tag, CString(szFrameTag) ) )
 		{
 		case 'i':		// "TIT2" "TT2"
 			CopyID3v2Field( pXML.get(), L"title", pBuffer, nFrameSize );
@@ -1146,7 +1098,7 @@ bool CLibraryBuilderInternals::CopyID3v2Field(CXMLElement* pXML, LPCTSTR pszAttr
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals MP3 scan (threaded)
 
-bool CLibraryBuilderInternals::ReadMP3Frames(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadMP3Frames(DWORD nIndex, CFileReader& hFile)
 {
 	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
 
@@ -1163,7 +1115,7 @@ bool CLibraryBuilderInternals::ReadMP3Frames(DWORD nIndex, HANDLE hFile)
 //
 // Refer to this doc: http://www.mp3-tech.org/programmer/frame_header.html
 //
-bool CLibraryBuilderInternals::ScanMP3Frame(CXMLElement* pXML, HANDLE hFile, DWORD nIgnore)
+bool CLibraryBuilderInternals::ScanMP3Frame(CXMLElement* pXML, CFileReader& hFile, DWORD nIgnore)
 {
 	// Bitrate index
 	static DWORD nBitrateTable[16][5] =
@@ -1198,7 +1150,7 @@ bool CLibraryBuilderInternals::ScanMP3Frame(CXMLElement* pXML, HANDLE hFile, DWO
 	};
 
 	static const int nChannelTable[4]		= { 2, 2, 2, 1 };
-	static const CString strSoundType[4]	= { L"Stereo", L"Joint Stereo", L"Dual Channel", L"Single Channel" };
+	static const LPCTSTR strSoundType[4]	= { L"Stereo", L"Joint Stereo", L"Dual Channel", L"Single Channel" };
 
 	BYTE nLayer					= 0;
 	bool bVariable				= false;
@@ -1621,104 +1573,29 @@ CString CLibraryBuilderInternals::GetSummaryField(MSIHANDLE hSummaryInfo, UINT n
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals JPEG (threaded)
 
-bool CLibraryBuilderInternals::ReadJPEG(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadJPEG(DWORD nIndex, CFileReader& hFile)
 {
-	DWORD nRead	= 0;
-	WORD wMagic	= 0;
-
-	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-		return false;
-	if ( ! ReadFile( hFile, &wMagic, 2, &nRead, NULL ) )
-		return false;
-	if ( nRead != 2 || wMagic != 0xD8FF )
-		return LibraryBuilder.SubmitCorrupted( nIndex );
-
-	BYTE nByte	= 0, nBits = 0, nComponents = 0;
-	WORD nWidth = 0, nHeight = 0;
-	CString strComment;
-
-	for ( DWORD nSeek = 512; nSeek > 0; nSeek-- )
-	{
-		if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 )
-			return false;
-		if ( nByte != 0xFF )
-			continue;
-
-		while ( nByte == 0xFF )
-		{
-			if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 )
-				return false;
-		}
-
-		if ( ! ReadFile( hFile, &wMagic, 2, &nRead, NULL ) )
-			return false;
-		wMagic = swapEndianess( wMagic );
-		if ( nRead != 2 || wMagic < 2 )
-			return false;
+	CImageHeader oHeader;
+	bool bCorrupted;
 
-		switch ( nByte )
-		{
-		case 0xC0: case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
-		case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
-			if ( ! ReadFile( hFile, &nBits, 1, &nRead, NULL ) || nRead != 1 )
-				return false;
-			if ( ! ReadFile( hFile, &nHeight, 2, &nRead, NULL ) || nRead != 2 )
-				return false;
-			nHeight = swapEndianess( nHeight );
-			if ( ! ReadFile( hFile, &nWidth, 2, &nRead, NULL ) || nRead != 2 )
-				return false;
-			nWidth = swapEndianess( nWidth );
-			if ( ! ReadFile( hFile, &nComponents, 1, &nRead, NULL ) || nRead != 1 )
-				return false;
-			if ( wMagic < 8 )
-				return false;
-			SetFilePointer( hFile, wMagic - 8, NULL, FILE_CURRENT );
-			break;
-		case 0xFE: case 0xEC:
-			if ( wMagic > 2 )
-			{
-				CBuffer pComment;
-				pComment.EnsureBuffer( wMagic - 2 );
-				pComment.m_nLength = (DWORD)wMagic - 2;
-				ReadFile( hFile, pComment.m_pBuffer, wMagic - 2, &nRead, NULL );
-				strComment = pComment.ReadString( nRead );
-			}
-			break;
-		case 0xD9: case 0xDA:
-			nSeek = 1;
-			break;
-		default:
-			SetFilePointer( hFile, wMagic - 2, NULL, FILE_CURRENT );
-			break;
-		}
-	}
-
-	if ( nWidth == 0 || nHeight == 0 )
-		return false;
-
-	strComment.Trim();
-
-	for ( int nChar = 0; nChar < strComment.GetLength(); nChar++ )
-	{
-		if ( strComment[ nChar ] < 32 )
-			strComment.SetAt( nChar, '?' );
-	}
+	if ( ! CLibraryBuilderHeaders::ReadJPEG( hFile, oHeader, bCorrupted ) )
+		return bCorrupted ? LibraryBuilder.SubmitCorrupted( nIndex ) : false;
 
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"image" ) );
 
 	CString strItem;
-	strItem.Format( L"%lu", nWidth );
+	strItem.Format( L"%lu", oHeader.m_nWidth );
 	pXML->AddAttribute( L"width", strItem );
-	strItem.Format( L"%lu", nHeight );
+	strItem.Format( L"%lu", oHeader.m_nHeight );
 	pXML->AddAttribute( L"height", strItem );
 
-	if ( nComponents == 3 )
+	if ( oHeader.m_nComponents == 3 )
 		pXML->AddAttribute( L"colors", L"16.7M" );
-	else if ( nComponents == 1 )
+	else if ( oHeader.m_nComponents == 1 )
 		pXML->AddAttribute( L"colors", L"Greyscale" );
 
-	if ( ! strComment.IsEmpty() )
-		pXML->AddAttribute( L"description", strComment );
+	if ( ! oHeader.m_sComment.IsEmpty() )
+		pXML->AddAttribute( L"description", oHeader.m_sComment );
 
 	LibraryBuilder.SubmitMetadata( nIndex, CSchema::uriImage, pXML.release() );
 
@@ -1728,32 +1605,20 @@ bool CLibraryBuilderInternals::ReadJPEG(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals GIF (threaded)
 
-bool CLibraryBuilderInternals::ReadGIF(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadGIF(DWORD nIndex, CFileReader& hFile)
 {
-	CHAR szMagic[6];
-	DWORD nRead;
+	CImageHeader oHeader;
+	bool bCorrupted;
 
-	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-		return false;
-	if ( ! ReadFile( hFile, szMagic, 6, &nRead, NULL ) )
-		return false;
-
-	if ( nRead != 6 || ( strncmp( szMagic, "GIF87a", 6 ) && strncmp( szMagic, "GIF89a", 6 ) ) )
-		return LibraryBuilder.SubmitCorrupted( nIndex );
-
-	WORD nWidth, nHeight;
-
-	if ( ! ReadFile( hFile, &nWidth, 2, &nRead, NULL ) || nRead != 2 || nWidth == 0 )
-		return false;
-	if ( ! ReadFile( hFile, &nHeight, 2, &nRead, NULL ) || nRead != 2 || nHeight == 0 )
-		return false;
+	if ( ! CLibraryBuilderHeaders::ReadGIF( hFile, oHeader, bCorrupted ) )
+		return bCorrupted ? LibraryBuilder.SubmitCorrupted( nIndex ) : false;
 
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"image" ) );
 	CString strItem;
 
-	strItem.Format( L"%u", nWidth );
+	strItem.Format( L"%u", oHeader.m_nWidth );
 	pXML->AddAttribute( L"width", strItem );
-	strItem.Format( L"%u", nHeight );
+	strItem.Format( L"%u", oHeader.m_nHeight );
 	pXML->AddAttribute( L"height", strItem );
 
 	pXML->AddAttribute( L"colors", L"256" );
@@ -1766,65 +1631,22 @@ bool CLibraryBuilderInternals::ReadGIF(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals PNG (threaded)
 
-bool CLibraryBuilderInternals::ReadPNG(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadPNG(DWORD nIndex, CFileReader& hFile)
 {
-	BYTE  nMagic[8];
-	DWORD nRead;
-
-	if ( GetFileSize( hFile, NULL ) < 33 )
-		return LibraryBuilder.SubmitCorrupted( nIndex );
-	if ( SetFilePointer( hFile, 0, NULL, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-		return false;
-	if ( ! ReadFile( hFile, nMagic, 8, &nRead, NULL ) )
-		return false;
-	if ( nRead != 8 )
-		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
-	if ( nMagic[0] != 137 || nMagic[1] != 80 || nMagic[2] != 78 )
-		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
-	if ( nMagic[3] != 71 || nMagic[4] != 13 || nMagic[5] != 10 )
-		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
-	if ( nMagic[6] != 26 || nMagic[7] != 10 )
-		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
-
-	DWORD nLength, nIHDR;
-
-	if ( ! ReadFile( hFile, &nLength, 4, &nRead, NULL ) )
-		return false;
-	nLength = swapEndianess( nLength );
-	if ( nRead != 4 || nLength < 10 )
-		return false;
-	if ( ! ReadFile( hFile, &nIHDR, 4, &nRead, NULL ) )
-		return false;
-	if ( nRead != 4 || nIHDR != 'RDHI' )
-		return false;
-
-	DWORD nWidth, nHeight;
-	BYTE  nBits, nColors;
+	CImageHeader oHeader;
+	bool bCorrupted;
 
-	if ( ! ReadFile( hFile, &nWidth, 4, &nRead, NULL ) )
-		return false;
-	nWidth = swapEndianess( nWidth );
-	if ( nRead != 4 || nWidth <= 0 || nWidth > 0xFFFF )
-		return false;
-	if ( ! ReadFile( hFile, &nHeight, 4, &nRead, NULL ) )
-		return false;
-	nHeight = swapEndianess( nHeight );
-	if ( nRead != 4 || nHeight <= 0 || nHeight > 0xFFFF )
-		return false;
-
-	if ( ! ReadFile( hFile, &nBits, 1, &nRead, NULL ) || nRead != 1 )
-		return false;
-	if ( ! ReadFile( hFile, &nColors, 1, &nRead, NULL ) || nRead != 1 )
-		return false;
+	if ( ! CLibraryBuilderHeaders::ReadPNG( hFile, oHeader, bCorrupted ) )
+		return bCorrupted ? LibraryBuilder.SubmitCorrupted( nIndex ) : false;
 
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"image" ) );
 
 	CString strItem;
-	strItem.Format( L"%lu", nWidth );
+	strItem.Format( L"%lu", oHeader.m_nWidth );
 	pXML->AddAttribute( L"width", strItem );
-	strItem.Format( L"%lu", nHeight );
+	strItem.Format( L"%lu", oHeader.m_nHeight );
 	pXML->AddAttribute( L"height", strItem );
-	pXML->AddAttribute( L"colors", GetColorsByBits( nBits ) );
+	pXML->AddAttribute( L"colors", GetColorsByBits( oHeader.m_nBits ) );
 
 	LibraryBuilder.SubmitMetadata( nIndex, CSchema::uriImage, pXML.release() );
 
@@ -1834,32 +1656,21 @@ bool CLibraryBuilderInternals::ReadPNG(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals BMP (threaded)
 
-bool CLibraryBuilderInternals::ReadBMP(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadBMP(DWORD nIndex, CFileReader& hFile)
 {
-	BITMAPFILEHEADER pBFH;
-	BITMAPINFOHEADER pBIH;
-	DWORD nRead;
+	CImageHeader oHeader;
 
-	if ( GetFileSize( hFile, NULL ) < sizeof( pBFH ) + sizeof( pBIH ) )
+	if ( ! CLibraryBuilderHeaders::ReadBMP( hFile, oHeader ) )
 		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
 
-	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
-	ReadFile( hFile, &pBFH, sizeof( pBFH ), &nRead, NULL );
-	if ( nRead != sizeof( pBFH ) || pBFH.bfType != 'MB' )
-		return false;	// LibraryBuilder.SubmitCorrupted( nIndex );
-
-	ReadFile( hFile, &pBIH, sizeof( pBIH ), &nRead, NULL );
-	if ( nRead != sizeof( pBIH ) || pBIH.biSize != sizeof( pBIH ) )
-		return false;
-
 	augment::auto_ptr< CXMLElement > pXML( new CXMLElement( NULL, L"image" ) );
 	CString strItem;
 
-	strItem.Format( L"%d", pBIH.biWidth );
+	strItem.Format( L"%d", (LONG)oHeader.m_nWidth );
 	pXML->AddAttribute( L"width", strItem );
-	strItem.Format( L"%d", pBIH.biHeight );
+	strItem.Format( L"%d", (LONG)oHeader.m_nHeight );
 	pXML->AddAttribute( L"height", strItem );
-	pXML->AddAttribute( L"colors", GetColorsByBits( pBIH.biBitCount ) );
+	pXML->AddAttribute( L"colors", GetColorsByBits( oHeader.m_nBits ) );
 
 	LibraryBuilder.SubmitMetadata( nIndex, CSchema::uriImage, pXML.release() );
 
@@ -1941,7 +1752,7 @@ typedef struct
 
 #pragma pack( pop )
 
-bool CLibraryBuilderInternals::ReadFLVVariable(HANDLE hFile, DWORD& nRemaning, VARIANT& varData, CXMLElement* pXML)
+bool CLibraryBuilderInternals::ReadFLVVariable(CFileReader& hFile, DWORD& nRemaning, VARIANT& varData, CXMLElement* pXML)
 {
 	DWORD nRead;
 
@@ -2005,7 +1816,7 @@ bool CLibraryBuilderInternals::ReadFLVVariable(HANDLE hFile, DWORD& nRemaning, V
 	return true;
 }
 
-bool CLibraryBuilderInternals::ReadFLVDouble(HANDLE hFile, DWORD& nRemaning, double& dValue)
+bool CLibraryBuilderInternals::ReadFLVDouble(CFileReader& hFile, DWORD& nRemaning, double& dValue)
 {
 	UI64 d;
 	if ( nRemaning < sizeof( d ) )
@@ -2020,7 +1831,7 @@ bool CLibraryBuilderInternals::ReadFLVDouble(HANDLE hFile, DWORD& nRemaning, dou
 	return true;
 }
 
-bool CLibraryBuilderInternals::ReadFLVBool(HANDLE hFile, DWORD& nRemaning, bool& bValue)
+bool CLibraryBuilderInternals::ReadFLVBool(CFileReader& hFile, DWORD& nRemaning, bool& bValue)
 {
 	UI8 d;
 	if ( nRemaning < sizeof( d ) )
@@ -2035,7 +1846,7 @@ bool CLibraryBuilderInternals::ReadFLVBool(HANDLE hFile, DWORD& nRemaning, bool&
 	return true;
 }
 
-bool CLibraryBuilderInternals::ReadFLVString(HANDLE hFile, DWORD& nRemaning, BOOL bLong, CStringA& strValue)
+bool CLibraryBuilderInternals::ReadFLVString(CFileReader& hFile, DWORD& nRemaning, BOOL bLong, CStringA& strValue)
 {
 	DWORD nRead;
 	DWORD nStringSize;
@@ -2072,7 +1883,7 @@ bool CLibraryBuilderInternals::ReadFLVString(HANDLE hFile, DWORD& nRemaning, BOO
 	return true;
 }
 
-bool CLibraryBuilderInternals::ReadFLVEMCA(HANDLE hFile, DWORD& nRemaning, CXMLElement* pXML)
+bool CLibraryBuilderInternals::ReadFLVEMCA(CFileReader& hFile, DWORD& nRemaning, CXMLElement* pXML)
 {
 	UI32 Fields;
 	if ( nRemaning < sizeof( Fields ) )
@@ -2159,7 +1970,7 @@ bool CLibraryBuilderInternals::ReadFLVEMCA(HANDLE hFile, DWORD& nRemaning, CXMLE
 	return true;
 }
 
-bool CLibraryBuilderInternals::ReadFLV(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadFLV(DWORD nIndex, CFileReader& hFile)
 {
 	BOOL bMetadata = FALSE;
 	DWORD nRead;
@@ -2303,7 +2114,7 @@ static const CLSID asfDRM1 =
 static const CLSID asfDRM2 =
 { 0x1EFB1A30, 0x0B62, 0x11D0, { 0xA3, 0x9B, 0x00, 0xA0, 0xC9, 0x03, 0x48, 0xF6 } };
 
-bool CLibraryBuilderInternals::ReadASF(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadASF(DWORD nIndex, CFileReader& hFile)
 {
 	QWORD nSize;
 	DWORD nRead;
@@ -2558,7 +2369,7 @@ bool CLibraryBuilderInternals::ReadASF(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals MPEG (threaded)
 
-bool CLibraryBuilderInternals::ReadMPEG(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadMPEG(DWORD nIndex, CFileReader& hFile)
 {
 	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
 
@@ -2622,7 +2433,7 @@ bool CLibraryBuilderInternals::ReadMPEG(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals OGG VORBIS (threaded)
 
-bool CLibraryBuilderInternals::ReadOGG(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadOGG(DWORD nIndex, CFileReader& hFile)
 {
 	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
 
@@ -2764,7 +2575,7 @@ bool CLibraryBuilderInternals::ReadOGG(DWORD nIndex, HANDLE hFile)
 	return true;
 }
 
-BYTE* CLibraryBuilderInternals::ReadOGGPage(HANDLE hFile, DWORD& nBuffer, BYTE nFlags, DWORD nSequence, DWORD nMinSize)
+BYTE* CLibraryBuilderInternals::ReadOGGPage(CFileReader& hFile, DWORD& nBuffer, BYTE nFlags, DWORD nSequence, DWORD nMinSize)
 {
 	DWORD nMagic, nRead, nSample;
 	BYTE nByte, nChunk;
@@ -2859,7 +2670,7 @@ bool CLibraryBuilderInternals::ReadOGGString(BYTE*& pOGG, DWORD& nOGG, CString&
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals APE Monkey's Audio (threaded)
 
-bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferFooter)
+bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, CFileReader& hFile, bool bPreferFooter)
 {
 	const DWORD nFileSize = GetFileSize( hFile, NULL );
 	if ( nFileSize < sizeof( APE_TAG_FOOTER ) )
@@ -2889,7 +2700,9 @@ bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferF
 	CString strTotalDiscsField, strTotalTracksField;
 
 	// Keys:
-	SwitchMap( Text )
+	std::map< const CString, char >& Text = APEKeys;
+	CSingleLock oSwitchLock( &SwitchSection, TRUE );
+	if ( Text.empty() )
 	{
 		Text[ L"title" ] 			= 't';
 		Text[ L"artist" ]			= 'a';
@@ -2949,6 +2762,7 @@ bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferF
 		Text[ L"musicbrainz trm id" ]		= 'Z';
 		Text[ L"musicip puid" ]				= 'M';
 	}
+	oSwitchLock.Unlock();
 
 	for ( int nTag = 0; nTag < pFooter.nFields; nTag++ )
 	{
@@ -2986,7 +2800,7 @@ bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferF
 		{
 			strKey.MakeLower();
 
-			switch ( Text[ strKey ] )
+			switch ( SwitchLookup( Text, strKey ) )
 			{
 			case 't':		// "title"
 				pXML->AddAttribute( L"title", strValue );
@@ -3326,7 +3140,7 @@ bool CLibraryBuilderInternals::ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferF
 	(((DWORD)(ch4) & 0xFF0000) >> 8) |		\
 	(((DWORD)(ch4) & 0xFF000000) >> 24))
 
-bool CLibraryBuilderInternals::ReadAVI(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadAVI(DWORD nIndex, CFileReader& hFile)
 {
 	if ( GetFileSize( hFile, NULL ) < sizeof( AVI_HEADER ) + 16 )
 		return false;
@@ -3522,7 +3336,7 @@ bool CLibraryBuilderInternals::ReadAVI(DWORD nIndex, HANDLE hFile)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals PDF (threaded)
 
-bool CLibraryBuilderInternals::ReadPDF(DWORD nIndex, HANDLE hFile, LPCTSTR pszPath)
+bool CLibraryBuilderInternals::ReadPDF(DWORD nIndex, CFileReader& hFile, LPCTSTR pszPath)
 {
 	DWORD nOffset, nCount, nCountStart, nPages = 0, nOffsetPrev, nFileLength = 0, nVersion;
 
@@ -4228,7 +4042,7 @@ CString	CLibraryBuilderInternals::DecodePDFText(CString strInput)
 	return strResult.Trim();
 }
 
-CString CLibraryBuilderInternals::ReadPDFLine(HANDLE hFile, bool bReverse, bool bComplex, bool bSplitter)
+CString CLibraryBuilderInternals::ReadPDFLine(CFileReader& hFile, bool bReverse, bool bComplex, bool bSplitter)
 {
 	bool bGt = false, bLt = false;
 	DWORD nRead, nLength;
@@ -4351,7 +4165,7 @@ CString CLibraryBuilderInternals::ReadPDFLine(HANDLE hFile, bool bReverse, bool
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals CHM (threaded)
 
-bool CLibraryBuilderInternals::ReadCHM(DWORD nIndex, HANDLE hFile, LPCTSTR pszPath)
+bool CLibraryBuilderInternals::ReadCHM(DWORD nIndex, CFileReader& hFile, LPCTSTR pszPath)
 {
 	CHAR szMagic[4];
 	DWORD nVersion, nIHDRSize, nLCID, nRead, nPos, nComprVersion;
@@ -4622,7 +4436,7 @@ bool CLibraryBuilderInternals::ReadCHM(DWORD nIndex, HANDLE hFile, LPCTSTR pszPa
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals DJVU
 
-bool CLibraryBuilderInternals::ReadDJVU(DWORD nIndex, HANDLE hFile)
+bool CLibraryBuilderInternals::ReadDJVU(DWORD nIndex, CFileReader& hFile)
 {
 	DWORD nRead;
 
@@ -4779,7 +4593,7 @@ bool CLibraryBuilderInternals::ReadCollection(DWORD nIndex, LPCTSTR pszPath)
 //////////////////////////////////////////////////////////////////////
 // CLibraryBuilderInternals TORRENT
 
-bool CLibraryBuilderInternals::ReadTorrent(DWORD nIndex, HANDLE /*hFile*/, LPCTSTR pszPath)
+bool CLibraryBuilderInternals::ReadTorrent(DWORD nIndex, CFileReader& /*hFile*/, LPCTSTR pszPath)
 {
 	CBTInfo oTorrent;
 	if ( ! oTorrent.LoadTorrentFile( pszPath ) )
@@ -19,6 +19,7 @@
 #pragma once
 
 class CXMLElement;
+class CFileReader;
 
 
 class CLibraryBuilderInternals
@@ -32,17 +33,17 @@ private:
 
 public:
 	int			LookupID3v1Genre(const CString& strGenre) const;
-	bool		ExtractMetadata(DWORD nIndex, const CString& strPath, HANDLE hFile);
+	bool		ExtractMetadata(DWORD nIndex, const CString& strPath, HANDLE hSource, DWORD nTimeout = 0);	// Timeout (ms) for reads by internal extractors
 	bool		ExtractProperties(DWORD nIndex, const CString& strPath);	// Windows properties
 
 private:
 	// ID3v1 and ID3v2 and MP3
-	bool		ReadID3v1(DWORD nIndex, HANDLE hFile);
+	bool		ReadID3v1(DWORD nIndex, CFileReader& hFile);
 	bool		CopyID3v1Field(CXMLElement* pXML, LPCTSTR pszAttribute, CString strValue);
-	bool		ReadID3v2(DWORD nIndex, HANDLE hFile);
+	bool		ReadID3v2(DWORD nIndex, CFileReader& hFile);
 	bool		CopyID3v2Field(CXMLElement* pXML, LPCTSTR pszAttribute, BYTE* pBuffer, DWORD nLength, bool bSkipLanguage = false);
-	bool		ReadMP3Frames(DWORD nIndex, HANDLE hFile);
-	bool		ScanMP3Frame(CXMLElement* pXML, HANDLE hFile, DWORD nIgnore);
+	bool		ReadMP3Frames(DWORD nIndex, CFileReader& hFile);
+	bool		ScanMP3Frame(CXMLElement* pXML, CFileReader& hFile, DWORD nIgnore);
 
 	// Module Version
 	bool		ReadVersion(DWORD nIndex, LPCTSTR pszPath);
@@ -59,35 +60,35 @@ private:
 	CString		GetSummaryField(MSIHANDLE hSummaryInfo, UINT nProperty);
 
 	// Image Files (Prefer GFLLibraryBuilder Plugin)
-	bool		ReadJPEG(DWORD nIndex, HANDLE hFile);
-	bool		ReadGIF(DWORD nIndex, HANDLE hFile);
-	bool		ReadPNG(DWORD nIndex, HANDLE hFile);
-	bool		ReadBMP(DWORD nIndex, HANDLE hFile);
+	bool		ReadJPEG(DWORD nIndex, CFileReader& hFile);
+	bool		ReadGIF(DWORD nIndex, CFileReader& hFile);
+	bool		ReadPNG(DWORD nIndex, CFileReader& hFile);
+	bool		ReadBMP(DWORD nIndex, CFileReader& hFile);
 
 	// General Media
-	bool		ReadFLV(DWORD nIndex, HANDLE hFile);
-	bool		ReadFLVVariable(HANDLE hFile, DWORD& nRemaning, VARIANT& varData, CXMLElement* pXML = NULL);
-	bool		ReadFLVDouble(HANDLE hFile, DWORD& nRemaning, double& dValue);
-	bool		ReadFLVBool(HANDLE hFile, DWORD& nRemaning, bool& bValue);
-	bool		ReadFLVString(HANDLE hFile, DWORD& nRemaning, BOOL bLong, CStringA& strValue);
-	bool		ReadFLVEMCA(HANDLE hFile, DWORD& nRemaning, CXMLElement* pXML = NULL);
+	bool		ReadFLV(DWORD nIndex, CFileReader& hFile);
+	bool		ReadFLVVariable(CFileReader& hFile, DWORD& nRemaning, VARIANT& varData, CXMLElement* pXML = NULL);
+	bool		ReadFLVDouble(CFileReader& hFile, DWORD& nRemaning, double& dValue);
+	bool		ReadFLVBool(CFileReader& hFile, DWORD& nRemaning, bool& bValue);
+	bool		ReadFLVString(CFileReader& hFile, DWORD& nRemaning, BOOL bLong, CStringA& strValue);
+	bool		ReadFLVEMCA(CFileReader& hFile, DWORD& nRemaning, CXMLElement* pXML = NULL);
 
-	bool		ReadASF(DWORD nIndex, HANDLE hFile);
-	bool		ReadAVI(DWORD nIndex, HANDLE hFile);
-	bool		ReadMPEG(DWORD nIndex, HANDLE hFile);
+	bool		ReadASF(DWORD nIndex, CFileReader& hFile);
+	bool		ReadAVI(DWORD nIndex, CFileReader& hFile);
+	bool		ReadMPEG(DWORD nIndex, CFileReader& hFile);
 //	bool		ReadMKV(DWORD nIndex, HANDLE hFile);
-	bool		ReadOGG(DWORD nIndex, HANDLE hFile);
-	BYTE*		ReadOGGPage(HANDLE hFile, DWORD& nBuffer, BYTE nFlags, DWORD nSequence, DWORD nMinSize = 0);
+	bool		ReadOGG(DWORD nIndex, CFileReader& hFile);
+	BYTE*		ReadOGGPage(CFileReader& hFile, DWORD& nBuffer, BYTE nFlags, DWORD nSequence, DWORD nMinSize = 0);
 	bool		ReadOGGString(BYTE*& pOGG, DWORD& nOGG, CString& str);
-	bool		ReadAPE(DWORD nIndex, HANDLE hFile, bool bPreferFooter = false);
+	bool		ReadAPE(DWORD nIndex, CFileReader& hFile, bool bPreferFooter = false);
 
-	bool		ReadDJVU(DWORD nIndex, HANDLE hFile);
-	bool		ReadCHM(DWORD nIndex, HANDLE hFile, LPCTSTR pszPath);
-	bool		ReadPDF(DWORD nIndex, HANDLE hFile, LPCTSTR pszPath);
-	CString		ReadPDFLine(HANDLE hFile, bool bReverse, bool bComplex = false, bool bSplitter = true);
+	bool		ReadDJVU(DWORD nIndex, CFileReader& hFile);
+	bool		ReadCHM(DWORD nIndex, CFileReader& hFile, LPCTSTR pszPath);
+	bool		ReadPDF(DWORD nIndex, CFileReader& hFile, LPCTSTR pszPath);
+	CString		ReadPDFLine(CFileReader& hFile, bool bReverse, bool bComplex = false, bool bSplitter = true);
 	CString		DecodePDFText(CString strInput);
 
-	bool		ReadTorrent(DWORD nIndex, HANDLE hFile, LPCTSTR pszPath);
+	bool		ReadTorrent(DWORD nIndex, CFileReader& hFile, LPCTSTR pszPath);
 	bool		ReadCollection(DWORD nIndex, LPCTSTR pszPath);
 	bool		ReadSkin(DWORD nIndex);
 	bool		ReadBook(DWORD nIndex, CString strPath);
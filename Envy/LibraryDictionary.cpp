@@ -47,6 +47,8 @@ CLibraryDictionary LibraryDictionary;
 CLibraryDictionary::CLibraryDictionary()
 	: m_pTable			( NULL )
 	, m_bValid			( false )
+	, m_bLoading		( false )
+	, m_bLoadStale		( false )
 	, m_nSearchCookie	( 1ul )
 {
 }
@@ -64,6 +66,10 @@ void CLibraryDictionary::AddFile(const CLibraryFile* pFile)
 {
 	ASSUME_LOCK( Library.m_pSection );
 
+	// Saved word lists are restored at once after all files are loaded
+	if ( m_bLoading )
+		return;
+
 	const bool bCanUpload = pFile->IsShared();
 
 	ProcessFile( pFile, true, bCanUpload );
@@ -76,6 +82,12 @@ void CLibraryDictionary::RemoveFile(const CLibraryFile* pFile)
 {
 	ASSUME_LOCK( Library.m_pSection );
 
+	if ( m_bLoading )
+	{
+		m_bLoadStale = true;
+		return;
+	}
+
 	ProcessFile( pFile, false, pFile->IsShared() );
 
 	// Always invalidate the table when removing a hashed file...
@@ -256,6 +268,9 @@ void CLibraryDictionary::Clear()
 
 	m_oWordMap.RemoveAll();
 
+	m_bLoading = false;
+	m_bLoadStale = false;
+
 	if ( m_pTable )
 	{
 		m_pTable->Clear();
@@ -373,7 +388,7 @@ CFileList* CLibraryDictionary::Search(const CQuerySearch* pSearch, const int nMa
 	return pHits;
 }
 
-void CLibraryDictionary::Serialize(CArchive& ar, const int /*nVersion*/)
+void CLibraryDictionary::Serialize(CArchive& ar, const int nVersion)
 {
 	ASSUME_LOCK( Library.m_pSection );
 
@@ -386,5 +401,117 @@ void CLibraryDictionary::Serialize(CArchive& ar, const int /*nVersion*/)
 		DWORD nWordsCount = 0u;
 		ar >> nWordsCount;
 		m_oWordMap.InitHashTable( GetBestHashTableSize( nWordsCount ) );
+
+		// Word lists follow the files, don't parse every name and metadata
+		m_bLoading = ( nVersion >= 4 && nVersion < 1000 );
+		m_bLoadStale = false;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryDictionary word index serialize
+//
+// Saves word lists as file indexes, so loading skips keyword parsing and
+// the per-word duplicate scan of ProcessWord(). Falls back to a rebuild
+// if the files loaded don't match the files saved.
+
+void CLibraryDictionary::SerializeWords(CArchive& ar, const int /*nVersion*/)
+{
+	ASSUME_LOCK( Library.m_pSection );
+
+	if ( ar.IsStoring() )
+	{
+		DWORD nFiles = 0;
+		for ( POSITION pos = LibraryMaps.GetFileIterator(); pos; )
+		{
+			if ( LibraryMaps.GetNextFile( pos )->HasHash() )
+				nFiles++;
+		}
+		ar << nFiles;
+
+		ar.WriteCount( m_oWordMap.GetCount() );
+		for ( POSITION pos1 = m_oWordMap.GetStartPosition(); pos1; )
+		{
+			CString strWord;
+			CFileList* pList = NULL;
+			m_oWordMap.GetNextAssoc( pos1, strWord, pList );
+
+			ar << strWord;
+			ar.WriteCount( pList->GetCount() );
+			for ( POSITION pos2 = pList->GetHeadPosition(); pos2; )
+			{
+				ar << pList->GetNext( pos2 )->m_nIndex;
+			}
+		}
+	}
+	else // Loading
+	{
+		if ( ! m_bLoading )
+			return;		// Older version, words added with each file
+
+		m_bLoading = false;
+
+		DWORD nFiles = 0;
+		ar >> nFiles;
+
+		bool bValid = ! m_bLoadStale;
+		for ( POSITION pos = LibraryMaps.GetFileIterator(); pos && bValid; )
+		{
+			if ( LibraryMaps.GetNextFile( pos )->HasHash() )
+				bValid = ( nFiles-- != 0 );
+		}
+		bValid = bValid && nFiles == 0;
+
+		for ( DWORD_PTR nWords = ar.ReadCount(); nWords; nWords-- )
+		{
+			CString strWord;
+			ar >> strWord;
+
+			CFileList* pList = NULL;
+			if ( bValid )
+			{
+				pList = new CFileList;
+				m_oWordMap.SetAt( strWord, pList );
+			}
+
+			for ( DWORD_PTR nCount = ar.ReadCount(); nCount; nCount-- )
+			{
+				DWORD nIndex = 0;
+				ar >> nIndex;
+
+				if ( ! bValid )
+					continue;
+
+				CLibraryFile* pFile = LibraryMaps.LookupFile( nIndex );
+				if ( pFile && pFile->HasHash() )
+					pList->AddTail( pFile );
+				else
+					bValid = false;
+			}
+		}
+
+		if ( ! bValid )
+			RebuildWords();
+
+		Invalidate();
+	}
+}
+
+void CLibraryDictionary::RebuildWords()
+{
+	for ( POSITION pos = m_oWordMap.GetStartPosition(); pos; )
+	{
+		CString strWord;
+		CFileList* pList = NULL;
+		m_oWordMap.GetNextAssoc( pos, strWord, pList );
+		delete pList;
+	}
+	m_oWordMap.RemoveAll();
+
+	for ( POSITION pos = LibraryMaps.GetFileIterator(); pos; )
+	{
+		const CLibraryFile* pFile = LibraryMaps.GetNextFile( pos );
+		if ( pFile->HasHash() )
+			ProcessFile( pFile, true, pFile->IsShared() );
 	}
 }
@@ -38,6 +38,7 @@ public:
 	void		Invalidate();			// Force dictionary and hash table to re-build
 	void		Clear();
 	void		Serialize(CArchive& ar, int nVersion);
+	void		SerializeWords(CArchive& ar, int nVersion);	// Prebuilt word index, after all files
 	CFileList*	Search(const CQuerySearch* pSearch, int nMaximum = 0, bool bLocal = false, bool bAvailableOnly = true);
 
 	INT_PTR 	GetWordCount() const { return m_oWordMap.GetCount(); }	// For Debug Benchmark
@@ -48,8 +49,11 @@ private:
 	CWordMap	m_oWordMap;
 	CQueryHashTable* m_pTable;
 	bool		m_bValid;				// Table is up to date
+	bool		m_bLoading;				// Library load, words restored by SerializeWords()
+	bool		m_bLoadStale;			// File removed while loading, rebuild words instead
 	DWORD		m_nSearchCookie;
 
+	void		RebuildWords();
 	void		ProcessFile(const CLibraryFile* pFile, bool bAdd, bool bCanUpload);
 	void		ProcessPhrase(const CLibraryFile* pFile, const CString& strPhrase, bool bAdd, bool bCanUpload);
 	void		ProcessWord(const CLibraryFile* pFile, const CString& strWord, bool bAdd, bool bCanUpload);
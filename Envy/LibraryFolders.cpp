@@ -729,6 +729,10 @@ BOOL CLibraryFolders::ThreadScan(const BOOL bForce)
 			{
 				if ( pFolder->ThreadScan() ) bChanged = TRUE;
 			}
+			else if ( pFolder->ThreadUpdate() )
+			{
+				bChanged = TRUE;	// Journaled per-file changes
+			}
 		}
 		else
 		{
@@ -38,16 +38,134 @@ END_INTERFACE_MAP()
 CLibraryMaps LibraryMaps;
 
 
+//////////////////////////////////////////////////////////////////////
+// CLibraryHashMap construction
+
+CLibraryHashMap::CLibraryHashMap()
+	: m_pTable	( NULL )
+	, m_nMask	( 0 )
+	, m_nCount	( 0 )
+{
+}
+
+CLibraryHashMap::~CLibraryHashMap()
+{
+	delete [] m_pTable;
+}
+
+void CLibraryHashMap::RemoveAll()
+{
+	delete [] m_pTable;
+	m_pTable = NULL;
+	m_nMask = 0;
+	m_nCount = 0;
+}
+
+void CLibraryHashMap::Resize(DWORD nSize)
+{
+	ASSERT( nSize && ( nSize & ( nSize - 1 ) ) == 0 );
+
+	Entry* pOld = m_pTable;
+	const DWORD nOldSize = pOld ? m_nMask + 1 : 0;
+
+	m_pTable = new Entry[ nSize ];
+	ZeroMemory( m_pTable, nSize * sizeof( Entry ) );
+	m_nMask = nSize - 1;
+
+	for ( DWORD i = 0; i < nOldSize; ++i )
+	{
+		if ( pOld[ i ].pFile )
+		{
+			DWORD nSlot = pOld[ i ].nKey & m_nMask;
+			while ( m_pTable[ nSlot ].pFile )
+				nSlot = ( nSlot + 1 ) & m_nMask;
+			m_pTable[ nSlot ] = pOld[ i ];
+		}
+	}
+
+	delete [] pOld;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryHashMap operations
+
+void CLibraryHashMap::Add(DWORD nKey, CLibraryFile* pFile)
+{
+	ASSERT( pFile );
+
+	// Keep load under 75%
+	if ( ! m_pTable )
+		Resize( FILE_HASH_SIZE );
+	else if ( ( m_nCount + 1 ) * 4 > ( m_nMask + 1 ) * 3 )
+		Resize( ( m_nMask + 1 ) * 2 );
+
+	DWORD nSlot = nKey & m_nMask;
+	while ( m_pTable[ nSlot ].pFile )
+		nSlot = ( nSlot + 1 ) & m_nMask;
+
+	m_pTable[ nSlot ].nKey = nKey;
+	m_pTable[ nSlot ].pFile = pFile;
+	m_nCount++;
+}
+
+void CLibraryHashMap::Remove(DWORD nKey, const CLibraryFile* pFile)
+{
+	if ( ! m_pTable )
+		return;
+
+	DWORD nSlot = nKey & m_nMask;
+	for ( ; m_pTable[ nSlot ].pFile != pFile; nSlot = ( nSlot + 1 ) & m_nMask )
+	{
+		if ( ! m_pTable[ nSlot ].pFile )
+			return;		// Not found
+	}
+
+	m_nCount--;
+
+	// Shift following entries of the run back into the gap (no tombstones needed),
+	// an entry may move only if the gap lies between its home slot and its slot
+	for ( DWORD nNext = ( nSlot + 1 ) & m_nMask; m_pTable[ nNext ].pFile; nNext = ( nNext + 1 ) & m_nMask )
+	{
+		const DWORD nHome = m_pTable[ nNext ].nKey & m_nMask;
+		if ( ( ( nNext - nHome ) & m_nMask ) >= ( ( nNext - nSlot ) & m_nMask ) )
+		{
+			m_pTable[ nSlot ] = m_pTable[ nNext ];
+			nSlot = nNext;
+		}
+	}
+
+	m_pTable[ nSlot ].nKey = 0;
+	m_pTable[ nSlot ].pFile = NULL;
+}
+
+CLibraryFile* CLibraryHashMap::GetNext(DWORD nKey, DWORD& nPos) const
+{
+	if ( ! m_pTable )
+		return NULL;
+
+	for ( ; nPos <= m_nMask; ++nPos )
+	{
+		const Entry& oEntry = m_pTable[ ( nKey + nPos ) & m_nMask ];
+		if ( ! oEntry.pFile )
+			break;		// End of run
+
+		if ( oEntry.nKey == nKey )
+		{
+			++nPos;
+			return oEntry.pFile;
+		}
+	}
+
+	nPos = m_nMask + 1;
+	return NULL;
+}
+
+
 //////////////////////////////////////////////////////////////////////
 // CLibraryMaps construction
 
 CLibraryMaps::CLibraryMaps()
-	: m_pSHA1Map	( )
-	, m_pTigerMap	( )
-	, m_pED2KMap	( )
-	, m_pMD5Map		( )
-	, m_pBTHMap		( )
-	, m_nNextIndex	( 4 )
+	: m_nNextIndex	( 4 )
 	, m_nFiles		( 0 )
 	, m_nVolume		( 0 )
 {
@@ -200,8 +318,8 @@ CFileList* CLibraryMaps::LookupFilesByHash(const CEnvyFile* pFilter, BOOL bShare
 
 	if ( pFilter->m_oSHA1 )
 	{
-		for ( CLibraryFile* pFile = m_pSHA1Map[ FILE_INDEX( pFilter->m_oSHA1 ) ];
-			pFile; pFile = pFile->m_pNextSHA1 )
+		DWORD nPos = 0;
+		while ( CLibraryFile* pFile = m_pSHA1Map.GetNext( FILE_HASH_KEY( pFilter->m_oSHA1 ), nPos ) )
 		{
 			if ( validAndEqual( pFile->m_oSHA1, pFilter->m_oSHA1 ) &&
 				 *pFile == *pFilter &&
@@ -228,8 +346,8 @@ CFileList* CLibraryMaps::LookupFilesByHash(const CEnvyFile* pFilter, BOOL bShare
 
 	if ( pFilter->m_oED2K )
 	{
-		for ( CLibraryFile* pFile = m_pED2KMap[ FILE_INDEX( pFilter->m_oED2K ) ];
-			pFile; pFile = pFile->m_pNextED2K )
+		DWORD nPos = 0;
+		while ( CLibraryFile* pFile = m_pED2KMap.GetNext( FILE_HASH_KEY( pFilter->m_oED2K ), nPos ) )
 		{
 			if ( validAndEqual( pFile->m_oED2K, pFilter->m_oED2K ) &&
 				 *pFile == *pFilter &&
@@ -256,8 +374,8 @@ CFileList* CLibraryMaps::LookupFilesByHash(const CEnvyFile* pFilter, BOOL bShare
 
 	if ( pFilter->m_oTiger )
 	{
-		for ( CLibraryFile* pFile = m_pTigerMap[ FILE_INDEX( pFilter->m_oTiger ) ];
-			pFile; pFile = pFile->m_pNextTiger )
+		DWORD nPos = 0;
+		while ( CLibraryFile* pFile = m_pTigerMap.GetNext( FILE_HASH_KEY( pFilter->m_oTiger ), nPos ) )
 		{
 			if ( validAndEqual( pFile->m_oTiger, pFilter->m_oTiger ) &&
 				 *pFile == *pFilter &&
@@ -284,8 +402,8 @@ CFileList* CLibraryMaps::LookupFilesByHash(const CEnvyFile* pFilter, BOOL bShare
 
 	if ( pFilter->m_oBTH )
 	{
-		for ( CLibraryFile* pFile = m_pBTHMap[ FILE_INDEX( pFilter->m_oBTH ) ];
-			pFile; pFile = pFile->m_pNextBTH )
+		DWORD nPos = 0;
+		while ( CLibraryFile* pFile = m_pBTHMap.GetNext( FILE_HASH_KEY( pFilter->m_oBTH ), nPos ) )
 		{
 			if ( validAndEqual( pFile->m_oBTH, pFilter->m_oBTH ) &&
 				 *pFile == *pFilter &&
@@ -314,8 +432,8 @@ CFileList* CLibraryMaps::LookupFilesByHash(const CEnvyFile* pFilter, BOOL bShare
 		// Since MD5 is not commonly used for searches we use it for the duplicate file search
 		// which requires getting a list of files not to return only 1 file. See CLibrary::CheckDuplicates
 
-		for ( CLibraryFile* pFile = m_pMD5Map[ FILE_INDEX( pFilter->m_oMD5 ) ];
-			pFile; pFile = pFile->m_pNextMD5 )
+		DWORD nPos = 0;
+		while ( CLibraryFile* pFile = m_pMD5Map.GetNext( FILE_HASH_KEY( pFilter->m_oMD5 ), nPos ) )
 		{
 			if ( validAndEqual( pFile->m_oMD5, pFilter->m_oMD5 ) &&
 				 *pFile == *pFilter &&
@@ -373,9 +491,8 @@ CLibraryFile* CLibraryMaps::LookupFileBySHA1(const Hashes::Sha1Hash& oSHA1, BOOL
 
 	CQuickLock oLock( Library.m_pSection );
 
-	CLibraryFile* pFile = m_pSHA1Map[ FILE_INDEX( oSHA1 ) ];
-
-	for ( ; pFile; pFile = pFile->m_pNextSHA1 )
+	DWORD nPos = 0;
+	while ( CLibraryFile* pFile = m_pSHA1Map.GetNext( FILE_HASH_KEY( oSHA1 ), nPos ) )
 	{
 		if ( validAndEqual( oSHA1, pFile->m_oSHA1 ) )
 		{
@@ -395,9 +512,8 @@ CLibraryFile* CLibraryMaps::LookupFileByTiger(const Hashes::TigerHash& oTiger, B
 
 	CQuickLock oLock( Library.m_pSection );
 
-	CLibraryFile* pFile = m_pTigerMap[ FILE_INDEX( oTiger ) ];
-
-	for ( ; pFile; pFile = pFile->m_pNextTiger )
+	DWORD nPos = 0;
+	while ( CLibraryFile* pFile = m_pTigerMap.GetNext( FILE_HASH_KEY( oTiger ), nPos ) )
 	{
 		if ( validAndEqual( oTiger, pFile->m_oTiger ) )
 		{
@@ -417,9 +533,8 @@ CLibraryFile* CLibraryMaps::LookupFileByED2K(const Hashes::Ed2kHash& oED2K, BOOL
 
 	CQuickLock oLock( Library.m_pSection );
 
-	CLibraryFile* pFile = m_pED2KMap[ FILE_INDEX( oED2K ) ];
-
-	for ( ; pFile; pFile = pFile->m_pNextED2K )
+	DWORD nPos = 0;
+	while ( CLibraryFile* pFile = m_pED2KMap.GetNext( FILE_HASH_KEY( oED2K ), nPos ) )
 	{
 		if ( validAndEqual( oED2K, pFile->m_oED2K ) )
 		{
@@ -439,9 +554,8 @@ CLibraryFile* CLibraryMaps::LookupFileByBTH(const Hashes::BtHash& oBTH, BOOL bSh
 
 	CQuickLock oLock( Library.m_pSection );
 
-	CLibraryFile* pFile = m_pBTHMap[ FILE_INDEX( oBTH ) ];
-
-	for ( ; pFile; pFile = pFile->m_pNextBTH )
+	DWORD nPos = 0;
+	while ( CLibraryFile* pFile = m_pBTHMap.GetNext( FILE_HASH_KEY( oBTH ), nPos ) )
 	{
 		if ( validAndEqual( oBTH, pFile->m_oBTH ) )
 		{
@@ -461,9 +575,8 @@ CLibraryFile* CLibraryMaps::LookupFileByMD5(const Hashes::Md5Hash& oMD5, BOOL bS
 
 	CQuickLock oLock( Library.m_pSection );
 
-	CLibraryFile* pFile = m_pMD5Map[ FILE_INDEX( oMD5 ) ];
-
-	for ( ; pFile; pFile = pFile->m_pNextMD5 )
+	DWORD nPos = 0;
+	while ( CLibraryFile* pFile = m_pMD5Map.GetNext( FILE_HASH_KEY( oMD5 ), nPos ) )
 	{
 		if ( validAndEqual( oMD5, pFile->m_oMD5 ) )
 		{
@@ -502,21 +615,18 @@ void CLibraryMaps::Clear()
 		m_pNameMap.GetNextAssoc( p, k, v );
 		TRACE( _T( "m_pNameMap lost : %ls = 0x%08x\n" ), (LPCTSTR)k, v );
 	}
-	for ( int i = 0; i < FILE_HASH_SIZE; ++i )
-	{
-		ASSERT( m_pSHA1Map[ i ] == NULL );
-		ASSERT( m_pTigerMap[ i ] == NULL );
-		ASSERT( m_pED2KMap[ i ] == NULL );
-		ASSERT( m_pBTHMap[ i ] == NULL );
-		ASSERT( m_pMD5Map[ i ] == NULL );
-	}
+	ASSERT( m_pSHA1Map.GetCount() == 0 );
+	ASSERT( m_pTigerMap.GetCount() == 0 );
+	ASSERT( m_pED2KMap.GetCount() == 0 );
+	ASSERT( m_pBTHMap.GetCount() == 0 );
+	ASSERT( m_pMD5Map.GetCount() == 0 );
 #endif
 
-	ZeroMemory( m_pSHA1Map, sizeof( m_pSHA1Map ) );
-	ZeroMemory( m_pTigerMap, sizeof( m_pTigerMap ) );
-	ZeroMemory( m_pED2KMap, sizeof( m_pED2KMap ) );
-	ZeroMemory( m_pBTHMap, sizeof( m_pBTHMap ) );
-	ZeroMemory( m_pMD5Map, sizeof( m_pMD5Map ) );
+	m_pSHA1Map.RemoveAll();
+	m_pTigerMap.RemoveAll();
+	m_pED2KMap.RemoveAll();
+	m_pBTHMap.RemoveAll();
+	m_pMD5Map.RemoveAll();
 
 	ASSERT( m_nFiles == 0 );
 	ASSERT( m_nVolume == 0 );
@@ -585,37 +695,27 @@ void CLibraryMaps::OnFileAdd(CLibraryFile* pFile)
 
 	if ( pFile->m_oSHA1 )
 	{
-		CLibraryFile** pHash = &m_pSHA1Map[ FILE_INDEX( pFile->m_oSHA1 ) ];
-		pFile->m_pNextSHA1 = *pHash;
-		*pHash = pFile;
+		m_pSHA1Map.Add( FILE_HASH_KEY( pFile->m_oSHA1 ), pFile );
 	}
 
 	if ( pFile->m_oTiger )
 	{
-		CLibraryFile** pHash = &m_pTigerMap[ FILE_INDEX( pFile->m_oTiger ) ];
-		pFile->m_pNextTiger = *pHash;
-		*pHash = pFile;
+		m_pTigerMap.Add( FILE_HASH_KEY( pFile->m_oTiger ), pFile );
 	}
 
 	if ( pFile->m_oED2K )
 	{
-		CLibraryFile** pHash = &m_pED2KMap[ FILE_INDEX( pFile->m_oED2K ) ];
-		pFile->m_pNextED2K = *pHash;
-		*pHash = pFile;
+		m_pED2KMap.Add( FILE_HASH_KEY( pFile->m_oED2K ), pFile );
 	}
 
 	if ( pFile->m_oBTH )
 	{
-		CLibraryFile** pHash = &m_pBTHMap[ FILE_INDEX( pFile->m_oBTH ) ];
-		pFile->m_pNextBTH = *pHash;
-		*pHash = pFile;
+		m_pBTHMap.Add( FILE_HASH_KEY( pFile->m_oBTH ), pFile );
 	}
 
 	if ( pFile->m_oMD5 )
 	{
-		CLibraryFile** pHash = &m_pMD5Map[ FILE_INDEX( pFile->m_oMD5 ) ];
-		pFile->m_pNextMD5 = *pHash;
-		*pHash = pFile;
+		m_pMD5Map.Add( FILE_HASH_KEY( pFile->m_oMD5 ), pFile );
 	}
 }
 
@@ -650,87 +750,27 @@ void CLibraryMaps::OnFileRemove(CLibraryFile* pFile)
 
 	if ( pFile->m_oSHA1 )
 	{
-		CLibraryFile** pPrev = &m_pSHA1Map[ FILE_INDEX( pFile->m_oSHA1 ) ];
-
-		for ( CLibraryFile* pOther = *pPrev; pOther; pOther = pOther->m_pNextSHA1 )
-		{
-			if ( pOther == pFile )
-			{
-				*pPrev = pOther->m_pNextSHA1;
-				break;
-			}
-			pPrev = &pOther->m_pNextSHA1;
-		}
-
-		pFile->m_pNextSHA1 = NULL;
+		m_pSHA1Map.Remove( FILE_HASH_KEY( pFile->m_oSHA1 ), pFile );
 	}
 
 	if ( pFile->m_oTiger )
 	{
-		CLibraryFile** pPrev = &m_pTigerMap[ FILE_INDEX( pFile->m_oTiger ) ];
-
-		for ( CLibraryFile* pOther = *pPrev; pOther; pOther = pOther->m_pNextTiger )
-		{
-			if ( pOther == pFile )
-			{
-				*pPrev = pOther->m_pNextTiger;
-				break;
-			}
-			pPrev = &pOther->m_pNextTiger;
-		}
-
-		pFile->m_pNextTiger = NULL;
+		m_pTigerMap.Remove( FILE_HASH_KEY( pFile->m_oTiger ), pFile );
 	}
 
 	if ( pFile->m_oED2K )
 	{
-		CLibraryFile** pPrev = &m_pED2KMap[ FILE_INDEX( pFile->m_oED2K ) ];
-
-		for ( CLibraryFile* pOther = *pPrev; pOther; pOther = pOther->m_pNextED2K )
-		{
-			if ( pOther == pFile )
-			{
-				*pPrev = pOther->m_pNextED2K;
-				break;
-			}
-			pPrev = &pOther->m_pNextED2K;
-		}
-
-		pFile->m_pNextED2K = NULL;
+		m_pED2KMap.Remove( FILE_HASH_KEY( pFile->m_oED2K ), pFile );
 	}
 
 	if ( pFile->m_oBTH )
 	{
-		CLibraryFile** pPrev = &m_pBTHMap[ FILE_INDEX( pFile->m_oBTH ) ];
-
-		for ( CLibraryFile* pOther = *pPrev; pOther; pOther = pOther->m_pNextBTH )
-		{
-			if ( pOther == pFile )
-			{
-				*pPrev = pOther->m_pNextBTH;
-				break;
-			}
-			pPrev = &pOther->m_pNextBTH;
-		}
-
-		pFile->m_pNextBTH = NULL;
+		m_pBTHMap.Remove( FILE_HASH_KEY( pFile->m_oBTH ), pFile );
 	}
 
 	if ( pFile->m_oMD5 )
 	{
-		CLibraryFile** pPrev = &m_pMD5Map[ FILE_INDEX( pFile->m_oMD5 ) ];
-
-		for ( CLibraryFile* pOther = *pPrev; pOther; pOther = pOther->m_pNextMD5 )
-		{
-			if ( pOther == pFile )
-			{
-				*pPrev = pOther->m_pNextMD5;
-				break;
-			}
-			pPrev = &pOther->m_pNextMD5;
-		}
-
-		pFile->m_pNextMD5 = NULL;
+		m_pMD5Map.Remove( FILE_HASH_KEY( pFile->m_oMD5 ), pFile );
 	}
 }
 
@@ -23,8 +23,43 @@
 class CLibrary;
 class CQuerySearch;
 
-#define FILE_HASH_SIZE	512
-#define FILE_INDEX(x)	( *(WORD*)(&(x)[0]) & 511 )
+#define FILE_HASH_SIZE		512		// Initial hash table size (power of 2)
+#define FILE_HASH_KEY(x)	( *(const DWORD*)(&(x)[0]) )
+
+
+// Open-addressed multimap of files by hash (linear probing),
+// first hash DWORD is kept inline so probing doesn't touch CLibraryFile
+
+class CLibraryHashMap
+{
+public:
+	CLibraryHashMap();
+	~CLibraryHashMap();
+
+public:
+	void			Add(DWORD nKey, CLibraryFile* pFile);
+	void			Remove(DWORD nKey, const CLibraryFile* pFile);
+	void			RemoveAll();
+	CLibraryFile*	GetNext(DWORD nKey, DWORD& nPos) const;	// Files with same key, start with nPos = 0
+	DWORD			GetCount() const { return m_nCount; }
+
+protected:
+	struct Entry
+	{
+		DWORD			nKey;
+		CLibraryFile*	pFile;		// NULL for empty slot
+	};
+
+	Entry*			m_pTable;
+	DWORD			m_nMask;
+	DWORD			m_nCount;
+
+	void			Resize(DWORD nSize);
+
+private:
+	CLibraryHashMap(const CLibraryHashMap&);
+	CLibraryHashMap& operator=(const CLibraryHashMap&);
+};
 
 
 class CLibraryMaps : public CComObject
@@ -62,11 +97,11 @@ protected:
 	CIndexMap		m_pIndexMap;
 	CFileMap		m_pNameMap;
 	CFileMap		m_pPathMap;
-	CLibraryFile*	m_pSHA1Map[ FILE_HASH_SIZE ];
-	CLibraryFile*	m_pTigerMap[ FILE_HASH_SIZE ];
-	CLibraryFile*	m_pED2KMap[ FILE_HASH_SIZE ];
-	CLibraryFile*	m_pBTHMap[ FILE_HASH_SIZE ];
-	CLibraryFile*	m_pMD5Map[ FILE_HASH_SIZE ];
+	CLibraryHashMap	m_pSHA1Map;
+	CLibraryHashMap	m_pTigerMap;
+	CLibraryHashMap	m_pED2KMap;
+	CLibraryHashMap	m_pBTHMap;
+	CLibraryHashMap	m_pMD5Map;
 	CFileList		m_pDeleted;
 	DWORD			m_nNextIndex;
 	DWORD			m_nFiles;
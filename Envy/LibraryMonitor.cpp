@@ -0,0 +1,221 @@
+//
+// LibraryMonitor.cpp
+//
+// This file is part of Envy (getenvy.com)  2016-2020
+// Portions copyright Shareaza 2002-2007 and PeerProject 2008-2015
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+#include "StdAfx.h"
+#include "LibraryMonitor.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#define new DEBUG_NEW
+#endif	// Debug
+
+// Network shares refuse buffers larger than 64 KB
+#define MONITOR_BUFFER_SIZE		( 64 * 1024 )
+
+#define MONITOR_FILTER			( FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | \
+								  FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE )
+
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryMonitor construction
+
+CLibraryMonitor::CLibraryMonitor()
+	: m_hDirectory	( INVALID_HANDLE_VALUE )
+	, m_pBuffer 	( NULL )
+	, m_bPending	( FALSE )
+{
+	ZeroMemory( &m_pOverlapped, sizeof( m_pOverlapped ) );
+}
+
+CLibraryMonitor::~CLibraryMonitor()
+{
+	Close();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryMonitor open/close
+
+BOOL CLibraryMonitor::Open(LPCTSTR pszPath)
+{
+	Close();
+
+	m_hDirectory = CreateFile( SafePath( pszPath ), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+	if ( m_hDirectory == INVALID_HANDLE_VALUE )
+		return FALSE;
+
+	m_pOverlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+	m_pBuffer = new DWORD[ MONITOR_BUFFER_SIZE / sizeof( DWORD ) ];
+
+	if ( ! m_pOverlapped.hEvent || ! m_pBuffer || ! Request() )
+	{
+		Close();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CLibraryMonitor::Close()
+{
+	if ( m_hDirectory != INVALID_HANDLE_VALUE )
+	{
+		if ( m_bPending )
+		{
+			// Cancel outstanding request and wait for it, buffer is still in use by kernel
+			DWORD nIgnore;
+			CancelIo( m_hDirectory );
+			GetOverlappedResult( m_hDirectory, &m_pOverlapped, &nIgnore, TRUE );
+			m_bPending = FALSE;
+		}
+
+		CloseHandle( m_hDirectory );
+		m_hDirectory = INVALID_HANDLE_VALUE;
+	}
+
+	if ( m_pOverlapped.hEvent )
+	{
+		CloseHandle( m_pOverlapped.hEvent );
+		m_pOverlapped.hEvent = NULL;
+	}
+
+	delete [] m_pBuffer;
+	m_pBuffer = NULL;
+}
+
+BOOL CLibraryMonitor::Request()
+{
+	ASSERT( ! m_bPending );
+
+	ResetEvent( m_pOverlapped.hEvent );
+
+	if ( ! ReadDirectoryChangesW( m_hDirectory, m_pBuffer, MONITOR_BUFFER_SIZE,
+		TRUE, MONITOR_FILTER, NULL, &m_pOverlapped, NULL ) )
+		return FALSE;
+
+	m_bPending = TRUE;
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLibraryMonitor collect changes
+
+BOOL CLibraryMonitor::Poll()
+{
+	if ( ! IsOpen() )
+		return FALSE;
+
+	for ( ;; )
+	{
+		DWORD nLength = 0;
+		if ( ! GetOverlappedResult( m_hDirectory, &m_pOverlapped, &nLength, FALSE ) )
+		{
+			if ( GetLastError() == ERROR_IO_INCOMPLETE )
+				return TRUE;	// No more changes
+
+			// Folder removed, network share lost, etc.
+			m_bPending = FALSE;
+			Close();
+			ClearChanges();
+			return FALSE;
+		}
+
+		m_bPending = FALSE;
+
+		// Zero length means kernel buffer overflow, changes lost
+		const BOOL bComplete = ( nLength != 0 );
+
+		const BYTE* pData = (const BYTE*)m_pBuffer;
+		while ( bComplete && nLength >= sizeof( FILE_NOTIFY_INFORMATION ) )
+		{
+			const FILE_NOTIFY_INFORMATION* pInfo = (const FILE_NOTIFY_INFORMATION*)pData;
+
+			Add( pInfo->Action, CString( pInfo->FileName, pInfo->FileNameLength / sizeof( WCHAR ) ) );
+
+			if ( ! pInfo->NextEntryOffset || pInfo->NextEntryOffset > nLength )
+				break;
+
+			pData += pInfo->NextEntryOffset;
+			nLength -= pInfo->NextEntryOffset;
+		}
+
+		if ( ! Request() )
+		{
+			Close();
+			ClearChanges();
+			return FALSE;
+		}
+
+		if ( ! bComplete )
+		{
+			ClearChanges();
+			return FALSE;
+		}
+	}
+}
+
+void CLibraryMonitor::Add(DWORD nAction, const CString& strPath)
+{
+	// Orphan old name of rename pair means file moved out of monitored tree
+	if ( ! m_sRenamed.IsEmpty() && nAction != FILE_ACTION_RENAMED_NEW_NAME )
+	{
+		m_pChanges.AddTail( CChange( FILE_ACTION_REMOVED, m_sRenamed ) );
+		m_sRenamed.Empty();
+	}
+
+	switch ( nAction )
+	{
+	case FILE_ACTION_RENAMED_OLD_NAME:
+		m_sRenamed = strPath;
+		break;
+
+	case FILE_ACTION_RENAMED_NEW_NAME:
+		m_pChanges.AddTail( CChange( m_sRenamed.IsEmpty() ? FILE_ACTION_ADDED : FILE_ACTION_RENAMED_NEW_NAME, strPath, m_sRenamed ) );
+		m_sRenamed.Empty();
+		break;
+
+	case FILE_ACTION_MODIFIED:
+		// Writing file produces bursts of identical notifications
+		if ( ! m_pChanges.IsEmpty() &&
+			 m_pChanges.GetTail().m_nAction == FILE_ACTION_MODIFIED &&
+			 m_pChanges.GetTail().m_sPath.CompareNoCase( strPath ) == 0 )
+			break;
+		m_pChanges.AddTail( CChange( nAction, strPath ) );
+		break;
+
+	default:	// FILE_ACTION_ADDED, FILE_ACTION_REMOVED
+		m_pChanges.AddTail( CChange( nAction, strPath ) );
+	}
+}
+
+BOOL CLibraryMonitor::GetNextChange(CChange& oChange)
+{
+	if ( m_pChanges.IsEmpty() )
+		return FALSE;
+
+	oChange = m_pChanges.RemoveHead();
+	return TRUE;
+}
+
+void CLibraryMonitor::ClearChanges()
+{
+	m_pChanges.RemoveAll();
+	m_sRenamed.Empty();
+}
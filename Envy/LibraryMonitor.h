@@ -0,0 +1,62 @@
+//
+// LibraryMonitor.h
+//
+// This file is part of Envy (getenvy.com)  2016-2020
+// Portions copyright Shareaza 2002-2007 and PeerProject 2008-2015
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+#pragma once
+
+
+// Per-file change journal of a shared root folder (ReadDirectoryChangesW)
+
+class CLibraryMonitor
+{
+public:
+	CLibraryMonitor();
+	~CLibraryMonitor();
+
+public:
+	class CChange
+	{
+	public:
+		CChange(DWORD nAction = 0, LPCTSTR pszPath = L"", LPCTSTR pszOldPath = L"")
+			: m_nAction( nAction ), m_sPath( pszPath ), m_sOldPath( pszOldPath ) {}
+
+		DWORD		m_nAction;		// FILE_ACTION_ADDED, FILE_ACTION_REMOVED, FILE_ACTION_MODIFIED or FILE_ACTION_RENAMED_NEW_NAME
+		CString		m_sPath;		// Relative to monitored folder, "sub\name"
+		CString		m_sOldPath;		// Previous name of renamed file
+	};
+
+protected:
+	HANDLE		m_hDirectory;
+	OVERLAPPED	m_pOverlapped;
+	DWORD*		m_pBuffer;			// DWORD-aligned FILE_NOTIFY_INFORMATION records
+	BOOL		m_bPending;			// Asynchronous request issued
+	CString		m_sRenamed;			// Old name waiting for its FILE_ACTION_RENAMED_NEW_NAME pair
+	CList< CChange > m_pChanges;
+
+public:
+	BOOL		Open(LPCTSTR pszPath);			// Start monitoring folder tree
+	void		Close();
+	BOOL		IsOpen() const { return m_hDirectory != INVALID_HANDLE_VALUE; }
+	BOOL		Poll();							// Queue completed notifications. FALSE if some were lost (full scan needed)
+	BOOL		GetNextChange(CChange& oChange);
+	void		ClearChanges();
+	INT_PTR		GetChangeCount() const { return m_pChanges.GetCount(); }
+
+protected:
+	BOOL		Request();
+	void		Add(DWORD nAction, const CString& strPath);
+};
@@ -65,6 +65,8 @@ CManagedSearch::CManagedSearch(CQuerySearch* pSearch, int nPriority)
 	, m_tLastED2K	( 0 )
 	, m_tMoreResults( 0 )
 	, m_tExecute	( 0 )
+	, m_pG2Done		( NULL )
+	, m_tG2Done		( 0 )
 {
 	m_dwRef = 0;
 }
@@ -73,6 +75,8 @@ CManagedSearch::~CManagedSearch()
 {
 	DEBUG_ONLY( CQuickLock( SearchManager.m_pSection ) );
 	ASSERT( SearchManager.m_pList.Find( this ) == NULL );
+
+	delete m_pG2Done;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -143,6 +147,7 @@ void CManagedSearch::Start()
 		m_tLastED2K		= 0;
 		m_tMoreResults	= 0;
 		m_nQueryCount	= 0;
+		m_tG2Done		= 0;
 		m_pNodes.RemoveAll();
 	}
 }
@@ -417,14 +422,39 @@ BOOL CManagedSearch::ExecuteG2Mesh(const DWORD /*tTicks*/, const DWORD tSecs)
 {
 	ASSUME_LOCK( SearchManager.m_pSection );
 
-	// Look at all known Gnutella2 hubs, newest first
+	// Per-hub re-query time
+	DWORD nFrequency;
+
+	if ( m_nPriority >= spLowest )
+	{
+		// Low priority "auto find" sources
+		if ( m_pSearch->m_oSHA1 )		// Has SHA1- probably exists on G2
+			nFrequency = 16 * 60 * 60;
+		else							// Reduce frequency if no SHA1.
+			nFrequency = 32 * 60 * 60;
+	}
+	else
+		nFrequency = Settings.Gnutella2.RequeryDelay * ( m_nPriority + 1 );
 
 	CQuickLock oLock( HostCache.Gnutella2.m_pSection );
 
-	for ( CHostCacheIterator i = HostCache.Gnutella2.Begin();
-		i != HostCache.Gnutella2.End(); ++i )
+	// Hubs found recently queried are skipped without lookup,
+	// until they may be due again or the filter outgrows its size
+	if ( ! m_pG2Done )
+		m_pG2Done = new CHostQueryFilter;
+	if ( tSecs - m_tG2Done >= nFrequency || m_pG2Done->IsFull() )
 	{
-		CHostCacheHostPtr pHost = (*i);
+		m_pG2Done->Clear( HostCache.Gnutella2.GetCount() );
+		m_tG2Done = tSecs;
+	}
+
+	// Look at Gnutella2 hubs that can be queried now, longest waiting first
+
+	for ( CHostQueryIterator i = HostCache.Gnutella2.QueryBegin(); ; )
+	{
+		CHostCacheHostPtr pHost = HostCache.Gnutella2.GetNextQuery( i, tSecs, m_pG2Done );
+		if ( ! pHost )
+			break;
 
 		// Must be Gnutella2
 		ASSERT( pHost->m_nProtocol == PROTOCOL_G2 );
@@ -433,10 +463,6 @@ BOOL CManagedSearch::ExecuteG2Mesh(const DWORD /*tTicks*/, const DWORD tSecs)
 		if ( Neighbours.Get( pHost->m_pAddress ) )
 			continue;
 
-		// If this host can't be queried now, don't query it
-		if ( ! pHost->CanQuery( tSecs ) )
-			continue;
-
 		// Check if we have an appropriate query key for this host,
 		// and if so, record the receiver address
 		SOCKADDR_IN* pReceiver = NULL;
@@ -478,34 +504,23 @@ BOOL CManagedSearch::ExecuteG2Mesh(const DWORD /*tTicks*/, const DWORD tSecs)
 			DWORD tLastQuery;
 			ASSERT( pReceiver != NULL );
 
-			// Lookup the host
-			if ( m_pNodes.Lookup( pHost->m_pAddress.s_addr, tLastQuery ) )
+			// Lookup the host, check per-hub re-query time
+			if ( m_pNodes.Lookup( pHost->m_pAddress.s_addr, tLastQuery ) &&
+				 tSecs - tLastQuery < nFrequency )
 			{
-				// Check per-hub re-query time
-				DWORD nFrequency;
-
-				if ( m_nPriority >= spLowest )
-				{
-					// Low priority "auto find" sources
-					if ( m_pSearch->m_oSHA1 )		// Has SHA1- probably exists on G2
-						nFrequency = 16 * 60 * 60;
-					else							// Reduce frequency if no SHA1.
-						nFrequency = 32 * 60 * 60;
-				}
-				else
-					nFrequency = Settings.Gnutella2.RequeryDelay * ( m_nPriority + 1 );
-
-				if ( tSecs - tLastQuery < nFrequency )
-					continue;
+				m_pG2Done->Add( pHost->m_pAddress.s_addr );
+				continue;
 			}
 
 			// Set the last query time for this host for this search
 			m_pNodes.SetAt( pHost->m_pAddress.s_addr, tSecs );
+			m_pG2Done->Add( pHost->m_pAddress.s_addr );
 
 			// Record the query time on the host, for all searches
 			pHost->m_tQuery = tSecs;
 			if ( pHost->m_tAck == 0 )
 				pHost->m_tAck = tSecs;
+			HostCache.Gnutella2.QueueQuery( pHost );
 
 			// Try to create a packet
 			m_pSearch->m_bAndG1 = ( Settings.Gnutella1.Enabled && m_bAllowG1 );
@@ -574,6 +589,7 @@ BOOL CManagedSearch::ExecuteG2Mesh(const DWORD /*tTicks*/, const DWORD tSecs)
 							pHost->m_tAck = tSecs;
 						pHost->m_tKeyTime = tSecs;
 						pHost->m_nKeyValue = 0;
+						HostCache.Gnutella2.QueueQuery( pHost );
 
 						theApp.Message( MSG_DEBUG | MSG_FACILITY_SEARCH, L"Requesting query key from %s through %s",
 							(LPCTSTR)CString( inet_ntoa( pHost->m_pAddress ) ), (LPCTSTR)CString( inet_ntoa( pReceiver->sin_addr ) ) );
@@ -600,6 +616,7 @@ BOOL CManagedSearch::ExecuteG2Mesh(const DWORD /*tTicks*/, const DWORD tSecs)
 							pHost->m_tAck = tSecs;
 						pHost->m_tKeyTime = tSecs;
 						pHost->m_nKeyValue = 0;
+						HostCache.Gnutella2.QueueQuery( pHost );
 
 						if ( pReceiver == &Network.m_pHost )
 						{
@@ -656,7 +673,7 @@ BOOL CManagedSearch::ExecuteDonkeyMesh(const DWORD /*tTicks*/, const DWORD tSecs
 		pHost->m_tQuery = tSecs;
 
 		// Create a packet in the appropriate format
-		if ( CPacket* pPacket = m_pSearch->ToEDPacket( TRUE, pHost->m_nUDPFlags ) )
+		if ( CPacket* pPacket = m_pSearch->ToEDPacket( TRUE, pHost->Extra().m_nUDPFlags ) )
 		{
 			// Send the datagram if possible
 			if ( Datagrams.Send( &pHost->m_pAddress, pHost->m_nPort + 4, pPacket, TRUE ) )
@@ -679,6 +696,9 @@ void CManagedSearch::OnHostAcknowledge(DWORD nAddress)
 	ASSUME_LOCK( SearchManager.m_pSection );
 
 	m_pNodes.SetAt( nAddress, static_cast< DWORD >( time( NULL ) ) );
+
+	if ( m_pG2Done )
+		m_pG2Done->Add( nAddress );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -23,6 +23,7 @@
 class CPacket;
 class CNeighbour;
 class CManagedSearch;
+class CHostQueryFilter;
 
 typedef CComObjectPtr< CManagedSearch > CSearchPtr;
 
@@ -104,6 +105,8 @@ protected:
 	CQuerySearchPtr m_pSearch;				// Search handler
 	CDwordDwordMap	m_pNodes;				// Pair of IP and query time (s)
 	CDwordDwordMap	m_pG1Nodes;				// Pair of IP and last sent packet TTL
+	CHostQueryFilter* m_pG2Done;			// G2 hubs in m_pNodes queried within the re-query time (bloom filter)
+	DWORD			m_tG2Done;				// Time m_pG2Done was last cleared (s)
 
 	BOOL	ExecuteNeighbours(const DWORD tTicks, const DWORD tSecs);
 	BOOL	ExecuteG1Mesh(const DWORD tTicks = 0, const DWORD tSecs = 0);
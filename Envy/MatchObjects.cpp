@@ -200,6 +200,10 @@ void CMatchList::AddHits(const CQueryHit* pHits, const CQuerySearch* pFilter)
 {
 	CSingleLock pLock( &m_pSection, TRUE );
 	CMatchFile** pMap = NULL;
+
+	// New files and files whose sort key changed, placed once after the batch
+	CArray< CMatchFile* > pPending;
+	DWORD nNew = 0;
 	for ( const CQueryHit* pNext = pHits; pNext; pNext = pNext->m_pNext )
 	{
 		// Empty file names mean a hit for the currently downloading file.
@@ -292,24 +296,10 @@ void CMatchList::AddHits(const CQueryHit* pHits, const CQuerySearch* pFilter)
 
 		if ( pFile )	// New hit for an existing file
 		{
-			pMap = m_pFiles;
-			for ( DWORD nCount = m_nFiles; nCount; nCount--, pMap++ )
+			if ( ! pFile->m_bPending )
 			{
-				if ( *pMap == pFile )
-				{
-					if ( m_nSortColumn >= 0 )
-					{
-						UpdateRange( m_nFiles - nCount );
-						MoveMemory( pMap, pMap + 1, ( nCount - 1 ) * sizeof *pMap );
-						m_nFiles--;
-						InsertSorted( pFile );
-					}
-					else
-					{
-						UpdateRange( m_nFiles - nCount, m_nFiles - nCount );
-					}
-					break;
-				}
+				pFile->m_bPending = TRUE;
+				pPending.Add( pFile );
 			}
 		}
 		else	// New file hit
@@ -326,16 +316,17 @@ void CMatchList::AddHits(const CQueryHit* pHits, const CQuerySearch* pFilter)
 
 			pFile->m_bNew = m_bNew;
 
-			if ( m_nFiles + 1 > m_nBuffer )
+			if ( m_nFiles + nNew + 1 > m_nBuffer )
 			{
-				if ( CMatchFile** pFiles = new CMatchFile*[ m_nBuffer + BUFFER_GROW ] )
+				const DWORD nBuffer = m_nBuffer + max( (DWORD)BUFFER_GROW, m_nBuffer / 2 );
+				if ( CMatchFile** pFiles = new CMatchFile*[ nBuffer ] )
 				{
 					if ( m_pFiles )
 					{
 						CopyMemory( pFiles, m_pFiles, m_nFiles * sizeof( CMatchFile* ) );
 						delete [] m_pFiles;
 					}
-					m_nBuffer += BUFFER_GROW;
+					m_nBuffer = nBuffer;
 					m_pFiles = pFiles;
 				}
 				else	// Out of memory
@@ -349,15 +340,9 @@ void CMatchList::AddHits(const CQueryHit* pHits, const CQuerySearch* pFilter)
 			pFile->m_pNextSize = *pMap;
 			*pMap = pFile;
 
-			if ( m_nSortColumn >= 0 )
-			{
-				InsertSorted( pFile );
-			}
-			else
-			{
-				UpdateRange( m_nFiles );
-				m_pFiles[ m_nFiles++ ] = pFile;
-			}
+			pFile->m_bPending = TRUE;
+			pPending.Add( pFile );
+			nNew++;
 		}
 
 		if ( ! Stats.bHadSHA1 && pFile->m_oSHA1 )
@@ -392,6 +377,9 @@ void CMatchList::AddHits(const CQueryHit* pHits, const CQuerySearch* pFilter)
 		}
 	}
 
+	if ( ! pPending.IsEmpty() )
+		InsertSorted( pPending.GetData(), (DWORD)pPending.GetCount() );
+
 	UpdateStats();
 }
 
@@ -509,23 +497,111 @@ CMatchFile* CMatchList::FindFileAndAddHit(CQueryHit* pHit, const findType nFindF
 //////////////////////////////////////////////////////////////////////
 // CMatchList insert to a sorted array
 
-void CMatchList::InsertSorted(CMatchFile* pFile)
+// Orders files as InsertSorted does: pA goes before pB unless pB sorts after it
+struct CMatchFileBefore
 {
-	int nFirst = 0;
-	for ( int nLast = m_nFiles - 1; nLast >= nFirst; )
+	CMatchFileBefore(int nSortDir) : m_nSortDir( nSortDir ) {}
+
+	inline bool operator()(CMatchFile* pA, CMatchFile* pB) const
+	{
+		return pB->Compare( pA ) == m_nSortDir;
+	}
+
+	int m_nSortDir;
+};
+
+void CMatchList::InsertSorted(CMatchFile** ppFiles, DWORD nCount)
+{
+	// Files already in the list have m_bPending set, new ones also but not listed yet,
+	// buffer has room for all new ones.  One pass per batch instead of one per hit.
+
+	if ( m_nSortColumn < 0 )
+	{
+		// Unsorted: changed files stay in place, new files go to the end
+		for ( DWORD nFile = 0; nFile < m_nFiles; nFile++ )
+		{
+			if ( m_pFiles[ nFile ]->m_bPending )
+			{
+				m_pFiles[ nFile ]->m_bPending = FALSE;
+				UpdateRange( nFile, nFile );
+			}
+		}
+
+		for ( DWORD nFile = 0; nFile < nCount; nFile++ )
+		{
+			if ( ppFiles[ nFile ]->m_bPending )
+			{
+				ppFiles[ nFile ]->m_bPending = FALSE;
+				UpdateRange( m_nFiles );
+				m_pFiles[ m_nFiles++ ] = ppFiles[ nFile ];
+			}
+		}
+
+		return;
+	}
+
+	// Take changed files out, keeping order of the rest
+	DWORD nFirst = m_nFiles;
+	DWORD nKept = 0;
+	for ( DWORD nFile = 0; nFile < m_nFiles; nFile++ )
 	{
-		DWORD nMiddle = ( nFirst + nLast ) >> 1;
+		CMatchFile* pFile = m_pFiles[ nFile ];
+		if ( pFile->m_bPending )
+		{
+			if ( nFirst > nFile )
+				nFirst = nFile;
+		}
+		else
+		{
+			m_pFiles[ nKept++ ] = pFile;
+		}
+	}
+
+	std::sort( ppFiles, ppFiles + nCount, CMatchFileBefore( m_bSortDir ) );
 
-		if ( pFile->Compare( m_pFiles[ nMiddle ] ) == m_bSortDir )
-			nFirst = nMiddle + 1;
+	// Merge from the back
+	DWORD nTo = nKept + nCount;
+	DWORD nFrom = nKept;
+	for ( DWORD nNext = nCount; nNext; )
+	{
+		CMatchFile* pFile = ppFiles[ nNext - 1 ];
+		if ( nFrom == 0 || pFile->Compare( m_pFiles[ nFrom - 1 ] ) == m_bSortDir )
+		{
+			pFile->m_bPending = FALSE;
+			m_pFiles[ --nTo ] = pFile;
+			nNext--;
+		}
 		else
-			nLast = nMiddle - 1;
+		{
+			m_pFiles[ --nTo ] = m_pFiles[ --nFrom ];
+		}
 	}
 
-	MoveMemory( m_pFiles + nFirst + 1, m_pFiles + nFirst, ( m_nFiles - nFirst ) * sizeof *m_pFiles );
-	m_pFiles[ nFirst ] = pFile;
-	m_nFiles++;
-	UpdateRange( nFirst );
+	m_nFiles = nKept + nCount;
+	UpdateRange( min( nFirst, nTo ) );
+}
+
+// Insertion sort for lists that are already nearly in order (flipped direction, refiltered)
+
+BOOL CMatchList::SortInsertion(DWORD nBudget)
+{
+	for ( DWORD nIndex = 1; nIndex < m_nFiles; nIndex++ )
+	{
+		CMatchFile* pCurrent = m_pFiles[ nIndex ];
+		DWORD nIndex2 = nIndex;
+		for ( ; nIndex2 && m_pFiles[ nIndex2 - 1 ]->Compare( pCurrent ) == m_bSortDir; nIndex2-- )
+		{
+			if ( ! nBudget-- )
+			{
+				m_pFiles[ nIndex2 ] = pCurrent;
+				return FALSE;
+			}
+			m_pFiles[ nIndex2 ] = m_pFiles[ nIndex2 - 1 ];
+		}
+		m_pFiles[ nIndex2 ] = pCurrent;
+	}
+
+	return TRUE;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -986,11 +1062,24 @@ void CMatchList::SelectSchema(CSchemaPtr pSchema, CSchemaMemberList* pColumns)
 
 void CMatchList::SetSortColumn(int nColumn, BOOL bDirection)
 {
+	const BOOL bReverse = ( nColumn >= 0 && nColumn == m_nSortColumn && m_bSortDir != ( bDirection ? -1 : 1 ) );
+
 	m_nSortColumn	= nColumn;
 	m_bSortDir		= bDirection ? -1 : 1;
 
 	if ( m_nSortColumn < 0 || ! m_nFiles ) return;
 
+	// Same column, other direction: reversed list is almost in order already
+	if ( bReverse )
+		std::reverse( m_pFiles, m_pFiles + m_nFiles );
+
+	// Usually only a few files moved since last sort, avoid full quicksort
+	if ( SortInsertion( m_nFiles ) )
+	{
+		UpdateRange();
+		return;
+	}
+
 	int nFirst		= 0;
 	int nLast		= m_nFiles - 1;
 	DWORD nStack	= 0;
@@ -1332,6 +1421,7 @@ CMatchFile::CMatchFile(CMatchList* pList, CQueryHit* pHit)
 	, m_bDownload		( FALSE )
 	, m_bNew			( FALSE )
 	, m_bOneValid		( FALSE )
+	, m_bPending		( FALSE )
 	, m_nShellIndex		( -1 )
 	, m_nColumns		( 0 )
 	, m_pColumns		( NULL )
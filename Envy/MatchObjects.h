@@ -142,7 +142,8 @@ public:
 
 protected:
 	CMatchFile* FindFileAndAddHit(CQueryHit* pHit, const findType nFindFlag, FILESTATS* Stats);
-	void		InsertSorted(CMatchFile* pFile);
+	void		InsertSorted(CMatchFile** ppFiles, DWORD nCount);	// Place new and changed files at once
+	BOOL		SortInsertion(DWORD nBudget);	// Finish a nearly sorted list, FALSE if too many moves
 	BOOL		FilterHit(CQueryHit* pHit);
 
 	friend class CMatchFile;
@@ -186,6 +187,7 @@ public:
 	BOOL		m_bDownload;
 	BOOL		m_bNew;
 	BOOL		m_bOneValid;
+	BOOL		m_bPending;				// Waiting for CMatchList::InsertSorted
 	int			m_nShellIndex;
 	int			m_nColumns;
 	CString*	m_pColumns;
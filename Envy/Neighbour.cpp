@@ -48,6 +48,15 @@ static char THIS_FILE[] = __FILE__;
 #endif	// Debug
 
 #define Z_TIMER 200		// 1/5th of a second
+#define Z_SAMPLE	65536	// Bytes fed to zlib between level reviews
+#define Z_POOR		95		// Output/input percentage not worth deflating (already compressed payloads)
+#define Z_PROBE		8		// Reviews at level 0 before trying to compress again
+#define Z_BUSY		4096	// Links sending faster than this (B/s) step down first when over budget
+
+// Deflate time of all links, network thread (us)
+static QWORD nZLibTime = 0;		// This second
+static QWORD nZLibLoad = 0;		// Last second
+static DWORD tZLibLoad = 0;
 
 //////////////////////////////////////////////////////////////////////
 // CNeighbour construction
@@ -96,9 +105,17 @@ CNeighbour::CNeighbour(PROTOCOLID nProtocol)
 	, m_pZSInput		( NULL )
 	, m_pZSOutput		( NULL )
 	, m_bZFlush 		( FALSE )
+	, m_bZPending		( FALSE )
 	, m_bZInputEOS		( FALSE )
 	, m_tZOutput		( 0 )
+	, m_nZLevel 		( 0 )
+	, m_nZSampleIn		( 0 )
+	, m_nZSampleOut		( 0 )
+	, m_nZProbe 		( 0 )
+	, m_nZTime			( 0 )
 {
+	ZeroMemory( m_nLostByClass, sizeof( m_nLostByClass ) );
+
 	m_bAutoDelete = TRUE;
 }
 
@@ -145,9 +162,17 @@ CNeighbour::CNeighbour(PROTOCOLID nProtocol, CNeighbour* pBase)
 	, m_pZSInput		( NULL )
 	, m_pZSOutput		( NULL )
 	, m_bZFlush 		( pBase->m_bZFlush )
+	, m_bZPending		( FALSE )
 	, m_bZInputEOS		( pBase->m_bZInputEOS )
 	, m_tZOutput		( pBase->m_tZOutput )
+	, m_nZLevel 		( 0 )
+	, m_nZSampleIn		( 0 )
+	, m_nZSampleOut		( 0 )
+	, m_nZProbe 		( 0 )
+	, m_nZTime			( 0 )
 {
+	CopyMemory( m_nLostByClass, pBase->m_nLostByClass, sizeof( m_nLostByClass ) );
+
 	AttachTo( pBase );
 
 	pBase->m_pZInput  = NULL;
@@ -387,7 +412,8 @@ BOOL CNeighbour::OnWrite()
 	{
 		// Zero the z_stream structure and set it up for compression
 		ZeroMemory( m_pZSOutput, sizeof(z_stream) );
-		if ( deflateInit( m_pZSOutput, Settings.Connection.ZLibCompressionLevel ) != Z_OK )
+		m_nZLevel = (int)Settings.Connection.ZLibCompressionLevel;
+		if ( deflateInit( m_pZSOutput, m_nZLevel ) != Z_OK )
 		{
 			// There was an error setting up zlib, clean up and leave now
 			delete m_pZSOutput;
@@ -409,13 +435,21 @@ BOOL CNeighbour::OnWrite()
 			return TRUE;	// Return true if there is still more to send after this (do)
 	}
 
-	// If it's been more than 2 seconds since we've flushed the compressed output buffer to the remote computer, set the flag to do it next
 	const DWORD tNow = GetTickCount();
-	if ( tNow >= m_tZOutput + Z_TIMER )
+	if ( tNow - tZLibLoad >= 1000 )
+	{
+		nZLibLoad = nZLibTime;
+		nZLibTime = 0;
+		tZLibLoad = tNow;
+	}
+
+	// Batch packets into one sync flush per Z_TIMER, instead of flushing each write
+	if ( m_bZPending && tNow - m_tZOutput >= Z_TIMER )
 		m_bZFlush = TRUE;
 
 	// Loop until all the data in ZOutput has been compressed into Output
 	while ( ( m_pZOutput->m_nLength && ! pOutput->m_nLength )		// ZOutput has data to compress and Output is empty
+		|| ( m_bZFlush && ! pOutput->m_nLength )					// Or, zlib holds data waiting for the flush
 		|| m_pZSOutput->avail_out == 0 )							// Or, zlib says it has no more room left (do)
 	{
 		// Make sure the output buffer is 1 KB (do)
@@ -428,29 +462,38 @@ BOOL CNeighbour::OnWrite()
 		m_pZSOutput->next_out	= pOutput->m_pBuffer + pOutput->m_nLength;	// Start next_out and avail_out on the empty space in Output
 		m_pZSOutput->avail_out	= pOutput->GetBufferSize() - pOutput->m_nLength;
 
-		// Call zlib inflate to decompress the contents of m_pInput into the end of m_pZInput
+		// Call zlib deflate to compress the contents of m_pZOutput into the end of m_pOutput, timing it for the CPU budget
+		const __int64 tStart = GetMicroCount();
 		CBuffer::Deflate( m_pZSOutput, m_bZFlush ? Z_SYNC_FLUSH : Z_NO_FLUSH );		// Zlib adjusts next in, avail in, next out, and avail out to record what it did
+		const QWORD nTime = (QWORD)( GetMicroCount() - tStart );
+		m_nZTime += nTime;
+		nZLibTime += nTime;
 
 		// Add the number of uncompressed bytes that zlib compressed to the m_nZOutput count
-		m_nZOutput += m_pZOutput->m_nLength - m_pZSOutput->avail_in;
+		const DWORD nInput = m_pZOutput->m_nLength - m_pZSOutput->avail_in;
+		m_nZOutput += nInput;
+		m_nZSampleIn += nInput;
+		if ( nInput )
+			m_bZPending = TRUE;
 
 		// Remove the chunk that zlib compressed from the start of ZOutput
-		m_pZOutput->Remove( m_pZOutput->m_nLength - m_pZSOutput->avail_in );
+		m_pZOutput->Remove( nInput );
 
 		// Set nOutput to the size of the new compressed block in the output buffer between the data already there, and the empty space afterwards
 		int nOutput = ( pOutput->GetBufferSize() - pOutput->m_nLength ) - m_pZSOutput->avail_out;
 
-		// Zlib compressed something
-		if ( nOutput )
+		// Zlib compressed something, add the new block to the length
+		pOutput->m_nLength += nOutput;
+		m_nZSampleOut += nOutput;
+
+		// Zlib took all input and had room left, so the flush is complete
+		if ( m_bZFlush && ! m_pZOutput->m_nLength && m_pZSOutput->avail_out )
 		{
-			// Add the new block to the length, and record when this happened
-			pOutput->m_nLength += nOutput;
+			m_bZFlush = FALSE;
+			m_bZPending = FALSE;
 			m_tZOutput = tNow;
-		}
-		else if ( m_bZFlush )
-		{
-			// Zlib didn't compress anything, and the flush flag is true
-			m_bZFlush = FALSE;		// Make the flush flag false
+
+			AdjustCompression( pOutput );
 		}
 
 		// Send the contents of the output buffer to the remote computer
@@ -588,6 +631,61 @@ void CNeighbour::GetCompression(float& nInRate, float& nOutRate) const
 	}
 }
 
+// Report the current outgoing deflate level and time spent deflating for this link
+void CNeighbour::GetCompressionCost(int& nLevel, DWORD& nTime) const
+{
+	nLevel = m_pZSOutput ? m_nZLevel : -1;
+	nTime = (DWORD)( m_nZTime / 1000 );		// ms
+}
+
+// Pick the deflate level for this link from its compressibility, its traffic and the CPU spent by all links
+// Called right after a sync flush, when zlib holds no pending input
+void CNeighbour::AdjustCompression(CBuffer* pOutput)
+{
+	if ( m_nZSampleIn < Z_SAMPLE )
+		return;
+
+	const int nMax = (int)Settings.Connection.ZLibCompressionLevel;
+	const QWORD nBudget = (QWORD)Settings.Connection.ZLibCPUBudget * 1000;	// us per second
+	int nLevel = m_nZLevel;
+
+	if ( nLevel == 0 )
+	{
+		// Stored blocks tell nothing about the payload, try compressing again now and then
+		if ( ++m_nZProbe >= Z_PROBE )
+			nLevel = 1;
+	}
+	else if ( (QWORD)m_nZSampleOut * 100 >= (QWORD)m_nZSampleIn * Z_POOR )
+	{
+		// Already compressed payloads, deflate only costs CPU here
+		nLevel = 0;
+		m_nZProbe = 0;
+	}
+	else if ( nZLibLoad > nBudget )
+	{
+		// Over budget, busy links account for most of the deflate time
+		if ( m_mOutput.nMeasure >= Z_BUSY )
+			nLevel = max( nLevel - 1, 1 );
+	}
+	else if ( nZLibLoad < nBudget / 2 )
+	{
+		nLevel++;
+	}
+
+	nLevel = min( nLevel, nMax );
+
+	m_nZSampleIn = m_nZSampleOut = 0;
+
+	if ( nLevel == m_nZLevel )
+		return;
+
+	// deflateParams() may emit a block boundary, keep it in the output buffer
+	const uInt nAvail = m_pZSOutput->avail_out;
+	if ( deflateParams( m_pZSOutput, nLevel, Z_DEFAULT_STRATEGY ) == Z_OK )
+		m_nZLevel = nLevel;
+	pOutput->m_nLength += nAvail - m_pZSOutput->avail_out;
+}
+
 DWORD CNeighbour::GetMaxTTL() const
 {
 	return ( m_nMaxTTL != (DWORD)-1 ) ?
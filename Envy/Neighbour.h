@@ -103,6 +103,7 @@ public:
 	DWORD		m_nOutputCount;
 	DWORD		m_nDropCount;
 	DWORD		m_nLostCount;
+	DWORD		m_nLostByClass[ 4 ];	// Lost by CPacketBuffer class: control, hits, pushes, queries
 	DWORD		m_nOutbound;
 
 	// If the remote computer sends us a pong packet it made, copy the sharing statistics here
@@ -124,12 +125,19 @@ protected:
 	z_streamp	m_pZSInput;				// Pointer to the zlib z_stream structure for decompression
 	z_streamp	m_pZSOutput;			// Pointer to the zlib z_stream structure for compression
 	BOOL		m_bZFlush;				// True to flush the compressed output buffer to the remote computer
-	DWORD		m_tZOutput;				// The time that Zlib last compressed something
+	BOOL		m_bZPending;			// Zlib holds data fed since the last flush
+	DWORD		m_tZOutput;				// The time of the last sync flush
+	int			m_nZLevel;				// Deflate level currently used for this link
+	DWORD		m_nZSampleIn;			// Bytes fed to zlib since the level was last reviewed
+	DWORD		m_nZSampleOut;			// Bytes zlib produced from them
+	DWORD		m_nZProbe;				// Reviews spent at level 0 since compressibility was last probed
+	QWORD		m_nZTime;				// Time spent deflating for this link (us)
 	BOOL		m_bZInputEOS;			// Got End Of Stream while decompressing incoming data
 
 public:
 	DWORD		GetMaxTTL() const;		// Get maximum TTL which is safe for both sides
 	void		GetCompression(float& nInRate, float& nOutRate) const;	// Calculate average compression rate in either direction for this connection
+	void		GetCompressionCost(int& nLevel, DWORD& nTime) const;	// Current outgoing deflate level and deflate time so far (ms)
 
 	virtual DWORD GetUserCount() const { return 0; }	// Returns hub/server leaf/user count variable
 	virtual DWORD GetUserLimit() const { return 0; }	// Returns hub/server leaf/user limit variable
@@ -150,4 +158,6 @@ protected:
 	virtual BOOL OnWrite();
 	virtual BOOL OnCommonHit(CPacket* pPacket);
 	virtual BOOL OnCommonQueryHash(CPacket* pPacket);
+
+	void		AdjustCompression(CBuffer* pOutput);	// Review the deflate level at a flush boundary
 };
@@ -28,6 +28,7 @@
 #include "Network.h"
 #include "Datagrams.h"
 #include "QuerySearch.h"
+#include "Security.h"
 #include "G1Packet.h"
 #include "G2Packet.h"
 #include "Statistics.h"
@@ -49,13 +50,6 @@ CNeighboursWithRouting::~CNeighboursWithRouting()
 {
 }
 
-void CNeighboursWithRouting::Connect()
-{
-	CNeighboursWithED2K::Connect();
-
-	m_pQueries.RemoveAll();
-}
-
 //////////////////////////////////////////////////////////////////////
 // CNeighboursWithRouting packet broadcasting
 
@@ -72,6 +66,9 @@ int CNeighboursWithRouting::Broadcast(CPacket* pPacket, CNeighbour* pExcept, BOO
 	if ( ! pLock.Lock( 150 ) )
 		return 0;
 
+	// Serialize once, every neighbour copies the same bytes
+	pPacket->Encode();
+
 	// Count how many neighbours we will send this packet to
 	int nCount = 0;
 	bool bSend = true;
@@ -100,24 +97,8 @@ int CNeighboursWithRouting::Broadcast(CPacket* pPacket, CNeighbour* pExcept, BOO
 
 bool CNeighboursWithRouting::CheckQuery(const CQuerySearch* pSearch)
 {
-	CIPTime pThisQuery;
-	pThisQuery.m_pAddress = pSearch->m_pEndpoint.sin_addr;
-	pThisQuery.m_nTime = GetTickCount();
-
-	for ( POSITION pos = m_pQueries.GetHeadPosition(); pos; )
-	{
-		POSITION posOrig = pos;
-		const CIPTime& pLastQuery = m_pQueries.GetNext( pos );
-
-		if ( pThisQuery.m_nTime >= pLastQuery.m_nTime + 5 * 1000 )	// Maximum 1 query per 5 seconds
-			m_pQueries.RemoveAt( posOrig );		// Remove old
-		else if ( pThisQuery.m_pAddress.s_addr == pLastQuery.m_pAddress.s_addr )
-			return false;	// Too early
-	}
-
-	m_pQueries.AddHead( pThisQuery );
-
-	return true;
+	// Maximum 1 query per Settings.Gnutella*.QueryFlood (5 seconds)
+	return ! Security.IsQueryFlood( &pSearch->m_pEndpoint.sin_addr, pSearch->m_nProtocol );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -143,6 +124,9 @@ int CNeighboursWithRouting::RouteQuery(const CQuerySearch* pSearch, CPacket* pPa
 	// Make sure that the packet is either for Gnutella or Gnutella2, and one of the pointers points to it
 	ASSERT( pG1 || pG2 );
 
+	// Serialize once, every neighbour copies the same bytes
+	pPacket->Encode();
+
 	// It's a Gnutella2 packet
 	if ( pG2 )
 	{
@@ -182,6 +166,8 @@ int CNeighboursWithRouting::RouteQuery(const CQuerySearch* pSearch, CPacket* pPa
 						// Turn it into a Gnutella packet (do)
 						pG1 = pSearch->ToG1Packet();
 					}
+
+					if ( pG1 ) pG1->Encode();
 				}
 
 				// Send the packet to this connected Gnutella computer
@@ -267,6 +253,8 @@ int CNeighboursWithRouting::RouteQuery(const CQuerySearch* pSearch, CPacket* pPa
 				*pPtr++ = (BYTE)( ( Network.m_pHost.sin_port >> 8 ) & 0xFF );
 				*pPtr++ = (BYTE)( Network.m_pHost.sin_port & 0xFF );
 			}
+
+			pG2->Encode();
 		}
 
 		// Loop through all the computers we're connected to
@@ -35,22 +35,11 @@ protected:
 	CNeighboursWithRouting();			// Constructor and destructor don't do anything
 	virtual ~CNeighboursWithRouting();
 
-protected:
-	typedef struct
-	{
-		IN_ADDR	m_pAddress;
-		DWORD	m_nTime;
-	} CIPTime;
-
-	CList< CIPTime > m_pQueries;
-
 public:
-	virtual void Connect();
-
 	// Send a packet to all the computers we're connected to
 	int Broadcast(CPacket* pPacket, CNeighbour* pExcept = NULL, BOOL bGGEP = FALSE);
 
-	// Limit queries by endpoint addresses
+	// Limit queries by endpoint addresses (shared CSecurity flood filter)
 	bool CheckQuery(const CQuerySearch* pSearch);
 
 	// Send a query packet to all the computers we're connected to, translating it to Gnutella and Gnutella2 for computers running that software
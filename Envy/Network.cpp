@@ -117,6 +117,7 @@ CNetwork::CNetwork()
 	, m_bConnected			( false )
 	, m_bUPnPPortsForwarded	( TRI_UNKNOWN )
 	, m_tUPnPMap			( 0 )
+	, m_nJobHits			( 0 )
 {
 	m_pHost.sin_family = AF_INET;
 	m_sAddress.Format( L"0.0.0.0:%u" + Settings.Connection.InPort );
@@ -1215,9 +1216,46 @@ void CNetwork::OnQuerySearch(CLocalSearch* pSearch)
 
 void CNetwork::OnQueryHits(CQueryHit* pHits)
 {
+	DWORD nCount = 0;
+	for ( const CQueryHit* pHit = pHits; pHit; pHit = pHit->m_pNext )
+		nCount++;
+
 	CQuickLock oLock( m_pJobSection );
 
-	// ToDo: Add overload protection code
+	// Overload protection: processing fell far behind, drop new hits
+	if ( m_nJobHits > Settings.Search.HitQueue * 2 )
+	{
+		Statistics.Current.Hits.Dropped += nCount;
+		pHits->Delete();
+		return;
+	}
+
+	m_nJobHits += nCount;
+
+	// Append to a recent unprocessed batch for the same search, so
+	// downloads and search windows get one lock handoff per batch
+	int nLookBack = 4;
+	for ( POSITION pos = m_oJobs.GetTailPosition(); pos && nLookBack--; )
+	{
+		const CJob& oJob = m_oJobs.GetPrev( pos );
+		if ( oJob.GetType() != CJob::Hit || oJob.GetStage() != 0 )
+			continue;
+
+		CQueryHit* pBatch = (CQueryHit*)oJob.GetData();
+		if ( ! validAndEqual( pBatch->m_oSearchID, pHits->m_oSearchID ) &&
+			 ( pBatch->m_oSearchID || pHits->m_oSearchID ) )
+			continue;
+
+		DWORD nBatch = 1;
+		CQueryHit* pTail = pBatch;
+		for ( ; pTail->m_pNext && nBatch < Settings.Search.HitBatch; pTail = pTail->m_pNext )
+			nBatch++;
+		if ( pTail->m_pNext || nBatch + nCount > Settings.Search.HitBatch )
+			continue;	// Batch is full
+
+		pTail->m_pNext = pHits;
+		return;
+	}
 
 	m_oJobs.AddTail( CJob( CJob::Hit, pHits ) );
 }
@@ -1246,6 +1284,8 @@ void CNetwork::RunJobs()
 			{
 			case CJob::Hit:
 				bKeep = ProcessQueryHits( oJob );
+				if ( ! bKeep )
+					Statistics.Sample( statHitRoute, GetTickCount() - oJob.GetQueued() );
 				break;
 
 			case CJob::Search:
@@ -1269,6 +1309,8 @@ void CNetwork::ClearJobs()
 {
 	CQuickLock oLock( m_pJobSection );
 
+	m_nJobHits = 0;
+
 	while ( ! m_oJobs.IsEmpty() )
 	{
 		CJob oJob = m_oJobs.RemoveHead();
@@ -1357,6 +1399,15 @@ bool CNetwork::ProcessQueryHits(CNetwork::CJob& oJob)
 		break;
 
 	case 2:		// Send hits to search windows
+		if ( m_nJobHits > Settings.Search.HitQueue )
+		{
+			// Interface fell behind, downloads got these hits already
+			for ( const CQueryHit* pHit = pHits; pHit; pHit = pHit->m_pNext )
+				Statistics.Current.Hits.Unshown++;
+
+			oJob.Next();
+		}
+		else
 		{
 			CSingleLock oAppLock( &theApp.m_pSection );
 			if ( oAppLock.Lock( 250 ) )
@@ -1394,6 +1445,15 @@ bool CNetwork::ProcessQueryHits(CNetwork::CJob& oJob)
 
 	if ( oJob.GetStage() == 3 )
 	{
+		DWORD nCount = 0;
+		for ( const CQueryHit* pHit = pHits; pHit; pHit = pHit->m_pNext )
+			nCount++;
+
+		{
+			CQuickLock oLock( m_pJobSection );
+			m_nJobHits -= min( nCount, m_nJobHits );
+		}
+
 		pHits->Delete();	// Clean-up
 		return false;
 	}
@@ -104,6 +104,7 @@ protected:
 			: m_nType( nType )
 			, m_pData( pData )
 			, m_nStage( nStage )
+			, m_tQueued( GetTickCount() )
 		{
 		}
 
@@ -111,6 +112,7 @@ protected:
 			: m_nType( oJob.m_nType )
 			, m_pData( oJob.m_pData )
 			, m_nStage( oJob.m_nStage )
+			, m_tQueued( oJob.m_tQueued )
 		{
 		}
 
@@ -119,6 +121,7 @@ protected:
 			m_nType = oJob.m_nType;
 			m_pData = oJob.m_pData;
 			m_nStage = oJob.m_nStage;
+			m_tQueued = oJob.m_tQueued;
 			return *this;
 		}
 
@@ -142,13 +145,20 @@ protected:
 			return m_nStage;
 		}
 
+		DWORD GetQueued() const
+		{
+			return m_tQueued;
+		}
+
 	protected:
 		JobType	m_nType;
 		void*	m_pData;
 		int		m_nStage;
+		DWORD	m_tQueued;		// Tick count when added
 	};
 	CCriticalSection	m_pJobSection;			// m_oJobs synchronization
 	CList< CJob >		m_oJobs;
+	DWORD				m_nJobHits;				// Query hits waiting in m_oJobs
 
 	// Process asynchronous jobs (hits, searches, etc.):
 	void		RunJobs();
@@ -56,6 +56,7 @@ CPacket::CPacket(PROTOCOLID nProtocol)
 	, m_bUDP	   ( FALSE )
 	, m_bOutgoing  ( FALSE )
 	, m_nNeighbourUnique	( NULL )
+	, m_pEncoded	( NULL )
 {
 }
 
@@ -63,6 +64,7 @@ CPacket::~CPacket()
 {
 	// If the packet points to some memory, delete it
 	delete [] m_pBuffer;
+	delete m_pEncoded;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -82,6 +84,25 @@ void CPacket::Reset()
 	m_bUDP		 = FALSE;
 	m_bOutgoing	 = FALSE;
 	m_nNeighbourUnique = NULL;
+
+	// Pooled packets drop their wire bytes, the next use has different content
+	delete m_pEncoded;
+	m_pEncoded   = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPacket shared encoding
+
+// Broadcast and query routing hand one packet to hundreds of neighbours,
+// compose the header once and let each output buffer copy the result
+void CPacket::Encode()
+{
+	if ( m_pEncoded )
+		return;
+
+	CBuffer* pEncoded = new CBuffer();
+	ToBuffer( pEncoded );
+	m_pEncoded = pEncoded;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -58,6 +58,8 @@ public:
 	BOOL  m_bOutgoing;
 	DWORD_PTR m_nNeighbourUnique;
 
+	CBuffer* m_pEncoded;	// Wire bytes shared by every neighbour a routed packet goes to, NULL until Encode
+
 	// Set the position a given distance forwards from the start, or backwards from the end
 	enum { seekStart, seekEnd, seekCurrent };
 
@@ -68,6 +70,9 @@ public:
 	// What is const = 0 (do)
 	virtual void ToBuffer(CBuffer* pBuffer, bool bTCP = true) = 0;
 
+	// Serialize once before sending to many neighbours, ToBuffer then appends these bytes (packet must not change afterwards)
+	void Encode();
+
 public:
 	// Packet position and length
 	void Seek(DWORD nPosition, int nRelative = seekStart);	// Set the position the given distance from the given end
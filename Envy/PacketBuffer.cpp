@@ -16,18 +16,14 @@
 // (http://www.gnu.org/licenses/agpl.html)
 //
 
-// CG1PacketBuffer holds arrays of packets to send, organized by their type
-// http://shareaza.sourceforge.net/mediawiki/index.php/Developers.Code.CG1PacketBuffer
-// http://getenvy.com/archives/envywiki/Developers.Code.CG1PacketBuffer.html
+// CPacketBuffer holds the packets waiting to go out to one G1 or G2 neighbour, by priority class
 
 #include "StdAfx.h"
 #include "Settings.h"
 #include "Envy.h"
 #include "PacketBuffer.h"
-
-#include "Buffer.h"
 #include "G1Packet.h"
-#include "Neighbours.h"
+#include "G2Packet.h"
 #include "Statistics.h"
 
 #ifdef _DEBUG
@@ -36,269 +32,210 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
-//////////////////////////////////////////////////////////////////////
-// CG1PacketBuffer construction
+// Share of the byte budget each class keeps however busy the others are (%)
+static const DWORD nClassShare[ CPacketBuffer::pcMax ] = {
+	10,		// Control
+	40,		// Hits
+	10,		// Pushes
+	40 };	// Queries
 
-// Takes access to a buffer to write packets to directly instead of keeping them in this new object
-// Makes a new CG1PacketBuffer object that holds 9 arrays of 64 packets each, one array for each packet type
-CG1PacketBuffer::CG1PacketBuffer(CBuffer* pBuffer)
-	: m_pBuffer  ( pBuffer )	// Save given pointer to a buffer in the object
-	, m_nTotal   ( 0 )			// The total number of packets we've added to empty spots in arrays
-	, m_nCycle   ( 1 )			// What kind of packet to send next, like 1 ping, 2 pong, and so on
-	, m_nIterate ( 0 )			// Start out the count of packets of a type we've sent as 0
-	, m_nDropped ( 0 )			// The total number of packets we've overwritten in the arrays because of lack of room
 
-{
-	// Make an array of 9 new CG1PacketBufferType objects, each of which are an array of 64 packets
-	m_pType = new CG1PacketBufferType[ G1_PACKTYPE_MAX ];	// One array for each packet type, like ping or pong
-}
+//////////////////////////////////////////////////////////////////////
+// CPacketBuffer construction
 
-// Delete this CG1PacketBuffer object
-CG1PacketBuffer::~CG1PacketBuffer()
+CPacketBuffer::CPacketBuffer(PROTOCOLID nProtocol)
+	: m_nProtocol	( nProtocol )
+	, m_nTotal		( 0 )
+	, m_nTotalBytes	( 0 )
 {
-	// Tell all the packets in the arrays for each type that we're not linked to them from here anymore
-	Clear();
-
-	// Delete the array of 9 CG1PacketBufferType objects
-	delete [] m_pType;
+	ZeroMemory( m_nBytes, sizeof( m_nBytes ) );
+	ZeroMemory( m_nDropped, sizeof( m_nDropped ) );
 }
 
-//////////////////////////////////////////////////////////////////////
-// CG1PacketBuffer add
-
-// Takes a Gnutella packet and true to put it in the buffer, false to put it in the arrays
-void CG1PacketBuffer::Add(CG1Packet* pPacket, BOOL bBuffered)
+CPacketBuffer::~CPacketBuffer()
 {
-	// If the packet isn't buffered yet, or doesn't have a type like ping or pong yet
-	if ( ! bBuffered || ! pPacket->m_nTypeIndex )
-	{
-		// Write the packet directly into the buffer, and we're done
-		pPacket->ToBuffer( m_pBuffer );
-		return;
-	}
-
-	// If the packet is already buffered, or it has a known type like ping or pong, add it to the appropriate array
-	BOOL bFresh =					// Add will tell us if it added the packet in an empty spot, or overwrote a packet
-		m_pType 					// The array of packet arrays for each type
-		[ pPacket->m_nTypeIndex ]	// The type of the packet, like ping or pong, brings us to the array for that type
-		.Add( pPacket );			// Add the packet to that array
-
-	if ( bFresh )	// Add had an empty spot in the array for the new packet
-	{
-		// Add the added packet to the total
-		m_nTotal++;
-	}
-	else			// Add had to overwrite a packet because there are already 64 of that type there
-	{
-		// Count the packet that was overwritten as dropped and lost
-		m_nDropped++;
-		Statistics.Current.Gnutella1.Lost++;	// Our count of how many packets we lost before being able to send
-	}
+	Clear();
 }
 
 //////////////////////////////////////////////////////////////////////
-// CG1PacketBuffer packet selection
+// CPacketBuffer classification
 
-// Takes an expiration time
-// Gets a packet to send, choosing one added recently and of a different type than the one before
-// Returns the packet
-CG1Packet* CG1PacketBuffer::GetPacketToSend(DWORD dwExpire)
+int CPacketBuffer::GetClass(const CPacket* pPacket)
 {
-	// Let the loop send as many as
-	static int nVolumeByType[ G1_PACKTYPE_MAX ] = {
-		0,		// 0 unknown packets at a time
-		1,		// 1 pign packet at a time
-		2,		// 2 pong packets at a time
-		5,		// 5 bye packets at a time
-		1,		// 1 query route packet at a time
-		1,		// 1 vendor specific packet at a time
-		5,		// 5 push packets at a time
-		1,		// 1 query packet at a time
-		4 };	// 4 query hit packets at a time
-
-	// Loop
-	for ( int nCycle = G1_PACKTYPE_MAX * 2;	// Start nCycle as 18		The local variable nCycle isn't used in the loop, just here
-		 nCycle;								// Stop if nCycle is 0 (looped 18 times)
-		 nCycle--,								// Decrement loop counter
-		 m_nCycle++,							// Move to the next packet type array, like from 1 ping to 2 pong and so on
-		 m_nIterate = 0 )						// Reset the count of packets of this type we've sent to 0
+	if ( pPacket->m_nProtocol == PROTOCOL_G1 )
 	{
-		// Cycle from ping 1, to pong 2, to bye 3, and so on
-		m_nCycle %= G1_PACKTYPE_MAX;	// Divide m_nCycle by 9 and take the remainder, which is 0 through 8
-		if ( ! m_nCycle ) continue; 	// If that produced 0 unknown packet type, skip the rest of the code in the loop and loop again
-
-		// If we've sent more packets of this type than the list of limits above allows, skip the rest of the loop code and loop again
-		if ( m_nIterate >= nVolumeByType[ m_nCycle ] ) continue;	// How could m_nIterate ever get above 1? (do)
-
-		// Get the most recently added and not expired packet of the type determined by cycle
-		CG1Packet* pPacket =	// Get a pointer to a packet
-			m_pType[ m_nCycle ]	// The array of 64 packets of m_nCycle type, like 1 ping first, then 2 pong, and so on
-			.Get(				// Get the most recently added and not expired packet from that array
-				dwExpire,		// Tell Get the expiration time
-				&m_nTotal,		// Get will update the total number of packets added in empty slots and dropped here
-				&m_nDropped );
-
-		// If we got a packet, increment iterate and return it
-		if ( pPacket )
+		switch ( static_cast< const CG1Packet* >( pPacket )->m_nTypeIndex )
 		{
-			m_nIterate++;		// Count that we've found a packet and the program will send it
-			return pPacket; 	// Return the packet to the caller so it can send it
+		case G1_PACKTYPE_HIT:
+			return pcHit;
+		case G1_PACKTYPE_PUSH:
+			return pcPush;
+		case G1_PACKTYPE_QUERY:
+			return pcQuery;
+		default:
+			return pcControl;
 		}
 	}
 
-	// We don't have any more packets to send
-	return NULL;
+	const CG2Packet* pG2 = static_cast< const CG2Packet* >( pPacket );
+	if ( pG2->IsType( G2_PACKET_HIT ) || pG2->IsType( G2_PACKET_HIT_WRAP ) )
+		return pcHit;
+	if ( pG2->IsType( G2_PACKET_PUSH ) )
+		return pcPush;
+	if ( pG2->IsType( G2_PACKET_QUERY ) || pG2->IsType( G2_PACKET_QUERY_WRAP ) || pG2->IsType( G2_PACKET_QUERY_KEY_REQ ) )
+		return pcQuery;
+	return pcControl;
 }
 
 //////////////////////////////////////////////////////////////////////
-// CG1PacketBuffer clear
+// CPacketBuffer add
 
-// Clears all the packets from all the arrays
-void CG1PacketBuffer::Clear()
+void CPacketBuffer::Add(CPacket* pPacket)
 {
-	// Loop through the 9 arrays of 64 packets, one array for each packet type
-	for ( int nType = 0; nType < G1_PACKTYPE_MAX; nType++ )
-	{
-		// Clear this array
-		m_pType[ nType ].Clear();
-	}
+	const int nClass = GetClass( pPacket );
 
-	// Reset the count of how many packets we've added in empty array spots
-	m_nTotal = 0;
-}
+	CEntry pEntry;
+	pEntry.pPacket	= pPacket;
+	pEntry.tExpire	= GetTickCount() + Settings.Gnutella1.PacketBufferTime;
+	pEntry.nSize	= pPacket->m_nLength;
+	pEntry.nHops	= ( m_nProtocol == PROTOCOL_G1 ) ? static_cast< CG1Packet* >( pPacket )->m_nHops : 0;
 
-//////////////////////////////////////////////////////////////////////
-// CG1PacketBufferType construction
+	MakeRoom( nClass, pEntry.nSize );
 
-// Create a new array of packet pointers
-CG1PacketBufferType::CG1PacketBufferType()
+	pPacket->AddRef();
+	m_pQueue[ nClass ].push_back( pEntry );
+	m_nBytes[ nClass ] += pEntry.nSize;
+	m_nTotalBytes += pEntry.nSize;
+	m_nTotal++;
+}
+
+// Evicts queued packets until one of nClass and nSize bytes fits
+void CPacketBuffer::MakeRoom(int nClass, DWORD nSize)
 {
-	// Set the number of Gnutella packets this CG1PacketBufferType object will point to from the program settings
-	m_nCapacity = Settings.Gnutella1.PacketBufferSize;	// By default, it's 64
+	const DWORD nBudget = Settings.Gnutella.OutboundBuffer;
+	const DWORD nCapacity = Settings.Gnutella1.PacketBufferSize;	// Packets per class, bounds tiny packets too
+	const DWORD tNow = GetTickCount();
 
-	// Make the arrays of packet pointers and times
-	m_pBuffer = new CG1Packet*[ m_nCapacity ];	// Allocate an array of 64 pointers to Gnutella packets, and point m_pBuffer at this array
-	m_pTime   = new DWORD[ m_nCapacity ];		// Make an array of 64 DWORDs to record the time each packet will expire
+	for ( ;; )
+	{
+		int nVictim = -1;
 
-	// Start packet indices and counts at 0
-	m_nHead  = 0;	// This is the index where we will add a packet to the array, initialize to 0 even though we'll add them back to front
-	m_nCount = 0;	// We haven't added any packets to the array yet
-}
+		if ( m_pQueue[ nClass ].size() >= nCapacity )
+		{
+			nVictim = nClass;
+		}
+		else if ( m_nTotalBytes + nSize > nBudget && m_nTotal )
+		{
+			// Lowest class over its share pays, a class within its share only makes room for itself
+			for ( int nTest = pcMax - 1; nTest >= 0; nTest-- )
+			{
+				if ( m_nBytes[ nTest ] > nBudget / 100 * nClassShare[ nTest ] && ! m_pQueue[ nTest ].empty() )
+				{
+					nVictim = nTest;
+					break;
+				}
+			}
+
+			if ( nVictim < 0 && ! m_pQueue[ nClass ].empty() )
+				nVictim = nClass;
+			if ( nVictim < 0 )
+				return;		// Only an oversized packet of a class within its share, let it through
+		}
+		else
+		{
+			return;
+		}
 
-// Delete this array of packet pointers
-CG1PacketBufferType::~CG1PacketBufferType()
-{
-	// Clear all the packet pointers from the array, and reset the count and head values to 0
-	Clear();	// Tells each packet that we're not pointing to it anymore
+		// Expired first, then the one that travelled farthest, then the oldest
+		CEntryQueue& pQueue = m_pQueue[ nVictim ];
+		CEntryQueue::iterator iWorst = pQueue.begin();
+		for ( CEntryQueue::iterator i = pQueue.begin(); i != pQueue.end(); ++i )
+		{
+			if ( (LONG)( tNow - (*i).tExpire ) >= 0 )
+			{
+				iWorst = i;
+				break;
+			}
+			if ( (*i).nHops > (*iWorst).nHops )
+				iWorst = i;
+		}
 
-	// Free the memory of the pointer and DWORD arrays we allocated in the constructor
-	delete [] m_pTime;
-	delete [] m_pBuffer;
+		Drop( nVictim, iWorst );
+	}
 }
 
-//////////////////////////////////////////////////////////////////////
-// CG1PacketBufferType add
-
-// Takes a pointer to a Gnutella packet
-// Adds it and its expiration time to the arrays inside this CG1PacketBufferType object, going from end to start
-// Returns false if the array was full and we overwrote a packet, true if we're still on the first sweep backwards
-BOOL CG1PacketBufferType::Add(CG1Packet* pPacket)
+void CPacketBuffer::Drop(int nClass, CEntryQueue::iterator i)
 {
-	// Assume that there is room for one more packet
-	BOOL bFresh = TRUE;
+	m_nBytes[ nClass ] -= (*i).nSize;
+	m_nTotalBytes -= (*i).nSize;
+	m_nTotal--;
+	m_nDropped[ nClass ]++;
 
-	// If the arrays are full, we'll put this packet in the last place again and fill backwards from there again
-	if ( m_nCount == m_nCapacity )	// Count and capacity are both 64
+	if ( m_nProtocol == PROTOCOL_G1 )
 	{
-		// Record there is one fewer packet in the array
-		m_nCount--; 				// Now count is 63
-
-		// Call Release on the last packet in the buffer, then the one before that, then (do)
-		m_pBuffer[					// Look at an index in the buffer of arrays we are about to calculate
-			( m_nHead + m_nCount )	// Head + count are usually 64, but we just decremented count so now they're 63
-			% m_nCapacity ]			// Divide by 64 and take the remainder, which is 63
-			->Release();			// Release the last packet in the array, the one at index 63
-
-		// Note that no, there wasn't room for another packet, but we made room so it's OK
-		bFresh = FALSE;
+		Statistics.Current.Gnutella1.Lost++;
+		Statistics.Current.Gnutella1.LostByClass[ nClass ]++;
+	}
+	else
+	{
+		Statistics.Current.Gnutella2.Lost++;
+		Statistics.Current.Gnutella2.LostByClass[ nClass ]++;
 	}
 
-	// Count head down each time this line runs like 63, 62, 61 ... 3, 2, 1, 0, 63, 62, 61 ... to sweep backwards down the array
-	if ( ! m_nHead-- )
-		m_nHead += m_nCapacity;			// If head is 0, add capacity to it, and also decrement it either way
-
-	// Record there will be one more packet stored here
-	m_nCount++;						// If we are overwriting packets now, this will set the count back up to 64
-
-	// Store a pointer to the packet and the time a minute from now when it will expire at the head index of the arrays
-	m_pBuffer[ m_nHead ] = pPacket;			// Store the pointer to the packet
-	m_pTime[ m_nHead ] =					// A minute from now, the packet we're adding will expire
-		GetTickCount() +					// The tick count now
-		Settings.Gnutella1.PacketBufferTime;	// By default, this is 1 minute
-
-	// Have the packet count one more pointer saved to it
-	pPacket->AddRef();
-
-	// Return true if we did that without making more room, or false if we did it after making more room
-	return bFresh;
+	(*i).pPacket->Release();
+	m_pQueue[ nClass ].erase( i );
 }
 
-// Takes an expiration time, and access to 2 integers to write statistics
-// Gets the packet we added most recently that hasn't expired, and moves head forward and decrements count
-// Returns a pointer to it
-CG1Packet* CG1PacketBufferType::Get(DWORD dwExpire, int* pnTotal, int* pnDropped)
-{
-	// Local variables
-	CG1Packet* pPacket; 	// A pointer to a packet copied from the array of packet pointers
-	DWORD dwPacket; 		// The expiration time of that packet
+//////////////////////////////////////////////////////////////////////
+// CPacketBuffer packet selection
 
-	// Loop until we find a packet that hasn't expired
-	do
+// Control packets keep their order, the other classes send the newest first as fresher hits and queries are worth more
+CPacket* CPacketBuffer::GetPacketToSend(DWORD tNow)
+{
+	for ( int nClass = 0; nClass < pcMax; nClass++ )
 	{
-		// If there aren't any packet pointers in the array, we won't be able to find this one
-		if ( ! m_nCount ) return NULL;		// Not found
-
-		// Get the packet pointer and time we most recently added to the arrays
-		pPacket  = m_pBuffer[ m_nHead ];	// The pointer the Add method added the last time it ran
-		dwPacket = m_pTime[ m_nHead ];		// The tick count 1 minute after it ran
+		CEntryQueue& pQueue = m_pQueue[ nClass ];
 
-		// Move forward in the array to the next most recently added packet
-		m_nHead = ( m_nHead + 1 ) % m_nCapacity;	// Add 1 to head unless it is 63, then take it back to 0
+		while ( ! pQueue.empty() )
+		{
+			CEntryQueue::iterator i = ( nClass == pcControl ) ? pQueue.begin() : --pQueue.end();
 
-		// This packet is either expired, or will be returned, so we can record 1 less packet in the array
-		m_nCount--;
+			if ( (LONG)( tNow - (*i).tExpire ) >= 0 )
+			{
+				Drop( nClass, i );
+				continue;
+			}
 
-		// This packet has expired
-		if ( dwPacket < dwExpire )	// This packet's expiration date happened before the given expiration date
-		{
-			// Adjust the numbers the caller gave us access to
-			if ( pnTotal )   (*pnTotal)--;		// This is one less packet total
-			if ( pnDropped ) (*pnDropped)++;	// This is one more packet dropped
+			CPacket* pPacket = (*i).pPacket;
 
-			// Count this in statistics as a lost packet
-			Statistics.Current.Gnutella1.Lost++;
+			m_nBytes[ nClass ] -= (*i).nSize;
+			m_nTotalBytes -= (*i).nSize;
+			m_nTotal--;
+			pQueue.erase( i );
 
-			// Tell the packet we're no longer pointing to it from here
-			pPacket->Release();
-			pPacket = NULL; 	// Stay in the do while loop
+			return pPacket;
 		}
 	}
-	while ( pPacket == NULL );	// If the if statement didn't run, exit the do while loop
 
-	// Return the pointer to the first packet we found that hasn't expired
-	return pPacket;
+	return NULL;
 }
 
-// Clears all the packet pointers from the array, and resets the count and head values to 0
-void CG1PacketBufferType::Clear()
+//////////////////////////////////////////////////////////////////////
+// CPacketBuffer clear
+
+void CPacketBuffer::Clear()
 {
-	// If count is 5, loop for 5, 4, 3, 2, and 1, set count to 0, and don't enter the loop
-	while ( m_nCount-- > 0 )	// Enter the loop if count is positive, and then decrement the count
+	for ( int nClass = 0; nClass < pcMax; nClass++ )
 	{
-		// Tell each packet we're not pointing to it anymore
-		m_pBuffer[ ( m_nHead + m_nCount ) % m_nCapacity ]->Release();
+		for ( CEntryQueue::iterator i = m_pQueue[ nClass ].begin(); i != m_pQueue[ nClass ].end(); ++i )
+		{
+			(*i).pPacket->Release();
+		}
+
+		m_pQueue[ nClass ].clear();
+		m_nBytes[ nClass ] = 0;
 	}
 
-	// Count is 0, reset head to that value also
-	m_nHead = 0;
+	m_nTotal = 0;
+	m_nTotalBytes = 0;
 }
@@ -16,72 +16,71 @@
 // (http://www.gnu.org/licenses/agpl.html)
 //
 
-// CG1PacketBuffer holds arrays of packets to send, organized by their type
-// http://shareaza.sourceforge.net/mediawiki/index.php/Developers.Code.CG1PacketBuffer
-// http://getenvy.com/archives/envywiki/Developers.Code.CG1PacketBuffer.html
+// CPacketBuffer holds the packets waiting to go out to one G1 or G2 neighbour, by priority class
+// Control packets leave first, then hits, pushes and queries.  Each class is guaranteed a share of a
+// byte budget; when the budget is exceeded the lowest class over its share loses its stalest packet.
 
 #pragma once
 
-class CBuffer;
-class CG1Packet;
-class CG1PacketBufferType;
+class CPacket;
 
 
-// Holds 9 arrays of 64 Gnutella packets each, one array for each packet type, like ping or pong
-class CG1PacketBuffer
+class CPacketBuffer
 {
-
-public:
-	// Make a new set of arrays, and delete this set
-	CG1PacketBuffer(CBuffer* pBuffer);	// Takes a buffer to write packets to instead of putting them in the arrays
-	virtual ~CG1PacketBuffer();
-
 public:
-	// Total counts of packets in the arrays
-	int m_nTotal;   // Number of packets Add added without overwriting any
-	int m_nDropped; // Number of packets Add overwrote
+	CPacketBuffer(PROTOCOLID nProtocol);
+	~CPacketBuffer();
+
+	enum
+	{
+		pcControl,		// Pings, pongs, vendor and other keep-alive or routing traffic
+		pcHit,			// Query hits
+		pcPush,			// Push requests
+		pcQuery,		// Queries and query key requests
+		pcMax
+	};
 
 protected:
-	// The buffer where we can write packets directly, instead of putting them in arrays
-	CBuffer* m_pBuffer;
-
-	// Arrays of packets, one for each type
-	CG1PacketBufferType* m_pType;    // An array of 9 pointers to arrays of 64 packets each, one array for each packet type
-	int                  m_nCycle;   // The type of packet to send next, like 1 ping array, 2 pong array, and so on
-	int                  m_nIterate; // Number of packets of this type we've recently sent
+	struct CEntry
+	{
+		CPacket*	pPacket;
+		DWORD		tExpire;	// Dropped instead of sent after this (ticks)
+		DWORD		nSize;		// Bytes counted against the budget
+		BYTE		nHops;		// Distance travelled, far packets are dropped first
+	};
+	typedef std::list< CEntry > CEntryQueue;
+
+	PROTOCOLID		m_nProtocol;
+	CEntryQueue		m_pQueue[ pcMax ];
+	DWORD			m_nBytes[ pcMax ];
+	DWORD			m_nDropped[ pcMax ];
+	DWORD			m_nTotal;			// Packets held
+	DWORD			m_nTotalBytes;		// Bytes held
 
 public:
-	// Add a packet to its array, and clear them all
-	void Add(CG1Packet* pPacket, BOOL bBuffered = TRUE);
-	void Clear();
-
-	// Get a packet to send, it chooses one added recently, not expired, and keeps the type mixed up
-	CG1Packet* GetPacketToSend(DWORD dwExpire = 0);
-};
+	void		Add(CPacket* pPacket);					// Keeps a reference
+	CPacket*	GetPacketToSend(DWORD tNow);			// Highest class first, caller releases
+	void		Clear();
 
+	static int	GetClass(const CPacket* pPacket);
 
-// Holds an array of 64 pointers to packets to send, all of one type, and the time each expires 1 minute after they were added
-class CG1PacketBufferType
-{
+	inline DWORD GetCount() const
+	{
+		return m_nTotal;
+	}
 
-public:
-	// Create a new packet buffer type object, and delete this one
-	CG1PacketBufferType();
-	virtual ~CG1PacketBufferType();
+	inline DWORD GetDropped(int nClass = -1) const
+	{
+		return ( nClass < 0 ) ?
+			m_nDropped[ pcControl ] + m_nDropped[ pcHit ] + m_nDropped[ pcPush ] + m_nDropped[ pcQuery ] :
+			m_nDropped[ nClass ];
+	}
 
 protected:
-	// Two arrays that hold information about 64 Gnutella packets
-	CG1Packet** m_pBuffer; // This is a pointer to an array of 64 pointers to Gnutella packets, and has nothing to do with a CBuffer object
-	DWORD*      m_pTime;   // The time each packet will expire, which is 1 minute after it is added
+	void		Drop(int nClass, CEntryQueue::iterator i);
+	void		MakeRoom(int nClass, DWORD nSize);
 
-	// Indices and counts for those arrays
-	int m_nHead;     // The index in the array where we added information about a packet most recently
-	int m_nCount;    // The number of spots in the array filled with a packet pointer and time
-	int m_nCapacity; // The size of the arrays we allocated from settings, 64 by default
-
-public:
-	// Add a packet to the array, get one out, and clear them all
-	BOOL       Add(CG1Packet* pPacket);
-	CG1Packet* Get(DWORD dwExpire = 0, int* pnTotal = NULL, int* pnDropped = NULL);
-	void       Clear();
+private:
+	CPacketBuffer(const CPacketBuffer&);
+	CPacketBuffer& operator=(const CPacketBuffer&);
 };
@@ -0,0 +1,198 @@
+//
+// QueueIndex.h
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software. You may redistribute and/or modify it
+// under the terms of the GNU Affero General Public License
+// as published by the Free Software Foundation (fsf.org);
+// version 3 or later at your option. (AGPLv3)
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero General Public License 3.0 for details:
+// (http://www.gnu.org/licenses/agpl.html)
+//
+
+// Arrival-ordered queue with O(log n) position lookup, removal and access by position.
+// Removed items leave holes in the slot array, a Fenwick (binary indexed) tree counts
+// live slots so positions skip them.  Holes are compacted once they outnumber items.
+// T must have an "INT_PTR m_nQueueSlot" member, owned by the index while queued.
+
+#pragma once
+
+#include <vector>
+
+template< class T >
+class CQueueIndex
+{
+public:
+	CQueueIndex()
+		: m_nCount	( 0 )
+	{
+	}
+
+public:
+	inline INT_PTR GetCount() const
+	{
+		return m_nCount;
+	}
+
+	inline bool IsEmpty() const
+	{
+		return m_nCount == 0;
+	}
+
+	inline bool Contains(const T* pItem) const
+	{
+		const INT_PTR nSlot = pItem->m_nQueueSlot;
+		return nSlot >= 0 && nSlot < (INT_PTR)m_pSlots.size() && m_pSlots[ nSlot ] == pItem;
+	}
+
+	// Append item at the end of queue
+	void Add(T* pItem)
+	{
+		ASSERT( ! Contains( pItem ) );
+
+		const INT_PTR nSlot = (INT_PTR)m_pSlots.size();
+		m_pSlots.push_back( pItem );
+		pItem->m_nQueueSlot = nSlot;
+
+		// New tree node covers ( k - lowbit( k ), k ], existing slots of that range plus this one
+		const INT_PTR k = nSlot + 1;
+		m_pTree.push_back( 1 + Sum( k - 1 ) - Sum( k - ( k & -k ) ) );
+		m_nCount++;
+	}
+
+	// Remove item from any position
+	bool Remove(T* pItem)
+	{
+		if ( ! Contains( pItem ) )
+			return false;
+
+		const INT_PTR nSlot = pItem->m_nQueueSlot;
+		m_pSlots[ nSlot ] = NULL;
+		pItem->m_nQueueSlot = -1;
+		Update( nSlot + 1, -1 );
+		m_nCount--;
+
+		if ( m_nCount == 0 )
+			RemoveAll();
+		else if ( (INT_PTR)m_pSlots.size() > 64 && (INT_PTR)m_pSlots.size() > m_nCount * 2 )
+			Compact();
+
+		return true;
+	}
+
+	// Put new item at the position of old one
+	bool Replace(T* pOld, T* pNew)
+	{
+		if ( ! Contains( pOld ) )
+			return false;
+
+		const INT_PTR nSlot = pOld->m_nQueueSlot;
+		m_pSlots[ nSlot ] = pNew;
+		pNew->m_nQueueSlot = nSlot;
+		pOld->m_nQueueSlot = -1;
+		return true;
+	}
+
+	// Zero-based position, or -1 if not queued here
+	INT_PTR GetPosition(const T* pItem) const
+	{
+		if ( ! Contains( pItem ) )
+			return -1;
+
+		return Sum( pItem->m_nQueueSlot + 1 ) - 1;
+	}
+
+	// Item at zero-based position
+	T* GetAt(INT_PTR nPosition) const
+	{
+		ASSERT( nPosition >= 0 && nPosition < m_nCount );
+		if ( nPosition < 0 || nPosition >= m_nCount )
+			return NULL;
+
+		// Descend the tree for the slot with nPosition + 1 live slots up to it
+		const INT_PTR nSize = (INT_PTR)m_pTree.size();
+		INT_PTR nBit = 1;
+		while ( nBit * 2 <= nSize )
+			nBit *= 2;
+
+		INT_PTR k = 0;
+		INT_PTR nRemaining = nPosition + 1;
+		for ( ; nBit; nBit /= 2 )
+		{
+			if ( k + nBit <= nSize && m_pTree[ k + nBit - 1 ] < nRemaining )
+			{
+				k += nBit;
+				nRemaining -= m_pTree[ k - 1 ];
+			}
+		}
+
+		ASSERT( k < nSize && m_pSlots[ k ] );
+		return m_pSlots[ k ];
+	}
+
+	void RemoveAll()
+	{
+		for ( typename std::vector< T* >::iterator i = m_pSlots.begin(); i != m_pSlots.end(); ++i )
+		{
+			if ( *i )
+				(*i)->m_nQueueSlot = -1;
+		}
+
+		m_pSlots.clear();
+		m_pTree.clear();
+		m_nCount = 0;
+	}
+
+protected:
+	std::vector< T* >		m_pSlots;	// Items in arrival order, NULL for removed
+	std::vector< INT_PTR >	m_pTree;	// Fenwick tree of live slots (1-based, stored at k - 1)
+	INT_PTR					m_nCount;	// Live items
+
+	// Live slots in 1-based range [ 1, k ]
+	INT_PTR Sum(INT_PTR k) const
+	{
+		INT_PTR nSum = 0;
+		for ( ; k > 0; k -= k & -k )
+			nSum += m_pTree[ k - 1 ];
+		return nSum;
+	}
+
+	void Update(INT_PTR k, INT_PTR nDelta)
+	{
+		const INT_PTR nSize = (INT_PTR)m_pTree.size();
+		for ( ; k <= nSize; k += k & -k )
+			m_pTree[ k - 1 ] += nDelta;
+	}
+
+	// Drop holes and rebuild tree in linear time
+	void Compact()
+	{
+		INT_PTR nSlot = 0;
+		for ( typename std::vector< T* >::iterator i = m_pSlots.begin(); i != m_pSlots.end(); ++i )
+		{
+			if ( *i )
+			{
+				(*i)->m_nQueueSlot = nSlot;
+				m_pSlots[ nSlot++ ] = *i;
+			}
+		}
+		m_pSlots.resize( nSlot );
+
+		m_pTree.assign( nSlot, 1 );
+		for ( INT_PTR k = 1; k <= nSlot; k++ )
+		{
+			const INT_PTR nParent = k + ( k & -k );
+			if ( nParent <= nSlot )
+				m_pTree[ nParent - 1 ] += m_pTree[ k - 1 ];
+		}
+	}
+
+private:
+	CQueueIndex(const CQueueIndex&);
+	CQueueIndex& operator=(const CQueueIndex&);
+};
@@ -49,6 +49,7 @@
 #include "GProfile.h"
 #include "EnvyURL.h"
 #include "Skin.h"
+#include "Statistics.h"
 
 #include "WndMain.h"
 #include "WndSearch.h"
@@ -553,6 +554,8 @@ void CRemote::PageSwitch(const CString& strPath)
 	// ToDo: "/" = IDR_HTML_ABOUT
 	if ( strPath == L"/" || strPath == L"/remote" )
 		m_sRedirect = L"/remote/";
+	else if ( ::StartsWith( strPath, L"/remote/statistics" ) )
+		PageStatistics();
 	else if ( ::StartsWith( strPath, L"/remote/" ) )
 		PageLogin();
 	else if ( ::StartsWith( strPath, L"/remote/logout" ) )
@@ -1534,6 +1537,22 @@ void CRemote::PageNetworkNetwork(int nID, bool* pbConnect, LPCTSTR pszName)
 	Prepare( L"network_" );
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// CRemote page : statistics (JSON, or ?format=csv)
+
+void CRemote::PageStatistics()
+{
+	if ( CheckCookie() ) return;
+
+	const BOOL bCSV = GetKey( L"format" ).CompareNoCase( L"csv" ) == 0;
+	const CStringA strOutput = UTF8Encode( Statistics.Export( bCSV ) );
+
+	m_pResponse.Add( (LPCSTR)strOutput, strOutput.GetLength() );
+	m_sHeader = bCSV ?
+		L"Content-Type: text/csv; charset=UTF-8\r\nCache-Control: no-cache\r\n" :
+		L"Content-Type: application/json; charset=UTF-8\r\nCache-Control: no-cache\r\n";
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // CRemote page : banner
 
@@ -69,6 +69,7 @@ protected:
 	void			PageNewDownload();
 	void			PageUploads();
 	void			PageNetwork();
+	void			PageStatistics();
 	void			PageBanner(const CString& strPath);
 	void			PageImage(const CString& strPath);
 
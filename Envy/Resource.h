@@ -1247,6 +1247,7 @@
 #define IDS_NEIGHBOUR_TOTAL             20534
 #define IDS_NEIGHBOUR_RATIO             20535
 #define IDS_NEIGHBOUR_REJECTED          20536
+#define IDS_NEIGHBOUR_LOST              20537
 #define IDS_NEIGHBOUR_UNKNOWN           20538
 #define IDS_NETWORK_CONNECT             20540
 #define IDS_NETWORK_CONNECTING          20541
@@ -17,7 +17,6 @@
 //
 
 #include "StdAfx.h"
-#include "Envy.h"
 #include "RouteCache.h"
 
 #ifdef _DEBUG
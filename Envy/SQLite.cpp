@@ -26,12 +26,19 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+#define DATABASE_POOL_MAX		8		// Idle connections kept open
+#define DATABASE_STATEMENT_MAX	32		// Prepared statements cached per connection
+
+CDatabasePool DatabasePool;
+
 //////////////////////////////////////////////////////////////////////////////
 // CDatabase
 
 CDatabase::CDatabase(LPCTSTR szDatabase)
 	: m_db			( NULL )
 	, m_st			( NULL )
+	, m_sDatabase	( szDatabase )
+	, m_bCached		( false )
 	, m_bBusy		( false )
 #ifdef _DEBUG
 	, m_nThread		( GetCurrentThreadId() )
@@ -49,6 +56,15 @@ CDatabase::~CDatabase()
 
 	Finalize();
 
+	for ( POSITION pos = m_pStatements.GetStartPosition(); pos; )
+	{
+		CString strQuery;
+		sqlite3_stmt* st;
+		m_pStatements.GetNextAssoc( pos, strQuery, st );
+		sqlite3_finalize( st );
+	}
+	m_pStatements.RemoveAll();
+
 	if ( m_db )
 	{
 		sqlite3_close( m_db );
@@ -100,10 +116,10 @@ bool CDatabase::Prepare(LPCTSTR szQuery)
 
 	m_sQuery = szQuery;
 
-	return PrepareHelper();
+	return PrepareHelper( true );
 }
 
-bool CDatabase::PrepareHelper()
+bool CDatabase::PrepareHelper(bool bCache)
 {
 	ASSERT( m_nThread == GetCurrentThreadId() );	// Don't pass database across thread boundaries
 	ASSERT( m_db );
@@ -113,6 +129,16 @@ bool CDatabase::PrepareHelper()
 
 	Finalize();
 
+	// Reuse statement prepared earlier for the same text (already reset)
+	if ( bCache && m_pStatements.Lookup( m_sQuery, m_st ) )
+	{
+		m_bCached = true;
+		m_sQuery.Empty();
+		return true;
+	}
+
+	const CString strQuery( m_sQuery );
+
 	for ( ;; )
 	{
 		LPCWSTR pszTail = NULL;
@@ -126,7 +152,15 @@ bool CDatabase::PrepareHelper()
 				m_sQuery.Empty();
 
 			if ( m_st )
+			{
+				// Keep single statements, multiple statements are prepared one by one
+				if ( bCache && m_sQuery.IsEmpty() && m_pStatements.GetCount() < DATABASE_STATEMENT_MAX )
+				{
+					m_pStatements.SetAt( strQuery, m_st );
+					m_bCached = true;
+				}
 				return true;
+			}
 
 			// This happens for a comment or white-space
 			break;
@@ -147,10 +181,20 @@ void CDatabase::Finalize()
 
 	if ( m_st )
 	{
-		sqlite3_finalize( m_st );
+		if ( m_bCached )
+		{
+			// Keep prepared for next use, but release row locks and bound buffers
+			sqlite3_reset( m_st );
+			sqlite3_clear_bindings( m_st );
+		}
+		else
+		{
+			sqlite3_finalize( m_st );
+		}
 		m_st = NULL;
 	}
 
+	m_bCached = false;
 	m_bBusy = false;
 	m_raw.RemoveAll();
 }
@@ -289,3 +333,83 @@ bool CDatabase::Bind(int nIndex, LPCVOID pData, int nLength)
 {
 	return m_st && sqlite3_bind_blob( m_st, nIndex, pData, nLength, SQLITE_STATIC ) == SQLITE_OK;
 }
+
+
+//////////////////////////////////////////////////////////////////////////////
+// CDatabasePool
+
+CDatabasePool::CDatabasePool()
+{
+}
+
+CDatabasePool::~CDatabasePool()
+{
+	Clear();
+}
+
+CDatabase* CDatabasePool::Acquire(LPCTSTR szDatabase, LPCTSTR szInit)
+{
+	ASSERT( szDatabase && *szDatabase );
+
+	{
+		CQuickLock oLock( m_pSection );
+
+		for ( POSITION pos = m_pIdle.GetHeadPosition(); pos; )
+		{
+			POSITION posThis = pos;
+			CDatabase* pDatabase = m_pIdle.GetNext( pos );
+			if ( pDatabase->m_sDatabase.CompareNoCase( szDatabase ) == 0 )
+			{
+				m_pIdle.RemoveAt( posThis );
+#ifdef _DEBUG
+				pDatabase->m_nThread = GetCurrentThreadId();
+#endif
+				return pDatabase;
+			}
+		}
+	}
+
+	// Open new one outside lock
+	CDatabase* pDatabase = new CDatabase( szDatabase );
+	if ( *pDatabase && szInit && *szInit )
+		pDatabase->Exec( szInit );
+
+	return pDatabase;
+}
+
+void CDatabasePool::Release(CDatabase* pDatabase)
+{
+	if ( ! pDatabase )
+		return;
+
+	pDatabase->Finalize();
+
+	// Don't keep broken connections or interrupted transactions
+	if ( *pDatabase && sqlite3_get_autocommit( pDatabase->m_db ) )
+	{
+		CQuickLock oLock( m_pSection );
+
+		if ( m_pIdle.GetCount() < DATABASE_POOL_MAX )
+		{
+			m_pIdle.AddHead( pDatabase );
+			return;
+		}
+	}
+
+	delete pDatabase;
+}
+
+void CDatabasePool::Clear()
+{
+	CQuickLock oLock( m_pSection );
+
+	for ( POSITION pos = m_pIdle.GetHeadPosition(); pos; )
+	{
+		CDatabase* pDatabase = m_pIdle.GetNext( pos );
+#ifdef _DEBUG
+		pDatabase->m_nThread = GetCurrentThreadId();
+#endif
+		delete pDatabase;
+	}
+	m_pIdle.RemoveAll();
+}
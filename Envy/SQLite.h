@@ -31,6 +31,10 @@
 //		}
 //	}
 
+// Pooled:		Reuses an open connection and its prepared statements
+//	CPooledDatabase db( theApp.GetDatabasePath( DB_THUMBS ) );
+//	if ( *db && db->Prepare( L"SELECT ..." ) ) ...
+
 #pragma once
 
 struct sqlite3;
@@ -39,6 +43,8 @@ struct sqlite3_stmt;
 
 class CDatabase
 {
+	friend class CDatabasePool;
+
 public:
 	CDatabase(LPCWSTR szDatabase);
 	~CDatabase();
@@ -47,7 +53,7 @@ public:
 	operator bool() const throw();					// Return true if database successfully opened
 
 	bool			Exec(LPCTSTR szQuery);			// Execute multiple queries without parameters
-	bool			Prepare(LPCTSTR szQuery);		// Prep single query
+	bool			Prepare(LPCTSTR szQuery);		// Prep single query (cached by text, reset on reuse)
 	bool			Step(); 						// Run one query iteration
 	void			Finalize(); 					// Finalize query
 	bool			IsBusy() const throw(); 		// Return true if latest SQL call failed for a locked table state
@@ -70,21 +76,77 @@ public:
 
 protected:
 	typedef CMap< CString, const CString&, int, int > CRaw;		// std::map< std::wstring, int >
+	typedef CMap< CString, const CString&, sqlite3_stmt*, sqlite3_stmt* > CStatementMap;
 
 	sqlite3*		m_db;							// Handle to SQL database
 	sqlite3_stmt*	m_st;							// SQL statement handle
 	CRaw			m_raw;							// Column name to column number map
 	CString			m_sQuery;						// SQL query
+	CString			m_sDatabase;					// Database file path
+	CStatementMap	m_pStatements;					// Prepared statements by SQL text
+	bool			m_bCached;						// Current statement is owned by m_pStatements
 	bool			m_bBusy;						// Last SQL call returned with busy error
 
 #ifdef _DEBUG
 	DWORD			m_nThread;						// Thread ID (debug only)
 #endif
 
-	bool			PrepareHelper();				// Prepare single query
+	bool			PrepareHelper(bool bCache = false);	// Prepare single query
 	int				GetColumn(LPCTSTR pszName) const; // Return column index by column name
 
 private:
 	CDatabase(const CDatabase&);
 	CDatabase& operator=(const CDatabase&);
 };
+
+
+// Idle connections kept open for reuse, each used by one thread at a time
+
+class CDatabasePool
+{
+public:
+	CDatabasePool();
+	~CDatabasePool();
+
+public:
+	CDatabase*		Acquire(LPCTSTR szDatabase, LPCTSTR szInit = NULL);	// Reuse idle connection or open new one (szInit runs once per connection)
+	void			Release(CDatabase* pDatabase);	// Reset and return connection to idle list
+	void			Clear();						// Close all idle connections
+
+protected:
+	CCriticalSection		m_pSection;
+	CList< CDatabase* >		m_pIdle;
+
+private:
+	CDatabasePool(const CDatabasePool&);
+	CDatabasePool& operator=(const CDatabasePool&);
+};
+
+extern CDatabasePool DatabasePool;
+
+
+// Scoped connection borrowed from DatabasePool
+
+class CPooledDatabase
+{
+public:
+	explicit CPooledDatabase(LPCTSTR szDatabase, LPCTSTR szInit = NULL)
+		: m_pDatabase	( DatabasePool.Acquire( szDatabase, szInit ) )
+	{
+	}
+
+	~CPooledDatabase()
+	{
+		DatabasePool.Release( m_pDatabase );
+	}
+
+	CDatabase* operator->() const throw() { return m_pDatabase; }
+	CDatabase& operator*() const throw() { return *m_pDatabase; }
+
+protected:
+	CDatabase*		m_pDatabase;
+
+private:
+	CPooledDatabase(const CPooledDatabase&);
+	CPooledDatabase& operator=(const CPooledDatabase&);
+};
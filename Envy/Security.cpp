@@ -724,10 +724,26 @@ BOOL CSecurity::IsFlood(const IN_ADDR* pAddress, const LPCTSTR pszVendor /*NULL*
 {
 	if ( nProtocol == PROTOCOL_G2 )
 	{
-		CString strCode = theApp.GetCountryCode( *pAddress );
-		if ( StartsWith( strCode, _P( L"TW" ) ) ||
-			 StartsWith( strCode, _P( L"HK" ) ) ||
-			 StartsWith( strCode, _P( L"CN" ) ) )
+		const DWORD tNow = GetTickCount();
+		BYTE nRegion;
+		{
+			CQuickLock oLock( m_pSection );
+			nRegion = m_Floods.GetRegion( pAddress->s_addr, tNow );
+		}
+
+		if ( nRegion == CFloodFilter::regionUnknown )
+		{
+			CString strCode = theApp.GetCountryCode( *pAddress );
+			nRegion = ( StartsWith( strCode, _P( L"TW" ) ) ||
+						StartsWith( strCode, _P( L"HK" ) ) ||
+						StartsWith( strCode, _P( L"CN" ) ) ) ?
+				CFloodFilter::regionFlood : CFloodFilter::regionAllowed;
+
+			CQuickLock oLock( m_pSection );
+			m_Floods.SetRegion( pAddress->s_addr, tNow, nRegion );
+		}
+
+		if ( nRegion == CFloodFilter::regionFlood )
 		{
 			if ( ! pszVendor || ! *pszVendor ||
 				 _tcsicmp( pszVendor, L"FOXY" ) == 0 ||
@@ -739,6 +755,30 @@ BOOL CSecurity::IsFlood(const IN_ADDR* pAddress, const LPCTSTR pszVendor /*NULL*
 	return FALSE;
 }
 
+// Limit queries per endpoint address (was CNeighboursWithRouting list walk)
+BOOL CSecurity::IsQueryFlood(const IN_ADDR* pAddress, PROTOCOLID nProtocol)
+{
+	DWORD nPeriod;
+	switch ( nProtocol )
+	{
+	case PROTOCOL_G1:
+		nPeriod = Settings.Gnutella1.QueryFlood;
+		break;
+	case PROTOCOL_G2:
+		nPeriod = Settings.Gnutella2.QueryFlood;
+		break;
+	default:
+		return FALSE;
+	}
+
+	if ( ! nPeriod )
+		return FALSE;
+
+	CQuickLock oLock( m_pSection );
+
+	return ! m_Floods.Check( pAddress->s_addr, GetTickCount(), nPeriod );
+}
+
 //////////////////////////////////////////////////////////////////////
 // CSecurity expire
 
@@ -1220,6 +1260,98 @@ CLiveList* CSecurity::GetList() const
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// CFloodFilter construction
+
+CFloodFilter::CFloodFilter()
+	: m_nSecond	( 0 )
+{
+	m_pEntries.InitHashTable( 4099 );
+}
+
+//////////////////////////////////////////////////////////////////////
+// CFloodFilter checks
+
+// Returns false if this address already queried within period (ms)
+bool CFloodFilter::Check(DWORD nAddress, DWORD tNow, DWORD nPeriod)
+{
+	Advance( tNow );
+
+	CFloodEntry* pEntry = Lookup( nAddress, tNow, tNow + nPeriod );
+
+	if ( (LONG)( pEntry->m_tAllow - tNow ) > 0 )
+		return false;	// Too early
+
+	pEntry->m_tAllow = tNow + nPeriod;
+
+	return true;
+}
+
+BYTE CFloodFilter::GetRegion(DWORD nAddress, DWORD tNow)
+{
+	Advance( tNow );
+
+	const CFloodMap::CPair* pPair = m_pEntries.PLookup( nAddress );
+
+	return pPair ? pPair->value.m_nRegion : (BYTE)regionUnknown;
+}
+
+void CFloodFilter::SetRegion(DWORD nAddress, DWORD tNow, BYTE nRegion)
+{
+	Lookup( nAddress, tNow, tNow + RegionLife )->m_nRegion = nRegion;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CFloodFilter entries
+
+CFloodFilter::CFloodEntry* CFloodFilter::Lookup(DWORD nAddress, DWORD tNow, DWORD tExpire)
+{
+	if ( CFloodMap::CPair* pPair = m_pEntries.PLookup( nAddress ) )
+	{
+		if ( (LONG)( tExpire - pPair->value.m_tExpire ) > 0 )
+			pPair->value.m_tExpire = tExpire;	// Wheel picks up later expiry on its pass
+		return &pPair->value;
+	}
+
+	CFloodEntry pEntry = { tNow, tExpire, regionUnknown };
+	m_pEntries.SetAt( nAddress, pEntry );
+	m_pWheel[ ( tExpire / 1000 ) % Slots ].push_back( nAddress );
+
+	return &m_pEntries.PLookup( nAddress )->value;
+}
+
+// Expire entries of each second passed since last call, re-slot the extended ones
+void CFloodFilter::Advance(DWORD tNow)
+{
+	const DWORD nSecond = tNow / 1000;
+
+	if ( m_nSecond == 0 )
+		m_nSecond = nSecond;
+
+	// A full turn visits every entry once, longer idle need not repeat
+	const DWORD nCount = min( nSecond - m_nSecond, (DWORD)Slots );
+	m_nSecond = nSecond;
+
+	for ( DWORD nPass = nCount; nPass; nPass-- )
+	{
+		std::vector< DWORD > pSlot;
+		pSlot.swap( m_pWheel[ ( nSecond - nPass + 1 ) % Slots ] );
+
+		for ( std::vector< DWORD >::const_iterator i = pSlot.begin(); i != pSlot.end(); ++i )
+		{
+			const CFloodMap::CPair* pPair = m_pEntries.PLookup( *i );
+			if ( ! pPair )
+				continue;
+
+			if ( (LONG)( pPair->value.m_tExpire - tNow ) <= 0 )
+				m_pEntries.RemoveKey( *i );
+			else
+				m_pWheel[ ( pPair->value.m_tExpire / 1000 ) % Slots ].push_back( *i );
+		}
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////
 // CAdultFilter construction
 
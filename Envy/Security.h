@@ -60,6 +60,41 @@ enum {
 };
 
 
+// Hashed per-address flood limiter, entries expire through a one-second timer wheel
+class CFloodFilter
+{
+public:
+	CFloodFilter();
+
+	enum { regionUnknown, regionAllowed, regionFlood };
+
+protected:
+	enum { Slots = 64, RegionLife = 60 * 1000 };	// Wheel span (seconds), GeoIP verdict life (ms)
+
+	typedef struct
+	{
+		DWORD	m_tAllow;		// Tick of next allowed query
+		DWORD	m_tExpire;		// Tick entry may be dropped
+		BYTE	m_nRegion;		// Cached flood region verdict
+	} CFloodEntry;
+
+	typedef CMap< DWORD, DWORD, CFloodEntry, const CFloodEntry& > CFloodMap;
+
+	CFloodMap				m_pEntries;
+	std::vector< DWORD >	m_pWheel[ Slots ];	// Addresses by expiry second
+	DWORD					m_nSecond;			// Last expired wheel second
+
+public:
+	bool	Check(DWORD nAddress, DWORD tNow, DWORD nPeriod);	// Token bucket of one query per period
+	BYTE	GetRegion(DWORD nAddress, DWORD tNow);
+	void	SetRegion(DWORD nAddress, DWORD tNow, BYTE nRegion);
+
+protected:
+	CFloodEntry*	Lookup(DWORD nAddress, DWORD tNow, DWORD tExpire);
+	void			Advance(DWORD tNow);
+};
+
+
 class CSecurity
 {
 public:
@@ -91,6 +126,7 @@ protected:
 //	std::vector< CSecureRule* >	m_pRuleIndex;		// Alt applicable rule to map index byte (memory efficiency)
 	std::set< DWORD >			m_Cache;			// Known good addresses
 	CList< CSecureRule* >		m_pRules;
+	CFloodFilter				m_Floods;			// Query rate and flood region by address
 
 public:
 	INT_PTR			GetCount() const;
@@ -111,6 +147,7 @@ public:
 	BOOL			IsDenied(const CEnvyFile* pFile);
 	BOOL			IsDenied(const CQuerySearch* pQuery, const CString& strContent);
 	BOOL			IsFlood(const IN_ADDR* pAddress, const LPCTSTR pszVendor = NULL, PROTOCOLID nProtocol = PROTOCOL_NULL);
+	BOOL			IsQueryFlood(const IN_ADDR* pAddress, PROTOCOLID nProtocol);
 	BOOL			Import(LPCTSTR pszFile);
 	BOOL			Load();
 	BOOL			Save();
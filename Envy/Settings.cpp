@@ -211,6 +211,8 @@ void CSettings::Load()
 	Add( L"Library", L"MarkFileAsDownload", &Library.MarkFileAsDownload, true );
 	Add( L"Library", L"ManyFilesWarning", &Library.ManyFilesWarning, 0, 1, 0, 2 );
 	Add( L"Library", L"ExecuteFilesLimit", &Library.ExecuteFilesLimit, 20, 1, 0, 1000, L" files" );
+	Add( L"Library", L"ExtractThreads", &Library.ExtractThreads, 2, 1, 1, 4 );
+	Add( L"Library", L"ExtractTimeout", &Library.ExtractTimeout, 30, 1, 1, 600, L" s" );
 	Add( L"Library", L"MaliciousFileCount", &Library.MaliciousFileCount, 5, 1, 2, 50, L" files" );
 	Add( L"Library", L"MaliciousFileSize", &Library.MaliciousFileSize, 2*MegaByte, KiloByte, KiloByte, 10*MegaByte, L" KB" );
 	Add( L"Library", L"MaliciousFileTypes", &Library.MaliciousFileTypes, L"|exe|com|bat|vbs|scr|zip|rar|ace|7z|cab|lzh|tar|tgz|bz2|wma|wmv|" );
@@ -271,6 +273,8 @@ void CSettings::Load()
 	Add( L"Search", L"GeneralThrottle", &Search.GeneralThrottle, 200, 1, 200, 1000, L" ms" );
 	Add( L"Search", L"HideSearchPanel", &Search.HideSearchPanel, false );
 	Add( L"Search", L"HighlightNew", &Search.HighlightNew, true );
+	Add( L"Search", L"HitBatch", &Search.HitBatch, 256, 1, 1, 4096 );
+	Add( L"Search", L"HitQueue", &Search.HitQueue, 8192, 1, 256, 100000 );
 	Add( L"Search", L"LastSchemaURI", &Search.LastSchemaURI );
 	Add( L"Search", L"MaxPreviewLength", &Search.MaxPreviewLength, 20*KiloByte, KiloByte, 1, 5*KiloByte, L" KB" );
 	Add( L"Search", L"MonitorFilter", &Search.MonitorFilter );
@@ -355,7 +359,9 @@ void CSettings::Load()
 	Add( L"Connection", L"MulticastLoop", &Connection.MulticastLoop, false );
 	Add( L"Connection", L"MulticastTTL", &Connection.MulticastTTL, 1, 1, 0, 255 );
 	Add( L"Connection", L"ZLibCompressionLevel", &Connection.ZLibCompressionLevel, 2, 1, 0, 9 );
+	Add( L"Connection", L"ZLibCPUBudget", &Connection.ZLibCPUBudget, 50, 1, 1, 1000, L" ms" );
 
+	Add( L"Bandwidth", L"Burst", &Bandwidth.Burst, 250, 1, 10, 5000, L" ms" );
 	Add( L"Bandwidth", L"Downloads", &Bandwidth.Downloads, 0 );
 	Add( L"Bandwidth", L"HubIn", &Bandwidth.HubIn, 0, 128, 0, 8192, L" Kb/s" );
 	Add( L"Bandwidth", L"HubOut", &Bandwidth.HubOut, 0, 128, 0, 8192, L" Kb/s" );
@@ -365,6 +371,13 @@ void CSettings::Load()
 	Add( L"Bandwidth", L"PeerIn", &Bandwidth.PeerIn, 0, 128, 0, 8192, L" Kb/s" );
 	Add( L"Bandwidth", L"PeerOut", &Bandwidth.PeerOut, 0, 128, 0, 8192, L" Kb/s" );
 	Add( L"Bandwidth", L"Request", &Bandwidth.Request, 32*128, 128, 0, 8192, L" Kb/s" );
+	Add( L"Bandwidth", L"Reserve", &Bandwidth.Reserve, 10, 1, 0, 50, L" %" );
+	Add( L"Bandwidth", L"ShareBT", &Bandwidth.ShareBT, 100, 1, 1, 100, L" %" );
+	Add( L"Bandwidth", L"ShareDC", &Bandwidth.ShareDC, 100, 1, 1, 100, L" %" );
+	Add( L"Bandwidth", L"ShareED2K", &Bandwidth.ShareED2K, 100, 1, 1, 100, L" %" );
+	Add( L"Bandwidth", L"ShareG1", &Bandwidth.ShareG1, 100, 1, 1, 100, L" %" );
+	Add( L"Bandwidth", L"ShareG2", &Bandwidth.ShareG2, 100, 1, 1, 100, L" %" );
+	Add( L"Bandwidth", L"ShareHTTP", &Bandwidth.ShareHTTP, 100, 1, 1, 100, L" %" );
 	Add( L"Bandwidth", L"UdpOut", &Bandwidth.UdpOut, 0, 128, 0, 8192, L" Kb/s" );
 	Add( L"Bandwidth", L"Uploads", &Bandwidth.Uploads, 0 );
 
@@ -401,6 +414,7 @@ void CSettings::Load()
 	Add( L"Gnutella", L"MaxHitWords", &Gnutella.MaxHitWords, 30, 1, 3, 100, L" words" );
 	Add( L"Gnutella", L"MaxHitLength", &Gnutella.MaxHitLength, 180, 1, 50, 255, L" chars" );
 	Add( L"Gnutella", L"MaximumPacket", &Gnutella.MaximumPacket, 64*KiloByte, KiloByte, 32, 256, L" KB" );
+	Add( L"Gnutella", L"OutboundBuffer", &Gnutella.OutboundBuffer, 256*KiloByte, KiloByte, 16, 4096, L" KB" );
 	Add( L"Gnutella", L"RouteCache", &Gnutella.RouteCache, 600, 60, 1, 120, L" m" );
 	Add( L"Gnutella", L"SpecifyProtocol", &Gnutella.SpecifyProtocol, true );
 
@@ -426,6 +440,7 @@ void CSettings::Load()
 	Add( L"Gnutella1", L"PongCache", &Gnutella1.PongCache, 10000, 1000, 1, 180, L" s" );
 	Add( L"Gnutella1", L"PongCount", &Gnutella1.PongCount, 10, 1, 1, 64 );
 	Add( L"Gnutella1", L"QueryHitUTF8", &Gnutella1.QueryHitUTF8, true );
+	Add( L"Gnutella1", L"QueryFlood", &Gnutella1.QueryFlood, 5000, 1000, 0, 60, L" s" );
 	Add( L"Gnutella1", L"QuerySearchUTF8", &Gnutella1.QuerySearchUTF8, true );
 	Add( L"Gnutella1", L"QueryThrottle", &Gnutella1.QueryThrottle, 60, 1, 20, 30*60, L" s" );
 	Add( L"Gnutella1", L"QueryGlobalThrottle", &Gnutella1.QueryGlobalThrottle, 60*1000, 1000, 60, 60*60, L" s" );
@@ -460,6 +475,7 @@ void CSettings::Load()
 	}
 	Add( L"Gnutella2", L"PingRate", &Gnutella2.PingRate, 15000, 1000, 5, 180, L" s" );
 	Add( L"Gnutella2", L"PingRelayLimit", &Gnutella2.PingRelayLimit, 10, 1, 10, 30 );
+	Add( L"Gnutella2", L"QueryFlood", &Gnutella2.QueryFlood, 5000, 1000, 0, 60, L" s" );
 	Add( L"Gnutella2", L"QueryThrottle", &Gnutella2.QueryThrottle, 120, 1, 20, 30*60, L" s" );
 	Add( L"Gnutella2", L"QueryGlobalThrottle", &Gnutella2.QueryGlobalThrottle, 125, 1, 1, 60*1000, L" ms" );
 	Add( L"Gnutella2", L"QueryHostDeadline", &Gnutella2.QueryHostDeadline, 10*60, 1, 1, 120*60, L" s" );
@@ -196,6 +196,8 @@ public:
 		bool		HighPriorityHash;		// Use high priority hashing or not
 		DWORD		HighPriorityHashing;	// desired speed in MB/s when hashing with hi priority
 		DWORD		LowPriorityHashing;		// desired speed in MB/s when hashing with low priority
+		DWORD		ExtractThreads;			// Metadata extraction workers running beside hashing
+		DWORD		ExtractTimeout;			// Seconds before a metadata extractor is abandoned
 		DWORD		ManyFilesWarning;		// Too many files selected warning.  0 -ask user, 1 -no, 2 -yes
 		DWORD		ExecuteFilesLimit;		// Minimum number of selected files to trigger warning  (TOO_MANY_FILES_LIMIT)
 		DWORD		MaliciousFileCount;		// Minimum number of duplicate files to trigger warning
@@ -263,6 +265,8 @@ public:
 		DWORD		GeneralThrottle;		// A general throttle for how often each individual search may run. Low values may cause source finding to get overlooked.
 		DWORD		ClearPrevious;			// Clear previous search results? 0 - ask user; 1 - no; 2 - yes.
 		bool		SanityCheck;			// Drop hits of banned hosts
+		DWORD		HitBatch;				// Query hits merged into one processing job
+		DWORD		HitQueue;				// Query hits waiting before search windows are skipped (twice that and new hits are dropped)
 	} Search;
 
 	struct sMediaPlayer
@@ -341,7 +345,8 @@ public:
 		bool		EnableMulticast;		// Send and accept multi-cast packets (default true)
 		bool		MulticastLoop;			// Use multi-cast loopback (default false, for debugging)
 		DWORD		MulticastTTL;			// TTL for multi-cast packets (default 1)
-		DWORD		ZLibCompressionLevel;	// ZLib compression level: 0-9 (default 1)
+		DWORD		ZLibCompressionLevel;	// ZLib compression level: 0-9 (default 1), upper bound of the per-link level
+		DWORD		ZLibCPUBudget;			// Deflate time all neighbour links may use per second (ms) before levels step down
 	} Connection;
 
 	struct sBandwidth
@@ -357,6 +362,14 @@ public:
 		DWORD		Downloads;				// Inbound speed limit in Bytes/seconds
 		DWORD		Uploads;				// Outbound speed limit in Bytes/seconds
 		DWORD		HubUploads;
+		DWORD		Burst;					// Governor token bucket depth (ms of line speed)
+		DWORD		Reserve;				// Governor line share kept for control traffic (%)
+		DWORD		ShareBT;				// Governor line share per protocol (%, 100 = no limit)
+		DWORD		ShareDC;
+		DWORD		ShareED2K;
+		DWORD		ShareG1;
+		DWORD		ShareG2;
+		DWORD		ShareHTTP;
 	} Bandwidth;
 
 	struct sCommunity
@@ -396,6 +409,7 @@ public:
 		DWORD		MaxHitWords;			// Maximum number of words in a hit filename  ~30
 		DWORD		MaxHitLength;			// Maximum number of chars in a hit filename  ~160
 		DWORD		MaximumPacket;			// Drop packets large than specified (32-256 KB)
+		DWORD		OutboundBuffer;			// Bytes of buffered packets held per neighbour before the lowest class is dropped
 		DWORD		HitsPerPacket;			// Maximum file hits in single search result packet
 		DWORD		RouteCache;				// Life time of node route (seconds)
 		DWORD		HostCacheSize;			// Number of hosts of each type in Host cache
@@ -433,6 +447,7 @@ public:
 	//	DWORD		HitQueueLimit;			// Protect G1 clients from badly configured queues
 		bool		QueryHitUTF8;			// Use UTF-8 encoding to read Gnutella1 QueryHit packets
 		bool		QuerySearchUTF8;		// Use UTF-8 encoding to create Gnutella1 Query packets
+		DWORD		QueryFlood;				// Minimum interval between queries from one address (ms)
 		DWORD		QueryThrottle;
 		DWORD		QueryGlobalThrottle;	// Multicast query rate (ticks)
 		DWORD		MulticastPingRate;		// Multicast ping rate (ticks)
@@ -467,6 +482,7 @@ public:
 		DWORD		HostCount;				// Number of hosts in X-Try-Hubs
 		DWORD		HostExpire;
 		DWORD		PingRate;
+		DWORD		QueryFlood;				// Minimum interval between queries from one address (ms)
 		DWORD		QueryThrottle;			// Throttle for G2 neighbor searches (sec) (was QueryHostThrottle)
 		DWORD		QueryGlobalThrottle;	// Max G2 query rate (Cannot exceed 8/sec)
 		DWORD		QueryHostDeadline;
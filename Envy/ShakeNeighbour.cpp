@@ -32,6 +32,7 @@
 #include "Buffer.h"
 #include "Packet.h"
 #include "Security.h"
+#include "Statistics.h"
 #include "HostCache.h"
 #include "VendorCache.h"
 
@@ -637,6 +638,62 @@ BOOL CShakeNeighbour::ReadResponse()
 //////////////////////////////////////////////////////////////////////
 // CShakeNeighbour handshake header processing
 
+// Expected handshake headers, hashed once at startup so lookups only read the table
+static const CTextSwitch::Item pHeaderItems[] =
+{
+	{ L"user-agent",				'u' },
+	{ L"remote-ip",					'i' },
+	{ L"listen-ip",					'o' },
+	{ L"x-my-address",				'o' },
+	{ L"x-node",					'o' },
+	{ L"node",						'o' },
+	{ L"pong-caching",				'p' },
+	{ L"vendor-message",			'v' },
+	{ L"ggep",						'g' },
+	{ L"accept",					'a' },
+	{ L"accept-encoding",			'e' },
+	{ L"content-encoding",			's' },
+	{ L"content-type",				't' },
+	{ L"x-query-routing",			'q' },
+	{ L"x-hub",						'h' },
+	{ L"x-ultrapeer",				'h' },
+	{ L"x-hub-needed",				'n' },
+	{ L"x-ultrapeer-needed",		'n' },
+	{ L"x-hub-loaded",				'l' },
+	{ L"x-ultrapeer-loaded",		'l' },
+	{ L"x-degree",					'd' },
+	{ L"x-max-ttl",					'm' },
+	{ L"x-dynamic-querying",		'y' },
+	{ L"x-ultrapeer-query-routing",	'z' },
+	{ L"x-requeries",				'r' },
+	{ L"x-ext-probes",				'b' },
+	{ L"x-locale-pref",				'f' },
+	{ L"x-try-dna-hubs",			'D' },
+	{ L"x-try-hubs",				'H' },
+	{ L"x-try-ultrapeers",			'U' },
+	{ L"x-hostname",				'N' },
+
+	// http://getenvy.com/limewirewiki/Known_Gnutella_Connection_Headers.html
+	// http://limewire.negatis.com/index.php?title=Known_Gnutella_Connection_Headers
+//	{ L"uptime",					'x' },
+//	{ L"x-live-since",				'x' },
+//	{ L"x-features",				'x' },
+//	{ L"x-version",					'x' },
+//	{ L"x-guess",					'x' },	// OOB
+//	{ L"x-leaf-max",				'x' },
+//	{ L"x-hops-flow",				'x' },
+//	{ L"x-bye-packet",				'x' },
+//	{ L"x-try",						'x' },
+
+	// http://getenvy.com/limewirewiki/Communicating_Network_Topology_Information.html
+	// http://limewire.negatis.com/index.php?title=Communicating_Network_Topology_Information
+//	{ L"crawler",					'w' },
+//	{ L"leaves",					'#' },
+//	{ L"peers",						'#' },
+};
+
+static const CTextSwitch HeaderNames( pHeaderItems, _countof( pHeaderItems ) );
+
 // Takes a handshake header and value parsed from a line sent by the remote computer
 // Reads it and sets member variables to reflect the remote computer's capabilities
 // Returns true to keep going, or false to indicate the handshake is over or we should stop trying to read it
@@ -648,61 +705,7 @@ BOOL CShakeNeighbour::OnHeaderLine(CString& strHeader, CString& strValue)
 	if ( strHeader.GetLength() < 4 )
 		return TRUE;	// Skip bad/unknown small header
 
-	// Expected Headers:
-	SwitchMap( Text )
-	{
-		Text[ L"user-agent" ]			= 'u';
-		Text[ L"remote-ip" ]			= 'i';
-		Text[ L"listen-ip" ]			= 'o';
-		Text[ L"x-my-address" ]			= 'o';
-		Text[ L"x-node" ]				= 'o';
-		Text[ L"node" ]					= 'o';
-		Text[ L"pong-caching" ]			= 'p';
-		Text[ L"vendor-message" ]		= 'v';
-		Text[ L"ggep" ]					= 'g';
-		Text[ L"accept" ]				= 'a';
-		Text[ L"accept-encoding" ] 		= 'e';
-		Text[ L"content-encoding" ]		= 's';
-		Text[ L"content-type" ]			= 't';
-		Text[ L"x-query-routing" ] 		= 'q';
-		Text[ L"x-hub" ]				= 'h';
-		Text[ L"x-ultrapeer" ]			= 'h';
-		Text[ L"x-hub-needed" ]			= 'n';
-		Text[ L"x-ultrapeer-needed" ]	= 'n';
-		Text[ L"x-hub-loaded" ]			= 'l';
-		Text[ L"x-ultrapeer-loaded" ]	= 'l';
-		Text[ L"x-degree" ]				= 'd';
-		Text[ L"x-max-ttl" ]			= 'm';
-		Text[ L"x-dynamic-querying" ]	= 'y';
-		Text[ L"x-ultrapeer-query-routing" ] = 'z';
-		Text[ L"x-requeries" ]			= 'r';
-		Text[ L"x-ext-probes" ]			= 'b';
-		Text[ L"x-locale-pref" ]		= 'f';
-		Text[ L"x-try-dna-hubs" ]		= 'D';
-		Text[ L"x-try-hubs" ]			= 'H';
-		Text[ L"x-try-ultrapeers" ]		= 'U';
-		Text[ L"x-hostname" ]			= 'N';
-
-		// http://getenvy.com/limewirewiki/Known_Gnutella_Connection_Headers.html
-		// http://limewire.negatis.com/index.php?title=Known_Gnutella_Connection_Headers
-		//Text[ L"uptime" ]				= 'x';
-		//Text[ L"x-live-since" ]		= 'x';
-		//Text[ L"x-features" ]			= 'x';
-		//Text[ L"x-version" ]			= 'x';
-		//Text[ L"x-guess" ]			= 'x';	// OOB
-		//Text[ L"x-leaf-max" ]			= 'x';
-		//Text[ L"x-hops-flow" ] 		= 'x';
-		//Text[ L"x-bye-packet" ]		= 'x';
-		//Text[ L"x-try" ]				= 'x';
-
-		// http://getenvy.com/limewirewiki/Communicating_Network_Topology_Information.html
-		// http://limewire.negatis.com/index.php?title=Communicating_Network_Topology_Information
-		//Text[ L"crawler" ]			= 'w';
-		//Text[ L"leaves" ]				= '#';
-		//Text[ L"peers" ]				= '#';
-	}
-
-	switch ( Text[ CString( strHeader ).MakeLower() ] )
+	switch ( HeaderNames.Lookup( strHeader ) )
 	{
 	case 'u':		// "User-Agent"
 		// Save the name and version of the remote program
@@ -1456,6 +1459,8 @@ BOOL CShakeNeighbour::OnHeadersCompleteG1()
 // Creates a new GC1Neighbour or CG2Neighbour object based on this one, and deletes this one
 void CShakeNeighbour::OnHandshakeComplete()
 {
+	Statistics.Sample( statHandshake, GetTickCount() - m_tConnected );
+
 	m_bAutoDelete = FALSE;
 
 	// Remove this CShakeNeighbour object from the list of them the neighbours object keeps
@@ -66,12 +66,7 @@ END_INTERFACE_MAP()
 // CLibraryFile construction
 
 CLibraryFile::CLibraryFile(CLibraryFolder* pFolder, LPCTSTR pszName)
-	: m_pNextSHA1		( NULL )
-	, m_pNextTiger		( NULL )
-	, m_pNextED2K		( NULL )
-	, m_pNextBTH		( NULL )
-	, m_pNextMD5		( NULL )
-	, m_nScanCookie		( 0ul )
+	: m_nScanCookie		( 0ul )
 	, m_nUpdateCookie	( 0ul )
 	, m_nSelectCookie	( 0ul )
 	, m_nListCookie		( 0ul )
@@ -235,7 +230,6 @@ CXMLElement* CLibraryFile::CreateXML(CXMLElement* pRoot, BOOL bSharedOnly, XmlTy
 		{
 			if ( CXMLElement* pMetadata = pFile->AddElement( L"metadata" ) )
 			{
-				m_pMetadata->m_bOrdered = FALSE;	// Workaround
 				pMetadata->AddAttribute( L"xmlns:s", m_pSchema->GetURI() );
 				pMetadata->AddElement( m_pMetadata->Prefix( L"s:" ) );
 			}
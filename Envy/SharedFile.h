@@ -42,11 +42,6 @@ public:
 	virtual ~CLibraryFile();
 
 public:
-	CLibraryFile*	m_pNextSHA1;
-	CLibraryFile*	m_pNextTiger;
-	CLibraryFile*	m_pNextED2K;
-	CLibraryFile*	m_pNextBTH;
-	CLibraryFile*	m_pNextMD5;
 	DWORD			m_nScanCookie;
 	DWORD			m_nUpdateCookie;
 	DWORD			m_nSelectCookie;
@@ -24,6 +24,7 @@
 #include "Library.h"
 #include "LibraryDictionary.h"
 #include "LibraryFolders.h"
+#include "LibraryMonitor.h"
 #include "Application.h"
 #include "Skin.h"
 #include "XML.h"
@@ -56,7 +57,7 @@ CLibraryFolder::CLibraryFolder(CLibraryFolder* pParent, LPCTSTR pszPath)
 	, m_sName		( PathFindFileName( m_sPath ) )
 	, m_bShared 	( pParent ? TRI_UNKNOWN : TRI_TRUE )
 	, m_bExpanded	( pParent ? FALSE : TRUE )
-	, m_hMonitor	( INVALID_HANDLE_VALUE )
+	, m_pMonitor	( NULL )
 	, m_bForceScan	( TRUE )
 	, m_bOffline	( FALSE )
 {
@@ -74,10 +75,10 @@ CLibraryFolder::~CLibraryFolder()
 
 void CLibraryFolder::CloseMonitor()
 {
-	if ( m_hMonitor != INVALID_HANDLE_VALUE )
+	if ( m_pMonitor )
 	{
-		FindCloseChangeNotification( m_hMonitor );
-		m_hMonitor = INVALID_HANDLE_VALUE;
+		delete m_pMonitor;
+		m_pMonitor = NULL;
 		m_bForceScan = FALSE;
 	}
 }
@@ -580,33 +581,26 @@ BOOL CLibraryFolder::IsChanged()
 	BOOL bChanged = FALSE;
 
 	// Monitor changes
-	if ( m_hMonitor != INVALID_HANDLE_VALUE )
+	if ( m_pMonitor && ! m_pMonitor->Poll() )
 	{
-		switch ( WaitForSingleObject( m_hMonitor, 0 ) )
-		{
-		case WAIT_TIMEOUT:		// No changes
-			break;
-
-		case WAIT_OBJECT_0:		// Changes detected
-			bChanged = TRUE;
-
-			// Reset monitor
-			if ( FindNextChangeNotification( m_hMonitor ) )
-				break;
+		// Changes lost (overflow) or errors
+		bChanged = TRUE;
 
-		default:				// Errors
+		if ( ! m_pMonitor->IsOpen() )
 			CloseMonitor();
-		}
 	}
 
-	if ( m_hMonitor == INVALID_HANDLE_VALUE && Settings.Library.WatchFolders )
+	if ( ! m_pMonitor && Settings.Library.WatchFolders )
 	{
 		// Enable monitor
-		m_hMonitor = FindFirstChangeNotification( m_sPath, TRUE,
-			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
-			FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_LAST_WRITE );
+		m_pMonitor = new CLibraryMonitor();
+		if ( ! m_pMonitor->Open( m_sPath ) )
+		{
+			delete m_pMonitor;
+			m_pMonitor = NULL;
+		}
 	}
-	else if ( m_hMonitor != INVALID_HANDLE_VALUE && ! Settings.Library.WatchFolders )
+	else if ( m_pMonitor && ! Settings.Library.WatchFolders )
 	{
 		// Disable monitor
 		CloseMonitor();
@@ -619,9 +613,193 @@ BOOL CLibraryFolder::IsChanged()
 		m_bForceScan = FALSE;
 	}
 
+	// Full scan supersedes journaled changes
+	if ( bChanged && m_pMonitor )
+		m_pMonitor->ClearChanges();
+
 	return bChanged;
 }
 
+BOOL CLibraryFolder::ThreadUpdate()
+{
+	ASSUME_LOCK( Library.m_pSection );
+
+	if ( ! m_pMonitor )
+		return FALSE;
+
+	BOOL bChanged = FALSE;
+
+	CLibraryMonitor::CChange oChange;
+	while ( Library.IsThreadEnabled() && m_pMonitor->GetNextChange( oChange ) )
+	{
+		if ( ! OnMonitorChange( oChange.m_sPath, oChange.m_nAction, oChange.m_sOldPath, bChanged ) )
+		{
+			// Unknown folder, journal out of sync with library
+			m_pMonitor->ClearChanges();
+			m_bForceScan = TRUE;
+			Library.Wakeup();
+			break;
+		}
+	}
+
+	if ( bChanged )
+		m_nUpdateCookie++;
+
+	return bChanged;
+}
+
+BOOL CLibraryFolder::OnMonitorChange(const CString& strPath, DWORD nAction, const CString& strOldPath, BOOL& bChanged)
+{
+	ASSUME_LOCK( Library.m_pSection );
+
+	const int nSlash = strPath.ReverseFind( L'\\' );
+	const CString strName = strPath.Mid( nSlash + 1 );
+
+	// Locate parent folder
+	CLibraryFolder* pParent = this;
+	if ( nSlash > 0 )
+	{
+		pParent = GetFolderByName( strPath.Left( nSlash ) );
+		if ( ! pParent )
+		{
+			// Changes inside skipped folders are expected
+			CString strFolder = m_sPath;
+			for ( int nPos = 0; nPos < nSlash; )
+			{
+				const CString strPart = strPath.Tokenize( L"\\", nPos );
+				if ( strPart.IsEmpty() ) break;
+				if ( CLibrary::IsBadFile( strPart, strFolder, GetFileAttributes( SafePath( strFolder + L"\\" + strPart ) ) ) )
+					return TRUE;
+				strFolder += L"\\" + strPart;
+			}
+			return FALSE;
+		}
+	}
+
+	if ( strName.IsEmpty() )
+		return TRUE;
+
+	if ( pParent->m_sPath.CompareNoCase( Settings.Downloads.IncompletePath ) == 0 )
+		return TRUE;
+
+	const CString strFullPath = pParent->m_sPath + L"\\" + strName;
+
+	WIN32_FILE_ATTRIBUTE_DATA pData = {};
+	if ( nAction == FILE_ACTION_REMOVED ||
+		 ! GetFileAttributesEx( SafePath( strFullPath ), GetFileExInfoStandard, &pData ) )
+		pData.dwFileAttributes = INVALID_FILE_ATTRIBUTES;		// Already gone
+
+	const BOOL bBadFile = CLibrary::IsBadFile( strName, pParent->m_sPath, pData.dwFileAttributes );
+
+	// Rename in place to keep hashes and metadata
+	if ( nAction == FILE_ACTION_RENAMED_NEW_NAME && ! bBadFile &&
+		 ! ( pData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+	{
+		const int nOldSlash = strOldPath.ReverseFind( L'\\' );
+		if ( strOldPath.Left( max( nOldSlash, 0 ) ).CompareNoCase( strPath.Left( max( nSlash, 0 ) ) ) == 0 )
+		{
+			if ( CLibraryFile* pFile = pParent->GetFile( strOldPath.Mid( nOldSlash + 1 ) ) )
+			{
+				if ( ! pParent->GetFile( strName ) )
+				{
+					Library.RemoveFile( pFile );
+					VERIFY( pParent->m_pFiles.RemoveKey( pFile->m_sName ) );
+					pFile->m_sName = strName;
+					pParent->m_pFiles.SetAt( pFile->m_sName, pFile );
+					Library.AddFile( pFile );
+					pParent->m_nUpdateCookie++;
+					bChanged = TRUE;
+				}
+			}
+		}
+	}
+
+	if ( nAction == FILE_ACTION_RENAMED_NEW_NAME && ! strOldPath.IsEmpty() )
+	{
+		// Remove old name (left over by folder or cross-folder renames)
+		if ( ! OnMonitorChange( strOldPath, FILE_ACTION_REMOVED, CString(), bChanged ) )
+			return FALSE;
+	}
+
+	const DWORD nFiles	= pParent->m_nFiles;
+	const QWORD nVolume	= pParent->m_nVolume;
+
+	if ( bBadFile )
+	{
+		// Removed or became unshareable
+		if ( CLibraryFolder* pFolder = pParent->GetFolderByName( strName ) )
+		{
+			pParent->m_nFiles	-= pFolder->m_nFiles;
+			pParent->m_nVolume	-= pFolder->m_nVolume;
+
+			VERIFY( pParent->m_pFolders.RemoveKey( pFolder->m_sName ) );
+			pFolder->OnDelete( Settings.Library.CreateGhosts ? TRI_TRUE : TRI_FALSE );
+			pParent->m_nUpdateCookie++;
+			bChanged = TRUE;
+		}
+		else if ( CLibraryFile* pFile = pParent->GetFile( strName ) )
+		{
+			pFile->OnDelete( TRUE, Settings.Library.CreateGhosts ? TRI_TRUE : TRI_FALSE );
+			bChanged = TRUE;
+		}
+	}
+	else if ( pData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+	{
+		// Folder content changes are reported separately
+		if ( nAction == FILE_ACTION_MODIFIED && pParent->GetFolderByName( strName ) )
+			return TRUE;
+
+		CLibraryFolder* pFolder = pParent->GetFolderByName( strName );
+		if ( pFolder )
+		{
+			pParent->m_nFiles	-= pFolder->m_nFiles;
+			pParent->m_nVolume	-= pFolder->m_nVolume;
+		}
+		else
+		{
+			pFolder = new CLibraryFolder( pParent, strFullPath );
+			pParent->m_pFolders.SetAt( pFolder->m_sName, pFolder );
+			pParent->m_nUpdateCookie++;
+			bChanged = TRUE;
+		}
+
+		if ( pFolder->ThreadScan( pParent->m_nScanCookie ) )
+			bChanged = TRUE;
+
+		pParent->m_nFiles	+= pFolder->m_nFiles;
+		pParent->m_nVolume	+= pFolder->m_nVolume;
+	}
+	else
+	{
+		BOOL bNew;
+		CLibraryFile* pFile = pParent->AddFile( strName, bNew );
+		if ( ! bNew )
+			pParent->m_nVolume -= pFile->m_nSize;
+		else
+			bChanged = TRUE;
+
+		const QWORD nLongSize = (QWORD)pData.nFileSizeLow |
+			( (QWORD)pData.nFileSizeHigh << 32 );
+
+		if ( pFile->ThreadScan( pParent->m_nScanCookie, nLongSize, &pData.ftLastWriteTime ) )
+			bChanged = TRUE;
+
+		pParent->m_nVolume += pFile->m_nSize;
+	}
+
+	// Propagate totals up to root
+	for ( CLibraryFolder* pFolder = pParent->m_pParent; pFolder; pFolder = pFolder->m_pParent )
+	{
+		pFolder->m_nFiles	+= pParent->m_nFiles - nFiles;
+		pFolder->m_nVolume	+= pParent->m_nVolume - nVolume;
+	}
+
+	if ( pParent != this && ( pParent->m_nFiles != nFiles || pParent->m_nVolume != nVolume ) )
+		pParent->m_nUpdateCookie++;
+
+	return TRUE;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CLibraryFolder scan
 
@@ -21,6 +21,7 @@
 #include "LibraryFolders.h"
 
 class CLibraryList;
+class CLibraryMonitor;
 class CXMLElement;
 
 
@@ -50,7 +51,7 @@ protected:
 	TRISTATE		m_bShared;
 	CFileMap		m_pFiles;
 	CFolderMap		m_pFolders;
-	HANDLE			m_hMonitor;
+	CLibraryMonitor*	m_pMonitor;		// Change journal (root folder only)
 	BOOL			m_bForceScan;		// TRUE - next scan forced (root folder only)
 	BOOL			m_bOffline;			// TRUE - folder absent (root folder only)
 	Hashes::Guid	m_oGUID;
@@ -82,7 +83,8 @@ public:
 	BOOL			SetOnline();
 	void			Serialize(CArchive& ar, int nVersion);
 	BOOL			ThreadScan(DWORD nScanCookie = 0);
-	BOOL			IsChanged();						// Manage filesystem change notification. Returns TRUE if changes detected.
+	BOOL			IsChanged();						// Manage filesystem change notification. Returns TRUE if full scan needed.
+	BOOL			ThreadUpdate();						// Apply journaled per-file changes. Returns TRUE if library changed.
 	void			OnDelete(TRISTATE bCreateGhost = TRI_UNKNOWN);
 	void			OnFileRename(CLibraryFile* pFile);
 	void			Maintain(BOOL bAdd);
@@ -90,6 +92,7 @@ public:
 protected:
 	// Disable change notification monitor
 	void			CloseMonitor();
+	BOOL			OnMonitorChange(const CString& strPath, DWORD nAction, const CString& strOldPath, BOOL& bChanged);
 	void			Clear();
 	void			RenewGUID();
 	bool			operator==(const CLibraryFolder& val) const;
@@ -19,6 +19,7 @@
 #include "StdAfx.h"
 #include "Envy.h"
 #include "Statistics.h"
+#include "BandwidthGovernor.h"
 #include "Network.h"
 #include "Neighbours.h"
 
@@ -35,10 +36,16 @@ CStatistics Statistics;
 // CStatistics construction
 
 CStatistics::CStatistics()
+	: m_nHistory		( 0 )
+	, m_nHistoryCount	( 0 )
 {
 	ZeroMemory( &Ever, sizeof( Ever ) );
 	ZeroMemory( &Today, sizeof( Today ) );
 	ZeroMemory( &Current, sizeof( Current ) );
+	ZeroMemory( &m_pSecond, sizeof( m_pSecond ) );
+	ZeroMemory( (LPVOID)m_pShard, sizeof( m_pShard ) );
+	ZeroMemory( m_pHistory, sizeof( m_pHistory ) );
+	ZeroMemory( m_nHistogram, sizeof( m_nHistogram ) );
 
 	m_tSeconds = GetMicroCount() / 1000;
 }
@@ -53,6 +60,7 @@ CStatistics::~CStatistics()
 void CStatistics::Update()
 {
 	const QWORD tNow = GetMicroCount() / 1000;	// ms
+	BOOL bSecond = FALSE;
 
 	if ( tNow >= m_tSeconds + 1000 )
 	{
@@ -65,12 +73,242 @@ void CStatistics::Update()
 		}
 
 		m_tSeconds = tNow;
+		bSecond = TRUE;
 	}
 
 	CopyMemory( &Last, &Current, sizeof( Current ) );
 	Add( &Today, &Current, sizeof( Current ) );
 	Add( &Ever, &Current, sizeof( Current ) );
+	Add( &m_pSecond, &Current, sizeof( Current ) );
 	ZeroMemory( &Current, sizeof( Current ) );
+
+	if ( bSecond )
+		Collect();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CStatistics sample (hot path)
+
+void CStatistics::Sample(StatisticsMetric nMetric, DWORD nValue)
+{
+	ASSERT( nMetric >= 0 && nMetric < statLast );
+
+	// Thread IDs are multiples of four
+	sShard& oShard = m_pShard[ ( GetCurrentThreadId() >> 2 ) % STATISTICS_SHARDS ];
+
+	DWORD nBucket = 0;
+	if ( nValue && _BitScanReverse( &nBucket, nValue ) )
+		nBucket = min( nBucket + 1, (DWORD)( STATISTICS_BUCKETS - 1 ) );
+
+	InterlockedIncrement( &oShard.Count[ nMetric ][ nBucket ] );
+	InterlockedExchangeAdd64( &oShard.Sum[ nMetric ], (LONGLONG)nValue );
+}
+
+//////////////////////////////////////////////////////////////////////
+// CStatistics collect one second of history
+
+void CStatistics::Collect()
+{
+	CQuickLock oLock( m_pSection );
+
+	sSecond& oSecond = m_pHistory[ m_nHistory ];
+	m_nHistory = ( m_nHistory + 1 ) % STATISTICS_HISTORY;
+	if ( m_nHistoryCount < STATISTICS_HISTORY )
+		m_nHistoryCount++;
+
+	oSecond.Time = static_cast< DWORD >( time( NULL ) );
+	CopyMemory( &oSecond.Totals, &m_pSecond, sizeof( m_pSecond ) );
+	ZeroMemory( &m_pSecond, sizeof( m_pSecond ) );
+
+	for ( int nMetric = 0; nMetric < statLast; nMetric++ )
+	{
+		DWORD pBuckets[ STATISTICS_BUCKETS ] = {};
+		QWORD nSum = 0;
+
+		for ( int nShard = 0; nShard < STATISTICS_SHARDS; nShard++ )
+		{
+			sShard& oShard = m_pShard[ nShard ];
+			for ( int nBucket = 0; nBucket < STATISTICS_BUCKETS; nBucket++ )
+			{
+				if ( oShard.Count[ nMetric ][ nBucket ] )
+					pBuckets[ nBucket ] += (DWORD)InterlockedExchange( &oShard.Count[ nMetric ][ nBucket ], 0 );
+			}
+			nSum += (QWORD)InterlockedExchange64( &oShard.Sum[ nMetric ], 0 );
+		}
+
+		DWORD nCount = 0;
+		for ( int nBucket = 0; nBucket < STATISTICS_BUCKETS; nBucket++ )
+		{
+			nCount += pBuckets[ nBucket ];
+			m_nHistogram[ nMetric ][ nBucket ] += pBuckets[ nBucket ];
+		}
+
+		sMetric& oMetric = oSecond.Metric[ nMetric ];
+		oMetric.Count	= nCount;
+		oMetric.Average	= nCount ? (DWORD)( nSum / nCount ) : 0;
+		oMetric.Median	= Percentile( pBuckets, nCount, 50 );
+		oMetric.Peak	= Percentile( pBuckets, nCount, 99 );
+	}
+}
+
+DWORD CStatistics::Percentile(const DWORD* pBuckets, DWORD nCount, DWORD nPercent)
+{
+	if ( ! nCount )
+		return 0;
+
+	const QWORD nRank = ( (QWORD)nCount * nPercent + 99 ) / 100;
+	QWORD nSeen = 0;
+
+	for ( int nBucket = 0; nBucket < STATISTICS_BUCKETS; nBucket++ )
+	{
+		nSeen += pBuckets[ nBucket ];
+		if ( nSeen >= nRank )
+			return nBucket ? (DWORD)( ( 1ull << nBucket ) - 1 ) : 0;
+	}
+
+	return 0xFFFFFFFF;
+}
+
+LPCTSTR CStatistics::GetMetricName(int nMetric)
+{
+	switch ( nMetric )
+	{
+	case statHandshake:
+		return L"handshake_ms";
+	case statHitRoute:
+		return L"hit_route_ms";
+	case statDiskWrite:
+		return L"disk_write_us";
+	case statHashRate:
+		return L"hash_kbps";
+	case statExtractTime:
+		return L"extract_ms";
+	default:
+		return L"unknown";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CStatistics export
+
+CString CStatistics::Export(BOOL bCSV) const
+{
+	CQuickLock oLock( m_pSection );
+
+	CString strOutput;
+
+	if ( bCSV )
+	{
+		strOutput = L"time,bandwidth_in,bandwidth_out,packets_in,packets_out,packets_routed,packets_dropped,packets_encoded,packets_shared,queries,hits_unshown,hits_dropped,lost_control,lost_hits,lost_pushes,lost_queries";
+		for ( int nMetric = 0; nMetric < statLast; nMetric++ )
+		{
+			LPCTSTR pszName = GetMetricName( nMetric );
+			strOutput.AppendFormat( L",%s_count,%s_avg,%s_p50,%s_p99", pszName, pszName, pszName, pszName );
+		}
+		strOutput += L"\r\n";
+	}
+	else
+	{
+		strOutput = L"{\"interval\":1,\"history\":[";
+	}
+
+	for ( int nItem = 0; nItem < m_nHistoryCount; nItem++ )
+	{
+		const sSecond& oSecond = m_pHistory[ ( m_nHistory - m_nHistoryCount + nItem + STATISTICS_HISTORY ) % STATISTICS_HISTORY ];
+		const sTotals& oTotals = oSecond.Totals;
+
+		strOutput.AppendFormat( bCSV ?
+			L"%lu,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u,%I64u" :
+			L"{\"time\":%lu,\"bandwidth_in\":%I64u,\"bandwidth_out\":%I64u,\"packets_in\":%I64u,\"packets_out\":%I64u,"
+			L"\"packets_routed\":%I64u,\"packets_dropped\":%I64u,\"packets_encoded\":%I64u,\"packets_shared\":%I64u,\"queries\":%I64u,"
+			L"\"hits_unshown\":%I64u,\"hits_dropped\":%I64u,"
+			L"\"lost_control\":%I64u,\"lost_hits\":%I64u,\"lost_pushes\":%I64u,\"lost_queries\":%I64u",
+			oSecond.Time,
+			oTotals.Bandwidth.Incoming,
+			oTotals.Bandwidth.Outgoing,
+			oTotals.Gnutella1.Incoming + oTotals.Gnutella2.Incoming,
+			oTotals.Gnutella1.Outgoing + oTotals.Gnutella2.Outgoing,
+			oTotals.Gnutella1.Routed + oTotals.Gnutella2.Routed,
+			oTotals.Gnutella1.Dropped + oTotals.Gnutella2.Dropped,
+			oTotals.Gnutella1.Encoded + oTotals.Gnutella2.Encoded,
+			oTotals.Gnutella1.Shared + oTotals.Gnutella2.Shared,
+			oTotals.Gnutella1.Queries + oTotals.Gnutella2.Queries,
+			oTotals.Hits.Unshown,
+			oTotals.Hits.Dropped,
+			oTotals.Gnutella1.LostByClass[ 0 ] + oTotals.Gnutella2.LostByClass[ 0 ],
+			oTotals.Gnutella1.LostByClass[ 1 ] + oTotals.Gnutella2.LostByClass[ 1 ],
+			oTotals.Gnutella1.LostByClass[ 2 ] + oTotals.Gnutella2.LostByClass[ 2 ],
+			oTotals.Gnutella1.LostByClass[ 3 ] + oTotals.Gnutella2.LostByClass[ 3 ] );
+
+		for ( int nMetric = 0; nMetric < statLast; nMetric++ )
+		{
+			const sMetric& oMetric = oSecond.Metric[ nMetric ];
+			if ( bCSV )
+				strOutput.AppendFormat( L",%lu,%lu,%lu,%lu",
+					oMetric.Count, oMetric.Average, oMetric.Median, oMetric.Peak );
+			else
+				strOutput.AppendFormat( L",\"%s\":{\"count\":%lu,\"avg\":%lu,\"p50\":%lu,\"p99\":%lu}",
+					GetMetricName( nMetric ), oMetric.Count, oMetric.Average, oMetric.Median, oMetric.Peak );
+		}
+
+		strOutput += bCSV ? L"\r\n" : ( nItem + 1 < m_nHistoryCount ? L"}," : L"}" );
+	}
+
+	if ( bCSV )
+		return strOutput;
+
+	// Histograms since start, bucket n counts values below 2^n
+	strOutput += L"],\"histogram\":{";
+	for ( int nMetric = 0; nMetric < statLast; nMetric++ )
+	{
+		strOutput.AppendFormat( L"%s\"%s\":[", nMetric ? L"," : L"", GetMetricName( nMetric ) );
+		for ( int nBucket = 0; nBucket < STATISTICS_BUCKETS; nBucket++ )
+			strOutput.AppendFormat( nBucket ? L",%I64u" : L"%I64u", m_nHistogram[ nMetric ][ nBucket ] );
+		strOutput += L"]";
+	}
+	strOutput += L"}";
+
+	// Current throughput by governor class and protocol (bytes/s)
+	strOutput += L",\"governor\":{";
+	for ( int nDirection = bdIn; nDirection < bdLast; nDirection++ )
+	{
+		const BandwidthDirection nDir = (BandwidthDirection)nDirection;
+		strOutput.AppendFormat( L"%s\"%s\":{\"line\":%lu,\"control\":%lu,\"transfer\":%lu,\"protocols\":[",
+			nDirection ? L"," : L"", nDirection == bdIn ? L"in" : L"out",
+			BandwidthGovernor.GetMeasured( nDir ),
+			BandwidthGovernor.GetMeasured( nDir, bcControl ),
+			BandwidthGovernor.GetMeasured( nDir, bcTransfer ) );
+		for ( int nProtocol = PROTOCOL_NULL; nProtocol < PROTOCOL_LAST; nProtocol++ )
+			strOutput.AppendFormat( nProtocol ? L",%lu" : L"%lu", BandwidthGovernor.GetMeasured( nDir, (PROTOCOLID)nProtocol ) );
+		strOutput += L"]}";
+	}
+	strOutput += L"}}";
+
+	return strOutput;
+}
+
+BOOL CStatistics::Export(LPCTSTR pszFile) const
+{
+	const BOOL bCSV = _tcsicmp( PathFindExtension( pszFile ), L".csv" ) == 0;
+	const CStringA strOutput = UTF8Encode( Export( bCSV ) );
+
+	CFile pFile;
+	if ( ! pFile.Open( pszFile, CFile::modeWrite | CFile::modeCreate | CFile::shareDenyWrite ) )
+		return FALSE;
+
+	try
+	{
+		pFile.Write( (LPCSTR)strOutput, strOutput.GetLength() );
+		pFile.Close();
+	}
+	catch ( CException* pException )
+	{
+		pFile.Abort();
+		pException->Delete();
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -18,6 +18,20 @@
 
 #pragma once
 
+#define STATISTICS_SHARDS		8		// Sample shards (by thread)
+#define STATISTICS_BUCKETS		32		// Power-of-two histogram buckets
+#define STATISTICS_HISTORY		300		// Seconds of rolling history
+
+enum StatisticsMetric
+{
+	statHandshake,		// Neighbour handshake time (ms)
+	statHitRoute,		// Query hit queue to processing delay (ms)
+	statDiskWrite,		// Transfer file write latency (us)
+	statHashRate,		// Library hashing throughput (KB/s)
+	statExtractTime,	// Library metadata extraction time per file (ms)
+	statLast
+};
+
 
 class CStatistics
 {
@@ -26,7 +40,7 @@ public:
 	~CStatistics();
 
 public:
-	struct
+	struct sTotals
 	{
 		struct
 		{
@@ -73,6 +87,9 @@ public:
 			QWORD	PingsReceived;
 			QWORD	PongsSent;
 			QWORD	PongsReceived;
+			QWORD	Encoded;	// Packets serialized
+			QWORD	Shared;		// Packets copied from a shared encoding
+			QWORD	LostByClass[ 4 ];	// Outbound packets lost by CPacketBuffer class: control, hits, pushes, queries
 		} Gnutella1, Gnutella2;
 
 		struct
@@ -81,15 +98,56 @@ public:
 			QWORD	Incoming;
 			QWORD	Dropped;
 		} BitTorrent, eDonkey, DC;
+
+		struct
+		{
+			QWORD	Unshown;	// Given to downloads only, search windows fell behind
+			QWORD	Dropped;	// Not processed at all, hit queue overloaded
+		} Hits;
 	}
 	Ever, Today, Last, Current;
 
 	void	Update();
+	void	Sample(StatisticsMetric nMetric, DWORD nValue);	// Lock-free, any thread
+	CString	Export(BOOL bCSV = FALSE) const;				// Rolling history as JSON or CSV
+	BOOL	Export(LPCTSTR pszFile) const;					// By file extension
 
 protected:
+	struct __declspec(align(64)) sShard					// One per thread group, own cache lines
+	{
+		volatile LONG		Count[ statLast ][ STATISTICS_BUCKETS ];
+		volatile LONGLONG	Sum[ statLast ];
+	};
+
+	struct sMetric
+	{
+		DWORD	Count;
+		DWORD	Average;
+		DWORD	Median;		// Bucket upper bound
+		DWORD	Peak;		// 99th percentile bucket upper bound
+	};
+
+	struct sSecond
+	{
+		DWORD	Time;		// Seconds since 1970
+		sTotals	Totals;
+		sMetric	Metric[ statLast ];
+	};
+
 	QWORD	m_tSeconds;		// ms
+	sShard	m_pShard[ STATISTICS_SHARDS ];
+	sTotals	m_pSecond;		// Accumulates the current second
+	sSecond	m_pHistory[ STATISTICS_HISTORY ];
+	int		m_nHistory;		// Next slot
+	int		m_nHistoryCount;
+	QWORD	m_nHistogram[ statLast ][ STATISTICS_BUCKETS ];	// Since start
+	mutable CCriticalSection m_pSection;	// History and histogram
+
+	void	Collect();		// Once per second, drains shards into history
 
-	static void Add(LPVOID pTarget, LPCVOID pSource, int nCount);
+	static void		Add(LPVOID pTarget, LPCVOID pSource, int nCount);
+	static DWORD	Percentile(const DWORD* pBuckets, DWORD nCount, DWORD nPercent);
+	static LPCTSTR	GetMetricName(int nMetric);
 };
 
 extern CStatistics Statistics;
@@ -1530,3 +1530,82 @@ BOOL MakeSafePath(CString& sPath)
 		sPath = CString( L"\\\\?\\" ) + sPath;
 	return TRUE;
 }
+
+//////////////////////////////////////////////////////////////////////
+// CTextSwitch
+
+CTextSwitch::CTextSwitch(const Item* pItems, size_t nCount)
+	: m_nMask	( 0 )
+	, m_nSeed	( 0 )
+{
+	ASSERT( nCount < 255 );
+
+	m_pEntries.reserve( nCount );
+	for ( size_t i = 0; i < nCount; i++ )
+	{
+		Entry oEntry = { pItems[ i ].pszKey, (int)_tcslen( pItems[ i ].pszKey ), pItems[ i ].cValue };
+		m_pEntries.push_back( oEntry );
+	}
+
+	Build();
+}
+
+char CTextSwitch::Lookup(LPCTSTR pszText, int nLength) const
+{
+	if ( m_pTable.empty() )
+		return 0;
+
+	const BYTE nEntry = m_pTable[ Hash( pszText, nLength, m_nSeed ) & m_nMask ];
+	if ( ! nEntry )
+		return 0;
+
+	const Entry& oEntry = m_pEntries[ nEntry - 1 ];
+	if ( oEntry.nLength != nLength || _tcsnicmp( oEntry.pszKey, pszText, nLength ) != 0 )
+		return 0;
+
+	return oEntry.cValue;
+}
+
+// Find a table size and seed where every key gets its own slot
+void CTextSwitch::Build()
+{
+	for ( DWORD nSize = 16; ; nSize *= 2 )
+	{
+		if ( nSize < m_pEntries.size() * 2 )
+			continue;
+
+		for ( DWORD nSeed = 0; nSeed < 256; nSeed++ )
+		{
+			m_pTable.assign( nSize, 0 );
+			m_nMask = nSize - 1;
+			m_nSeed = nSeed;
+
+			DWORD nEntry = 1;
+			for ( ; nEntry <= m_pEntries.size(); nEntry++ )
+			{
+				const Entry& oEntry = m_pEntries[ nEntry - 1 ];
+				BYTE& nSlot = m_pTable[ Hash( oEntry.pszKey, oEntry.nLength, m_nSeed ) & m_nMask ];
+				if ( nSlot )
+					break;
+				nSlot = (BYTE)nEntry;
+			}
+
+			if ( nEntry > m_pEntries.size() )
+				return;
+		}
+	}
+}
+
+DWORD CTextSwitch::Hash(LPCTSTR pszText, int nLength, DWORD nSeed)
+{
+	// FNV-1a over ASCII lower case
+	DWORD nHash = 2166136261u ^ ( nSeed * 16777619u );
+	for ( ; nLength; nLength--, pszText++ )
+	{
+		TCHAR c = *pszText;
+		if ( c >= L'A' && c <= L'Z' )
+			c += L'a' - L'A';
+		nHash = ( nHash ^ (DWORD)c ) * 16777619u;
+	}
+	return nHash;
+}
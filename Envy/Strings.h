@@ -19,6 +19,7 @@
 #pragma once
 
 #include <set>
+#include <vector>
 
 // Produce 2 comma-separated arguments: string itself, and string length (without null terminator)	_P( L"Text" ) = L"Text",4
 #define _P(x)	(x),(_countof(x)-1)
@@ -187,3 +188,42 @@ CString Escape(const CString& strValue);
 
 // Unescape unsafe symbols
 CString Unescape(const TCHAR* __restrict pszXML, int nLength = -1);
+
+// Case-insensitive switch on ASCII text (header names etc.) by perfect hash:
+// One probe, no lower-case copy. Keys must be string literals.
+// Declare tables at file scope so they are built during static initialization,
+// before any thread starts; afterwards they are only read and need no lock.
+// Usage:
+//	static const CTextSwitch::Item pItems[] = { { L"content-length", 'l' } };
+//	static const CTextSwitch Text( pItems, _countof( pItems ) );
+//	switch ( Text.Lookup( strHeader ) )
+class CTextSwitch
+{
+public:
+	struct Item
+	{
+		LPCTSTR	pszKey;
+		char	cValue;
+	};
+
+	CTextSwitch(const Item* pItems, size_t nCount);
+
+	char	Lookup(LPCTSTR pszText, int nLength) const;
+	inline char Lookup(const CString& strText) const { return Lookup( strText, strText.GetLength() ); }
+
+private:
+	struct Entry
+	{
+		LPCTSTR	pszKey;
+		int		nLength;
+		char	cValue;
+	};
+
+	std::vector< Entry >	m_pEntries;
+	std::vector< BYTE >		m_pTable;	// Entry index + 1, or 0 if free
+	DWORD					m_nMask;
+	DWORD					m_nSeed;
+
+	void	Build();
+	static DWORD Hash(LPCTSTR pszText, int nLength, DWORD nSeed);
+};
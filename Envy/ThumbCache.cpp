@@ -31,6 +31,17 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+#define THUMB_BATCH			16			// Pending thumbnails written per transaction
+#define THUMB_BATCH_MAX		64			// Pending thumbnails before Store writes them itself
+#define THUMB_BATCH_DELAY	2000		// ms, Longest pending thumbnail wait
+#define THUMB_DB_INIT		L"PRAGMA synchronous=NORMAL;"	// Safe with WAL, no sync per commit
+
+CCriticalSection			CThumbCache::m_pSection;
+CCriticalSection			CThumbCache::m_pFlushSection;
+CThumbCache::CPendingMap	CThumbCache::m_pPending;
+CThumbCache::CPendingMap	CThumbCache::m_pFlushing;
+DWORD						CThumbCache::m_tPending = 0;
+
 //////////////////////////////////////////////////////////////////////
 // CThumbCache init
 
@@ -65,6 +76,9 @@ void CThumbCache::InitDatabase()
 		theApp.KeepAlive();
 		//TIMER_STOP
 	}
+
+	// Write-ahead log, views keep reading while thumbnails are written (persistent)
+	db->Exec( L"PRAGMA journal_mode=WAL;" );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -84,17 +98,28 @@ BOOL CThumbCache::Load(LPCTSTR pszPath, CImageFile* pImage)
 		return FALSE;
 	}
 
+	CString strPath( pszPath );
+	strPath.MakeLower();
+
+	// Not written to database yet
+	BOOL bPending = FALSE;
+	if ( LoadPending( strPath, fd, pImage, bPending ) )
+		return TRUE;
+
+	if ( bPending )
+	{
+		Delete( pszPath );		// Remove outdated or bad thumbnail
+		return FALSE;
+	}
+
 	// Load file info from database
-	augment::auto_ptr< CDatabase > db( theApp.GetDatabase( DB_THUMBS ) );
+	CPooledDatabase db( theApp.GetDatabasePath( DB_THUMBS ), THUMB_DB_INIT );
 	if ( ! *db )
 	{
 		TRACE( "CThumbCache::InitDatabase : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
 		return FALSE;
 	}
 
-	CString strPath( pszPath );
-	strPath.MakeLower();
-
 	if ( ! db->Prepare( L"SELECT FileSize, LastWriteTime, Image FROM Files WHERE Filename == ?;" ) ||
 		 ! db->Bind( 1, strPath ) ||
 		 ! db->Step() ||
@@ -135,18 +160,57 @@ BOOL CThumbCache::Load(LPCTSTR pszPath, CImageFile* pImage)
 	return loaded;
 }
 
+BOOL CThumbCache::LoadPending(const CString& strPath, const WIN32_FIND_DATA& fd, CImageFile* pImage, BOOL& bFound)
+{
+	CQuickLock oLock( m_pSection );
+
+	// Newest first, then the batch still being written
+	if ( LoadPending( m_pPending, strPath, fd, pImage, bFound ) )
+		return TRUE;
+	if ( bFound )
+		return FALSE;	// Outdated
+
+	return LoadPending( m_pFlushing, strPath, fd, pImage, bFound );
+}
+
+BOOL CThumbCache::LoadPending(const CPendingMap& pMap, const CString& strPath, const WIN32_FIND_DATA& fd, CImageFile* pImage, BOOL& bFound)
+{
+	CPending* pPending;
+	bFound = pMap.Lookup( strPath, pPending );
+	if ( ! bFound )
+		return FALSE;
+
+	return pPending->nFileSize == MAKEQWORD( fd.nFileSizeLow, fd.nFileSizeHigh ) &&
+		pPending->nLastWriteTime == MAKEQWORD( fd.ftLastWriteTime.dwLowDateTime, fd.ftLastWriteTime.dwHighDateTime ) &&
+		pImage->LoadFromMemory( L".jpg", pPending->pData.get(), pPending->nData );
+}
+
 void CThumbCache::Delete(LPCTSTR pszPath)
 {
-	augment::auto_ptr< CDatabase > db( theApp.GetDatabase( DB_THUMBS ) );
+	CString strPath( pszPath );
+	strPath.MakeLower();
+
+	{
+		CQuickLock oLock( m_pSection );
+
+		CPending* pPending;
+		if ( m_pPending.Lookup( strPath, pPending ) )
+		{
+			m_pPending.RemoveKey( strPath );
+			delete pPending;
+		}
+	}
+
+	// Wait for a batch in flight, it may hold an older thumbnail of this file
+	CQuickLock oFlushLock( m_pFlushSection );
+
+	CPooledDatabase db( theApp.GetDatabasePath( DB_THUMBS ), THUMB_DB_INIT );
 	if ( ! *db )
 	{
 		TRACE( "CThumbCache::InitDatabase : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
 		return;
 	}
 
-	CString strPath( pszPath );
-	strPath.MakeLower();
-
 	if ( ! db->Prepare( L"DELETE FROM Files WHERE Filename == ?;" ) ||
 		 ! db->Bind( 1, strPath ) )
 	{
@@ -174,13 +238,6 @@ BOOL CThumbCache::Store(LPCTSTR pszPath, CImageFile* pImage)
 		return FALSE;
 	}
 
-	augment::auto_ptr< CDatabase > db( theApp.GetDatabase( DB_THUMBS ) );
-	if ( ! *db )
-	{
-		TRACE( "CThumbCache::InitDatabase : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
-		return FALSE;
-	}
-
 	CString strPath( pszPath );
 	strPath.MakeLower();
 
@@ -192,30 +249,36 @@ BOOL CThumbCache::Store(LPCTSTR pszPath, CImageFile* pImage)
 		TRACE( "CThumbCache::Store : Can't save thumbnail to JPEG for %s\n", (LPCSTR)CT2A( pszPath ) );
 		return FALSE;
 	}
-	auto_array< BYTE > data( buf );
 
-	// Remove old image
-	if ( ! db->Prepare( L"DELETE FROM Files WHERE Filename == ?;" ) ||
-		 ! db->Bind( 1, strPath ) )
-	{
-		TRACE( "CThumbCache::Store : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
-		return FALSE;
-	}
-	db->Step();
+	CPending* pPending = new CPending;
+	pPending->nFileSize = MAKEQWORD( fd.nFileSizeLow, fd.nFileSizeHigh );
+	pPending->nLastWriteTime = MAKEQWORD( fd.ftLastWriteTime.dwLowDateTime, fd.ftLastWriteTime.dwHighDateTime );
+	pPending->pData.reset( buf );
+	pPending->nData = data_len;
 
-	// Store new one
-	if ( ! db->Prepare( L"INSERT INTO Files ( Filename, FileSize, LastWriteTime, Image ) VALUES ( ?, ?, ?, ? );" ) ||
-		 ! db->Bind( 1, strPath ) ||
-		 ! db->Bind( 2, (__int64)MAKEQWORD( fd.nFileSizeLow, fd.nFileSizeHigh ) ) ||
-		 ! db->Bind( 3, (__int64)MAKEQWORD( fd.ftLastWriteTime.dwLowDateTime, fd.ftLastWriteTime.dwHighDateTime ) ) ||
-		 ! db->Bind( 4, data.get(), data_len ) ||
-		 ! db->Step() )
+	// Queue for batched insert, single row transactions are the slow part
+	BOOL bFlush;
 	{
-		TRACE( "CThumbCache::Store : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
-		return FALSE;
+		CQuickLock oLock( m_pSection );
+
+		CPending* pOld;
+		if ( m_pPending.Lookup( strPath, pOld ) )
+			delete pOld;
+		else if ( m_pPending.IsEmpty() )
+			m_tPending = GetTickCount();
+
+		m_pPending.SetAt( strPath, pPending );
+
+		bFlush = ( m_pPending.GetCount() >= THUMB_BATCH_MAX );
+		if ( ! bFlush && m_pPending.GetCount() >= THUMB_BATCH )
+			Library.Wakeup();	// Library thread writes the batch
 	}
 
-	TRACE( "CThumbCache::Store : Thumbnail saved for %s\n", (LPCSTR)CT2A( pszPath ) );
+	// Library thread is busy scanning, don't let the queue grow
+	if ( bFlush )
+		Flush();
+
+	TRACE( "CThumbCache::Store : Thumbnail queued for %s\n", (LPCSTR)CT2A( pszPath ) );
 
 	CSingleLock oLock( &Library.m_pSection, FALSE );
 	if ( ! oLock.Lock( 300 ) ) return TRUE;
@@ -259,3 +322,89 @@ BOOL CThumbCache::Cache(LPCTSTR pszPath, CImageFile* pImage, BOOL bLoadFromFile)
 
 	return TRUE;
 }
+
+//////////////////////////////////////////////////////////////////////
+// CThumbCache flush
+
+void CThumbCache::OnRun()
+{
+	{
+		CQuickLock oLock( m_pSection );
+
+		if ( m_pPending.IsEmpty() ||
+			( m_pPending.GetCount() < THUMB_BATCH && GetTickCount() - m_tPending < THUMB_BATCH_DELAY ) )
+			return;
+	}
+
+	Flush();
+}
+
+void CThumbCache::Flush()
+{
+	CQuickLock oFlushLock( m_pFlushSection );
+
+	// Take the batch, views keep reading it from m_pFlushing until written
+	{
+		CQuickLock oLock( m_pSection );
+
+		ASSERT( m_pFlushing.IsEmpty() );
+		if ( m_pPending.IsEmpty() )
+			return;
+
+		for ( POSITION pos = m_pPending.GetStartPosition(); pos; )
+		{
+			CString strPath;
+			CPending* pPending;
+			m_pPending.GetNextAssoc( pos, strPath, pPending );
+			m_pFlushing.SetAt( strPath, pPending );
+		}
+		m_pPending.RemoveAll();
+	}
+
+	// Database I/O without m_pSection, Load and Store don't wait for it
+	CPooledDatabase db( theApp.GetDatabasePath( DB_THUMBS ), THUMB_DB_INIT );
+	if ( ! *db )
+	{
+		TRACE( "CThumbCache::Flush : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
+	}
+	else if ( db->Exec( L"BEGIN TRANSACTION;" ) )
+	{
+		bool bResult = true;
+		for ( POSITION pos = m_pFlushing.GetStartPosition(); pos && bResult; )
+		{
+			CString strPath;
+			CPending* pPending;
+			m_pFlushing.GetNextAssoc( pos, strPath, pPending );
+
+			// Replaces old image (Filename is unique)
+			bResult = db->Prepare( L"INSERT OR REPLACE INTO Files ( Filename, FileSize, LastWriteTime, Image ) VALUES ( ?, ?, ?, ? );" ) &&
+				db->Bind( 1, strPath ) &&
+				db->Bind( 2, (__int64)pPending->nFileSize ) &&
+				db->Bind( 3, (__int64)pPending->nLastWriteTime ) &&
+				db->Bind( 4, pPending->pData.get(), (int)pPending->nData ) &&
+				db->Step();
+		}
+
+		if ( bResult && db->Exec( L"COMMIT;" ) )
+		{
+			TRACE( "CThumbCache::Flush : %d thumbnails saved\n", (int)m_pFlushing.GetCount() );
+		}
+		else
+		{
+			TRACE( "CThumbCache::Flush : Database error: %s\n", (LPCSTR)CT2A( db->GetLastErrorMessage() ) );
+			db->Exec( L"ROLLBACK;" );
+		}
+	}
+
+	// Cache only, failed thumbnails are made again on next view
+	CQuickLock oLock( m_pSection );
+
+	for ( POSITION pos = m_pFlushing.GetStartPosition(); pos; )
+	{
+		CString strPath;
+		CPending* pPending;
+		m_pFlushing.GetNextAssoc( pos, strPath, pPending );
+		delete pPending;
+	}
+	m_pFlushing.RemoveAll();
+}
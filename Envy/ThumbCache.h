@@ -28,4 +28,26 @@ public:
 	static void Delete(LPCTSTR pszPath);
 	static BOOL	Store(LPCTSTR pszPath, CImageFile* pImage);
 	static BOOL Cache(LPCTSTR pszPath, CImageFile* pImage = NULL, BOOL bLoadFromFile = TRUE);
+	static void Flush();			// Write pending thumbnails in one transaction
+	static void OnRun();			// Library thread tick, flush when batch is full or old enough
+
+protected:
+	// Encoded thumbnail waiting for batched insert
+	struct CPending
+	{
+		QWORD			nFileSize;
+		QWORD			nLastWriteTime;
+		auto_array< BYTE >	pData;
+		DWORD			nData;
+	};
+	typedef CMap< CString, const CString&, CPending*, CPending* > CPendingMap;
+
+	static CCriticalSection	m_pSection;		// Guards pending maps only, never held during database I/O
+	static CCriticalSection	m_pFlushSection;	// Serializes database writes and deletes
+	static CPendingMap		m_pPending;		// Lower-case path to thumbnail
+	static CPendingMap		m_pFlushing;	// Batch being written, read-only until flush ends
+	static DWORD			m_tPending;		// Oldest pending thumbnail time
+
+	static BOOL	LoadPending(const CString& strPath, const WIN32_FIND_DATA& fd, CImageFile* pImage, BOOL& bFound);
+	static BOOL	LoadPending(const CPendingMap& pMap, const CString& strPath, const WIN32_FIND_DATA& fd, CImageFile* pImage, BOOL& bFound);
 };
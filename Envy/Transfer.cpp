@@ -42,6 +42,7 @@ CTransfer::CTransfer(PROTOCOLID nProtocol)
 	, m_nBandwidth		( 0ul )
 	, m_tRequest		( 0 )
 {
+	m_nBandwidthClass = bcTransfer;
 }
 
 CTransfer::~CTransfer()
@@ -22,6 +22,7 @@
 #include "Download.h"
 #include "Downloads.h"
 #include "Transfers.h"
+#include "Statistics.h"
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -328,12 +329,16 @@ BOOL CTransferFile::Write(QWORD nOffset, LPCVOID pBuffer, QWORD nBuffer, QWORD*
 	DWORD nOffsetHigh	= (DWORD)( ( nOffset & 0xFFFFFFFF00000000 ) >> 32 );
 	SetFilePointer( m_hFile, nOffsetLow, (PLONG)&nOffsetHigh, FILE_BEGIN );
 
+	const __int64 tStart = GetMicroCount();
+
 	if ( ! WriteFile( m_hFile, pBuffer, (DWORD)nBuffer, (LPDWORD)pnWritten, NULL ) )
 	{
 		theApp.Message( MSG_ERROR, L"Can't write to file \"%s\". %s", (LPCTSTR)m_sPath, GetErrorString() );
 		return FALSE;
 	}
 
+	Statistics.Sample( statDiskWrite, (DWORD)( GetMicroCount() - tStart ) );
+
 	return TRUE;
 }
 
@@ -74,6 +74,7 @@ CUploadQueue::~CUploadQueue()
 		CUploadTransfer* pUpload = m_pQueued.GetAt( nPosition );
 		pUpload->m_pQueue = NULL;
 	}
+	m_pQueued.RemoveAll();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -223,14 +224,10 @@ BOOL CUploadQueue::Dequeue(CUploadTransfer* pUpload)
 		return TRUE;
 	}
 
-	for ( DWORD nPosition = 0; nPosition < GetQueuedCount(); nPosition++ )
+	if ( m_pQueued.Remove( pUpload ) )
 	{
-		if ( m_pQueued.GetAt( nPosition ) == pUpload )
-		{
-			pUpload->m_pQueue = NULL;
-			m_pQueued.RemoveAt( nPosition );
-			return TRUE;
-		}
+		pUpload->m_pQueue = NULL;
+		return TRUE;
 	}
 
 	return FALSE;
@@ -246,16 +243,11 @@ int CUploadQueue::GetPosition(CUploadTransfer* pUpload, BOOL bStart)
 
 	if ( m_pActive.Find( pUpload ) ) return 0;
 
-	for ( DWORD nPosition = 0; nPosition < GetQueuedCount(); nPosition++ )
-	{
-		if ( m_pQueued.GetAt( nPosition ) == pUpload )
-		{
-			if ( nPosition == 0 && Start( pUpload, ! bStart ) ) return 0;
-			return nPosition + 1;
-		}
-	}
+	const INT_PTR nPosition = m_pQueued.GetPosition( pUpload );
+	if ( nPosition < 0 ) return -1;
 
-	return -1;
+	if ( nPosition == 0 && Start( pUpload, ! bStart ) ) return 0;
+	return (int)nPosition + 1;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -277,15 +269,11 @@ BOOL CUploadQueue::StealPosition(CUploadTransfer* pTarget, CUploadTransfer* pSou
 		return TRUE;
 	}
 
-	for ( DWORD nPosition = 0; nPosition < GetQueuedCount(); nPosition++ )
+	if ( m_pQueued.Replace( pSource, pTarget ) )
 	{
-		if ( m_pQueued.GetAt( nPosition ) == pSource )
-		{
-			m_pQueued.SetAt( nPosition, pTarget );
-			pTarget->m_pQueue = this;
-			pSource->m_pQueue = NULL;
-			return TRUE;
-		}
+		pTarget->m_pQueue = this;
+		pSource->m_pQueue = NULL;
+		return TRUE;
 	}
 
 	return FALSE;
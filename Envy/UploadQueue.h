@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include "QueueIndex.h"
+
 class CUploadTransfer;
 
 
@@ -29,7 +31,7 @@ public:
 
 protected:
 	CList< CUploadTransfer* >	m_pActive;
-	CArray< CUploadTransfer* >	m_pQueued;
+	CQueueIndex< CUploadTransfer >	m_pQueued;	// Indexed by CUploadTransfer::m_nQueueSlot
 
 public:
 	int			m_nIndex;
@@ -103,7 +105,7 @@ public:
 
 	inline CUploadTransfer* GetQueuedAt(INT_PTR nPos) const
 	{
-		return m_pQueued.GetAt( nPos );
+		return m_pQueued.GetAt( nPos );		// O(log n)
 	}
 
 	inline DWORD GetQueuedCount() const
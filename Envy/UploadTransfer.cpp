@@ -45,6 +45,7 @@ static char THIS_FILE[] = __FILE__;
 CUploadTransfer::CUploadTransfer(PROTOCOLID nProtocol)
 	: CTransfer			( nProtocol )
 	, m_pQueue			( NULL )
+	, m_nQueueSlot		( -1 )
 	, m_pBaseFile		( NULL )
 	, m_nFileBase		( 0 )
 	, m_bFilePartial	( FALSE )
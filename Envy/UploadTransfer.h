@@ -38,6 +38,7 @@ public:
 
 public:
 	CUploadQueue*	m_pQueue;		// Queue reference
+	INT_PTR			m_nQueueSlot;	// Queued slot (CQueueIndex), -1 if not queued
 	CUploadFile*	m_pBaseFile;	// Reference file
 	DWORD			m_nUserRating;	// Has the downloader uploaded anything?
 
@@ -207,6 +207,35 @@ BOOL CUploadTransferHTTP::ReadRequest()
 //////////////////////////////////////////////////////////////////////
 // CUploadTransferHTTP read : headers
 
+// Expected headers, hashed once at startup so lookups only read the table
+static const CTextSwitch::Item pHeaderItems[] =
+{
+	{ L"connection",					'c' },
+	{ L"accept",						'a' },
+	{ L"accept-encoding",				'e' },
+//	{ L"authorization",				'k' },	// ToDo: Proposed PrivateKey, See: http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html
+	{ L"range",							'r' },
+	{ L"content-urn",					'u' },
+	{ L"x-content-urn",					'u' },
+	{ L"x-gnutella-content-urn",		'u' },
+	{ L"x-gnutella-alternate-location",	'l' },
+	{ L"alt-location",					'a' },
+	{ L"x-alt",							'a' },
+	{ L"x-nalt",						's' },
+	{ L"x-nick",						'n' },
+	{ L"x-name",						'n' },
+	{ L"x-username",					'n' },
+	{ L"x-features",					'f' },
+	{ L"x-queue",						'q' },
+
+	{ L"x-node",						'z' },
+	{ L"x-palt",						'x' },
+	{ L"fp-1a",							'x' },
+	{ L"fp-auth-challenge",				'x' },
+};
+
+static const CTextSwitch HeaderNames( pHeaderItems, _countof( pHeaderItems ) );
+
 BOOL CUploadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 {
 	if ( ! CUploadTransfer::OnHeaderLine( strHeader, strValue ) )
@@ -215,37 +244,7 @@ BOOL CUploadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 	if ( strHeader.GetLength() < 3 )
 		return TRUE;	// Skip bad/unknown header
 
-	CString strCase( strHeader );
-	strCase = ToLower( strCase );
-
-	// Expected Headers
-	SwitchMap( Text )
-	{
-		Text[ L"connection" ]			= 'c';
-		Text[ L"accept" ]				= 'a';
-		Text[ L"accept-encoding" ]		= 'e';
-	//	Text[ L"authorization" ]		= 'k';	// ToDo: Proposed PrivateKey, See: http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html
-		Text[ L"range" ]				= 'r';
-		Text[ L"content-urn" ]			= 'u';
-		Text[ L"x-content-urn" ]		= 'u';
-		Text[ L"x-gnutella-content-urn" ] = 'u';
-		Text[ L"x-gnutella-alternate-location" ] = 'l';
-		Text[ L"alt-location" ]			= 'a';
-		Text[ L"x-alt" ]				= 'a';
-		Text[ L"x-nalt" ]				= 's';
-		Text[ L"x-nick" ]				= 'n';
-		Text[ L"x-name" ]				= 'n';
-		Text[ L"x-username" ]			= 'n';
-		Text[ L"x-features" ]			= 'f';
-		Text[ L"x-queue" ]				= 'q';
-
-		Text[ L"x-node" ]				= 'z';
-		Text[ L"x-palt" ]				= 'x';
-		Text[ L"fp-1a" ]				= 'x';
-		Text[ L"fp-auth-challenge" ]	= 'x';
-	}
-
-	switch ( Text[ strCase ] )
+	switch ( HeaderNames.Lookup( strHeader ) )
 	{
 	case 'c':		// "Connection"
 		if ( strValue.CompareNoCase( L"Keep-Alive" ) == 0 )
@@ -339,7 +338,7 @@ BOOL CUploadTransferHTTP::OnHeaderLine(CString& strHeader, CString& strValue)
 		m_nGnutella |= 1;
 		break;
 	default:		// Unknown Header
-		theApp.Message( MSG_DEBUG, L"Unknown G1/G2 Header:  %s", (LPCTSTR)strCase );
+		theApp.Message( MSG_DEBUG, L"Unknown G1/G2 Header:  %s", (LPCTSTR)strHeader );
 		break;
 	}
 
@@ -1230,24 +1229,40 @@ BOOL CUploadTransferHTTP::OnWrite()
 		}
 
 		QWORD nPacket = min( m_nLength - m_nPosition, (QWORD)Settings.Uploads.ChunkSize );	// ~1000 KB
-		auto_array< BYTE > pBuffer( new BYTE[ (size_t)nPacket ] );
+
+		// Read into the chunk buffer without the output lock, socket writes go on meanwhile
+		m_pChunk.Clear();
+		if ( ! m_pChunk.EnsureBuffer( (size_t)nPacket ) )
+			return TRUE;
+
+		BYTE* pData = m_pChunk.GetData();
 
 		if ( m_bBackwards )
 		{
 			QWORD nRead = 0;
 			if ( ! ReadFile( m_nFileBase + m_nOffset + m_nLength -
-				 m_nPosition - nPacket, pBuffer.get(), nPacket, &nRead ) ||
+				 m_nPosition - nPacket, pData, nPacket, &nRead ) ||
 				 nRead != nPacket )
 				return TRUE;
-			WriteReversed( pBuffer.get(), (DWORD)nPacket );
+			std::reverse( pData, pData + (size_t)nPacket );
 		}
 		else
 		{
 			if ( ! ReadFile( m_nFileBase + m_nOffset + m_nPosition,
-				 pBuffer.get(), nPacket, &nPacket ) ||
+				 pData, nPacket, &nPacket ) ||
 				 nPacket == 0 )
 				return TRUE;
-			Write( pBuffer.get(), (DWORD)nPacket );
+		}
+
+		m_pChunk.m_nLength = (DWORD)nPacket;
+
+		{
+			// Swap into the (empty) output buffer, both keep their allocations between chunks
+			CLockedBuffer pOutput( GetOutput() );
+			if ( pOutput->m_nLength == 0 )
+				pOutput->Swap( m_pChunk );
+			else
+				pOutput->AddBuffer( &m_pChunk );
 		}
 
 		m_nPosition += nPacket;
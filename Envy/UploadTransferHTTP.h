@@ -61,6 +61,7 @@ protected:
 	CString		m_sLocations;
 	CString		m_sRanges;
 	CString		m_sPrivateKey;		// Envy-proposed extension: Browse Private Key
+	CBuffer		m_pChunk;			// File data read outside the output lock
 
 public:
 	virtual void	AttachTo(CConnection* pConnection);
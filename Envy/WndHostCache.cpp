@@ -225,12 +225,12 @@ void CHostCacheWnd::Update(BOOL bForce)
 		pItem->Set( COL_SEEN, pTime.Format( L"%Y-%m-%d %H:%M:%S" ) );
 
 		// Display workaround  (ToDo: Fix properly elsewhere)
-		CString strName = pHost->m_sName;
+		CString strName = pHost->Extra().m_sName;
 		if ( pHost->m_nProtocol == PROTOCOL_ED2K && strName.IsEmpty() )
 			strName = Neighbours.GetServerName( pHost->m_sAddress.IsEmpty() ? strAddress : pHost->m_sAddress );
 
 		pItem->Set( COL_NAME, strName );
-		pItem->Set( COL_INFO, pHost->m_sDescription );
+		pItem->Set( COL_INFO, pHost->Extra().m_sDescription );
 		if ( pHost->m_nDailyUptime )	// Only G1?
 		{
 			pTime = (time_t)pHost->m_nDailyUptime;
@@ -26,6 +26,126 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif
 
+#define XML_INTERN_LENGTH	64			// Longest name to share
+#define XML_INTERN_MAX		8192		// Limit shared names (network input is arbitrary)
+#define XML_POOL_BLOCK		256			// Nodes per pool block
+
+
+//////////////////////////////////////////////////////////////////////
+// CXMLHeap
+// Library metadata, schemas and hits hold millions of small nodes with few distinct names.
+// Nodes are carved from blocks and names are shared, instead of separate heap allocations.
+// Note: Lives until process exit, so not destroyed before global documents (Skin, Schemas).
+
+class CXMLHeap
+{
+public:
+	CXMLHeap()
+		: m_pElements	( NULL )
+		, m_pAttributes	( NULL )
+		, m_pFreeElements	( NULL )
+		, m_pFreeAttributes	( NULL )
+	{
+		InitializeCriticalSection( &m_pSection );
+		m_pNames.InitHashTable( 1021 );
+	}
+
+protected:
+	struct CFreeNode
+	{
+		CFreeNode*	m_pNext;
+	};
+
+	CRITICAL_SECTION	m_pSection;
+	CPlex*				m_pElements;
+	CPlex*				m_pAttributes;
+	CFreeNode*			m_pFreeElements;
+	CFreeNode*			m_pFreeAttributes;
+	CAtlMap< CString, BYTE, CStringElementTraits< CString > > m_pNames;
+
+	static void* Alloc(CPlex*& pBlocks, CFreeNode*& pFree, size_t nSize)
+	{
+		if ( ! pFree )
+		{
+			// New block, chain its nodes into free list
+			CPlex* pBlock = CPlex::Create( pBlocks, XML_POOL_BLOCK, (UINT)nSize );
+			BYTE* pNode = (BYTE*)pBlock->data() + nSize * ( XML_POOL_BLOCK - 1 );
+			for ( int nNode = XML_POOL_BLOCK; nNode; --nNode, pNode -= nSize )
+			{
+				( (CFreeNode*)pNode )->m_pNext = pFree;
+				pFree = (CFreeNode*)pNode;
+			}
+		}
+
+		CFreeNode* pNode = pFree;
+		pFree = pNode->m_pNext;
+		return pNode;
+	}
+
+	static void Free(CFreeNode*& pFree, void* pNode)
+	{
+		( (CFreeNode*)pNode )->m_pNext = pFree;
+		pFree = (CFreeNode*)pNode;
+	}
+
+public:
+	void* AllocElement()
+	{
+		EnterCriticalSection( &m_pSection );
+		void* pNode = Alloc( m_pElements, m_pFreeElements, sizeof( CXMLElement ) );
+		LeaveCriticalSection( &m_pSection );
+		return pNode;
+	}
+
+	void* AllocAttribute()
+	{
+		EnterCriticalSection( &m_pSection );
+		void* pNode = Alloc( m_pAttributes, m_pFreeAttributes, sizeof( CXMLAttribute ) );
+		LeaveCriticalSection( &m_pSection );
+		return pNode;
+	}
+
+	void FreeElement(void* pNode)
+	{
+		EnterCriticalSection( &m_pSection );
+		Free( m_pFreeElements, pNode );
+		LeaveCriticalSection( &m_pSection );
+	}
+
+	void FreeAttribute(void* pNode)
+	{
+		EnterCriticalSection( &m_pSection );
+		Free( m_pFreeAttributes, pNode );
+		LeaveCriticalSection( &m_pSection );
+	}
+
+	CString Intern(LPCTSTR pszName)
+	{
+		CString strName;
+		EnterCriticalSection( &m_pSection );
+		if ( const CAtlMap< CString, BYTE, CStringElementTraits< CString > >::CPair* pPair = m_pNames.Lookup( pszName ) )
+		{
+			strName = pPair->m_key;
+		}
+		else
+		{
+			strName = pszName;
+			if ( m_pNames.GetCount() < XML_INTERN_MAX )
+				m_pNames.SetAt( strName, 0 );
+		}
+		LeaveCriticalSection( &m_pSection );
+		return strName;
+	}
+};
+
+static CXMLHeap& XMLHeap()
+{
+	static CXMLHeap* pHeap = new CXMLHeap();	// Never freed, see above
+	return *pHeap;
+}
+
+static CXMLHeap& XMLHeapInit = XMLHeap();		// Construct before threads start
+
 
 //////////////////////////////////////////////////////////////////////
 // CXMLNode construction
@@ -37,7 +157,7 @@ CXMLNode::CXMLNode(CXMLElement* pParent, LPCTSTR pszName)
 	if ( pszName )
 	{
 		ASSERT( *pszName );
-		m_sName = pszName;
+		m_sName = Intern( pszName );
 	}
 }
 
@@ -102,13 +222,27 @@ BOOL CXMLNode::ParseIdentifier(LPCTSTR& pszBase, CString& strIdentifier)
 	if ( ! nIdentifier ) return FALSE;
 
 	pszBase += nParse;
-	_tcsncpy_s( strIdentifier.GetBuffer( nIdentifier + 1 ), nIdentifier + 1, pszBase, nIdentifier );
-	strIdentifier.ReleaseBuffer( nIdentifier );
+	strIdentifier = Intern( pszBase, nIdentifier );
 	pszBase += nIdentifier;
 
 	return TRUE;
 }
 
+CString CXMLNode::Intern(LPCTSTR pszName, int nLength)
+{
+	if ( nLength < 0 )
+		nLength = (int)_tcslen( pszName );
+
+	if ( nLength == 0 || nLength > XML_INTERN_LENGTH )
+		return CString( pszName, nLength );
+
+	TCHAR szName[ XML_INTERN_LENGTH + 1 ];
+	CopyMemory( szName, pszName, nLength * sizeof( TCHAR ) );
+	szName[ nLength ] = 0;
+
+	return XMLHeap().Intern( szName );
+}
+
 //////////////////////////////////////////////////////////////////////
 // CXMLNode serialize
 
@@ -123,6 +257,9 @@ void CXMLNode::Serialize(CArchive& ar)
 	{
 		ar >> m_sName;
 		ar >> m_sValue;
+
+		if ( ! m_sName.IsEmpty() )
+			m_sName = Intern( m_sName );
 	}
 }
 
@@ -179,7 +316,6 @@ void CXMLNode::UniformString(CString& str)
 CXMLElement::CXMLElement(CXMLElement* pParent, LPCTSTR pszName) : CXMLNode( pParent, pszName )
 {
 	m_nNode = xmlElement;
-	m_bOrdered = TRUE;		// Retain Attribute inserton order (workaround)
 }
 
 CXMLElement::~CXMLElement()
@@ -188,6 +324,18 @@ CXMLElement::~CXMLElement()
 	DeleteAllAttributes();
 }
 
+void* PASCAL CXMLElement::operator new(size_t nSize)
+{
+	ASSERT( nSize == sizeof( CXMLElement ) );
+	return XMLHeap().AllocElement();
+}
+
+void PASCAL CXMLElement::operator delete(void* pElement)
+{
+	if ( pElement )
+		XMLHeap().FreeElement( pElement );
+}
+
 CXMLElement* CXMLElement::AddElement(LPCTSTR pszName)
 {
 	CXMLElement* pElement = new CXMLElement( this, pszName );
@@ -204,23 +352,14 @@ CXMLElement* CXMLElement::Clone(CXMLElement* pParent) const
 	CXMLElement* pClone = new CXMLElement( pParent, m_sName );
 	if ( ! pClone ) return NULL;			// Out of memory
 
-	for ( POSITION pos = GetAttributeIterator(); pos; )
+	// Names are unique already
+	pClone->m_pAttributes.SetSize( 0, m_pAttributes.GetCount() );
+	for ( INT_PTR nAttribute = 0; nAttribute < m_pAttributes.GetCount(); ++nAttribute )
 	{
-		CXMLAttribute* pAttribute = GetNextAttribute( pos )->Clone( pClone );
+		CXMLAttribute* pAttribute = m_pAttributes.GetAt( nAttribute )->Clone( pClone );
 		if ( ! pAttribute ) return NULL;	// Out of memory
 
-		CString strNameLower( pAttribute->m_sName );
-		strNameLower.MakeLower();
-
-		// Delete the old attribute if one exists
-		CXMLAttribute* pExisting;
-		if ( pClone->m_pAttributes.Lookup( strNameLower, pExisting ) )
-			delete pExisting;
-
-		pClone->m_pAttributes.SetAt( strNameLower, pAttribute );
-
-		if ( m_bOrdered && ! pClone->m_pAttributesInsertion.Find( strNameLower ) )
-			pClone->m_pAttributesInsertion.AddTail( strNameLower );		// Track output order workaround
+		pClone->m_pAttributes.Add( pAttribute );
 	}
 
 	for ( POSITION pos = GetElementIterator(); pos; )
@@ -248,10 +387,17 @@ CXMLElement* CXMLElement::Prefix(const CString& sPrefix, CXMLElement* pParent) c
 			pNode->SetName( sPrefix + pNode->GetName() );
 		}
 
+		// Renaming may delete a namesake attribute, so collect names before renaming
+		CStringArray pRenames;
 		for ( POSITION pos = pCloned->GetAttributeIterator(); pos; )
 		{
-			CXMLAttribute* pNode = pCloned->GetNextAttribute( pos );
-			pNode->SetName( sPrefix + pNode->GetName() );
+			pRenames.Add( pCloned->GetNextAttribute( pos )->GetName() );
+		}
+
+		for ( INT_PTR nRename = 0; nRename < pRenames.GetCount(); ++nRename )
+		{
+			if ( CXMLAttribute* pNode = pCloned->GetAttribute( pRenames[ nRename ] ) )
+				pNode->SetName( sPrefix + pRenames[ nRename ] );
 		}
 	}
 	return pCloned;
@@ -271,16 +417,11 @@ void CXMLElement::DeleteAllElements()
 
 void CXMLElement::DeleteAllAttributes()
 {
-	for ( POSITION pos = m_pAttributes.GetStartPosition(); pos; )
+	for ( INT_PTR nAttribute = 0; nAttribute < m_pAttributes.GetCount(); ++nAttribute )
 	{
-		CXMLAttribute* pAttribute;
-		CString strName;
-
-		m_pAttributes.GetNextAssoc( pos, strName, pAttribute );
-		delete pAttribute;
+		delete m_pAttributes.GetAt( nAttribute );
 	}
 	m_pAttributes.RemoveAll();
-	m_pAttributesInsertion.RemoveAll();		// Track output order workaround
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -455,7 +596,7 @@ BOOL CXMLElement::ParseString(LPCTSTR& strXML)
 		if ( ! *strXML )
 			return FALSE;
 
-		CXMLAttribute* pAttribute = new CXMLAttribute( this );
+		CXMLAttribute* pAttribute = new CXMLAttribute( NULL );
 
 		if ( ! pAttribute || ! pAttribute->ParseString( strXML ) )
 		{
@@ -463,23 +604,9 @@ BOOL CXMLElement::ParseString(LPCTSTR& strXML)
 			return FALSE;
 		}
 
-		CString strNameLower( pAttribute->m_sName );
-		strNameLower.MakeLower();
-
-		// Delete the old attribute if one exists
-		CXMLAttribute* pExisting;
-		if ( m_pAttributes.Lookup( strNameLower, pExisting ) )
-			delete pExisting;
-
-		m_pAttributes.SetAt( strNameLower, pAttribute );
-
-		if ( m_bOrdered && ! m_pAttributesInsertion.Find( strNameLower ) )
-			m_pAttributesInsertion.AddTail( strNameLower );		// Track output order workaround
+		AddAttribute( pAttribute );
 	}
 
-	CString strClose = L"</";
-	strClose += m_sName + '>';
-
 	for ( ;; )
 	{
 		if ( ! *strXML )
@@ -509,7 +636,7 @@ BOOL CXMLElement::ParseString(LPCTSTR& strXML)
 			strXML = pszElement;
 		}
 
-		if ( ParseMatch( strXML, strClose ) )
+		if ( ParseClose( strXML ) )
 		{
 			break;
 		}
@@ -539,6 +666,25 @@ BOOL CXMLElement::ParseString(LPCTSTR& strXML)
 	return TRUE;
 }
 
+BOOL CXMLElement::ParseClose(LPCTSTR& pszBase) const
+{
+	// Match closing tag in place, "</name>"
+	LPCTSTR pszXML = pszBase;
+	for ( ; IsSpace( *pszXML ); pszXML++ );
+
+	if ( pszXML[0] != L'<' || pszXML[1] != L'/' )
+		return FALSE;
+	pszXML += 2;
+
+	const int nLength = m_sName.GetLength();
+	if ( _tcsncmp( pszXML, m_sName, nLength ) != 0 || pszXML[ nLength ] != L'>' )
+		return FALSE;
+
+	pszBase = pszXML + nLength + 1;
+
+	return TRUE;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CXMLElement from bytes
 
@@ -776,7 +922,7 @@ void CXMLElement::Serialize(CArchive& ar)
 	{
 		for ( int nCount = (int)ar.ReadCount(); nCount > 0; nCount-- )
 		{
-			CXMLAttribute* pAttribute = new CXMLAttribute( this );
+			CXMLAttribute* pAttribute = new CXMLAttribute( NULL );
 			pAttribute->Serialize( ar );
 
 			// Skip attribute if name is missing
@@ -786,18 +932,7 @@ void CXMLElement::Serialize(CArchive& ar)
 				continue;
 			}
 
-			CString strNameLower( pAttribute->m_sName );
-			strNameLower.MakeLower();
-
-			// Delete the old attribute if one exists
-			CXMLAttribute* pExisting;
-			if ( m_pAttributes.Lookup( strNameLower, pExisting ) )
-				delete pExisting;
-
-			m_pAttributes.SetAt( strNameLower, pAttribute );
-
-			if ( m_bOrdered && ! m_pAttributesInsertion.Find( strNameLower ) )
-				m_pAttributesInsertion.AddTail( strNameLower );		// Track output order workaround
+			AddAttribute( pAttribute );
 		}
 
 		for ( int nCount = (int)ar.ReadCount(); nCount > 0; nCount-- )
@@ -826,6 +961,18 @@ CXMLAttribute::~CXMLAttribute()
 {
 }
 
+void* PASCAL CXMLAttribute::operator new(size_t nSize)
+{
+	ASSERT( nSize == sizeof( CXMLAttribute ) );
+	return XMLHeap().AllocAttribute();
+}
+
+void PASCAL CXMLAttribute::operator delete(void* pAttribute)
+{
+	if ( pAttribute )
+		XMLHeap().FreeAttribute( pAttribute );
+}
+
 CXMLAttribute* CXMLElement::AddAttribute(LPCTSTR pszName, LPCTSTR pszValue)
 {
 	ASSERT( pszName && *pszName );
@@ -838,18 +985,7 @@ CXMLAttribute* CXMLElement::AddAttribute(LPCTSTR pszName, LPCTSTR pszValue)
 		if ( ! pAttribute )
 			return NULL;
 
-		CString strNameLower( pszName );
-		strNameLower.MakeLower();
-
-		// Delete the old attribute if one exists
-		CXMLAttribute* pExisting;
-		if ( m_pAttributes.Lookup( strNameLower, pExisting ) )
-			delete pExisting;
-
-		m_pAttributes.SetAt( strNameLower, pAttribute );
-
-		if ( m_bOrdered && ! m_pAttributesInsertion.Find( strNameLower ) )
-			m_pAttributesInsertion.AddTail( strNameLower );		// Track output order workaround
+		m_pAttributes.Add( pAttribute );
 	}
 
 	if ( pszValue )
@@ -868,18 +1004,19 @@ CXMLAttribute* CXMLElement::AddAttribute(LPCTSTR pszName, __int64 nValue)
 CXMLAttribute* CXMLElement::AddAttribute(CXMLAttribute* pAttribute)
 {
 	if ( pAttribute->m_pParent ) return NULL;
-	CString strNameLower( pAttribute->m_sName );
-	strNameLower.MakeLower();
 
-	// Delete the old attribute if one exists
-	CXMLAttribute* pExisting;
-	if ( m_pAttributes.Lookup( strNameLower, pExisting ) )
-		delete pExisting;
-
-	if ( m_bOrdered && ! m_pAttributesInsertion.Find( strNameLower ) )
-		m_pAttributesInsertion.AddTail( strNameLower );		// Track output order workaround
+	// Replace the old attribute if one exists, keeping its place
+	const INT_PTR nExisting = FindAttribute( pAttribute->m_sName );
+	if ( nExisting >= 0 )
+	{
+		delete m_pAttributes.GetAt( nExisting );
+		m_pAttributes.SetAt( nExisting, pAttribute );
+	}
+	else
+	{
+		m_pAttributes.Add( pAttribute );
+	}
 
-	m_pAttributes.SetAt( strNameLower, pAttribute );
 	pAttribute->m_pParent = this;
 	return pAttribute;
 }
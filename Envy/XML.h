@@ -43,6 +43,7 @@ protected:
 
 	static BOOL		ParseMatch(LPCTSTR& pszXML, LPCTSTR pszToken);
 	static BOOL		ParseIdentifier(LPCTSTR& pszXML, CString& strIdentifier);
+	static CString	Intern(LPCTSTR pszName, int nLength = -1);		// Shared name string (element and attribute names repeat a lot)
 	void			Serialize(CArchive& ar);
 
 public:
@@ -71,18 +72,21 @@ public:
 	CXMLElement(CXMLElement* pParent = NULL, LPCTSTR pszName = NULL);
 	virtual ~CXMLElement();
 
-public:
-	BOOL			m_bOrdered;						// Track attribute insertion order? (Workaround. ToDo: Fix properly)
-
 protected:
 	CList< CXMLElement* > m_pElements;
-	CList< CString > m_pAttributesInsertion;		// Track insertion order (parallel workaround for deterministic file output)
-	CMap< CString, const CString&, CXMLAttribute*, CXMLAttribute* > m_pAttributes;
+	CArray< CXMLAttribute* > m_pAttributes;			// Insertion order (deterministic file output), few per element
 
 	void			AddRecursiveWords(CString& strWords) const;
 	void			ToString(CString& strXML, BOOL bNewline) const;
+	INT_PTR			FindAttribute(LPCTSTR pszName) const;
+	BOOL			ParseClose(LPCTSTR& pszXML) const;
 
 public:
+	void* PASCAL	operator new(size_t nSize);
+	void* PASCAL	operator new(size_t nSize, LPCSTR /*pszFile*/, int /*nLine*/) { return operator new( nSize ); }	// DEBUG_NEW
+	void PASCAL		operator delete(void* pElement);
+	void PASCAL		operator delete(void* pElement, LPCSTR /*pszFile*/, int /*nLine*/) { operator delete( pElement ); }
+
 	CXMLElement*	Detach();
 	CXMLElement*	Clone(CXMLElement* pParent = NULL) const;
 	CXMLElement*	Prefix(const CString& sPrefix, CXMLElement* pParent = NULL) const;		// Clone element then rename all elements and attributes by using specified prefix
@@ -139,6 +143,11 @@ public:
 	BOOL			Equals(CXMLAttribute* pXML) const;
 	void			Serialize(CArchive& ar);
 	virtual void	SetName(LPCTSTR pszValue);
+
+	void* PASCAL	operator new(size_t nSize);
+	void* PASCAL	operator new(size_t nSize, LPCSTR /*pszFile*/, int /*nLine*/) { return operator new( nSize ); }	// DEBUG_NEW
+	void PASCAL		operator delete(void* pAttribute);
+	void PASCAL		operator delete(void* pAttribute, LPCSTR /*pszFile*/, int /*nLine*/) { operator delete( pAttribute ); }
 };
 
 #include "XML.inl"
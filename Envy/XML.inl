@@ -59,7 +59,7 @@ inline CString CXMLNode::GetName() const
 inline void CXMLNode::SetName(LPCTSTR pszName)
 {
 	ASSERT( pszName && *pszName );
-	m_sName = pszName;
+	m_sName = Intern( pszName );
 }
 
 inline BOOL CXMLNode::IsNamed(LPCTSTR pszName) const
@@ -155,6 +155,17 @@ inline void CXMLElement::RemoveElement(CXMLElement* pElement)
 
 //////////////////////////////////////////////////////////////////////
 // CXMLElement attribute access
+// POSITION is attribute index + 1
+
+inline INT_PTR CXMLElement::FindAttribute(LPCTSTR pszName) const
+{
+	for ( INT_PTR nAttribute = 0; nAttribute < m_pAttributes.GetCount(); ++nAttribute )
+	{
+		if ( m_pAttributes.GetAt( nAttribute )->m_sName.CompareNoCase( pszName ) == 0 )
+			return nAttribute;
+	}
+	return -1;
+}
 
 inline int CXMLElement::GetAttributeCount() const
 {
@@ -163,33 +174,21 @@ inline int CXMLElement::GetAttributeCount() const
 
 inline POSITION CXMLElement::GetAttributeIterator() const
 {
-	//ASSERT( m_pAttributes.GetCount() == m_pAttributesInsertion.GetCount() );
-
-	return m_bOrdered ?
-		m_pAttributesInsertion.GetHeadPosition() :		// Track output order workaround	(Broken Collection creation)
-		m_pAttributes.GetStartPosition();				// Legacy unordered
+	return m_pAttributes.GetCount() ? (POSITION)1 : NULL;
 }
 
 inline CXMLAttribute* CXMLElement::GetNextAttribute(POSITION& pos) const
 {
-	CXMLAttribute* pAttribute = NULL;
-	CString strName;
-
-	m_bOrdered ?
-		m_pAttributes.Lookup( m_pAttributesInsertion.GetNext( pos ), pAttribute ) :	// Track output order workaround	(Broken Collection creation)
-		m_pAttributes.GetNextAssoc( pos, strName, pAttribute );						// Legacy unordered
-
-	return pAttribute;
+	const INT_PTR nAttribute = (INT_PTR)pos - 1;
+	pos = ( nAttribute + 1 < m_pAttributes.GetCount() ) ? (POSITION)( nAttribute + 2 ) : NULL;
+	return m_pAttributes.GetAt( nAttribute );
 }
 
 inline CXMLAttribute* CXMLElement::GetAttribute(LPCTSTR pszName) const
 {
 	ASSERT( pszName && *pszName );
-	CXMLAttribute* pAttribute;
-	CString strNameLower( pszName );
-	strNameLower.MakeLower();
-
-	return m_pAttributes.Lookup( strNameLower, pAttribute ) ? pAttribute : NULL;
+	const INT_PTR nAttribute = FindAttribute( pszName );
+	return ( nAttribute >= 0 ) ? m_pAttributes.GetAt( nAttribute ) : NULL;
 }
 
 inline CString CXMLElement::GetAttributeValue(LPCTSTR pszName, LPCTSTR pszDefault) const
@@ -203,28 +202,21 @@ inline CString CXMLElement::GetAttributeValue(LPCTSTR pszName, LPCTSTR pszDefaul
 
 inline void CXMLElement::RemoveAttribute(CXMLAttribute* pAttribute)
 {
-	CString strNameLower( pAttribute->m_sName );
-	strNameLower.MakeLower();
-
-	m_pAttributes.RemoveKey( strNameLower );
-
-	if ( m_pAttributesInsertion.GetCount() )		// Tracking output order
-		m_pAttributesInsertion.RemoveAt( m_pAttributesInsertion.Find( strNameLower ) );
+	for ( INT_PTR nAttribute = 0; nAttribute < m_pAttributes.GetCount(); ++nAttribute )
+	{
+		if ( m_pAttributes.GetAt( nAttribute ) == pAttribute )
+		{
+			m_pAttributes.RemoveAt( nAttribute );
+			break;
+		}
+	}
 }
 
 inline void CXMLElement::DeleteAttribute(LPCTSTR pszName)
 {
 	ASSERT( pszName && *pszName );
-	CXMLAttribute* pAttribute = GetAttribute( pszName );
-	if ( ! pAttribute ) return;
-
-	CString strNameLower( pAttribute->m_sName );
-	strNameLower.MakeLower();
-
-	pAttribute->Delete();
-
-	if ( m_pAttributesInsertion.GetCount() )	// Tracking output order workaround
-		m_pAttributesInsertion.RemoveAt( m_pAttributesInsertion.Find( strNameLower ) );
+	if ( CXMLAttribute* pAttribute = GetAttribute( pszName ) )
+		pAttribute->Delete();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -233,12 +225,14 @@ inline void CXMLElement::DeleteAttribute(LPCTSTR pszName)
 inline void CXMLAttribute::SetName(LPCTSTR pszName)
 {
 	ASSERT( pszName && *pszName );
-	m_sName = pszName;
 
-	if ( CXMLElement* pParent = m_pParent )
+	// Rename in place, keeping order. Replace namesake attribute if any.
+	if ( m_pParent )
 	{
-		pParent->RemoveAttribute( this );
-		m_pParent = NULL;
-		pParent->AddAttribute( this );
+		CXMLAttribute* pExisting = m_pParent->GetAttribute( pszName );
+		if ( pExisting && pExisting != this )
+			pExisting->Delete();
 	}
+
+	m_sName = Intern( pszName );
 }
@@ -31,6 +31,164 @@ static char THIS_FILE[] = __FILE__;
 #define new DEBUG_NEW
 #endif	// Debug
 
+//////////////////////////////////////////////////////////////////////
+// CZLib stream pool
+
+#define ZLIB_POOL_SIZE		8		// Idle streams kept per direction
+
+class CZLibPool
+{
+public:
+	CZLibPool() {}
+
+	~CZLibPool()
+	{
+		while ( ! m_pDeflate.IsEmpty() )
+		{
+			z_streamp pStream = m_pDeflate.RemoveHead();
+			deflateEnd( pStream );
+			delete pStream;
+		}
+		while ( ! m_pInflate.IsEmpty() )
+		{
+			z_streamp pStream = m_pInflate.RemoveHead();
+			inflateEnd( pStream );
+			delete pStream;
+		}
+	}
+
+	CCriticalSection	m_pSection;
+	CList< z_streamp >	m_pDeflate;
+	CList< z_streamp >	m_pInflate;
+	CMap< z_streamp, z_streamp, int, int > m_pLevel;	// Deflate stream compression level
+};
+
+static CZLibPool ZLibPool;
+
+z_streamp CZLib::AcquireDeflate(int nLevel)
+{
+	z_streamp pStream = NULL;
+	int nStreamLevel = nLevel;
+	{
+		CQuickLock oLock( ZLibPool.m_pSection );
+		if ( ! ZLibPool.m_pDeflate.IsEmpty() )
+		{
+			pStream = ZLibPool.m_pDeflate.RemoveHead();
+			ZLibPool.m_pLevel.Lookup( pStream, nStreamLevel );
+			ZLibPool.m_pLevel.SetAt( pStream, nLevel );
+		}
+	}
+
+	if ( pStream )
+	{
+		// Stream was reset on release, level may be changed before any input
+		if ( nStreamLevel == nLevel || deflateParams( pStream, nLevel, Z_DEFAULT_STRATEGY ) == Z_OK )
+			return pStream;
+
+		{
+			CQuickLock oLock( ZLibPool.m_pSection );
+			ZLibPool.m_pLevel.RemoveKey( pStream );
+		}
+
+		deflateEnd( pStream );
+		delete pStream;
+		return NULL;
+	}
+
+	pStream = new z_stream;
+	ZeroMemory( pStream, sizeof( z_stream ) );
+	if ( deflateInit( pStream, nLevel ) != Z_OK )
+	{
+		delete pStream;
+		return NULL;
+	}
+
+	CQuickLock oLock( ZLibPool.m_pSection );
+	ZLibPool.m_pLevel.SetAt( pStream, nLevel );
+
+	return pStream;
+}
+
+void CZLib::ReleaseDeflate(z_streamp pStream)
+{
+	if ( deflateReset( pStream ) == Z_OK )
+	{
+		CQuickLock oLock( ZLibPool.m_pSection );
+		if ( ZLibPool.m_pDeflate.GetCount() < ZLIB_POOL_SIZE )
+		{
+			ZLibPool.m_pDeflate.AddHead( pStream );
+			return;
+		}
+		ZLibPool.m_pLevel.RemoveKey( pStream );
+	}
+	else
+	{
+		CQuickLock oLock( ZLibPool.m_pSection );
+		ZLibPool.m_pLevel.RemoveKey( pStream );
+	}
+
+	deflateEnd( pStream );
+	delete pStream;
+}
+
+z_streamp CZLib::AcquireInflate()
+{
+	{
+		CQuickLock oLock( ZLibPool.m_pSection );
+		if ( ! ZLibPool.m_pInflate.IsEmpty() )
+			return ZLibPool.m_pInflate.RemoveHead();
+	}
+
+	z_streamp pStream = new z_stream;
+	ZeroMemory( pStream, sizeof( z_stream ) );
+	if ( inflateInit( pStream ) != Z_OK )
+	{
+		delete pStream;
+		return NULL;
+	}
+
+	return pStream;
+}
+
+void CZLib::ReleaseInflate(z_streamp pStream)
+{
+	if ( inflateReset( pStream ) == Z_OK )
+	{
+		CQuickLock oLock( ZLibPool.m_pSection );
+		if ( ZLibPool.m_pInflate.GetCount() < ZLIB_POOL_SIZE )
+		{
+			ZLibPool.m_pInflate.AddHead( pStream );
+			return;
+		}
+	}
+
+	inflateEnd( pStream );
+	delete pStream;
+}
+
+// Compress whole input with pooled stream, same results as compress2()
+int CZLib::Deflate(LPCVOID pInput, DWORD nInput, BYTE* pOutput, DWORD* pnOutput)
+{
+	z_streamp pStream = AcquireDeflate( Settings.Connection.ZLibCompressionLevel );
+	if ( ! pStream )
+		return Z_MEM_ERROR;
+
+	pStream->next_in   = (Bytef*)pInput;
+	pStream->avail_in  = nInput;
+	pStream->next_out  = pOutput;
+	pStream->avail_out = *pnOutput;
+
+	int nRes = deflate( pStream, Z_FINISH );
+	*pnOutput = pStream->total_out;
+
+	ReleaseDeflate( pStream );
+
+	if ( nRes == Z_STREAM_END )
+		return Z_OK;
+
+	return ( nRes == Z_OK ) ? Z_BUF_ERROR : nRes;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CZLib compression
 
@@ -59,7 +217,7 @@ auto_array< BYTE > CZLib::Compress(LPCVOID pInput, DWORD nInput, DWORD* pnOutput
 	}
 
 	// Compress the data at pInput into pBuffer, putting how many bytes it wrote under pnOutput
-	int nRes = compress2( pBuffer.get(), pnOutput, (const BYTE *)pInput, nInput, Settings.Connection.ZLibCompressionLevel );
+	int nRes = Deflate( pInput, nInput, pBuffer.get(), pnOutput );
 
 	if ( nRes != Z_OK )
 	{
@@ -96,7 +254,7 @@ BYTE* CZLib::Compress2(LPCVOID pInput, DWORD nInput, DWORD* pnOutput, DWORD nSug
 	}
 
 	// Compress the data at pInput into pBuffer, putting how many bytes it wrote under pnOutput
-	int nRes = compress2( pBuffer, pnOutput, (const BYTE *)pInput, nInput, Settings.Connection.ZLibCompressionLevel );
+	int nRes = Deflate( pInput, nInput, pBuffer, pnOutput );
 	if ( nRes != Z_OK )
 	{
 		// The compress function reported error
@@ -119,70 +277,87 @@ BYTE* CZLib::Compress2(LPCVOID pInput, DWORD nInput, DWORD* pnOutput, DWORD nSug
 
 auto_array< BYTE > CZLib::Decompress(LPCVOID pInput, DWORD nInput, DWORD* pnOutput)
 {
-	// Guess how big the data will be decompressed, use nSuggest, or just guess it will be 4 times as big
-	for ( DWORD nSuggest = nInput * 4; ; nSuggest *= 2 )
-	{
-		*pnOutput = nSuggest;
+	*pnOutput = 0;
 
-		auto_array< BYTE > pBuffer( new BYTE[ *pnOutput ] );
-		if ( ! pBuffer.get() )
-		{
-			// Out of memory
-			*pnOutput = 0;
-			return auto_array< BYTE >();
-		}
+	z_streamp pStream = AcquireInflate();
+	if ( ! pStream )
+		return auto_array< BYTE >();
 
-		// Uncompress the data from pInput into pBuffer, writing how big it is now in pnOutput
-		int nRes = uncompress( pBuffer.get(), pnOutput, (const BYTE *)pInput, nInput );
+	pStream->next_in  = (Bytef*)pInput;
+	pStream->avail_in = nInput;
 
-		if ( Z_OK == nRes )
-			return pBuffer;
+	// Guess how big the data will be decompressed, just guess it will be 4 times as big
+	auto_array< BYTE > pBuffer;
+	for ( DWORD nSuggest = max( nInput * 4, 64 ); ; nSuggest *= 2 )
+	{
+		// Continue inflating into bigger buffer, keeping output so far
+		auto_array< BYTE > pNewBuffer( new BYTE[ nSuggest ] );
+		if ( ! pNewBuffer.get() )
+			break;		// Out of memory
+
+		if ( pStream->total_out )
+			memcpy( pNewBuffer.get(), pBuffer.get(), pStream->total_out );
+		pBuffer = pNewBuffer;
 
-		if ( Z_BUF_ERROR != nRes )
+		pStream->next_out  = pBuffer.get() + pStream->total_out;
+		pStream->avail_out = nSuggest - pStream->total_out;
+
+		const int nRes = inflate( pStream, Z_FINISH );
+		if ( nRes == Z_STREAM_END )
 		{
-			// Decompression error
-			*pnOutput = 0;
-			return auto_array< BYTE >();
+			*pnOutput = pStream->total_out;
+			ReleaseInflate( pStream );
+			return pBuffer;
 		}
+
+		// Output space exhausted or decompression error
+		if ( ( nRes != Z_BUF_ERROR && nRes != Z_OK ) || pStream->avail_out || nSuggest >= 0x40000000 )
+			break;
 	}
 
-	// The pBuffer buffer is bigger than necessary, move its bytes into one perfectly sized, and return it
-	//auto_array< BYTE > pOutput( new BYTE[ *pnOutput ] );	// Make a new buffer exactly the right size
-	//memcpy( pOutput.get(), pBuffer, *pnOutput );			// Copy the data from the one that's too big
-	//delete [] pBuffer;
-	//return pOutput;										// Return a pointer to the perfectly sized one
+	ReleaseInflate( pStream );
+	return auto_array< BYTE >();
 }
 
 BYTE* CZLib::Decompress2(LPCVOID pInput, DWORD nInput, DWORD* pnOutput)
 {
+	*pnOutput = 0;
+
+	z_streamp pStream = AcquireInflate();
+	if ( ! pStream )
+		return NULL;
+
+	pStream->next_in  = (Bytef*)pInput;
+	pStream->avail_in = nInput;
+
 	BYTE* pBuffer = NULL;
 
-	// Guess how big the data will be decompressed, use nSuggest, or just guess it will be 4 times as big
-	for ( DWORD nSuggest = nInput * 4; ; nSuggest *= 2 )
+	// Guess how big the data will be decompressed, just guess it will be 4 times as big
+	for ( DWORD nSuggest = max( nInput * 4, 64 ); ; nSuggest *= 2 )
 	{
-		*pnOutput = nSuggest;
-
-		BYTE* pNewBuffer = (BYTE*)realloc( pBuffer, *pnOutput );
+		// Continue inflating into bigger buffer, keeping output so far
+		BYTE* pNewBuffer = (BYTE*)realloc( pBuffer, nSuggest );
 		if ( ! pNewBuffer )
-		{
-			// Out of memory
-			free( pBuffer );
-			*pnOutput = 0;
-			return NULL;
-		}
+			break;		// Out of memory
 		pBuffer = pNewBuffer;
 
-		// Uncompress the data from pInput into pBuffer, writing how big it is now in pnOutput
-		int nRes = uncompress( pBuffer, pnOutput, (const BYTE *)pInput, nInput );
-		if ( Z_OK == nRes )
-			return pBuffer;
+		pStream->next_out  = pBuffer + pStream->total_out;
+		pStream->avail_out = nSuggest - pStream->total_out;
 
-		if ( Z_BUF_ERROR != nRes )
+		const int nRes = inflate( pStream, Z_FINISH );
+		if ( nRes == Z_STREAM_END )
 		{
-			// Decompression error
-			free( pBuffer );
-			*pnOutput = 0;
-			return NULL;
+			*pnOutput = pStream->total_out;
+			ReleaseInflate( pStream );
+			return pBuffer;
 		}
+
+		// Output space exhausted or decompression error
+		if ( ( nRes != Z_BUF_ERROR && nRes != Z_OK ) || pStream->avail_out || nSuggest >= 0x40000000 )
+			break;
 	}
+
+	free( pBuffer );
+	ReleaseInflate( pStream );
+	return NULL;
 }
@@ -35,4 +35,12 @@ public:
 	// Or, after use free memory by free() function:
 	static BYTE* Compress2(LPCVOID pInput, DWORD nInput, DWORD* pnOutput, DWORD nSuggest = 0);
 	static BYTE* Decompress2(LPCVOID pInput, DWORD nInput, DWORD* pnOutput);
+
+protected:
+	// Reusable streams, setup of window and hash tables dominates small payloads
+	static z_streamp AcquireDeflate(int nLevel);
+	static z_streamp AcquireInflate();
+	static void		 ReleaseDeflate(z_streamp pStream);
+	static void		 ReleaseInflate(z_streamp pStream);
+	static int		 Deflate(LPCVOID pInput, DWORD nInput, BYTE* pOutput, DWORD* pnOutput);
 };
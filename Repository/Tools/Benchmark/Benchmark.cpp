@@ -0,0 +1,2030 @@
+//
+// Benchmark.cpp
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation (fsf.org);
+// either version 3 of the License, or later version (at your option).
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// (http://www.gnu.org/licenses/gpl.html)
+//
+
+// Envy core performance test utility (headless, no UI)
+//
+// Usage: Benchmark [corpus folder] [results.csv]
+//
+// Corpus folder may contain recorded traffic:
+//   keywords.txt  - one file name or search phrase per line
+//   fragments.txt - one "+ offset length" or "- offset length" per line
+//   media\        - sample files for the metadata extractor read pattern and header parsers
+//   torrents\     - .torrent files for the bencode decoder
+//   packets\      - captured TCP payload after the handshake, one connection per file,
+//                   named by protocol: g1*.bin, g2*.bin, ed2k*.bin, bt*.bin, dc*.bin
+// Anything missing is replaced by fixed-seed synthetic data, so runs repeat.
+// Results are CSV: name,operations,microseconds,nanoseconds per operation
+
+#include "StdAfx.h"
+
+// Stand-ins for Envy globals used by FileFragments/Range.hpp and List.hpp
+
+enum { MSG_ERROR = 1 };
+
+class CBenchmarkApp
+{
+public:
+	void Message(int /*nType*/, LPCTSTR pszText) const
+	{
+		_ftprintf( stderr, _T("%s\n"), pszText );
+	}
+};
+
+static CBenchmarkApp theApp;
+
+#include "..\..\..\Envy\FileFragments\Exception.hpp"
+#include "..\..\..\Envy\FileFragments\Range.hpp"
+#include "..\..\..\Envy\FileFragments\FlatSet.hpp"
+#include "..\..\..\Envy\FileFragments\List.hpp"
+#include "..\..\..\Envy\FileFragments\ListTraits.hpp"
+#include "..\..\..\Envy\QueueIndex.h"
+#include "..\..\..\Envy\FileReader.h"
+#include "..\..\..\Envy\LibraryBuilderHeaders.h"
+#include "..\..\..\Envy\Buffer.h"
+#include "..\..\..\Envy\BENode.h"
+#include "..\..\..\Envy\RouteCache.h"
+#include "..\..\..\Envy\SQLite.h"
+
+#include <zlib/zlib.h>		// After Buffer.h, which then leaves out the CZLib based methods
+
+typedef Ranges::Range< uint64 > Fragment;
+typedef Ranges::FlatSet< Fragment, Ranges::RangeCompare< Fragment::size_type, Fragment::payload_type > > FragmentSet;
+typedef Ranges::List< Fragment, Fragments::ListTraits > FragmentList;
+typedef Ranges::List< Fragment, Fragments::ListTraits, FragmentSet > FlatFragmentList;	// As Fragments::List
+
+struct FragmentOp
+{
+	bool	bAdd;
+	uint64	nOffset;
+	uint64	nLength;
+};
+
+const uint64 FRAGMENT_FILE_SIZE = 4000ull * 1024 * 1024;	// 4 GB
+
+// Stand-in for CUploadTransfer as seen by CUploadQueue
+
+struct QueuedUpload
+{
+	QueuedUpload() : m_nQueueSlot( -1 ) { }
+	INT_PTR m_nQueueSlot;
+};
+
+const INT_PTR QUEUE_UPLOADS = 5000;		// Queued peers
+
+const DWORD MEDIA_SYNTHETIC_FILES = 32;
+const DWORD MEDIA_SYNTHETIC_SIZE = 2 * 1024 * 1024;
+
+const DWORD TORRENT_SYNTHETIC_FILES = 500;
+const DWORD TORRENT_SYNTHETIC_PIECES = 8000;	// 2 GB at 256 KB pieces
+
+const DWORD QHT_BITS = 20;						// Library.QueryRouteSize default
+const DWORD QHT_SIZE = 1u << QHT_BITS;
+const DWORD ROUTE_REPLIES = 32768;				// Recent GUIDs that replies come back on
+const DWORD HOSTCACHE_HOSTS = 16384;			// Gnutella.HostCacheSize maximum
+const DWORD HOST_POOL_SIZE = 256;				// As HostCache.cpp
+const DWORD HOST_QUERY_THROTTLE = 120;			// Gnutella2.QueryThrottle default
+
+const DWORD PACKET_SYNTHETIC_COUNT = 100000;	// Per protocol
+const DWORD PACKET_READ_SIZE = 4096;			// Bytes per socket read
+const DWORD G1_MAXIMUM_PACKET = 64 * 1024;		// Gnutella.MaximumPacket default
+const DWORD ED2K_DATA_BLOCK = 10240;
+const DWORD BT_DATA_BLOCK = 16384;
+
+const DWORD THUMB_BATCH = 16;					// As ThumbCache.cpp
+const DWORD THUMB_STORES = 2000;
+const DWORD THUMB_SIZE = 6 * 1024;				// 128 px JPEG at Library.ThumbQuality
+
+const int ZLIB_LEVEL = 2;						// Connection.ZLibCompressionLevel default
+const DWORD ZLIB_PASSES = 20000;				// Payloads per size
+
+//////////////////////////////////////////////////////////////////////
+// Timer and output
+
+__int64 GetMicroCount()
+{
+	static __int64 Freq = 0;
+	static __int64 FirstCount = 0;
+	if ( Freq < 0 )
+		return GetTickCount() * 1000;
+	if ( Freq == 0 )
+	{
+		if ( ! QueryPerformanceFrequency( (LARGE_INTEGER*)&Freq ) )
+		{
+			Freq = -1;
+			return GetMicroCount();
+		}
+		QueryPerformanceCounter( (LARGE_INTEGER*)&FirstCount );
+	}
+	__int64 Count = 0;
+	QueryPerformanceCounter( (LARGE_INTEGER*)&Count );
+	return ( 1000000 * ( Count - FirstCount ) ) / Freq;
+}
+
+static FILE* g_pResults = NULL;
+static DWORD g_nChecksum = 0;		// Keeps the optimizer from dropping work
+
+void Report(LPCTSTR pszName, QWORD nOperations, __int64 nElapsed)
+{
+	const double fPerOp = nOperations ? ( nElapsed * 1000.0 ) / nOperations : 0;
+	_tprintf( _T("%-28s %10I64u ops %10I64d us %10.1f ns/op\n"), pszName, nOperations, nElapsed, fPerOp );
+	if ( g_pResults )
+		_ftprintf( g_pResults, _T("%s,%I64u,%I64d,%.1f\n"), pszName, nOperations, nElapsed, fPerOp );
+}
+
+// Fixed seed linear congruential generator, same sequence on every run
+static DWORD g_nSeed = 20200101;
+
+DWORD NextRandom()
+{
+	g_nSeed = g_nSeed * 1103515245 + 12345;
+	return ( g_nSeed >> 8 );
+}
+
+//////////////////////////////////////////////////////////////////////
+// Corpus loading
+
+void LoadKeywords(LPCTSTR pszFolder, CStringArray& pWords)
+{
+	if ( pszFolder && *pszFolder )
+	{
+		CString strPath;
+		strPath.Format( _T("%s\\keywords.txt"), pszFolder );
+		CStdioFile pFile;
+		if ( pFile.Open( strPath, CFile::modeRead | CFile::shareDenyWrite ) )
+		{
+			CString strLine;
+			while ( pFile.ReadString( strLine ) )
+			{
+				strLine.Trim();
+				if ( ! strLine.IsEmpty() )
+					pWords.Add( strLine );
+			}
+		}
+	}
+
+	if ( pWords.GetSize() )
+		return;
+
+	static LPCTSTR pszParts[] =
+	{
+		_T("live"), _T("Album"), _T("2019"), _T("remix"), _T("[HD]"), _T("the"), _T("Artist"),
+		_T("track_01"), _T("mp3"), _T("video.avi"), _T("-bootleg"), _T("\x30a2\x30cb\x30e1"),
+		_T("\x58f0\x512a"), _T("edition"), _T("ost"), _T("part.2"), _T("\"exact phrase\""), _T("flac")
+	};
+
+	for ( int nLine = 0; nLine < 20000; nLine++ )
+	{
+		CString strLine;
+		for ( DWORD nWords = 2 + NextRandom() % 6; nWords; nWords-- )
+		{
+			if ( ! strLine.IsEmpty() )
+				strLine += ( NextRandom() & 1 ) ? _T(' ') : _T('.');
+			strLine += pszParts[ NextRandom() % _countof( pszParts ) ];
+		}
+		pWords.Add( strLine );
+	}
+}
+
+void LoadFragments(LPCTSTR pszFolder, std::vector< FragmentOp >& pOps)
+{
+	if ( pszFolder && *pszFolder )
+	{
+		CString strPath;
+		strPath.Format( _T("%s\\fragments.txt"), pszFolder );
+		CStdioFile pFile;
+		if ( pFile.Open( strPath, CFile::modeRead | CFile::shareDenyWrite ) )
+		{
+			CString strLine;
+			while ( pFile.ReadString( strLine ) )
+			{
+				TCHAR cOp = 0;
+				FragmentOp oOp;
+				if ( _stscanf( strLine, _T("%c %I64u %I64u"), &cOp, &oOp.nOffset, &oOp.nLength ) == 3 &&
+					 oOp.nOffset + oOp.nLength <= FRAGMENT_FILE_SIZE )
+				{
+					oOp.bAdd = ( cOp == _T('+') );
+					pOps.push_back( oOp );
+				}
+			}
+		}
+	}
+
+	if ( ! pOps.empty() )
+		return;
+
+	// Swarm-like pattern: mostly verified 256 KB blocks, some failed hash ranges removed
+	for ( int nOp = 0; nOp < 200000; nOp++ )
+	{
+		FragmentOp oOp;
+		oOp.bAdd = ( NextRandom() % 8 ) != 0;
+		oOp.nOffset = (uint64)( NextRandom() % ( FRAGMENT_FILE_SIZE / 262144 ) ) * 262144;
+		oOp.nLength = 262144 * ( 1 + NextRandom() % 4 );
+		if ( oOp.nOffset + oOp.nLength > FRAGMENT_FILE_SIZE )
+			oOp.nLength = FRAGMENT_FILE_SIZE - oOp.nOffset;
+		pOps.push_back( oOp );
+	}
+}
+
+// Falls back to fixed-seed temporary files, bTemporary tells the caller to delete them
+void LoadMedia(LPCTSTR pszFolder, CStringArray& pFiles, bool& bTemporary)
+{
+	bTemporary = false;
+
+	if ( pszFolder && *pszFolder )
+	{
+		CFileFind pFind;
+		CString strMask;
+		strMask.Format( _T("%s\\media\\*.*"), pszFolder );
+		for ( BOOL bFound = pFind.FindFile( strMask ); bFound; )
+		{
+			bFound = pFind.FindNextFile();
+			if ( ! pFind.IsDirectory() )
+				pFiles.Add( pFind.GetFilePath() );
+		}
+	}
+
+	if ( pFiles.GetSize() )
+		return;
+
+	TCHAR szTemp[ MAX_PATH ] = {};
+	GetTempPath( MAX_PATH, szTemp );
+
+	std::vector< BYTE > pData( MEDIA_SYNTHETIC_SIZE );
+	for ( DWORD nFile = 0; nFile < MEDIA_SYNTHETIC_FILES; nFile++ )
+	{
+		for ( DWORD nByte = 0; nByte < MEDIA_SYNTHETIC_SIZE; nByte++ )
+			pData[ nByte ] = (BYTE)NextRandom();
+
+		CString strPath;
+		strPath.Format( _T("%sEnvyBenchmark%02u.bin"), szTemp, nFile );
+		CFile pFile;
+		if ( pFile.Open( strPath, CFile::modeCreate | CFile::modeWrite ) )
+		{
+			pFile.Write( &pData[ 0 ], MEDIA_SYNTHETIC_SIZE );
+			pFile.Close();
+			pFiles.Add( strPath );
+		}
+	}
+
+	bTemporary = true;
+}
+
+// Falls back to one synthetic multi-file torrent
+void LoadTorrents(LPCTSTR pszFolder, std::vector< std::vector< BYTE > >& pTorrents)
+{
+	if ( pszFolder && *pszFolder )
+	{
+		CFileFind pFind;
+		CString strMask;
+		strMask.Format( _T("%s\\torrents\\*.torrent"), pszFolder );
+		for ( BOOL bFound = pFind.FindFile( strMask ); bFound; )
+		{
+			bFound = pFind.FindNextFile();
+			CFile pFile;
+			if ( pFind.IsDirectory() || ! pFile.Open( pFind.GetFilePath(), CFile::modeRead | CFile::shareDenyWrite ) )
+				continue;
+
+			const DWORD nLength = (DWORD)pFile.GetLength();
+			if ( nLength )
+			{
+				pTorrents.push_back( std::vector< BYTE >( nLength ) );
+				pFile.Read( &pTorrents.back()[ 0 ], nLength );
+			}
+		}
+	}
+
+	if ( ! pTorrents.empty() )
+		return;
+
+	CBENode oRoot;
+	oRoot.Add( "announce" )->SetString( CString( _T("http://tracker.example.com/announce") ) );
+	CBENode* pInfo = oRoot.Add( "info" );
+	pInfo->Add( "name" )->SetString( CString( _T("Benchmark Collection") ) );
+	pInfo->Add( "piece length" )->SetInt( 262144 );
+
+	std::vector< BYTE > pPieces( TORRENT_SYNTHETIC_PIECES * 20 );
+	for ( size_t nByte = 0; nByte < pPieces.size(); nByte++ )
+		pPieces[ nByte ] = (BYTE)NextRandom();
+	pInfo->Add( "pieces" )->SetString( &pPieces[ 0 ], pPieces.size() );
+
+	CBENode* pFiles = pInfo->Add( "files" );
+	for ( DWORD nFile = 0; nFile < TORRENT_SYNTHETIC_FILES; nFile++ )
+	{
+		CBENode* pFile = pFiles->Add();
+		pFile->Add( "length" )->SetInt( 1 + NextRandom() % 100000000 );
+		CBENode* pPath = pFile->Add( "path" );
+		CString strName;
+		strName.Format( _T("Disc %u"), nFile / 50 );
+		pPath->Add()->SetString( strName );
+		strName.Format( _T("track_%03u.flac"), nFile );
+		pPath->Add()->SetString( strName );
+	}
+
+	CBuffer oBuffer;
+	oRoot.Encode( &oBuffer );
+	pTorrents.push_back( std::vector< BYTE >( oBuffer.m_pBuffer, oBuffer.m_pBuffer + oBuffer.m_nLength ) );
+}
+
+// Appends every packets\<protocol>*.bin capture, false when there are none
+bool LoadPackets(LPCTSTR pszFolder, LPCTSTR pszProtocol, CBuffer& oStream)
+{
+	if ( ! pszFolder || ! *pszFolder )
+		return false;
+
+	CFileFind pFind;
+	CString strMask;
+	strMask.Format( _T("%s\\packets\\%s*.bin"), pszFolder, pszProtocol );
+	for ( BOOL bFound = pFind.FindFile( strMask ); bFound; )
+	{
+		bFound = pFind.FindNextFile();
+		CFile pFile;
+		if ( pFind.IsDirectory() || ! pFile.Open( pFind.GetFilePath(), CFile::modeRead | CFile::shareDenyWrite ) )
+			continue;
+
+		const DWORD nLength = (DWORD)pFile.GetLength();
+		if ( nLength && oStream.EnsureBuffer( nLength ) )
+		{
+			oStream.m_nLength += pFile.Read( oStream.m_pBuffer + oStream.m_nLength, nLength );
+		}
+	}
+
+	return oStream.m_nLength != 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Stand-ins for classes bound to Settings, Network and theApp
+//
+// Each one copies the data layout and inner loop of the Envy code named
+// above it, so change both together.
+
+// As CQueryHashTable::HashWord (QueryHashTable.cpp)
+inline DWORD QueryHashWord(LPCTSTR pszString, size_t nLength, DWORD nBits)
+{
+	DWORD nNumber = 0;
+	int nByte = 0;
+
+	for ( ; nLength; --nLength, ++pszString )
+	{
+		nNumber ^= ( tolower( *pszString ) & 0xFF ) << ( nByte * 8 );
+		nByte = ( nByte + 1 ) & 3;
+	}
+
+	return ( nNumber * 0x4F1BBCDC ) >> ( 32 - nBits );
+}
+
+// As CQueryHashTable AddExactString/CheckHash/Check, a clear bit marks a present word
+class CQueryHashStandIn
+{
+public:
+	CQueryHashStandIn() : m_pHash( QHT_SIZE / 8, 0xFF ), m_nCount( 0 ) { }
+
+	void AddExactString(LPCTSTR pszWord, size_t nLength)
+	{
+		const DWORD nHash = QueryHashWord( pszWord, nLength, QHT_BITS );
+		BYTE& nHashByte = m_pHash[ nHash >> 3 ];
+		const BYTE nMask = BYTE( 1 << ( nHash & 7 ) );
+		if ( nHashByte & nMask )
+		{
+			++m_nCount;
+			nHashByte &= ~nMask;
+		}
+	}
+
+	bool CheckHash(DWORD nHash) const
+	{
+		const DWORD lHash = nHash >> ( 32 - QHT_BITS );
+		return ! ( m_pHash[ lHash >> 3 ] & BYTE( 1 << ( lHash & 7 ) ) );
+	}
+
+	// Keyword search: at least 2/3 of three or more words, else all of them
+	bool Check(const WordTable& oWords) const
+	{
+		DWORD nWords = 0, nWordHits = 0;
+		for ( WordTable::const_iterator i = oWords.begin(); i != oWords.end(); ++i, ++nWords )
+		{
+			if ( CheckHash( QueryHashWord( i->first, i->second, 32 ) ) )
+				++nWordHits;
+		}
+
+		return ( nWords >= 3 )
+			? ( nWordHits * 3 / nWords >= 2 )
+			: ( nWordHits == nWords );
+	}
+
+	DWORD GetCount() const { return m_nCount; }
+
+protected:
+	std::vector< BYTE >	m_pHash;
+	DWORD				m_nCount;
+};
+
+// As CHostCacheHost, CHostCachePool and CHostCacheList (HostCache.h/.cpp): pooled host records
+// by address, an index newest first and the G2 query queue
+
+struct HostStandIn
+{
+	IN_ADDR	m_pAddress;
+	DWORD	m_tSeen;
+	DWORD	m_tQuery;		// Last query time, 0 when never queried
+	BOOL	m_bPriority;
+
+	DWORD QueryTime() const
+	{
+		return m_tQuery ? m_tQuery + HOST_QUERY_THROTTLE + 1 : 0;
+	}
+};
+
+struct HostAddressLess : public std::binary_function< IN_ADDR, IN_ADDR, bool >
+{
+	bool operator()(const IN_ADDR& pLeft, const IN_ADDR& pRight) const
+	{
+		return ntohl( pLeft.s_addr ) < ntohl( pRight.s_addr );
+	}
+};
+
+struct HostNewer : public std::binary_function< const HostStandIn*, const HostStandIn*, bool >
+{
+	bool operator()(const HostStandIn* pLeft, const HostStandIn* pRight) const
+	{
+		return pLeft->m_tSeen > pRight->m_tSeen;
+	}
+};
+
+typedef std::multimap< IN_ADDR, HostStandIn*, HostAddressLess > HostMapStandIn;
+typedef std::multiset< HostStandIn*, HostNewer > HostIndexStandIn;
+typedef std::set< std::pair< DWORD, DWORD > > HostQueueStandIn;		// Next query time, IP address
+
+// As CHostCachePool: blocks of HOST_POOL_SIZE, freed hosts reused first
+class CHostPoolStandIn
+{
+public:
+	~CHostPoolStandIn()
+	{
+		for ( INT_PTR nBlock = 0; nBlock < m_pBlocks.GetCount(); nBlock++ )
+			delete [] m_pBlocks.GetAt( nBlock );
+	}
+
+	HostStandIn* New()
+	{
+		if ( m_pFree.IsEmpty() )
+		{
+			HostStandIn* pBlock = new HostStandIn[ HOST_POOL_SIZE ];
+			m_pBlocks.Add( pBlock );
+			for ( int nHost = HOST_POOL_SIZE - 1; nHost >= 0; nHost-- )
+				m_pFree.Add( &pBlock[ nHost ] );
+		}
+
+		const INT_PTR nLast = m_pFree.GetCount() - 1;
+		HostStandIn* pHost = m_pFree.GetAt( nLast );
+		m_pFree.RemoveAt( nLast );
+		ZeroMemory( pHost, sizeof( HostStandIn ) );
+		return pHost;
+	}
+
+	void Delete(HostStandIn* pHost)
+	{
+		m_pFree.Add( pHost );
+	}
+
+protected:
+	CArray< HostStandIn* >	m_pBlocks;
+	CArray< HostStandIn* >	m_pFree;
+};
+
+class CHostCacheStandIn
+{
+public:
+	HostStandIn* Find(const IN_ADDR& pAddress) const
+	{
+		HostMapStandIn::const_iterator i = m_Hosts.find( pAddress );
+		return ( i != m_Hosts.end() ) ? i->second : NULL;
+	}
+
+	// As CHostCacheList::Add and Update
+	HostStandIn* Add(const IN_ADDR& pAddress, DWORD tSeen, BOOL bPriority)
+	{
+		HostStandIn* pHost = Find( pAddress );
+		if ( ! pHost )
+		{
+			pHost = m_pPool.New();
+			PruneHosts();
+
+			pHost->m_pAddress = pAddress;
+			pHost->m_tSeen = tSeen;
+			pHost->m_bPriority = bPriority;
+			m_Hosts.insert( HostMapStandIn::value_type( pAddress, pHost ) );
+			m_HostsTime.insert( pHost );
+		}
+		else if ( pHost->m_tSeen != tSeen )
+		{
+			m_HostsTime.erase( std::find( m_HostsTime.begin(), m_HostsTime.end(), pHost ) );
+			pHost->m_tSeen = tSeen;
+			m_HostsTime.insert( pHost );
+		}
+		QueueQuery( pHost );
+		return pHost;
+	}
+
+	// As CHostCacheList::QueueQuery
+	void QueueQuery(const HostStandIn* pHost)
+	{
+		const DWORD nAddress = pHost->m_pAddress.s_addr;
+		const DWORD tNext = pHost->QueryTime();
+
+		std::map< DWORD, DWORD >::iterator i = m_pQueryTimes.find( nAddress );
+		if ( i != m_pQueryTimes.end() )
+		{
+			if ( i->second == tNext )
+				return;
+
+			m_pQueryQueue.erase( std::make_pair( i->second, nAddress ) );
+			i->second = tNext;
+		}
+		else
+		{
+			m_pQueryTimes.insert( std::make_pair( nAddress, tNext ) );
+		}
+
+		m_pQueryQueue.insert( std::make_pair( tNext, nAddress ) );
+	}
+
+	// As CHostCacheList::GetNextQuery then QueueQuery after sending
+	HostStandIn* QueryNext(DWORD tNow)
+	{
+		while ( ! m_pQueryQueue.empty() && m_pQueryQueue.begin()->first <= tNow )
+		{
+			const DWORD nAddress = m_pQueryQueue.begin()->second;
+			IN_ADDR pAddress;
+			pAddress.s_addr = nAddress;
+
+			m_pQueryQueue.erase( m_pQueryQueue.begin() );
+			m_pQueryTimes.erase( nAddress );
+
+			HostStandIn* pHost = Find( pAddress );
+			if ( ! pHost )
+				continue;
+
+			pHost->m_tQuery = tNow;
+			QueueQuery( pHost );
+			return pHost;
+		}
+		return NULL;
+	}
+
+	// As CHostCacheList::PruneHosts, oldest first, priority hosts only when there is no other choice
+	void PruneHosts()
+	{
+		for ( int nPass = 0; nPass < 2; nPass++ )
+		{
+			for ( HostIndexStandIn::iterator i = m_HostsTime.end();
+				m_Hosts.size() > HOSTCACHE_HOSTS && i != m_HostsTime.begin(); )
+			{
+				--i;
+				HostStandIn* pHost = *i;
+				if ( nPass == 0 && pHost->m_bPriority )
+					continue;
+
+				i = m_HostsTime.erase( i );
+				for ( HostMapStandIn::iterator j = m_Hosts.begin(); j != m_Hosts.end(); ++j )
+				{
+					if ( j->second == pHost )
+					{
+						m_Hosts.erase( j );
+						break;
+					}
+				}
+				m_pPool.Delete( pHost );
+			}
+		}
+	}
+
+	// Newest hosts, as X-Try-Hubs and KHL replies are built
+	DWORD GetNewest(DWORD nCount) const
+	{
+		DWORD nSum = 0;
+		for ( HostIndexStandIn::const_iterator i = m_HostsTime.begin(); nCount && i != m_HostsTime.end(); ++i, --nCount )
+			nSum += (*i)->m_pAddress.s_addr;
+		return nSum;
+	}
+
+	size_t GetCount() const { return m_Hosts.size(); }
+
+protected:
+	CHostPoolStandIn			m_pPool;
+	HostMapStandIn				m_Hosts;
+	HostIndexStandIn			m_HostsTime;
+	HostQueueStandIn			m_pQueryQueue;
+	std::map< DWORD, DWORD >	m_pQueryTimes;	// IP address -> time queued in m_pQueryQueue
+};
+
+// As CLibraryDictionary (LibraryDictionary.cpp): keyword to file list, search cookie per file
+
+struct LibraryFileStandIn
+{
+	LibraryFileStandIn() : m_nSearchCookie( 0 ) { }
+	DWORD	m_nSearchCookie;
+};
+
+typedef CList< LibraryFileStandIn* > FileListStandIn;
+
+class CLibraryDictionaryStandIn
+{
+public:
+	CLibraryDictionaryStandIn() : m_nSearchCookie( 0 ) { }
+
+	~CLibraryDictionaryStandIn()
+	{
+		for ( POSITION pos = m_oWordMap.GetStartPosition(); pos; )
+		{
+			CString strWord;
+			FileListStandIn* pList;
+			m_oWordMap.GetNextAssoc( pos, strWord, pList );
+			delete pList;
+		}
+	}
+
+	// As ProcessPhrase and ProcessWord
+	void ProcessFile(LibraryFileStandIn* pFile, LPCTSTR pszPhrase, bool bAdd)
+	{
+		WordTable oWords, oNegWords;
+		BuildWordTable( pszPhrase, oWords, oNegWords );
+		for ( WordTable::const_iterator i = oWords.begin(); i != oWords.end(); ++i )
+		{
+			CString strWord( i->first, (int)i->second );
+			strWord.MakeLower();
+
+			FileListStandIn* pList = NULL;
+			if ( m_oWordMap.Lookup( strWord, pList ) )
+			{
+				if ( POSITION pos = pList->Find( pFile ) )
+				{
+					if ( ! bAdd )
+					{
+						pList->RemoveAt( pos );
+						if ( pList->IsEmpty() )
+						{
+							delete pList;
+							m_oWordMap.RemoveKey( strWord );
+						}
+					}
+				}
+				else if ( bAdd )
+				{
+					pList->AddTail( pFile );
+				}
+			}
+			else if ( bAdd )
+			{
+				pList = new FileListStandIn;
+				pList->AddTail( pFile );
+				m_oWordMap.SetAt( strWord, pList );
+			}
+		}
+	}
+
+	// As Search, returns the number of distinct files hit
+	DWORD Search(LPCTSTR pszQuery)
+	{
+		++m_nSearchCookie;
+		DWORD nHits = 0;
+
+		WordTable oWords, oNegWords;
+		BuildWordTable( pszQuery, oWords, oNegWords );
+		for ( WordTable::const_iterator i = oWords.begin(); i != oWords.end(); ++i )
+		{
+			CString strWord( i->first, (int)i->second );
+			strWord.MakeLower();
+
+			FileListStandIn* pList = NULL;
+			if ( m_oWordMap.Lookup( strWord, pList ) )
+			{
+				for ( POSITION pos = pList->GetHeadPosition(); pos; )
+				{
+					LibraryFileStandIn* pFile = pList->GetNext( pos );
+					if ( pFile->m_nSearchCookie != m_nSearchCookie )
+					{
+						pFile->m_nSearchCookie = m_nSearchCookie;
+						++nHits;
+					}
+				}
+			}
+		}
+
+		return nHits;
+	}
+
+	INT_PTR GetWordCount() const { return m_oWordMap.GetCount(); }
+
+protected:
+	CMap< CString, const CString&, FileListStandIn*, FileListStandIn*& > m_oWordMap;
+	DWORD	m_nSearchCookie;
+};
+
+// As CThumbCache (ThumbCache.cpp) on the shipping CDatabase and DatabasePool, without image coding.
+// Pending thumbnails are written in batches. bLockedFlush keeps the cache section across the
+// transaction as FlushLocked did; otherwise the batch moves to m_pFlushing as Flush does now.
+
+#define THUMB_DB_INIT		L"PRAGMA synchronous=NORMAL;"	// As ThumbCache.cpp
+
+struct ThumbStandIn
+{
+	QWORD				nFileSize;
+	std::vector< BYTE >	pData;
+};
+
+typedef CMap< CString, const CString&, ThumbStandIn*, ThumbStandIn* > ThumbMapStandIn;
+
+class CThumbCacheStandIn
+{
+public:
+	CThumbCacheStandIn(LPCTSTR szDatabase, bool bLockedFlush)
+		: m_sDatabase	( szDatabase )
+		, m_bLockedFlush( bLockedFlush )
+	{
+	}
+
+	~CThumbCacheStandIn()
+	{
+		Clear( m_pPending );
+	}
+
+	bool Load(const CString& strPath, QWORD nFileSize)
+	{
+		{
+			CQuickLock oLock( m_pSection );
+
+			ThumbStandIn* pThumb;
+			if ( m_pPending.Lookup( strPath, pThumb ) || m_pFlushing.Lookup( strPath, pThumb ) )
+				return pThumb->nFileSize == nFileSize;
+		}
+
+		CPooledDatabase db( m_sDatabase, THUMB_DB_INIT );
+		if ( ! *db ||
+			 ! db->Prepare( L"SELECT FileSize, LastWriteTime, Image FROM Files WHERE Filename == ?;" ) ||
+			 ! db->Bind( 1, strPath ) ||
+			 ! db->Step() ||
+			 db->GetCount() != 3 )
+			return false;
+
+		int nData;
+		return db->GetBlob( L"Image", &nData ) != NULL && (QWORD)db->GetInt64( L"FileSize" ) == nFileSize;
+	}
+
+	// As Store, the caller here is also the library thread that writes full batches
+	void Store(const CString& strPath, QWORD nFileSize, const std::vector< BYTE >& pData)
+	{
+		ThumbStandIn* pThumb = new ThumbStandIn;
+		pThumb->nFileSize = nFileSize;
+		pThumb->pData = pData;
+
+		bool bFlush;
+		{
+			CQuickLock oLock( m_pSection );
+
+			ThumbStandIn* pOld;
+			if ( m_pPending.Lookup( strPath, pOld ) )
+				delete pOld;
+			m_pPending.SetAt( strPath, pThumb );
+
+			bFlush = ( m_pPending.GetCount() >= THUMB_BATCH );
+		}
+
+		if ( bFlush )
+			Flush();
+	}
+
+	void Flush()
+	{
+		if ( m_bLockedFlush )
+		{
+			CQuickLock oLock( m_pSection );
+
+			Write( m_pPending );
+			Clear( m_pPending );
+			return;
+		}
+
+		CQuickLock oFlushLock( m_pFlushSection );
+		{
+			CQuickLock oLock( m_pSection );
+
+			for ( POSITION pos = m_pPending.GetStartPosition(); pos; )
+			{
+				CString strPath;
+				ThumbStandIn* pThumb;
+				m_pPending.GetNextAssoc( pos, strPath, pThumb );
+				m_pFlushing.SetAt( strPath, pThumb );
+			}
+			m_pPending.RemoveAll();
+		}
+
+		Write( m_pFlushing );
+
+		CQuickLock oLock( m_pSection );
+		Clear( m_pFlushing );
+	}
+
+protected:
+	CString				m_sDatabase;
+	bool				m_bLockedFlush;
+	CCriticalSection	m_pSection;
+	CCriticalSection	m_pFlushSection;
+	ThumbMapStandIn		m_pPending;
+	ThumbMapStandIn		m_pFlushing;
+
+	void Write(const ThumbMapStandIn& pMap)
+	{
+		CPooledDatabase db( m_sDatabase, THUMB_DB_INIT );
+		if ( pMap.IsEmpty() || ! *db || ! db->Exec( L"BEGIN TRANSACTION;" ) )
+			return;
+
+		bool bResult = true;
+		for ( POSITION pos = pMap.GetStartPosition(); pos && bResult; )
+		{
+			CString strPath;
+			ThumbStandIn* pThumb;
+			pMap.GetNextAssoc( pos, strPath, pThumb );
+
+			bResult = db->Prepare( L"INSERT OR REPLACE INTO Files ( Filename, FileSize, LastWriteTime, Image ) VALUES ( ?, ?, ?, ? );" ) &&
+				db->Bind( 1, strPath ) &&
+				db->Bind( 2, (__int64)pThumb->nFileSize ) &&
+				db->Bind( 3, (__int64)0 ) &&
+				db->Bind( 4, &pThumb->pData[ 0 ], (int)pThumb->pData.size() ) &&
+				db->Step();
+		}
+
+		db->Exec( bResult ? L"COMMIT;" : L"ROLLBACK;" );
+	}
+
+	static void Clear(ThumbMapStandIn& pMap)
+	{
+		for ( POSITION pos = pMap.GetStartPosition(); pos; )
+		{
+			CString strPath;
+			ThumbStandIn* pThumb;
+			pMap.GetNextAssoc( pos, strPath, pThumb );
+			delete pThumb;
+		}
+		pMap.RemoveAll();
+	}
+};
+
+// Packet framing as the ReadBuffer/ProcessPackets loops, each returns whole packets consumed.
+// Pooled packet objects are not modelled, the payload is read in place.
+
+#pragma pack(1)
+struct G1Header		// As GNUTELLAPACKET (G1Packet.h)
+{
+	BYTE	m_oGUID[ 16 ];
+	BYTE	m_nType;
+	BYTE	m_nTTL;
+	BYTE	m_nHops;
+	LONG	m_nLength;
+};
+
+struct ED2KHeader	// As ED2K_TCP_HEADER (EDPacket.h)
+{
+	BYTE	nProtocol;
+	DWORD	nLength;
+	BYTE	nType;
+};
+#pragma pack()
+
+const BYTE G2_FLAG_COMPOUND		= 0x04;
+const BYTE G2_FLAG_BIG_ENDIAN	= 0x02;
+const BYTE ED2K_PROTOCOL_EDONKEY		= 0xE3;
+const BYTE ED2K_PROTOCOL_EMULE			= 0xC5;
+const BYTE ED2K_PROTOCOL_EMULE_PACKED	= 0xD4;
+
+// As CG1Neighbour::ProcessPackets
+DWORD ParseG1(CBuffer& oInput)
+{
+	DWORD nPackets = 0;
+	for ( ;; )
+	{
+		const G1Header* pPacket = (const G1Header*)oInput.m_pBuffer;
+		if ( oInput.m_nLength < sizeof( *pPacket ) ) break;
+
+		const DWORD nLength = sizeof( *pPacket ) + pPacket->m_nLength;
+		if ( pPacket->m_nLength < 0 || nLength >= G1_MAXIMUM_PACKET ) break;
+		if ( oInput.m_nLength < nLength ) break;
+
+		g_nChecksum += pPacket->m_nType;
+		oInput.Remove( nLength );
+		++nPackets;
+	}
+	return nPackets;
+}
+
+// As CG2Packet::ReadPacket over a compound payload, stops at the end-of-children marker
+DWORD WalkG2Children(const BYTE* pData, DWORD nData)
+{
+	DWORD nChildren = 0;
+	while ( nData )
+	{
+		const BYTE nInput = *pData++;
+		--nData;
+		if ( nInput == 0 ) break;
+
+		const BYTE nLenLen	= ( nInput & 0xC0 ) >> 6;
+		const BYTE nTypeLen	= ( ( nInput & 0x38 ) >> 3 ) + 1;
+		if ( nData < (DWORD)nLenLen + nTypeLen ) break;
+
+		DWORD nLength = 0;
+		CopyMemory( &nLength, pData, nLenLen );
+		pData += nLenLen + nTypeLen;
+		nData -= nLenLen + nTypeLen;
+		if ( nLength > nData ) break;
+
+		g_nChecksum += pData[ -1 ];
+		pData += nLength;
+		nData -= nLength;
+		++nChildren;
+	}
+	return nChildren;
+}
+
+// As CG2Packet::ReadBuffer plus the child walk done by the Q2/QH2/LNI handlers
+DWORD ParseG2(CBuffer& oInput)
+{
+	DWORD nPackets = 0;
+	while ( oInput.m_nLength )
+	{
+		const BYTE nInput = *oInput.m_pBuffer;
+		if ( nInput == 0 )
+		{
+			oInput.Remove( 1 );
+			continue;
+		}
+
+		const BYTE nLenLen	= ( nInput & 0xC0 ) >> 6;
+		const BYTE nTypeLen	= ( nInput & 0x38 ) >> 3;
+		const BYTE nFlags	= ( nInput & 0x07 );
+
+		if ( oInput.m_nLength < (DWORD)nLenLen + nTypeLen + 2 ) break;
+
+		DWORD nLength = 0;
+		const BYTE* pLenIn = oInput.m_pBuffer + 1;
+		if ( nFlags & G2_FLAG_BIG_ENDIAN )
+		{
+			for ( BYTE nIt = nLenLen; nIt; nIt-- )
+				nLength = ( nLength << 8 ) | *pLenIn++;
+		}
+		else
+		{
+			CopyMemory( &nLength, pLenIn, nLenLen );
+		}
+
+		const DWORD nHeader = nLenLen + nTypeLen + 2;
+		if ( oInput.m_nLength < nLength + nHeader ) break;
+
+		g_nChecksum += oInput.m_pBuffer[ nHeader - 1 ];
+		if ( nFlags & G2_FLAG_COMPOUND )
+			g_nChecksum += WalkG2Children( oInput.m_pBuffer + nHeader, nLength );
+
+		oInput.Remove( nLength + nHeader );
+		++nPackets;
+	}
+	return nPackets;
+}
+
+// As CEDPacket::ReadBuffer, packed packets are not generated so Inflate is not modelled
+DWORD ParseED2K(CBuffer& oInput)
+{
+	DWORD nPackets = 0;
+	for ( ;; )
+	{
+		if ( oInput.m_nLength < sizeof( ED2KHeader ) ) break;
+		const ED2KHeader* pHeader = (const ED2KHeader*)oInput.m_pBuffer;
+		if ( pHeader->nProtocol != ED2K_PROTOCOL_EDONKEY &&
+			 pHeader->nProtocol != ED2K_PROTOCOL_EMULE &&
+			 pHeader->nProtocol != ED2K_PROTOCOL_EMULE_PACKED ) break;
+		if ( oInput.m_nLength - sizeof( *pHeader ) + 1 < pHeader->nLength ) break;
+
+		g_nChecksum += pHeader->nType;
+		oInput.Remove( sizeof( *pHeader ) + pHeader->nLength - 1 );
+		++nPackets;
+	}
+	return nPackets;
+}
+
+// As CBTPacket::ReadBuffer, keep-alives count as packets
+DWORD ParseBT(CBuffer& oInput)
+{
+	DWORD nPackets = 0;
+	while ( oInput.m_nLength >= sizeof( DWORD ) )
+	{
+		const DWORD nLength = _byteswap_ulong( oInput.ReadDWORD() );
+		if ( oInput.m_nLength - sizeof( DWORD ) < nLength ) break;
+
+		oInput.Remove( sizeof( DWORD ) );
+		if ( nLength )
+		{
+			g_nChecksum += oInput.m_pBuffer[ 0 ];
+			oInput.Remove( nLength );
+		}
+		++nPackets;
+	}
+	return nPackets;
+}
+
+// As CDCPacket::ReadBuffer plus the command split done by CDCClient/CDCNeighbour
+DWORD ParseDC(CBuffer& oInput)
+{
+	DWORD nPackets = 0;
+	while ( oInput.m_nLength &&
+		( oInput.m_pBuffer[ 0 ] == '$' ||
+		  oInput.m_pBuffer[ 0 ] == '<' ||
+		  oInput.m_pBuffer[ 0 ] == '|' ) )
+	{
+		DWORD nLength = 0, nCommand = 0;
+		for ( DWORD i = 0; i < oInput.m_nLength; ++i )
+		{
+			if ( oInput.m_pBuffer[ i ] == '|' )
+			{
+				nLength = i + 1;
+				break;
+			}
+			if ( ! nCommand && oInput.m_pBuffer[ i ] == ' ' )
+				nCommand = i;
+		}
+		if ( ! nLength ) break;
+
+		g_nChecksum += nCommand ? nCommand : nLength;
+		oInput.Remove( nLength );
+		++nPackets;
+	}
+	return nPackets;
+}
+
+// Synthetic inbound streams, one per protocol, weighted towards search traffic
+
+void MakeG1Stream(CBuffer& oStream)
+{
+	static const BYTE nTypes[] = { 0x00, 0x01, 0x80, 0x80, 0x80, 0x81, 0x40, 0x30 };	// Ping, pong, query, hit, push, QRP
+
+	BYTE pPayload[ 1024 ];
+	for ( DWORD nByte = 0; nByte < sizeof( pPayload ); nByte++ )
+		pPayload[ nByte ] = (BYTE)NextRandom();
+
+	for ( DWORD nPacket = 0; nPacket < PACKET_SYNTHETIC_COUNT; nPacket++ )
+	{
+		G1Header oHeader;
+		for ( DWORD nByte = 0; nByte < sizeof( oHeader.m_oGUID ); nByte++ )
+			oHeader.m_oGUID[ nByte ] = (BYTE)NextRandom();
+		oHeader.m_nType		= nTypes[ NextRandom() % _countof( nTypes ) ];
+		oHeader.m_nTTL		= 3;
+		oHeader.m_nHops		= 1;
+		oHeader.m_nLength	= (LONG)( ( oHeader.m_nType == 0x81 ) ? 200 + NextRandom() % 800 : NextRandom() % 120 );
+
+		oStream.Add( &oHeader, sizeof( oHeader ) );
+		oStream.Add( pPayload, oHeader.m_nLength );
+	}
+}
+
+void WriteG2(CBuffer& oOutput, LPCSTR pszType, const BYTE* pBody, DWORD nBody, bool bCompound)
+{
+	const BYTE nLenLen	= BYTE( nBody > 0xFFFF ? 3 : nBody > 0xFF ? 2 : nBody ? 1 : 0 );
+	const BYTE nTypeLen	= (BYTE)strlen( pszType );
+	const BYTE nControl	= BYTE( ( nLenLen << 6 ) | ( ( nTypeLen - 1 ) << 3 ) | ( bCompound ? G2_FLAG_COMPOUND : 0 ) );
+
+	oOutput.Add( &nControl, 1 );
+	oOutput.Add( &nBody, nLenLen );
+	oOutput.Add( pszType, nTypeLen );
+	if ( nBody )
+		oOutput.Add( pBody, nBody );
+}
+
+void MakeG2Stream(CBuffer& oStream)
+{
+	static LPCSTR pszTypes[] = { "Q2", "Q2", "QH2", "QH2", "LNI", "KHL", "PI", "PO" };
+	static LPCSTR pszChildren[] = { "UDP", "URN", "DN", "MD", "I", "H", "NA", "TS" };
+
+	BYTE pPayload[ 512 ];
+	for ( DWORD nByte = 0; nByte < sizeof( pPayload ); nByte++ )
+		pPayload[ nByte ] = (BYTE)NextRandom();
+
+	CBuffer oBody;
+	for ( DWORD nPacket = 0; nPacket < PACKET_SYNTHETIC_COUNT; nPacket++ )
+	{
+		LPCSTR pszType = pszTypes[ NextRandom() % _countof( pszTypes ) ];
+		const DWORD nChildren = ( pszType[ 0 ] == 'P' ) ? 0 : 1 + NextRandom() % 8;
+
+		oBody.Clear();
+		for ( DWORD nChild = 0; nChild < nChildren; nChild++ )
+			WriteG2( oBody, pszChildren[ NextRandom() % _countof( pszChildren ) ], pPayload, 1 + NextRandom() % 63, false );
+
+		if ( ! nChildren )
+		{
+			oBody.Add( pPayload, NextRandom() % 32 );
+		}
+		else if ( NextRandom() & 1 )
+		{
+			const BYTE nEnd = 0;
+			oBody.Add( &nEnd, 1 );
+			oBody.Add( pPayload, 1 + NextRandom() % 255 );
+		}
+
+		WriteG2( oStream, pszType, oBody.m_pBuffer, oBody.m_nLength, nChildren != 0 );
+	}
+}
+
+void MakeED2KStream(CBuffer& oStream)
+{
+	static const BYTE nProtocols[] = { ED2K_PROTOCOL_EDONKEY, ED2K_PROTOCOL_EDONKEY, ED2K_PROTOCOL_EMULE };
+
+	std::vector< BYTE > pPayload( ED2K_DATA_BLOCK );
+	for ( size_t nByte = 0; nByte < pPayload.size(); nByte++ )
+		pPayload[ nByte ] = (BYTE)NextRandom();
+
+	for ( DWORD nPacket = 0; nPacket < PACKET_SYNTHETIC_COUNT; nPacket++ )
+	{
+		// Mostly small requests and answers, one in 32 carries file data
+		const DWORD nBody = ( NextRandom() % 32 == 0 ) ? ED2K_DATA_BLOCK : 8 + NextRandom() % 200;
+
+		ED2KHeader oHeader;
+		oHeader.nProtocol	= nProtocols[ NextRandom() % _countof( nProtocols ) ];
+		oHeader.nLength		= nBody + 1;
+		oHeader.nType		= (BYTE)NextRandom();
+
+		oStream.Add( &oHeader, sizeof( oHeader ) );
+		oStream.Add( &pPayload[ 0 ], nBody );
+	}
+}
+
+void MakeBTStream(CBuffer& oStream)
+{
+	std::vector< BYTE > pPayload( BT_DATA_BLOCK + 9 );
+	for ( size_t nByte = 0; nByte < pPayload.size(); nByte++ )
+		pPayload[ nByte ] = (BYTE)NextRandom();
+
+	for ( DWORD nPacket = 0; nPacket < PACKET_SYNTHETIC_COUNT; nPacket++ )
+	{
+		// Keep-alive, have, request, and one piece in 64
+		const DWORD nKind = NextRandom() % 64;
+		const DWORD nLength = ( nKind == 0 ) ? BT_DATA_BLOCK + 9 : ( nKind < 4 ) ? 0 : ( nKind < 40 ) ? 5 : 13;
+		const DWORD nLengthBE = _byteswap_ulong( nLength );
+
+		oStream.Add( &nLengthBE, sizeof( nLengthBE ) );
+		if ( nLength )
+			oStream.Add( &pPayload[ 0 ], nLength );
+	}
+}
+
+void MakeDCStream(CBuffer& oStream)
+{
+	for ( DWORD nPacket = 0; nPacket < PACKET_SYNTHETIC_COUNT; nPacket++ )
+	{
+		CStringA strCommand;
+		switch ( NextRandom() % 4 )
+		{
+		case 0:
+			strCommand.Format( "$Search Hub:user%u F?T?0?9?live$album|", NextRandom() % 1000 );
+			break;
+		case 1:
+			strCommand.Format( "$SR user%u Music\\track_%03u.flac\x05%u 3/3\x05TTH:%032u (hub.example.com:411)|",
+				NextRandom() % 1000, NextRandom() % 500, NextRandom(), NextRandom() );
+			break;
+		case 2:
+			strCommand.Format( "$MyINFO $ALL user%u <++ V:0.868,M:A,H:1/0/0,S:3>$ $100\x01$$%u$|",
+				NextRandom() % 1000, NextRandom() );
+			break;
+		default:
+			strCommand.Format( "<user%u> see you later|", NextRandom() % 1000 );
+		}
+		oStream.Print( strCommand );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// Benchmarks
+
+void BenchKeywords(const CStringArray& pWords)
+{
+	const INT_PTR nCount = pWords.GetSize();
+
+	__int64 tStart = GetMicroCount();
+	for ( INT_PTR nWord = 0; nWord < nCount; nWord++ )
+		g_nChecksum += MakeKeywords( pWords[ nWord ] ).GetLength();
+	Report( _T("keywords.make"), nCount, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nWord = 0; nWord < nCount; nWord++ )
+	{
+		WordTable oWords, oNegWords;
+		BuildWordTable( pWords[ nWord ], oWords, oNegWords );
+		g_nChecksum += (DWORD)( oWords.size() + oNegWords.size() );
+	}
+	Report( _T("keywords.wordtable"), nCount, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nWord = 0; nWord < nCount; nWord++ )
+	{
+		CString strWord( pWords[ nWord ] );
+		g_nChecksum += ToLower.Clean( strWord ).GetLength();
+	}
+	Report( _T("keywords.clean"), nCount, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nWord = 0; nWord < nCount; nWord++ )
+		g_nChecksum += URLDecode( URLEncode( pWords[ nWord ] ) ).GetLength();
+	Report( _T("strings.url"), nCount, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nWord = 0; nWord < nCount; nWord++ )
+		g_nChecksum += UTF8Decode( UTF8Encode( pWords[ nWord ] ) ).GetLength();
+	Report( _T("strings.utf8"), nCount, GetMicroCount() - tStart );
+}
+
+// Same operations on the std::set and the flat vector container, pszName tells them apart
+template< class ListT >
+void BenchFragments(LPCTSTR pszName, const std::vector< FragmentOp >& pOps)
+{
+	CString strName;
+	ListT oList( FRAGMENT_FILE_SIZE );
+
+	__int64 tStart = GetMicroCount();
+	for ( std::vector< FragmentOp >::const_iterator i = pOps.begin(); i != pOps.end(); ++i )
+	{
+		const Fragment oFragment( i->nOffset, i->nOffset + i->nLength );
+		if ( i->bAdd )
+			oList.insert( oFragment );
+		else
+			oList.erase( oFragment );
+	}
+	strName.Format( _T("%s.apply"), pszName );
+	Report( strName, pOps.size(), GetMicroCount() - tStart );
+	g_nChecksum += (DWORD)oList.size();
+
+	const QWORD nQueries = 1000000;
+	tStart = GetMicroCount();
+	for ( QWORD nQuery = 0; nQuery < nQueries; nQuery++ )
+	{
+		const uint64 nOffset = (uint64)NextRandom() * 1024 % FRAGMENT_FILE_SIZE;
+		g_nChecksum += oList.has_position( nOffset ) ? 1 : 0;
+	}
+	strName.Format( _T("%s.has_position"), pszName );
+	Report( strName, nQueries, GetMicroCount() - tStart );
+
+	const QWORD nInverse = 100;
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nInverse; nPass++ )
+		g_nChecksum += (DWORD)Ranges::inverse( oList ).size();
+	strName.Format( _T("%s.inverse"), pszName );
+	Report( strName, nInverse, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	g_nChecksum += (DWORD)oList.largest_range()->size();
+	strName.Format( _T("%s.largest_range"), pszName );
+	Report( strName, 1, GetMicroCount() - tStart );
+
+	// Fragment bars and the wanted list cache take copies
+	const QWORD nCopies = 100;
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nCopies; nPass++ )
+	{
+		const ListT oCopy( oList );
+		g_nChecksum += (DWORD)oCopy.size();
+	}
+	strName.Format( _T("%s.copy"), pszName );
+	Report( strName, nCopies, GetMicroCount() - tStart );
+
+	// Wanted list as GetPossibleFragments built it: subtract the inverse range by range
+	const ListT& oMask = oList;
+	ListT oOther( FRAGMENT_FILE_SIZE );
+	for ( QWORD nBlock = 0; nBlock < FRAGMENT_FILE_SIZE / 1048576; nBlock += 2 )
+		oOther.insert( oOther.end(), Fragment( nBlock * 1048576, nBlock * 1048576 + 1048576 ) );
+	const ListT oInverse( Ranges::inverse( oMask ) );
+
+	const QWORD nBulk = 10;
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nBulk; nPass++ )
+	{
+		ListT oResult( oOther );
+		oResult.erase( oInverse.begin(), oInverse.end() );
+		g_nChecksum += (DWORD)oResult.size();
+	}
+	strName.Format( _T("%s.subtract_each"), pszName );
+	Report( strName, nBulk, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nBulk; nPass++ )
+	{
+		ListT oResult( oOther );
+		oResult.erase( oInverse );
+		g_nChecksum += (DWORD)oResult.size();
+	}
+	strName.Format( _T("%s.subtract_bulk"), pszName );
+	Report( strName, nBulk, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nBulk; nPass++ )
+	{
+		ListT oResult( oOther );
+		oResult.intersect( oMask );
+		g_nChecksum += (DWORD)oResult.size();
+	}
+	strName.Format( _T("%s.intersect"), pszName );
+	Report( strName, nBulk, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( QWORD nPass = 0; nPass < nBulk; nPass++ )
+	{
+		ListT oResult( oOther );
+		oResult.insert( oMask );
+		g_nChecksum += (DWORD)oResult.size();
+	}
+	strName.Format( _T("%s.union"), pszName );
+	Report( strName, nBulk, GetMicroCount() - tStart );
+}
+
+void BenchQueue()
+{
+	std::vector< QueuedUpload > pUploads( QUEUE_UPLOADS );
+	CQueueIndex< QueuedUpload > oQueue;
+
+	__int64 tStart = GetMicroCount();
+	for ( INT_PTR nUpload = 0; nUpload < QUEUE_UPLOADS; nUpload++ )
+		oQueue.Add( &pUploads[ nUpload ] );
+	Report( _T("queue.enqueue"), QUEUE_UPLOADS, GetMicroCount() - tStart );
+
+	// Every queued peer polls its position (X-Queue), few leave or start
+	const QWORD nPolls = 1000000;
+	tStart = GetMicroCount();
+	for ( QWORD nPoll = 0; nPoll < nPolls; nPoll++ )
+	{
+		QueuedUpload* pUpload = &pUploads[ NextRandom() % QUEUE_UPLOADS ];
+		if ( oQueue.Contains( pUpload ) )
+		{
+			const INT_PTR nPosition = oQueue.GetPosition( pUpload );
+			g_nChecksum += (DWORD)nPosition;
+			if ( nPosition == 0 || NextRandom() % 100 == 0 )
+				oQueue.Remove( pUpload );	// Started or dropped
+		}
+		else
+		{
+			oQueue.Add( pUpload );			// Rejoined at tail
+		}
+	}
+	Report( _T("queue.churn"), nPolls, GetMicroCount() - tStart );
+
+	// Upload list view walks the queue by position
+	tStart = GetMicroCount();
+	const INT_PTR nCount = oQueue.GetCount();
+	for ( INT_PTR nPosition = 0; nPosition < nCount; nPosition++ )
+		g_nChecksum += (DWORD)oQueue.GetAt( nPosition )->m_nQueueSlot;
+	Report( _T("queue.walk"), nCount, GetMicroCount() - tStart );
+}
+
+// Replays the calls CLibraryBuilderInternals makes: header probe, ID3v1 tail,
+// chunk walk (RIFF/ASF/FLV/MP3 frames), padding scan, reverse PDF trailer scan.
+// Works on a raw HANDLE (Win32 calls) or a CFileReader (overloads) alike.
+template< class T >
+DWORD ProbeMedia(T& hFile)
+{
+	DWORD nSum = 0, nRead = 0;
+	BYTE pHeader[ 128 ];
+
+	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
+	if ( ReadFile( hFile, pHeader, 10, &nRead, NULL ) )
+		nSum += pHeader[ 0 ];
+
+	if ( SetFilePointer( hFile, -128, NULL, FILE_END ) != INVALID_SET_FILE_POINTER &&
+		 ReadFile( hFile, pHeader, 128, &nRead, NULL ) )
+		nSum += pHeader[ 3 ];
+
+	const DWORD nSize = GetFileSize( hFile, NULL );
+
+	SetFilePointer( hFile, 0, NULL, FILE_BEGIN );
+	for ( DWORD nChunk = 0; nChunk < 4096; nChunk++ )
+	{
+		DWORD nID = 0, nLength = 0;
+		if ( ! ReadFile( hFile, &nID, 4, &nRead, NULL ) || nRead != 4 ) break;
+		if ( ! ReadFile( hFile, &nLength, 4, &nRead, NULL ) || nRead != 4 ) break;
+		nSum += nID;
+		if ( SetFilePointer( hFile, 32 + ( nLength & 0x1FF ), NULL, FILE_CURRENT ) >= nSize ) break;
+	}
+
+	SetFilePointer( hFile, 10, NULL, FILE_BEGIN );
+	for ( DWORD nPad = 0; nPad < 2048; nPad++ )
+	{
+		BYTE nByte;
+		if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 ) break;
+		nSum += nByte;
+	}
+
+	for ( LONG nBack = 1; nBack <= 1024; nBack++ )
+	{
+		BYTE nByte;
+		if ( SetFilePointer( hFile, -nBack, NULL, FILE_END ) == INVALID_SET_FILE_POINTER ) break;
+		if ( ! ReadFile( hFile, &nByte, 1, &nRead, NULL ) || nRead != 1 ) break;
+		nSum += nByte;
+	}
+
+	return nSum;
+}
+
+void BenchMedia(const CStringArray& pFiles)
+{
+	const INT_PTR nCount = pFiles.GetSize();
+
+	for ( int nMode = 0; nMode < 2; nMode++ )
+	{
+		QWORD nReads = 0;
+		__int64 tStart = GetMicroCount();
+		for ( INT_PTR nFile = 0; nFile < nCount; nFile++ )
+		{
+			HANDLE hFile = CreateFile( pFiles[ nFile ], GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+			if ( hFile == INVALID_HANDLE_VALUE )
+				continue;
+
+			if ( nMode == 0 )
+			{
+				g_nChecksum += ProbeMedia( hFile );
+			}
+			else
+			{
+				CFileReader oFile( hFile );
+				g_nChecksum += ProbeMedia( oFile );
+				nReads += oFile.GetReadCount();
+			}
+
+			CloseHandle( hFile );
+		}
+		const __int64 tElapsed = GetMicroCount() - tStart;
+
+		Report( nMode ? _T("media.reader") : _T("media.handle"), nCount, tElapsed );
+		_tprintf( _T("%-28s %10.1f files/s"), _T(""), tElapsed ? nCount * 1000000.0 / tElapsed : 0 );
+		if ( nMode )
+			_tprintf( _T(" %10.1f reads/file"), nCount ? (double)nReads / nCount : 0 );
+		_tprintf( _T("\n") );
+	}
+}
+
+// Runs the shipping ID3 and image header parsers as ExtractMetadata dispatches them,
+// unknown extensions (and the synthetic files) go through every parser.
+// A one byte window sends every read straight to the file, the pre-CFileReader cost.
+DWORD ExtractHeaders(CFileReader& hFile, const CString& strExt)
+{
+	const bool bAll = strExt != _T("mp3") && strExt != _T("jpg") && strExt != _T("jpeg") &&
+		strExt != _T("png") && strExt != _T("gif") && strExt != _T("bmp");
+	DWORD nParsed = 0;
+	bool bCorrupted = false;
+
+	if ( bAll || strExt == _T("mp3") )
+	{
+		ID3V1 pInfo = {};
+		if ( CLibraryBuilderHeaders::ReadID3v1( hFile, pInfo ) )
+			nParsed++;
+
+		ID3V2_HEADER pHeader = {};
+		CBuffer pFrames;
+		if ( CLibraryBuilderHeaders::ReadID3v2( hFile, pHeader, pFrames ) )
+		{
+			g_nChecksum += pFrames.m_nLength;
+			nParsed++;
+		}
+	}
+
+	CImageHeader oHeader;
+	if ( ( bAll || strExt == _T("jpg") || strExt == _T("jpeg") ) &&
+		 CLibraryBuilderHeaders::ReadJPEG( hFile, oHeader, bCorrupted ) )
+		nParsed++;
+	if ( ( bAll || strExt == _T("png") ) &&
+		 CLibraryBuilderHeaders::ReadPNG( hFile, oHeader, bCorrupted ) )
+		nParsed++;
+	if ( ( bAll || strExt == _T("gif") ) &&
+		 CLibraryBuilderHeaders::ReadGIF( hFile, oHeader, bCorrupted ) )
+		nParsed++;
+	if ( ( bAll || strExt == _T("bmp") ) &&
+		 CLibraryBuilderHeaders::ReadBMP( hFile, oHeader ) )
+		nParsed++;
+
+	g_nChecksum += oHeader.m_nWidth + oHeader.m_nHeight;
+	return nParsed;
+}
+
+void BenchExtractors(const CStringArray& pFiles)
+{
+	const INT_PTR nCount = pFiles.GetSize();
+
+	for ( int nMode = 0; nMode < 2; nMode++ )
+	{
+		QWORD nReads = 0;
+		DWORD nParsed = 0;
+		__int64 tStart = GetMicroCount();
+		for ( INT_PTR nFile = 0; nFile < nCount; nFile++ )
+		{
+			HANDLE hFile = CreateFile( pFiles[ nFile ], GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+			if ( hFile == INVALID_HANDLE_VALUE )
+				continue;
+
+			CString strExt = pFiles[ nFile ].Mid( pFiles[ nFile ].ReverseFind( _T('.') ) + 1 );
+			strExt.MakeLower();
+
+			CFileReader oFile( hFile, nMode ? 64 * 1024 : 1 );
+			nParsed += ExtractHeaders( oFile, strExt );
+			nReads += oFile.GetReadCount();
+
+			CloseHandle( hFile );
+		}
+		const __int64 tElapsed = GetMicroCount() - tStart;
+
+		Report( nMode ? _T("extract.reader") : _T("extract.direct"), nCount, tElapsed );
+		_tprintf( _T("%-28s %10.1f files/s %10.1f reads/file %6u parsed\n"), _T(""),
+			tElapsed ? nCount * 1000000.0 / tElapsed : 0, nCount ? (double)nReads / nCount : 0, nParsed );
+	}
+}
+
+void BenchLibrary(const CStringArray& pWords)
+{
+	// First half are shared file names, second half are incoming searches
+	const INT_PTR nCount = pWords.GetSize();
+	const INT_PTR nFiles = nCount / 2;
+
+	CQueryHashStandIn oTable;
+	__int64 tStart = GetMicroCount();
+	for ( INT_PTR nFile = 0; nFile < nFiles; nFile++ )
+	{
+		WordTable oWords, oNegWords;
+		BuildWordTable( pWords[ nFile ], oWords, oNegWords );
+		for ( WordTable::const_iterator i = oWords.begin(); i != oWords.end(); ++i )
+			oTable.AddExactString( i->first, i->second );
+	}
+	Report( _T("qht.build"), nFiles, GetMicroCount() - tStart );
+	g_nChecksum += oTable.GetCount();
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nQuery = nFiles; nQuery < nCount; nQuery++ )
+	{
+		WordTable oWords, oNegWords;
+		BuildWordTable( pWords[ nQuery ], oWords, oNegWords );
+		g_nChecksum += oTable.Check( oWords ) ? 1 : 0;
+	}
+	Report( _T("qht.check"), nCount - nFiles, GetMicroCount() - tStart );
+
+	std::vector< LibraryFileStandIn > pFiles( nFiles );
+	CLibraryDictionaryStandIn oDictionary;
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nFile = 0; nFile < nFiles; nFile++ )
+		oDictionary.ProcessFile( &pFiles[ nFile ], pWords[ nFile ], true );
+	Report( _T("dictionary.add"), nFiles, GetMicroCount() - tStart );
+	g_nChecksum += (DWORD)oDictionary.GetWordCount();
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nQuery = nFiles; nQuery < nCount; nQuery++ )
+		g_nChecksum += oDictionary.Search( pWords[ nQuery ] );
+	Report( _T("dictionary.search"), nCount - nFiles, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( INT_PTR nFile = 0; nFile < nFiles; nFile++ )
+		oDictionary.ProcessFile( &pFiles[ nFile ], pWords[ nFile ], false );
+	Report( _T("dictionary.remove"), nFiles, GetMicroCount() - tStart );
+}
+
+// Shipping CRouteCache: every routed packet adds its GUID, a known one (reply or duplicate) is refused
+void BenchRoutes()
+{
+	CRouteCache oCache;
+	std::vector< Hashes::Guid > pSent( ROUTE_REPLIES );
+
+	SOCKADDR_IN pEndpoint = {};
+	pEndpoint.sin_family = AF_INET;
+
+	const QWORD nPackets = 1000000;
+	__int64 tStart = GetMicroCount();
+	for ( QWORD nPacket = 0; nPacket < nPackets; nPacket++ )
+	{
+		Hashes::Guid oGUID;
+		if ( NextRandom() % 4 == 0 )
+			oGUID = pSent[ NextRandom() % ROUTE_REPLIES ];
+		if ( ! oGUID.isValid() )
+		{
+			for ( size_t nByte = 0; nByte < oGUID.byteCount; nByte++ )
+				oGUID[ nByte ] = (BYTE)NextRandom();
+			oGUID.validate();
+		}
+
+		pEndpoint.sin_addr.s_addr = NextRandom();
+		if ( oCache.Add( oGUID, &pEndpoint ) )
+			pSent[ nPacket % ROUTE_REPLIES ] = oGUID;
+		else
+			g_nChecksum++;
+	}
+	Report( _T("routes.lookup_add"), nPackets, GetMicroCount() - tStart );
+}
+
+void BenchHosts()
+{
+	CHostCacheStandIn oCache;
+	IN_ADDR pAddress;
+
+	// KHL and X-Try-Hubs mostly repeat known hubs, enough new ones to keep pruning
+	const QWORD nUpdates = 20000;
+	__int64 tStart = GetMicroCount();
+	for ( QWORD nUpdate = 0; nUpdate < nUpdates; nUpdate++ )
+	{
+		pAddress.s_addr = htonl( 0x0A000000 + NextRandom() % ( HOSTCACHE_HOSTS * 2 ) );
+		oCache.Add( pAddress, (DWORD)nUpdate, NextRandom() % 64 == 0 );
+	}
+	Report( _T("hostcache.add"), nUpdates, GetMicroCount() - tStart );
+	g_nChecksum += (DWORD)oCache.GetCount();
+
+	const QWORD nLookups = 1000000;
+	tStart = GetMicroCount();
+	for ( QWORD nLookup = 0; nLookup < nLookups; nLookup++ )
+	{
+		pAddress.s_addr = htonl( 0x0A000000 + NextRandom() % ( HOSTCACHE_HOSTS * 2 ) );
+		g_nChecksum += oCache.Find( pAddress ) ? 1 : 0;
+	}
+	Report( _T("hostcache.find"), nLookups, GetMicroCount() - tStart );
+
+	// One G2 hub query per tick, as CManagedSearch::ExecuteG2Mesh walks the queue
+	const QWORD nQueries = 100000;
+	tStart = GetMicroCount();
+	for ( QWORD nQuery = 0; nQuery < nQueries; nQuery++ )
+	{
+		if ( const HostStandIn* pHost = oCache.QueryNext( (DWORD)( nUpdates + nQuery / 16 ) ) )
+			g_nChecksum += pHost->m_pAddress.s_addr;
+	}
+	Report( _T("hostcache.query"), nQueries, GetMicroCount() - tStart );
+
+	const QWORD nLists = 100000;
+	tStart = GetMicroCount();
+	for ( QWORD nList = 0; nList < nLists; nList++ )
+		g_nChecksum += oCache.GetNewest( 20 );
+	Report( _T("hostcache.newest"), nLists, GetMicroCount() - tStart );
+}
+
+typedef DWORD (*PacketParser)(CBuffer& oInput);
+
+// Feeds the stream in socket-sized reads, as CConnection::OnRead fills the input buffer
+void BenchPacketStream(LPCTSTR pszName, const CBuffer& oStream, PacketParser pfnParse)
+{
+	CBuffer oInput;
+	QWORD nPackets = 0;
+
+	__int64 tStart = GetMicroCount();
+	for ( DWORD nOffset = 0; nOffset < oStream.m_nLength; nOffset += PACKET_READ_SIZE )
+	{
+		oInput.Add( oStream.m_pBuffer + nOffset, min( PACKET_READ_SIZE, oStream.m_nLength - nOffset ) );
+		nPackets += pfnParse( oInput );
+	}
+	Report( pszName, nPackets, GetMicroCount() - tStart );
+	g_nChecksum += oInput.m_nLength;
+}
+
+// Corpus captures where present, else the synthetic stream for that protocol
+void BenchPackets(LPCTSTR pszCorpus)
+{
+	CBuffer oStream;
+
+	if ( ! LoadPackets( pszCorpus, _T("g1"), oStream ) )
+		MakeG1Stream( oStream );
+	BenchPacketStream( _T("packets.g1"), oStream, ParseG1 );
+
+	oStream.Clear();
+	if ( ! LoadPackets( pszCorpus, _T("g2"), oStream ) )
+		MakeG2Stream( oStream );
+	BenchPacketStream( _T("packets.g2"), oStream, ParseG2 );
+
+	oStream.Clear();
+	if ( ! LoadPackets( pszCorpus, _T("ed2k"), oStream ) )
+		MakeED2KStream( oStream );
+	BenchPacketStream( _T("packets.ed2k"), oStream, ParseED2K );
+
+	oStream.Clear();
+	if ( ! LoadPackets( pszCorpus, _T("bt"), oStream ) )
+		MakeBTStream( oStream );
+	BenchPacketStream( _T("packets.bt"), oStream, ParseBT );
+
+	oStream.Clear();
+	if ( ! LoadPackets( pszCorpus, _T("dc"), oStream ) )
+		MakeDCStream( oStream );
+	BenchPacketStream( _T("packets.dc"), oStream, ParseDC );
+}
+
+// Small payloads as G1 hits, G2 UDP packets and hit trailers: compress2()/uncompress() per call,
+// as CZLib did before, against one stream kept with deflateReset/inflateReset as CZLib::Deflate does now
+void BenchZLib(LPCTSTR pszCorpus)
+{
+	static const DWORD nSizes[] = { 128, 512, 1500, 4096 };
+
+	// Cut from the G2 capture when the corpus has one, else text and hashes as in a hit
+	CBuffer oSource;
+	if ( ! LoadPackets( pszCorpus, _T("g2"), oSource ) || oSource.m_nLength < 4096 )
+	{
+		oSource.Clear();
+		while ( oSource.m_nLength < 65536 )
+		{
+			CStringA strXML;
+			strXML.Format( "<audio title=\"Track %u\" artist=\"Artist %u\" album=\"Album\" bitrate=\"%u\"/>",
+				NextRandom() % 100, NextRandom() % 20, 128 + NextRandom() % 3 * 64 );
+			oSource.Print( strXML );
+			for ( int nByte = 0; nByte < 20; nByte++ )
+				oSource.Add( "0123456789ABCDEF" + NextRandom() % 16, 1 );
+		}
+	}
+
+	std::vector< BYTE > pOutput( compressBound( 4096 ) );
+	std::vector< BYTE > pPlain( 4096 );
+
+	for ( size_t nSize = 0; nSize < _countof( nSizes ); nSize++ )
+	{
+		const DWORD nInput = nSizes[ nSize ];
+		const DWORD nSlots = oSource.m_nLength / nInput;
+		CString strName;
+
+		__int64 tStart = GetMicroCount();
+		for ( DWORD nPass = 0; nPass < ZLIB_PASSES; nPass++ )
+		{
+			uLongf nOutput = (uLongf)pOutput.size();
+			compress2( &pOutput[ 0 ], &nOutput, oSource.m_pBuffer + ( nPass % nSlots ) * nInput, nInput, ZLIB_LEVEL );
+			g_nChecksum += (DWORD)nOutput;
+		}
+		strName.Format( _T("zlib.deflate.%u"), nInput );
+		Report( strName, ZLIB_PASSES, GetMicroCount() - tStart );
+
+		z_stream pDeflate = {};
+		deflateInit( &pDeflate, ZLIB_LEVEL );
+		tStart = GetMicroCount();
+		for ( DWORD nPass = 0; nPass < ZLIB_PASSES; nPass++ )
+		{
+			pDeflate.next_in   = oSource.m_pBuffer + ( nPass % nSlots ) * nInput;
+			pDeflate.avail_in  = nInput;
+			pDeflate.next_out  = &pOutput[ 0 ];
+			pDeflate.avail_out = (uInt)pOutput.size();
+			deflate( &pDeflate, Z_FINISH );
+			g_nChecksum += pDeflate.total_out;
+			deflateReset( &pDeflate );
+		}
+		strName.Format( _T("zlib.deflate.%u.reuse"), nInput );
+		Report( strName, ZLIB_PASSES, GetMicroCount() - tStart );
+		deflateEnd( &pDeflate );
+
+		// Inflate the same payload each pass, only setup cost differs between the two
+		uLongf nCompressed = (uLongf)pOutput.size();
+		compress2( &pOutput[ 0 ], &nCompressed, oSource.m_pBuffer, nInput, ZLIB_LEVEL );
+
+		tStart = GetMicroCount();
+		for ( DWORD nPass = 0; nPass < ZLIB_PASSES; nPass++ )
+		{
+			uLongf nPlain = (uLongf)pPlain.size();
+			uncompress( &pPlain[ 0 ], &nPlain, &pOutput[ 0 ], nCompressed );
+			g_nChecksum += (DWORD)nPlain;
+		}
+		strName.Format( _T("zlib.inflate.%u"), nInput );
+		Report( strName, ZLIB_PASSES, GetMicroCount() - tStart );
+
+		z_stream pInflate = {};
+		inflateInit( &pInflate );
+		tStart = GetMicroCount();
+		for ( DWORD nPass = 0; nPass < ZLIB_PASSES; nPass++ )
+		{
+			pInflate.next_in   = &pOutput[ 0 ];
+			pInflate.avail_in  = (uInt)nCompressed;
+			pInflate.next_out  = &pPlain[ 0 ];
+			pInflate.avail_out = (uInt)pPlain.size();
+			inflate( &pInflate, Z_FINISH );
+			g_nChecksum += pInflate.total_out;
+			inflateReset( &pInflate );
+		}
+		strName.Format( _T("zlib.inflate.%u.reuse"), nInput );
+		Report( strName, ZLIB_PASSES, GetMicroCount() - tStart );
+		inflateEnd( &pInflate );
+	}
+}
+
+struct ThumbReader
+{
+	CThumbCacheStandIn*	pCache;
+	volatile LONG		bStop;
+	QWORD				nLoads;
+	DWORD				nHits;
+};
+
+// Library view thread scrolling over thumbnails, stored or not yet
+unsigned __stdcall ThumbReaderThread(LPVOID pParam)
+{
+	ThumbReader* pReader = (ThumbReader*)pParam;
+	DWORD nSeed = 20200102;		// NextRandom() is not thread safe
+
+	while ( ! pReader->bStop )
+	{
+		nSeed = nSeed * 1103515245 + 12345;
+		CString strPath;
+		strPath.Format( _T("c:\\library\\album %u\\track_%04u.jpg"), ( nSeed >> 8 ) % THUMB_STORES / 20, ( nSeed >> 8 ) % THUMB_STORES );
+		if ( pReader->pCache->Load( strPath, THUMB_SIZE ) )
+			pReader->nHits++;
+		pReader->nLoads++;
+	}
+
+	return 0;
+}
+
+// Shipping CDatabase and DatabasePool: thumbnails stored in batches while a view loads them,
+// with the old flush that held the cache lock during the transaction and the current one
+void BenchThumbs()
+{
+	TCHAR szTemp[ MAX_PATH ] = {};
+	GetTempPath( MAX_PATH, szTemp );
+
+	std::vector< BYTE > pData( THUMB_SIZE );
+	for ( DWORD nByte = 0; nByte < THUMB_SIZE; nByte++ )
+		pData[ nByte ] = (BYTE)NextRandom();
+
+	for ( int nPass = 0; nPass < 2; nPass++ )
+	{
+		const bool bLockedFlush = ( nPass == 0 );
+
+		CString strDatabase;
+		strDatabase.Format( _T("%sEnvyBenchmark%s.db3"), szTemp, bLockedFlush ? _T("Locked") : _T("") );
+		DeleteFile( strDatabase );
+		{
+			// As CThumbCache::InitDatabase
+			CDatabase db( strDatabase );
+			if ( ! db || ! db.Exec( L"CREATE TABLE Files ("
+				L"Filename TEXT UNIQUE NOT NULL PRIMARY KEY, "
+				L"FileSize INTEGER NOT NULL, "
+				L"LastWriteTime INTEGER NOT NULL, "
+				L"Image BLOB NOT NULL, "
+				L"Flags INTEGER DEFAULT 0 NULL, "
+				L"SHA1 TEXT NULL, TTH TEXT NULL, ED2K TEXT NULL, MD5 TEXT NULL);" ) )
+			{
+				_ftprintf( stderr, _T("Thumbnail database error: %s\n"), (LPCTSTR)db.GetLastErrorMessage() );
+				return;
+			}
+			db.Exec( L"PRAGMA journal_mode=WAL;" );
+		}
+
+		{
+			CThumbCacheStandIn oCache( strDatabase, bLockedFlush );
+			ThumbReader oReader = { &oCache, FALSE, 0, 0 };
+
+			__int64 tStart = GetMicroCount();
+			HANDLE hThread = (HANDLE)_beginthreadex( NULL, 0, ThumbReaderThread, &oReader, 0, NULL );
+
+			for ( DWORD nStore = 0; nStore < THUMB_STORES; nStore++ )
+			{
+				CString strPath;
+				strPath.Format( _T("c:\\library\\album %u\\track_%04u.jpg"), nStore / 20, nStore );
+				oCache.Store( strPath, THUMB_SIZE, pData );
+			}
+			oCache.Flush();
+			const __int64 tElapsed = GetMicroCount() - tStart;
+
+			InterlockedExchange( &oReader.bStop, TRUE );
+			if ( hThread )
+			{
+				WaitForSingleObject( hThread, INFINITE );
+				CloseHandle( hThread );
+			}
+
+			Report( bLockedFlush ? _T("thumbs.store.locked") : _T("thumbs.store"), THUMB_STORES, tElapsed );
+			Report( bLockedFlush ? _T("thumbs.load.locked") : _T("thumbs.load"), oReader.nLoads, tElapsed );
+			g_nChecksum += oReader.nHits;
+		}
+
+		DatabasePool.Clear();
+		DeleteFile( strDatabase );
+		DeleteFile( strDatabase + _T("-wal") );
+		DeleteFile( strDatabase + _T("-shm") );
+	}
+}
+
+// Shipping CBENode: decode as torrent load, encode and info hash as CBTInfo does
+void BenchTorrents(const std::vector< std::vector< BYTE > >& pTorrents)
+{
+	const DWORD nPasses = 50;
+	const QWORD nCount = (QWORD)pTorrents.size() * nPasses;
+
+	__int64 tStart = GetMicroCount();
+	for ( DWORD nPass = 0; nPass < nPasses; nPass++ )
+	{
+		for ( size_t nTorrent = 0; nTorrent < pTorrents.size(); nTorrent++ )
+		{
+			if ( CBENode* pRoot = CBENode::Decode( &pTorrents[ nTorrent ][ 0 ], (DWORD)pTorrents[ nTorrent ].size() ) )
+			{
+				g_nChecksum += pRoot->GetCount();
+				delete pRoot;
+			}
+		}
+	}
+	Report( _T("benode.decode"), nCount, GetMicroCount() - tStart );
+
+	std::vector< CBENode* > pRoots;
+	for ( size_t nTorrent = 0; nTorrent < pTorrents.size(); nTorrent++ )
+	{
+		if ( CBENode* pRoot = CBENode::Decode( &pTorrents[ nTorrent ][ 0 ], (DWORD)pTorrents[ nTorrent ].size() ) )
+			pRoots.push_back( pRoot );
+	}
+
+	tStart = GetMicroCount();
+	for ( DWORD nPass = 0; nPass < nPasses; nPass++ )
+	{
+		for ( size_t nRoot = 0; nRoot < pRoots.size(); nRoot++ )
+		{
+			CBuffer oBuffer;
+			pRoots[ nRoot ]->Encode( &oBuffer );
+			g_nChecksum += oBuffer.m_nLength;
+		}
+	}
+	Report( _T("benode.encode"), (QWORD)pRoots.size() * nPasses, GetMicroCount() - tStart );
+
+	tStart = GetMicroCount();
+	for ( DWORD nPass = 0; nPass < nPasses; nPass++ )
+	{
+		for ( size_t nRoot = 0; nRoot < pRoots.size(); nRoot++ )
+		{
+			if ( const CBENode* pInfo = pRoots[ nRoot ]->GetNode( "info" ) )
+			{
+				BYTE pHash[ 20 ];
+				pInfo->GetSHA1().GetHash( pHash );
+				g_nChecksum += pHash[ 0 ];
+			}
+		}
+	}
+	Report( _T("benode.infohash"), (QWORD)pRoots.size() * nPasses, GetMicroCount() - tStart );
+
+	for ( size_t nRoot = 0; nRoot < pRoots.size(); nRoot++ )
+		delete pRoots[ nRoot ];
+}
+
+//////////////////////////////////////////////////////////////////////
+// Entry point
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	LPCTSTR pszCorpus = ( argc > 1 ) ? argv[ 1 ] : NULL;
+	LPCTSTR pszResults = ( argc > 2 ) ? argv[ 2 ] : _T("Benchmark.csv");
+
+#ifdef _WIN64
+	_tprintf( _T("Platform : 64-bit\n") );
+#else
+	_tprintf( _T("Platform : 32-bit\n") );
+#endif
+
+#ifdef _DEBUG
+	_tprintf( _T("Build    : Debug\n") );
+#else
+	_tprintf( _T("Build    : Release\n") );
+#endif
+
+	_tprintf( _T("Corpus   : %s\n\n"), pszCorpus ? pszCorpus : _T("(synthetic)") );
+
+	if ( _tfopen_s( &g_pResults, pszResults, _T("w") ) == 0 )
+		_ftprintf( g_pResults, _T("name,operations,microseconds,ns_per_op\n") );
+
+	CStringArray pWords;
+	LoadKeywords( pszCorpus, pWords );
+	BenchKeywords( pWords );
+	BenchLibrary( pWords );
+
+	std::vector< FragmentOp > pOps;
+	LoadFragments( pszCorpus, pOps );
+	BenchFragments< FragmentList >( _T("fragments"), pOps );
+	BenchFragments< FlatFragmentList >( _T("fragments.flat"), pOps );
+
+	BenchQueue();
+	BenchRoutes();
+	BenchHosts();
+	BenchPackets( pszCorpus );
+	BenchZLib( pszCorpus );
+	BenchThumbs();
+
+	std::vector< std::vector< BYTE > > pTorrents;
+	LoadTorrents( pszCorpus, pTorrents );
+	BenchTorrents( pTorrents );
+
+	bool bTemporary;
+	CStringArray pFiles;
+	LoadMedia( pszCorpus, pFiles, bTemporary );
+	BenchMedia( pFiles );
+	BenchExtractors( pFiles );
+	for ( INT_PTR nFile = 0; bTemporary && nFile < pFiles.GetSize(); nFile++ )
+		DeleteFile( pFiles[ nFile ] );
+
+	if ( g_pResults )
+		fclose( g_pResults );
+
+	_tprintf( _T("\nChecksum : %08x\n"), g_nChecksum );
+
+	return 0;
+}
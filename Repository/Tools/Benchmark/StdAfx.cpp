@@ -0,0 +1,5 @@
+//
+// StdAfx.cpp - Empty workaround stub file
+//
+
+#include "StdAfx.h"
@@ -0,0 +1,84 @@
+//
+// StdAfx.h
+//
+// This file is part of Envy (getenvy.com)  2020
+//
+// Envy is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation (fsf.org);
+// either version 3 of the License, or later version (at your option).
+//
+// Envy is distributed in the hope that it will be useful,
+// but AS-IS WITHOUT ANY WARRANTY; without even implied warranty
+// of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// (http://www.gnu.org/licenses/gpl.html)
+//
+
+#pragma once
+
+// TargetVer.h: 0x0601 Windows 7, 0x0A00 Windows 10
+
+#ifndef WINVER
+#define WINVER 0x0601
+#endif
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+
+#ifndef _WIN32_WINDOWS
+#define _WIN32_WINDOWS 0x0600
+#endif
+
+#ifndef _WIN32_IE
+#define _WIN32_IE 0x0800
+#endif
+
+#ifndef _SECURE_ATL
+#define _SECURE_ATL 1
+#endif
+
+#ifndef VC_EXTRALEAN
+#define VC_EXTRALEAN            // Exclude rarely-used stuff from Windows headers
+#endif
+
+#define _ATL_CSTRING_EXPLICIT_CONSTRUCTORS      // some CString constructors will be explicit
+
+#include <afx.h>            // MFC core, no UI
+#include <afxtempl.h>       // MFC templates
+#include <afxmt.h>          // MFC threads
+#include <atlbase.h>        // CAutoPtr for BENode
+#include <winsock2.h>       // SOCKADDR_IN for RouteCache, IN_ADDR for host cache
+
+#include <process.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+typedef unsigned __int64 QWORD;
+typedef unsigned __int64 uint64;
+
+const QWORD SIZE_UNKNOWN = ~0ull;
+
+// As Envy StdAfx.h, used by SQLite.cpp
+class CQuickLock
+{
+public:
+	explicit CQuickLock(CSyncObject& oMutex) : m_oMutex( oMutex ) { oMutex.Lock(); }
+	~CQuickLock() { m_oMutex.Unlock(); }
+private:
+	CSyncObject& m_oMutex;
+	CQuickLock(const CQuickLock&);
+	CQuickLock& operator=(const CQuickLock&);
+};
+
+#include "..\..\..\Envy\MinMax.h"		// As Envy, the windows.h macros evaluate arguments twice
+
+#include "..\..\..\HashLib\HashLib.h"
+#include "..\..\..\Envy\Hashes.hpp"
+#include "..\..\..\Envy\Strings.h"